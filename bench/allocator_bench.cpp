@@ -0,0 +1,436 @@
+/**
+ * @file allocator_bench.cpp
+ * @brief Custom Memory Allocator - Microbenchmark Suite
+ *
+ * Google Benchmark measurements of ns/op and throughput, each run against
+ * the system malloc for comparison:
+ * - malloc/free churn over fixed, uniform and power-law size distributions
+ * - realloc growth from 16 bytes up to 1 MB
+ * - churn at 1K, 100K and 1M live blocks (heap occupancy)
+ * - 1 to 64 threads through the global thread-cached allocator
+ * - each placement policy on mixed sizes, with search cost and
+ *   fragmentation counters
+ * - power-of-two 4 KB to 1 MB buffers on a heap and a buddy allocator
+ * - small-object churn and occupancy on slabs over a heap
+ * - the same heap in hardened mode, for the cost of its checks
+ *
+ * JSON for dashboards: --benchmark_out=results.json
+ * --benchmark_out_format=json (or build the bench_json target).
+ */
+
+#include "buddy_allocator.hpp"
+#include "memory_allocator.hpp"
+#include "slab_allocator.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace CustomAllocator;
+
+namespace {
+
+//=============================================================================
+// Backends
+//=============================================================================
+
+/// The platform's malloc, the baseline for every comparison
+struct SystemMalloc {
+  void *allocate(size_t size) { return std::malloc(size); }
+  void *reallocate(void *ptr, size_t size) { return std::realloc(ptr, size); }
+  void deallocate(void *ptr) { std::free(ptr); }
+};
+
+/// One growable MemoryAllocator heap (single-threaded)
+struct Heap {
+  explicit Heap(PlacementPolicy placement = PlacementPolicy::FirstFit)
+      : heap(options(placement)) {}
+
+  static AllocatorOptions options(PlacementPolicy placement) {
+    AllocatorOptions options;
+    options.heap_size = 64 * 1024 * 1024;
+    options.growable = true;
+    options.placement = placement;
+    return options;
+  }
+
+  void *allocate(size_t size) { return heap.my_malloc(size); }
+  void *reallocate(void *ptr, size_t size) {
+    return heap.my_realloc(ptr, size);
+  }
+  void deallocate(void *ptr) { heap.my_free(ptr); }
+
+  MemoryAllocator heap;
+};
+
+/// The same heap with canaries, free validation and quarantine
+struct HardenedHeap {
+  HardenedHeap() : heap(options()) {}
+
+  static AllocatorOptions options() {
+    AllocatorOptions options = Heap::options(PlacementPolicy::FirstFit);
+    options.hardened = true;
+    return options;
+  }
+
+  void *allocate(size_t size) { return heap.my_malloc(size); }
+  void *reallocate(void *ptr, size_t size) {
+    return heap.my_realloc(ptr, size);
+  }
+  void deallocate(void *ptr) { heap.my_free(ptr); }
+
+  MemoryAllocator heap;
+};
+
+/// A buddy allocator with a 64 MB heap of 4 KB to 2 MB blocks
+struct Buddy {
+  Buddy() : buddy(options()) {}
+
+  static BuddyOptions options() {
+    BuddyOptions options;
+    options.heap_size = 64 * 1024 * 1024;
+    return options;
+  }
+
+  void *allocate(size_t size) { return buddy.allocate(size); }
+  void deallocate(void *ptr) { buddy.deallocate(ptr); }
+
+  BuddyAllocator buddy;
+};
+
+/// 64 KB slabs over a growable heap (objects of up to 512 bytes)
+struct Slabs {
+  Slabs() : heap(Heap::options(PlacementPolicy::FirstFit)), slabs(heap) {}
+
+  void *allocate(size_t size) { return slabs.allocate(size); }
+  void deallocate(void *ptr) { slabs.deallocate(ptr); }
+
+  MemoryAllocator heap;
+  SlabAllocator slabs;
+};
+
+/// The thread-cached global custom_* functions
+struct Global {
+  void *allocate(size_t size) { return custom_malloc(size); }
+  void *reallocate(void *ptr, size_t size) {
+    return custom_realloc(ptr, size);
+  }
+  void deallocate(void *ptr) { custom_free(ptr); }
+};
+
+//=============================================================================
+// Size Distributions
+//=============================================================================
+
+enum class Sizes { Fixed, Uniform, PowerLaw };
+
+/// Entries in every precomputed size and index table (a power of two)
+constexpr size_t TABLE_SIZE = 1 << 16;
+
+/// Live blocks the churn benchmarks keep around
+constexpr size_t WINDOW = 1024;
+
+/**
+ * Deterministic request sizes, generated before timing starts so the RNG
+ * never shows up in the measurements.
+ * - Fixed: 64 bytes
+ * - Uniform: 16 to 1024 bytes
+ * - PowerLaw: Pareto (alpha 1.1) from 16 bytes, capped at 64 KB, so most
+ *   requests are tiny and a few are very large
+ */
+std::vector<size_t> makeSizes(Sizes distribution, size_t min_size = 16,
+                              size_t max_size = 1024) {
+  std::mt19937_64 rng(42);
+  std::vector<size_t> sizes(TABLE_SIZE);
+  switch (distribution) {
+  case Sizes::Fixed:
+    std::fill(sizes.begin(), sizes.end(), 64);
+    break;
+  case Sizes::Uniform: {
+    std::uniform_int_distribution<size_t> uniform(min_size, max_size);
+    for (size_t &size : sizes) {
+      size = uniform(rng);
+    }
+    break;
+  }
+  case Sizes::PowerLaw: {
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (size_t &size : sizes) {
+      double pareto = 16.0 / std::pow(1.0 - unit(rng), 1.0 / 1.1);
+      size = static_cast<size_t>(std::min(pareto, 64.0 * 1024));
+    }
+    break;
+  }
+  }
+  return sizes;
+}
+
+/// Deterministic slot indices below limit
+std::vector<size_t> makeIndices(size_t limit, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<size_t> uniform(0, limit - 1);
+  std::vector<size_t> indices(TABLE_SIZE);
+  for (size_t &index : indices) {
+    index = uniform(rng);
+  }
+  return indices;
+}
+
+//=============================================================================
+// Benchmarks
+//=============================================================================
+
+/**
+ * Free a random live block and allocate its replacement. One iteration is
+ * one free plus one malloc.
+ */
+template <typename Backend, Sizes Distribution>
+void BM_MallocFree(benchmark::State &state) {
+  auto backend = std::make_unique<Backend>();
+  const std::vector<size_t> sizes = makeSizes(Distribution);
+  const std::vector<size_t> slots = makeIndices(WINDOW, 7);
+
+  std::vector<void *> live(WINDOW);
+  for (size_t i = 0; i < WINDOW; i++) {
+    live[i] = backend->allocate(sizes[i]);
+  }
+
+  size_t i = 0;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    size_t slot = slots[i & (TABLE_SIZE - 1)];
+    size_t size = sizes[i & (TABLE_SIZE - 1)];
+    backend->deallocate(live[slot]);
+    live[slot] = backend->allocate(size);
+    benchmark::DoNotOptimize(live[slot]);
+    bytes += size;
+    i++;
+  }
+
+  for (void *ptr : live) {
+    backend->deallocate(ptr);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetBytesProcessed(static_cast<int64_t>(bytes));
+}
+
+/**
+ * Grow one buffer by 1.5x from 16 bytes to 1 MB, touching each new tail
+ * as a growing vector would. One iteration is the whole growth sequence.
+ */
+template <typename Backend>
+void BM_ReallocGrowth(benchmark::State &state) {
+  auto backend = std::make_unique<Backend>();
+  size_t reallocs = 0;
+  for (auto _ : state) {
+    size_t size = 16;
+    char *buffer = static_cast<char *>(backend->allocate(size));
+    while (size < 1024 * 1024) {
+      size_t grown = size + size / 2;
+      buffer = static_cast<char *>(backend->reallocate(buffer, grown));
+      buffer[grown - 1] = 1;
+      size = grown;
+      reallocs++;
+    }
+    benchmark::DoNotOptimize(buffer);
+    backend->deallocate(buffer);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(reallocs));
+}
+
+/**
+ * Churn with state.range(0) live blocks of 16 to 128 bytes, which shows
+ * how each allocator's cost grows with heap occupancy.
+ */
+template <typename Backend>
+void BM_Occupancy(benchmark::State &state) {
+  const size_t live_count = static_cast<size_t>(state.range(0));
+  auto backend = std::make_unique<Backend>();
+  const std::vector<size_t> sizes = makeSizes(Sizes::Uniform, 16, 128);
+  const std::vector<size_t> slots = makeIndices(live_count, 11);
+
+  std::vector<void *> live(live_count);
+  for (size_t i = 0; i < live_count; i++) {
+    live[i] = backend->allocate(sizes[i & (TABLE_SIZE - 1)]);
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    size_t slot = slots[i & (TABLE_SIZE - 1)];
+    backend->deallocate(live[slot]);
+    live[slot] = backend->allocate(sizes[(i * 3) & (TABLE_SIZE - 1)]);
+    benchmark::DoNotOptimize(live[slot]);
+    i++;
+  }
+
+  for (void *ptr : live) {
+    backend->deallocate(ptr);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["live_blocks"] = static_cast<double>(live_count);
+}
+
+/**
+ * Uniform churn on every thread of the run. Each thread keeps its own
+ * window; items/s is the combined throughput.
+ */
+template <typename Backend>
+void BM_Threads(benchmark::State &state) {
+  Backend backend;
+  const std::vector<size_t> sizes = makeSizes(Sizes::Uniform, 16, 512);
+  const std::vector<size_t> slots =
+      makeIndices(WINDOW, 100 + static_cast<uint64_t>(state.thread_index()));
+
+  std::vector<void *> live(WINDOW);
+  for (size_t i = 0; i < WINDOW; i++) {
+    live[i] = backend.allocate(sizes[i]);
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    size_t slot = slots[i & (TABLE_SIZE - 1)];
+    backend.deallocate(live[slot]);
+    live[slot] = backend.allocate(sizes[i & (TABLE_SIZE - 1)]);
+    benchmark::DoNotOptimize(live[slot]);
+    i++;
+  }
+
+  for (void *ptr : live) {
+    backend.deallocate(ptr);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Power-law churn on a heap using placement policy state.range(0). Times
+ * the same work as BM_MallocFree and adds the policy's cost and its
+ * effect: free blocks examined per search and external fragmentation.
+ */
+void BM_Placement(benchmark::State &state) {
+  const auto policy = static_cast<PlacementPolicy>(state.range(0));
+  auto backend = std::make_unique<Heap>(policy);
+  const std::vector<size_t> sizes = makeSizes(Sizes::PowerLaw);
+  const std::vector<size_t> slots = makeIndices(WINDOW * 4, 13);
+
+  std::vector<void *> live(WINDOW * 4);
+  for (size_t i = 0; i < live.size(); i++) {
+    live[i] = backend->allocate(sizes[i]);
+  }
+
+  size_t i = 0;
+  for (auto _ : state) {
+    size_t slot = slots[i & (TABLE_SIZE - 1)];
+    backend->deallocate(live[slot]);
+    live[slot] = backend->allocate(sizes[(i * 5) & (TABLE_SIZE - 1)]);
+    benchmark::DoNotOptimize(live[slot]);
+    i++;
+  }
+
+  MemoryStats stats = backend->heap.getStats();
+  for (void *ptr : live) {
+    backend->deallocate(ptr);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(placementPolicyName(policy));
+  state.counters["search_steps"] = stats.getAverageSearchLength();
+  state.counters["fragmentation"] = stats.getFragmentationRatio();
+  state.counters["heap_mb"] =
+      static_cast<double>(stats.total_heap_size) / (1024 * 1024);
+}
+
+/**
+ * Churn of power-of-two I/O buffers from 4 KB to 1 MB, 32 live at a time.
+ * Counts how many come back aligned to their own size, which a page- or
+ * DMA-oriented caller would otherwise have to over-allocate for.
+ */
+template <typename Backend>
+void BM_Buffers(benchmark::State &state) {
+  constexpr size_t LIVE = 32;
+  auto backend = std::make_unique<Backend>();
+  const std::vector<size_t> orders = makeIndices(9, 17);
+  const std::vector<size_t> slots = makeIndices(LIVE, 19);
+
+  std::vector<void *> live(LIVE);
+  std::vector<size_t> sizes(LIVE);
+  for (size_t i = 0; i < LIVE; i++) {
+    sizes[i] = size_t(4096) << orders[i];
+    live[i] = backend->allocate(sizes[i]);
+  }
+
+  size_t i = 0;
+  size_t aligned = 0;
+  for (auto _ : state) {
+    size_t slot = slots[i & (TABLE_SIZE - 1)];
+    backend->deallocate(live[slot]);
+    sizes[slot] = size_t(4096) << orders[(i * 7) & (TABLE_SIZE - 1)];
+    live[slot] = backend->allocate(sizes[slot]);
+    benchmark::DoNotOptimize(live[slot]);
+    aligned += (reinterpret_cast<uintptr_t>(live[slot]) & (sizes[slot] - 1)) == 0;
+    i++;
+  }
+
+  for (void *ptr : live) {
+    backend->deallocate(ptr);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.counters["naturally_aligned"] =
+      state.iterations() ? static_cast<double>(aligned) / state.iterations()
+                         : 0.0;
+}
+
+} // namespace
+
+//=============================================================================
+// Registration
+//=============================================================================
+
+BENCHMARK_TEMPLATE(BM_MallocFree, SystemMalloc, Sizes::Fixed);
+BENCHMARK_TEMPLATE(BM_MallocFree, Heap, Sizes::Fixed);
+BENCHMARK_TEMPLATE(BM_MallocFree, HardenedHeap, Sizes::Fixed);
+BENCHMARK_TEMPLATE(BM_MallocFree, Global, Sizes::Fixed);
+BENCHMARK_TEMPLATE(BM_MallocFree, Slabs, Sizes::Fixed);
+BENCHMARK_TEMPLATE(BM_MallocFree, SystemMalloc, Sizes::Uniform);
+BENCHMARK_TEMPLATE(BM_MallocFree, Heap, Sizes::Uniform);
+BENCHMARK_TEMPLATE(BM_MallocFree, HardenedHeap, Sizes::Uniform);
+BENCHMARK_TEMPLATE(BM_MallocFree, Global, Sizes::Uniform);
+BENCHMARK_TEMPLATE(BM_MallocFree, SystemMalloc, Sizes::PowerLaw);
+BENCHMARK_TEMPLATE(BM_MallocFree, Heap, Sizes::PowerLaw);
+BENCHMARK_TEMPLATE(BM_MallocFree, HardenedHeap, Sizes::PowerLaw);
+BENCHMARK_TEMPLATE(BM_MallocFree, Global, Sizes::PowerLaw);
+
+BENCHMARK_TEMPLATE(BM_ReallocGrowth, SystemMalloc);
+BENCHMARK_TEMPLATE(BM_ReallocGrowth, Heap);
+BENCHMARK_TEMPLATE(BM_ReallocGrowth, HardenedHeap);
+BENCHMARK_TEMPLATE(BM_ReallocGrowth, Global);
+
+BENCHMARK_TEMPLATE(BM_Occupancy, SystemMalloc)
+    ->Arg(1000)->Arg(100000)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_Occupancy, Heap)->Arg(1000)->Arg(100000)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_Occupancy, HardenedHeap)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_Occupancy, Global)->Arg(1000)->Arg(100000)->Arg(1000000);
+BENCHMARK_TEMPLATE(BM_Occupancy, Slabs)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+BENCHMARK_TEMPLATE(BM_Threads, SystemMalloc)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Threads, Global)->ThreadRange(1, 64)->UseRealTime();
+
+BENCHMARK(BM_Placement)
+    ->Arg(static_cast<int>(PlacementPolicy::FirstFit))
+    ->Arg(static_cast<int>(PlacementPolicy::NextFit))
+    ->Arg(static_cast<int>(PlacementPolicy::BestFit))
+    ->Arg(static_cast<int>(PlacementPolicy::AddressOrderedFirstFit))
+    ->Arg(static_cast<int>(PlacementPolicy::Tlsf));
+
+BENCHMARK_TEMPLATE(BM_Buffers, SystemMalloc);
+BENCHMARK_TEMPLATE(BM_Buffers, Heap);
+BENCHMARK_TEMPLATE(BM_Buffers, Buddy);
+
+BENCHMARK_MAIN();
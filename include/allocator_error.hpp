@@ -0,0 +1,102 @@
+/**
+ * @file allocator_error.hpp
+ * @brief Custom Memory Allocator - Error Codes and Error Hook
+ *
+ * Allocation failures and misuse are reported without any I/O:
+ * - last_error() holds the calling thread's most recent error
+ * - on_error() installs an optional hook that sees every error
+ *
+ * Both are silent by default. diagnostics.hpp provides a hook that prints
+ * errors to stderr.
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef ALLOCATOR_ERROR_HPP
+#define ALLOCATOR_ERROR_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CustomAllocator {
+
+/**
+ * @enum AllocError
+ * @brief What went wrong in an allocator call
+ */
+enum class AllocError : uint8_t {
+    None,               ///< No error since the last clear_last_error()
+    OutOfMemory,        ///< A request could not be satisfied
+    InvalidPointer,     ///< A pointer the allocator does not own
+    DoubleFree,         ///< A block that is already free was freed again
+    SizeOverflow,       ///< count * size overflowed
+    InvalidAlignment,   ///< An alignment that is not a power of two
+    SizeMismatch,       ///< A sized free whose size does not match the block
+    CorruptedBlock,     ///< A block header or its boundary tags failed a hardened check
+    UseAfterFree        ///< A quarantined block was written to or reallocated
+};
+
+/**
+ * @struct ErrorInfo
+ * @brief Details of one error, passed to the on_error hook
+ */
+struct ErrorInfo {
+    AllocError error;       ///< What went wrong
+    const char* function;   ///< Entry point that detected it, e.g. "my_free"
+    const void* ptr;        ///< Pointer involved (nullptr if none)
+    size_t size;            ///< Size involved (0 if none)
+};
+
+/**
+ * @brief Error hook type
+ *
+ * Runs on the failing thread, possibly while an arena lock is held, so it
+ * must not allocate from the allocator that reported the error.
+ */
+using ErrorHandler = void (*)(const ErrorInfo& info);
+
+/**
+ * @brief Most recent error on the calling thread
+ *
+ * Like errno, successful calls leave it unchanged.
+ *
+ * @return Last error, or AllocError::None
+ */
+AllocError last_error() noexcept;
+
+/**
+ * @brief Reset the calling thread's last_error() to AllocError::None
+ */
+void clear_last_error() noexcept;
+
+/**
+ * @brief Install the hook called for every error
+ * @param handler New hook, or nullptr to stay silent (the default)
+ * @return Previously installed hook
+ */
+ErrorHandler on_error(ErrorHandler handler) noexcept;
+
+/**
+ * @brief Short description of an error code
+ * @param error Error code
+ * @return Static string such as "Out of memory"
+ */
+const char* errorName(AllocError error) noexcept;
+
+/**
+ * @brief Record an error for last_error() and pass it to the hook
+ *
+ * Used by the allocators on their failure paths.
+ *
+ * @param error What went wrong
+ * @param function Entry point that detected it
+ * @param ptr Pointer involved (optional)
+ * @param size Size involved (optional)
+ */
+void reportError(AllocError error, const char* function,
+                 const void* ptr = nullptr, size_t size = 0) noexcept;
+
+} // namespace CustomAllocator
+
+#endif // ALLOCATOR_ERROR_HPP
@@ -0,0 +1,369 @@
+/**
+ * @file arena_set.hpp
+ * @brief Custom Memory Allocator - Sharded Arenas
+ *
+ * A set of independent MemoryAllocator heaps, each behind its own lock:
+ * - Threads are spread over the arenas round-robin, by CPU id, or to the
+ *   arenas of their own NUMA node
+ * - Frees are routed to the owning arena by address-range lookup, in the
+ *   fixed primary heaps or a table of extra segments and large mappings
+ * - Allocation throughput scales with cores instead of one heap lock
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef ARENA_SET_HPP
+#define ARENA_SET_HPP
+
+#include "memory_allocator.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CustomAllocator {
+
+/**
+ * @class ArenaSet
+ * @brief Thread-safe allocator sharded over N locked MemoryAllocator arenas
+ */
+class ArenaSet {
+public:
+    /**
+     * @enum Assignment
+     * @brief How threads are mapped to arenas
+     */
+    enum class Assignment {
+        RoundRobin,     ///< Each new thread takes the next arena
+        CpuId,          ///< Use the arena of the CPU the thread runs on
+        NumaNode        ///< Node-bound arenas; use one on the thread's current node
+    };
+
+    /// Returned by arenaIndexFor() for pointers outside every arena
+    static constexpr size_t NO_ARENA = static_cast<size_t>(-1);
+
+    /**
+     * @brief Create a set of arenas
+     *
+     * With Assignment::NumaNode the count is rounded up to a multiple of
+     * osNumaNodeCount() and arena i is bound to node i % nodeCount(), so
+     * every node gets the same number of arenas.
+     *
+     * @param arena_count Number of arenas (at least 1)
+     * @param heap_size Heap size of each arena
+     * @param assignment Thread-to-arena mapping
+     */
+    ArenaSet(size_t arena_count, size_t heap_size,
+             Assignment assignment = Assignment::RoundRobin);
+
+    /**
+     * @brief Create a set of arenas with full heap options
+     *
+     * Every arena gets a copy of the options; with Assignment::NumaNode
+     * numa_node is replaced per arena as above. The other constructor
+     * uses the defaults with growable set.
+     *
+     * @param arena_count Number of arenas (at least 1)
+     * @param options Heap options of each arena
+     * @param assignment Thread-to-arena mapping
+     */
+    ArenaSet(size_t arena_count, const AllocatorOptions& options,
+             Assignment assignment = Assignment::RoundRobin);
+
+    /**
+     * @brief Destructor - frees every arena and the mapping table
+     */
+    ~ArenaSet();
+
+    ArenaSet(const ArenaSet&) = delete;
+    ArenaSet& operator=(const ArenaSet&) = delete;
+
+    /**
+     * @brief Allocate from the calling thread's arena
+     *
+     * Arenas grow with extra OS segments; falls back to the other arenas
+     * only when the thread's arena cannot grow.
+     *
+     * @param size Number of bytes to allocate
+     * @return Pointer to allocated memory, or nullptr on failure
+     */
+    void* my_malloc(size_t size);
+
+    /**
+     * @brief Allocate from the arenas of one NUMA node only
+     *
+     * Never spills to other nodes, so the memory stays node-local; with a
+     * set that is not NUMA-bound every arena counts as node 0.
+     *
+     * @param size Number of bytes to allocate
+     * @param node Node index below nodeCount()
+     * @return Pointer to allocated memory, or nullptr for an unknown node
+     *         or when the node's arenas cannot grow (OutOfMemory)
+     */
+    void* my_malloc_on_node(size_t size, int node);
+
+    /**
+     * @brief Free a pointer back to whichever arena owns it
+     * @param ptr Pointer previously returned by this set
+     */
+    void my_free(void* ptr);
+
+    /**
+     * @brief Free a pointer whose allocation size the caller knows
+     * @param ptr Pointer previously returned by this set
+     * @param size Size originally requested for the block
+     */
+    void my_free_sized(void* ptr, size_t size);
+
+    /**
+     * @brief Free a pointer to an arena already found with arenaIndexFor()
+     * @param index Owning arena
+     * @param ptr Pointer previously returned by this set
+     */
+    void freeInArena(size_t index, void* ptr);
+
+    /**
+     * @brief Sized free to an arena already found with arenaIndexFor()
+     * @param index Owning arena
+     * @param ptr Pointer previously returned by this set
+     * @param size Size originally requested for the block
+     */
+    void freeSizedInArena(size_t index, void* ptr, size_t size);
+
+    /**
+     * @brief Reallocate within the owning arena, moving arenas if it is full
+     * @param ptr Existing allocation (can be nullptr)
+     * @param new_size New size in bytes
+     * @return Pointer to reallocated memory, or nullptr on failure (a pointer
+     *         the owning heap rejects is never moved)
+     */
+    void* my_realloc(void* ptr, size_t new_size);
+
+    /**
+     * @brief Allocate and zero-initialize memory from the thread's arena
+     * @param count Number of elements
+     * @param size Size of each element
+     * @return Pointer to allocated and zeroed memory
+     */
+    void* my_calloc(size_t count, size_t size);
+
+    /**
+     * @brief Allocate aligned memory from the thread's arena
+     * @param alignment Required alignment (a power of two)
+     * @param size Number of bytes to allocate
+     * @return Aligned pointer, or nullptr on failure
+     */
+    void* my_aligned_alloc(size_t alignment, size_t size);
+
+    /**
+     * @brief Allocate up to count blocks of one size under a single lock
+     * @param size Size of each block
+     * @param count Number of blocks wanted
+     * @param out Receives the allocated pointers
+     * @return Number of blocks actually allocated
+     */
+    size_t allocateBatch(size_t size, size_t count, void** out);
+
+    /**
+     * @brief Free a group of pointers, taking each arena lock once
+     * @param ptrs Pointers to free (the array is reordered)
+     * @param count Number of pointers
+     */
+    void freeBatch(void** ptrs, size_t count);
+
+    /**
+     * @brief Take every arena lock in index order, then the mapping table's
+     *        (e.g. around fork())
+     */
+    void lockAll();
+
+    /**
+     * @brief Release the locks taken by lockAll()
+     */
+    void unlockAll();
+
+    /**
+     * @brief Find the arena whose heap contains a pointer
+     *
+     * Primary heaps are checked without any lock; extra segments and
+     * large mappings under the mapping table's own short lock, never an
+     * arena lock.
+     *
+     * @param ptr Pointer to look up
+     * @return Arena index, or NO_ARENA if no arena owns it
+     */
+    size_t arenaIndexFor(const void* ptr) const;
+
+    /**
+     * @brief Check if a pointer lies inside any arena's heap
+     * @param ptr Pointer to check
+     * @return true if some arena owns the pointer
+     */
+    bool isValidPointer(const void* ptr) const {
+        return arenaIndexFor(ptr) != NO_ARENA;
+    }
+
+    /**
+     * @brief Get the arena assigned to the calling thread
+     * @return Arena index in [0, arenaCount())
+     */
+    size_t currentArenaIndex() const;
+
+    /// Number of arenas in the set
+    size_t arenaCount() const { return arenas_.size(); }
+
+    /// NUMA nodes the arenas are spread over (1 unless Assignment::NumaNode)
+    size_t nodeCount() const { return node_count_; }
+
+    /// Node an arena's memory is placed on (0 in a set that is not NUMA-bound)
+    int arenaNode(size_t index) const {
+        return static_cast<int>(index % node_count_);
+    }
+
+    /**
+     * @brief Check whether an arena is on the calling thread's node
+     *
+     * The global functions keep remote blocks out of the thread cache with
+     * it, so a block freed on another node goes straight home.
+     *
+     * @return true if the set has one node or the arena is on the current one
+     */
+    bool isNodeLocal(size_t index) const {
+        return node_count_ == 1 || arenaNode(index) == osCurrentNumaNode();
+    }
+
+    /**
+     * @brief Access one arena's allocator
+     *
+     * The caller must hold arenaLock(index) while using it concurrently
+     * with other threads.
+     */
+    MemoryAllocator& arena(size_t index) { return arenas_[index]->heap; }
+
+    /// Lock protecting one arena
+    std::mutex& arenaLock(size_t index) const { return arenas_[index]->lock; }
+
+    /**
+     * @brief Return free memory of every arena to the OS
+     * @return Bytes released or purged (see MemoryAllocator::trim())
+     */
+    size_t trim();
+
+    /**
+     * @brief Switch every arena to another placement policy
+     * @return false if some arena had no room for the TLSF index (those
+     *         arenas keep their old policy)
+     * @see MemoryAllocator::setPlacementPolicy()
+     */
+    bool setPlacementPolicy(PlacementPolicy policy);
+
+    /**
+     * @brief Get statistics for one arena
+     * @param index Arena index
+     * @return Snapshot of that arena's MemoryStats
+     */
+    MemoryStats getArenaStats(size_t index) const;
+
+    /**
+     * @brief Snapshot one arena's heap map under its lock
+     * @see MemoryAllocator::heapMap()
+     */
+    size_t heapMap(size_t index, HeapMapEntry* out, size_t capacity) const;
+
+    /**
+     * @brief Get statistics summed over the arenas of one NUMA node
+     * @param node Node index below nodeCount()
+     * @return Combined MemoryStats of that node's arenas
+     */
+    MemoryStats getNodeStats(int node) const;
+
+    /**
+     * @brief Get statistics summed over every arena
+     * @return Combined MemoryStats
+     */
+    MemoryStats getStats() const;
+
+private:
+    /**
+     * @struct Arena
+     * @brief One heap and the lock that serializes it
+     */
+    struct Arena {
+        MemoryAllocator heap;
+        mutable std::mutex lock;
+        ArenaSet* owner;        ///< Set whose mapping table the heap reports to
+        size_t index;           ///< Position in the set
+
+        Arena(const AllocatorOptions& options, ArenaSet* set, size_t i)
+            : heap(options), owner(set), index(i) {}
+    };
+
+    /**
+     * @struct Range
+     * @brief Address range of one arena's heap, for pointer routing
+     */
+    struct Range {
+        const char* start;
+        const char* end;
+        size_t index;
+    };
+
+    std::vector<std::unique_ptr<Arena>> arenas_;   ///< The arenas
+    std::vector<Range> ranges_;                   ///< Primary heap ranges sorted by start
+    Assignment assignment_;                       ///< Thread-to-arena mapping
+    size_t node_count_;                           ///< Nodes the arenas are bound to (1 if none)
+
+    Range* mappings_;                             ///< Extra segments and large mappings sorted by start
+    size_t mapping_count_;                        ///< Entries in use in mappings_
+    size_t mapping_capacity_;                     ///< Entries mappings_'s own mapping can hold
+    bool mappings_complete_;                      ///< False once an entry could not be recorded
+    mutable std::mutex mappings_lock_;            ///< Guards mappings_; taken after an arena lock
+
+    /**
+     * @brief MappingHook of every arena heap: keeps mappings_ current
+     * @param context The reporting Arena
+     */
+    static void onMapping(void* context, const void* base, size_t size,
+                          bool mapped);
+
+    /**
+     * @brief Double the mapping table's capacity (mappings_lock_ held)
+     * @return true on success
+     */
+    bool growMappings();
+
+    /**
+     * @brief The i-th arena to try for a thread whose own arena is first
+     *
+     * Visits the arenas of first's node before moving on to the next node,
+     * so allocation stays node-local for as long as it can.
+     */
+    size_t spillIndex(size_t first, size_t i) const;
+};
+
+/**
+ * @brief Global arena set backing the custom_* functions
+ */
+extern ArenaSet* g_arenas;
+
+/**
+ * @brief Initialize the global allocator as a set of arenas
+ *
+ * The arenas are growable and 16-byte aligned, the alignof(max_align_t)
+ * that malloc() and operator new must meet. g_allocator refers to the
+ * first arena afterwards.
+ *
+ * @param arena_count Number of arenas
+ * @param heap_size Heap size of each arena
+ * @param assignment Thread-to-arena mapping
+ */
+void initGlobalArenas(size_t arena_count,
+                      size_t heap_size = MemoryAllocator::DEFAULT_HEAP_SIZE,
+                      ArenaSet::Assignment assignment =
+                          ArenaSet::Assignment::RoundRobin);
+
+} // namespace CustomAllocator
+
+#endif // ARENA_SET_HPP
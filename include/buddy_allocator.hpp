@@ -0,0 +1,252 @@
+/**
+ * @file buddy_allocator.hpp
+ * @brief Custom Memory Allocator - Buddy-System Block Allocator
+ *
+ * Power-of-two blocks for page-sized buffers (I/O, DMA, huge pages):
+ * - A block splits only into two halves and merges only with its buddy,
+ *   found by flipping one bit of its offset from the heap start
+ * - No header in front of a block: free state and block orders live in
+ *   bitmaps outside the heap, so every block is aligned to its own size
+ * - Allocation and coalescing are O(log(max_block / min_block))
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef BUDDY_ALLOCATOR_HPP
+#define BUDDY_ALLOCATOR_HPP
+
+#include "allocator_error.hpp"
+#include "os_memory.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace CustomAllocator {
+
+/**
+ * @struct BuddyOptions
+ * @brief Geometry of a BuddyAllocator that maps its own heap
+ */
+struct BuddyOptions {
+    size_t heap_size = 16 * 1024 * 1024;    ///< Heap size (rounded down to a multiple of max_block)
+    size_t min_block = 4096;                ///< Smallest block, a power of two of at least 16 bytes
+    size_t max_block = OS_HUGE_PAGE_SIZE;   ///< Largest block, a power of two; blocks never merge beyond it
+    bool huge_pages = false;                ///< Back the heap with huge pages (see osMapHugeMemory())
+};
+
+/**
+ * @struct BuddyStats
+ * @brief Utilization of a BuddyAllocator
+ */
+struct BuddyStats {
+    size_t heap_size;            ///< Bytes of blocks the heap holds
+    size_t min_block;            ///< Smallest block size
+    size_t max_block;            ///< Largest block size
+    size_t used_bytes;           ///< Bytes in allocated blocks (requests rounded up to a power of two)
+    size_t free_bytes;           ///< Bytes in free blocks
+    size_t largest_free_block;   ///< Largest block allocate() can return right now
+    size_t free_blocks;          ///< Free blocks of every order
+    size_t total_allocations;    ///< Successful allocate() calls
+    size_t total_frees;          ///< Successful deallocate() calls
+    size_t failed_allocations;   ///< allocate() calls that found no block
+    size_t split_count;          ///< Blocks split in half
+    size_t merge_count;          ///< Buddies merged back together
+
+    /**
+     * @brief Calculate how much of the heap is allocated
+     * @return Used bytes as percentage of the heap (0-100)
+     */
+    double getUtilization() const {
+        if (heap_size == 0) return 0.0;
+        return (static_cast<double>(used_bytes) / heap_size) * 100.0;
+    }
+
+    /**
+     * @brief External fragmentation: free memory outside the largest free block
+     * @return (1 - largest_free_block / free_bytes) as a percentage (0-100)
+     */
+    double getFragmentationRatio() const {
+        if (free_bytes == 0) return 0.0;
+        return (1.0 - static_cast<double>(largest_free_block) / free_bytes) * 100.0;
+    }
+};
+
+/**
+ * @class BuddyAllocator
+ * @brief Binary buddy allocator over one contiguous heap
+ *
+ * Each request is rounded up to a power of two between min_block and
+ * max_block. The heap is a row of max_block-sized blocks; a block of
+ * order k (min_block << k bytes) at offset o from the heap start has its
+ * buddy at o ^ (min_block << k). Allocation takes the smallest non-empty
+ * order from a bitmap and splits down to the request; freeing merges with
+ * the buddy for as long as the buddy is free.
+ *
+ * Per-order free bitmaps and a byte per min_block unit holding the order
+ * of the allocated block that starts there sit in front of the heap, not
+ * in it. A heap the allocator maps itself starts on a max_block boundary,
+ * so every block is aligned to its own size in absolute terms; over
+ * external memory blocks are aligned to their size relative to the heap
+ * start, which is min_block-aligned. Free blocks hold their list links.
+ *
+ * The allocator is not thread-safe; like MemoryAllocator, use one per
+ * thread or guard it with a lock.
+ */
+class BuddyAllocator {
+public:
+    /// Largest number of orders (max_block / min_block <= 2^31)
+    static constexpr size_t MAX_ORDERS = 32;
+
+    /**
+     * @brief Map a heap from the OS
+     * @param options Heap size and block geometry
+     * @throws std::invalid_argument for a geometry that is not powers of two
+     *         or a heap smaller than min_block
+     * @throws std::bad_alloc if the heap cannot be mapped
+     */
+    explicit BuddyAllocator(const BuddyOptions& options = BuddyOptions());
+
+    /**
+     * @brief Manage an externally provided region; nothing is mapped
+     *
+     * The bitmaps are carved from the front of the region and the heap
+     * takes as many max_block blocks as fit after them. max_block shrinks
+     * to the largest power of two that fits when the region is smaller.
+     *
+     * @param memory Region to manage (must outlive the allocator)
+     * @param size Size of the region in bytes
+     * @param min_block Smallest block size
+     * @param max_block Largest block size
+     * @throws std::invalid_argument if the geometry is invalid or no
+     *         min_block block fits
+     */
+    BuddyAllocator(void* memory, size_t size, size_t min_block = 4096,
+                   size_t max_block = OS_HUGE_PAGE_SIZE);
+
+    /**
+     * @brief Destructor - unmaps the heap if the allocator mapped it
+     */
+    ~BuddyAllocator();
+
+    // Disable copy and move operations (blocks point into the heap)
+    BuddyAllocator(const BuddyAllocator&) = delete;
+    BuddyAllocator& operator=(const BuddyAllocator&) = delete;
+
+    /**
+     * @brief Allocate a block of at least size bytes
+     * @param size Bytes requested (at most maxBlock())
+     * @return Block aligned to its own size, or nullptr for size 0, a
+     *         size above maxBlock() or no free block (OutOfMemory)
+     */
+    void* allocate(size_t size);
+
+    /**
+     * @brief Free a block and merge it with its free buddies
+     * @param ptr Pointer returned by allocate() (can be nullptr)
+     */
+    void deallocate(void* ptr);
+
+    /**
+     * @brief Size of an allocated block
+     * @param ptr Pointer returned by allocate()
+     * @return Block size, or 0 if ptr is not an allocated block
+     */
+    size_t blockSize(const void* ptr) const;
+
+    /**
+     * @brief Check if a pointer lies inside this allocator's heap
+     */
+    bool owns(const void* ptr) const;
+
+    /// Smallest block size
+    size_t minBlock() const { return min_block_; }
+
+    /// Largest block size
+    size_t maxBlock() const { return min_block_ << max_order_; }
+
+    /// Bytes of blocks the heap holds
+    size_t heapSize() const { return heap_size_; }
+
+    /// Kind of pages behind the heap (None for external memory)
+    HugePageBacking backing() const { return backing_; }
+
+    /**
+     * @brief Get current utilization
+     * @return BuddyStats snapshot
+     */
+    BuddyStats getStats() const;
+
+    /**
+     * @brief Check the free lists, bitmaps and counters against each other
+     * @return true if every free block is on the list of its order, no two
+     *         free buddies are left unmerged and the byte counts add up
+     */
+    bool verify() const;
+
+    /**
+     * @brief Print utilization to stdout (diagnostics.cpp)
+     */
+    void printStats() const;
+
+private:
+    /// Links of a free block, stored in the block itself
+    struct FreeNode {
+        FreeNode* prev;
+        FreeNode* next;
+    };
+
+    char* heap_start_;                  ///< First block
+    size_t heap_size_;                  ///< Bytes of blocks
+    size_t min_block_;                  ///< Size of an order-0 block
+    size_t min_shift_;                  ///< log2(min_block_)
+    size_t max_order_;                  ///< Order of a max_block block
+    void* mapping_;                     ///< Mapping to unmap (nullptr for external memory)
+    size_t mapping_size_;               ///< Size of mapping_
+    HugePageBacking backing_;           ///< Pages behind a mapped heap
+
+    uint8_t* orders_;                   ///< Per unit: 1 + order of the allocated block starting there, else 0
+    uint64_t* free_bits_[MAX_ORDERS];   ///< Per order: one bit per block, set while it is free
+    FreeNode* free_lists_[MAX_ORDERS];  ///< Per order: free blocks, lowest address first initially
+    uint32_t nonempty_;                 ///< Bit k set when free_lists_[k] is non-empty
+
+    size_t used_bytes_;                 ///< Bytes in allocated blocks
+    size_t free_blocks_;                ///< Blocks on the free lists
+    size_t allocations_;                ///< Successful allocations
+    size_t frees_;                      ///< Successful frees
+    size_t failures_;                   ///< Failed allocations
+    size_t splits_;                     ///< Blocks split
+    size_t merges_;                     ///< Buddies merged
+
+    /**
+     * @brief Bytes of bitmaps and order map for a heap of units min_block units
+     */
+    static size_t metadataSize(size_t units, size_t max_order);
+
+    /**
+     * @brief Check the geometry and set min_block_, min_shift_ and max_order_
+     * @throws std::invalid_argument if a size is not a usable power of two
+     */
+    void setGeometry(size_t min_block, size_t max_block);
+
+    /**
+     * @brief Lay the metadata out at metadata and free every max_block block
+     */
+    void initialize(char* metadata);
+
+    /// Put the block at offset on the free list of its order
+    void pushFree(size_t offset, size_t order);
+
+    /// Take a free block off the free list of its order
+    void removeFree(size_t offset, size_t order);
+
+    /// Whether the block of the given order at offset is free
+    bool isFree(size_t offset, size_t order) const {
+        size_t index = offset >> (min_shift_ + order);
+        return (free_bits_[order][index / 64] >> (index % 64)) & 1;
+    }
+};
+
+} // namespace CustomAllocator
+
+#endif // BUDDY_ALLOCATOR_HPP
@@ -0,0 +1,125 @@
+/**
+ * @file diagnostics.hpp
+ * @brief Custom Memory Allocator - Console Diagnostics
+ *
+ * The iostream side of the project, kept out of the allocation code:
+ * - printErrorHandler(), an on_error hook that reports errors on stderr
+ * - The printStats() / printHeapLayout() methods are defined alongside it
+ * - printProfile() and writeHeapProfile() report what the profiler saw
+ * - writeStatsJson(), writeStatsPrometheus() and writeHeapMap() export the
+ *   counters and the block layout for dashboards and offline tools
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef DIAGNOSTICS_HPP
+#define DIAGNOSTICS_HPP
+
+#include "allocator_error.hpp"
+#include "profiler.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace CustomAllocator {
+
+class ArenaSet;
+class MemoryAllocator;
+struct MemoryStats;
+
+/// Version written into writeHeapMap() dumps
+constexpr uint32_t HEAP_MAP_VERSION = 1;
+
+/**
+ * @brief Error hook printing "[function] ERROR: ..." lines to stderr
+ *
+ * Install it with on_error(printErrorHandler). Every error then costs a
+ * synchronous stderr write, so it is meant for debugging and demos.
+ *
+ * @param info Error being reported
+ */
+void printErrorHandler(const ErrorInfo& info);
+
+/**
+ * @brief Print live bytes and the size-class and latency histograms
+ * @param profile Counters from profileSnapshot()
+ */
+void printProfile(const ProfileSnapshot& profile);
+
+/**
+ * @brief Write the live sampled allocations as a pprof heap profile
+ *
+ * The output is the text format of gperftools' heap profiler, which
+ * `pprof <binary> <file>` reads; /proc/self/maps is appended so the
+ * addresses can be symbolized.
+ *
+ * @param out Stream receiving the profile
+ * @return true if the stream is still good after writing
+ */
+bool writeHeapProfile(std::ostream& out);
+
+/**
+ * @brief Write every MemoryStats field as one JSON object
+ *
+ * Keys are the field names (counters without their total_ prefix) plus
+ * active_allocations and fragmentation_percent.
+ *
+ * @param stats Snapshot from getStats()
+ * @param out Stream receiving the object and a newline
+ * @return true if the stream is still good after writing
+ */
+bool writeStatsJson(const MemoryStats& stats, std::ostream& out);
+
+/**
+ * @brief Write the statistics in the Prometheus text exposition format
+ *
+ * Sizes and counts become gauges; monotonic counts become counters with
+ * a _total suffix. The fragmentation ratio is exported as 0-1.
+ *
+ * @param stats Snapshot from getStats()
+ * @param out Stream receiving the metrics
+ * @param prefix Metric name prefix
+ * @return true if the stream is still good after writing
+ */
+bool writeStatsPrometheus(const MemoryStats& stats, std::ostream& out,
+                          const std::string& prefix = "customalloc");
+
+/**
+ * @brief Write a binary dump of the heap's block layout
+ *
+ * The dump is a 24-byte header followed by the HeapMapEntry records of
+ * MemoryAllocator::heapMap(), in host byte order:
+ *
+ *     char     magic[4]       "CAHM"
+ *     uint32_t version        HEAP_MAP_VERSION
+ *     uint64_t entry_count
+ *     uint64_t entry_size     24
+ *     HeapMapEntry entries[entry_count]
+ *
+ * The map is copied before anything is written, so a slow stream does not
+ * hold up the heap.
+ *
+ * @param heap Heap to dump
+ * @param out Binary stream receiving the dump
+ * @return true if the stream is still good after writing
+ */
+bool writeHeapMap(const MemoryAllocator& heap, std::ostream& out);
+
+/**
+ * @brief Write a binary dump of one arena's block layout
+ *
+ * Same format as the MemoryAllocator overload. The arena is locked only
+ * while its map is copied.
+ *
+ * @param arenas Arena set owning the arena
+ * @param index Arena to dump (below arenaCount())
+ * @param out Binary stream receiving the dump
+ * @return true if the stream is still good after writing
+ */
+bool writeHeapMap(const ArenaSet& arenas, size_t index, std::ostream& out);
+
+} // namespace CustomAllocator
+
+#endif // DIAGNOSTICS_HPP
@@ -0,0 +1,179 @@
+/**
+ * @file fixed_pool.hpp
+ * @brief Custom Memory Allocator - Lock-Free Fixed-Size Object Pool
+ *
+ * A pool of equal-sized slots carved from one MemoryAllocator region:
+ * - O(1) allocate/free with no per-object header
+ * - Free slots form a lock-free Treiber stack with ABA protection
+ * - No contention on the parent allocator after construction
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef FIXED_POOL_HPP
+#define FIXED_POOL_HPP
+
+#include "memory_allocator.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace CustomAllocator {
+
+/**
+ * @struct PoolStats
+ * @brief Utilization of a FixedPool
+ */
+struct PoolStats {
+    size_t slot_size;            ///< Bytes per slot (object size rounded up)
+    size_t capacity;             ///< Total number of slots
+    size_t in_use;               ///< Slots currently handed out
+    size_t peak_in_use;          ///< High-water mark of in_use
+    size_t total_allocations;    ///< Successful allocate() calls
+    size_t total_frees;          ///< Successful deallocate() calls
+    size_t failed_allocations;   ///< allocate() calls on an exhausted pool
+    size_t region_size;          ///< Bytes taken from the parent allocator
+
+    /**
+     * @brief Calculate slot utilization
+     * @return Slots in use as percentage of capacity (0-100)
+     */
+    double getUtilization() const {
+        if (capacity == 0) return 0.0;
+        return (static_cast<double>(in_use) / capacity) * 100.0;
+    }
+};
+
+/**
+ * @class FixedPool
+ * @brief Thread-safe pool of fixed-size slots
+ *
+ * The pool takes a single region from its parent MemoryAllocator when
+ * constructed and returns it when destroyed; the parent must not be used
+ * concurrently from other threads at those two points. allocate() and
+ * deallocate() never touch the parent and are lock-free.
+ *
+ * The free-list links live in a side array of slot indices at the front
+ * of the region rather than in the slots themselves, so a slot's memory
+ * belongs entirely to its user. The stack head packs the top index with
+ * a version tag that changes on every push and pop, which defeats ABA.
+ */
+class FixedPool {
+public:
+    /**
+     * @brief Create a pool of equal-sized slots
+     *
+     * Slots are rounded up to, and aligned like, the parent's alignment().
+     *
+     * @param parent Allocator providing the backing region
+     * @param object_size Size of each object in bytes
+     * @param capacity Number of slots
+     * @throws std::invalid_argument for a zero size or capacity
+     * @throws std::bad_alloc if the parent cannot supply the region
+     */
+    FixedPool(MemoryAllocator& parent, size_t object_size, size_t capacity);
+
+    /**
+     * @brief Destructor - returns the region to the parent allocator
+     */
+    ~FixedPool();
+
+    // Disable copy and move operations (slots point into this pool)
+    FixedPool(const FixedPool&) = delete;
+    FixedPool& operator=(const FixedPool&) = delete;
+
+    /**
+     * @brief Take a slot from the pool
+     * @return Pointer to a slot, or nullptr if the pool is exhausted
+     */
+    void* allocate();
+
+    /**
+     * @brief Return a slot to the pool
+     * @param ptr Pointer previously returned by allocate() (can be nullptr)
+     */
+    void deallocate(void* ptr);
+
+    /**
+     * @brief Allocate a slot and construct an object in it
+     * @return Pointer to the new object, or nullptr if the pool is exhausted
+     */
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        assert(sizeof(T) <= slot_size_ && alignof(T) <= alignment());
+        void* slot = allocate();
+        return slot ? new (slot) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    /**
+     * @brief Destroy an object created with create() and free its slot
+     * @param object Object to destroy (can be nullptr)
+     */
+    template <typename T>
+    void destroy(T* object) {
+        if (object) {
+            object->~T();
+            deallocate(object);
+        }
+    }
+
+    /**
+     * @brief Check if a pointer is the start of one of this pool's slots
+     * @param ptr Pointer to check
+     * @return true if ptr is a slot of this pool
+     */
+    bool owns(const void* ptr) const;
+
+    /// Bytes per slot
+    size_t slotSize() const { return slot_size_; }
+
+    /// Alignment of every slot (the parent's alignment())
+    size_t alignment() const { return parent_.alignment(); }
+
+    /// Total number of slots
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * @brief Get current pool utilization
+     * @return PoolStats snapshot (counters are read independently)
+     */
+    PoolStats getStats() const;
+
+    /**
+     * @brief Print pool utilization to stdout (diagnostics.cpp)
+     */
+    void printStats() const;
+
+private:
+    /// Index value marking the end of the free stack
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    MemoryAllocator& parent_;           ///< Allocator owning the region
+    void* region_;                      ///< Region taken from the parent
+    size_t region_size_;                ///< Size of the region
+    std::atomic<uint32_t>* next_;       ///< Free stack link for each slot
+    char* slots_;                       ///< First slot
+    size_t slot_size_;                  ///< Bytes per slot
+    size_t capacity_;                   ///< Number of slots
+
+    std::atomic<uint64_t> head_;        ///< (tag << 32) | top slot index
+    std::atomic<size_t> in_use_;        ///< Slots handed out
+    std::atomic<size_t> peak_in_use_;   ///< High-water mark of in_use_
+    std::atomic<size_t> allocations_;   ///< Successful allocations
+    std::atomic<size_t> frees_;         ///< Successful frees
+    std::atomic<size_t> failures_;      ///< Allocations on an empty pool
+
+    /// Pack a slot index and version tag into a stack head value
+    static uint64_t makeHead(uint32_t index, uint32_t tag) {
+        return (static_cast<uint64_t>(tag) << 32) | index;
+    }
+};
+
+} // namespace CustomAllocator
+
+#endif // FIXED_POOL_HPP
@@ -14,25 +14,125 @@
 #ifndef MEMORY_ALLOCATOR_HPP
 #define MEMORY_ALLOCATOR_HPP
 
+#include "allocator_error.hpp"
+#include "os_memory.hpp"
+
 #include <cstddef>
 #include <cstdint>
-#include <iostream>
-#include <iomanip>
 
 namespace CustomAllocator {
 
+class MovableHeap;
+struct MemoryBlock;
+
+/**
+ * @struct FreeLinks
+ * @brief Size-class free list links
+ *
+ * Only free blocks are threaded on the size-class lists, so the links
+ * live in the (otherwise unused) data portion of the free block. Under
+ * NextFit and AddressOrderedFirstFit the same two words are the block's
+ * left and right children in the address tree.
+ */
+struct FreeLinks {
+    MemoryBlock* prev_free; ///< Previous free block in the same size class
+    MemoryBlock* next_free; ///< Next free block in the same size class
+};
+
 /**
  * @struct MemoryBlock
- * @brief Metadata structure for each memory block
- * 
- * This structure sits at the beginning of each allocation,
- * storing essential information for memory management.
+ * @brief Boundary-tag header for each memory block
+ *
+ * This 16-byte header sits at the beginning of each block. Block sizes
+ * are multiples of ALIGNMENT, so the low bits of the size word carry the
+ * block's FREE flag and, on free blocks only, its ZERO flag: every data
+ * byte past the free-list links is known to be zero, so calloc() need
+ * not clear it.
+ *
+ * The prev_size word is the previous block's footer: it holds that
+ * block's size while it is free and zero while it is allocated, which is
+ * all coalescing needs. Neighbours only ever write this word, never the
+ * size word, so the owner of an allocated block can read its size
+ * without taking the heap lock.
+ * Sizes stay far below 2^48, so the top 16 bits of the size word are
+ * free for a hardened heap's canary (see AllocatorOptions::hardened).
+ * Physical neighbours are reached by address arithmetic in O(1), and the
+ * free list links live in the data portion of free blocks, so no list
+ * pointers are stored in the header. A zero-sized, allocated sentinel
+ * block terminates the heap.
  */
 struct MemoryBlock {
-    size_t size;            ///< Size of the data portion (excluding metadata)
-    bool is_free;           ///< Flag indicating if block is available
-    MemoryBlock* next;      ///< Pointer to the next block in the list
-    MemoryBlock* prev;      ///< Pointer to the previous block (for coalescing)
+    static constexpr size_t FREE_BIT = 0x1;       ///< Block is available
+    static constexpr size_t ZERO_BIT = 0x2;       ///< Free block's data is zero past its links
+    static constexpr size_t QUARANTINE_BIT = 0x4; ///< Freed block held back by a hardened heap
+    static constexpr size_t FLAG_MASK = 0x7;      ///< Low bits reserved for flags
+    static constexpr size_t CANARY_SHIFT = 48;    ///< Position of the header canary
+    static constexpr size_t CANARY_MASK = size_t(0xFFFF) << CANARY_SHIFT; ///< High bits holding it
+
+    size_t prev_size;       ///< Previous block's size while it is free, else 0
+    size_t size_flags;      ///< Size of the data portion | state flags
+
+    /// Size of the data portion (excluding metadata)
+    size_t size() const { return size_flags & ~(FLAG_MASK | CANARY_MASK); }
+
+    /// Flag indicating if block is available
+    bool isFree() const { return (size_flags & FREE_BIT) != 0; }
+
+    /// Flag indicating if a free block's data is zero beyond its links
+    bool isZeroed() const { return (size_flags & ZERO_BIT) != 0; }
+
+    /// Flag indicating if an allocated block is waiting in the quarantine
+    bool isQuarantined() const { return (size_flags & QUARANTINE_BIT) != 0; }
+
+    /// Canary over the header's address and size (hardened heaps only)
+    uint16_t canary() const { return static_cast<uint16_t>(size_flags >> CANARY_SHIFT); }
+
+    /// Flag indicating if the physically previous block is available
+    bool isPrevFree() const { return prev_size != 0; }
+
+    /// True for the zero-sized sentinel that ends the heap
+    bool isSentinel() const { return size() == 0; }
+
+    void setSize(size_t size) {
+        size_flags = size | (size_flags & (FLAG_MASK | CANARY_MASK));
+    }
+
+    void setFree(bool free) {
+        size_flags = free ? (size_flags | FREE_BIT) : (size_flags & ~FREE_BIT);
+    }
+
+    void setZeroed(bool zeroed) {
+        size_flags = zeroed ? (size_flags | ZERO_BIT) : (size_flags & ~ZERO_BIT);
+    }
+
+    void setQuarantined(bool quarantined) {
+        size_flags = quarantined ? (size_flags | QUARANTINE_BIT)
+                                 : (size_flags & ~QUARANTINE_BIT);
+    }
+
+    void setCanary(uint16_t canary) {
+        size_flags = (size_flags & ~CANARY_MASK) | (size_t(canary) << CANARY_SHIFT);
+    }
+
+    /**
+     * @brief Get the physically next block
+     * @return Block immediately after this block's data
+     */
+    MemoryBlock* nextBlock() {
+        return reinterpret_cast<MemoryBlock*>(
+            reinterpret_cast<char*>(this) + sizeof(MemoryBlock) + size()
+        );
+    }
+
+    /**
+     * @brief Get the physically previous block using its footer
+     * @return Previous block; only valid when isPrevFree() is true
+     */
+    MemoryBlock* prevBlock() {
+        return reinterpret_cast<MemoryBlock*>(
+            reinterpret_cast<char*>(this) - prev_size - sizeof(MemoryBlock)
+        );
+    }
     
     /**
      * @brief Get pointer to the data portion of this block
@@ -52,6 +152,122 @@ struct MemoryBlock {
             reinterpret_cast<char*>(data) - sizeof(MemoryBlock)
         );
     }
+
+    /**
+     * @brief Get the size-class links stored in a free block's data
+     * @return Pointer to the free list links (valid only while free)
+     */
+    FreeLinks* links() {
+        return static_cast<FreeLinks*>(getData());
+    }
+};
+
+static_assert(sizeof(MemoryBlock) == 16, "MemoryBlock must stay a compact 16 bytes");
+
+/**
+ * @struct HeapSegment
+ * @brief One contiguous region of the heap
+ *
+ * Every segment holds a chain of blocks ending in its own sentinel. The
+ * initial heap is the primary segment; a growable allocator maps extra
+ * segments from the OS on demand, and their descriptor sits at the very
+ * start of the mapping.
+ */
+struct HeapSegment {
+    HeapSegment* next;      ///< Next segment (extra segments newest first)
+    char* start;            ///< First block of the segment
+    char* end;              ///< One past the segment's sentinel
+    size_t mapped_size;     ///< Bytes mapped from the OS (0 for the primary heap)
+    HugePageBacking backing; ///< Kind of pages the segment received
+
+    /// First block in physical (address) order
+    MemoryBlock* firstBlock() const {
+        return reinterpret_cast<MemoryBlock*>(start);
+    }
+
+    /// Zero-sized block terminating this segment
+    MemoryBlock* sentinel() const {
+        return reinterpret_cast<MemoryBlock*>(end - sizeof(MemoryBlock));
+    }
+
+    /// Check whether a data pointer lies inside this segment's blocks
+    bool contains(const void* ptr) const {
+        const char* p = static_cast<const char*>(ptr);
+        return p >= start + sizeof(MemoryBlock) && p < end - sizeof(MemoryBlock);
+    }
+};
+
+/**
+ * @struct LargeAllocation
+ * @brief Side-table entry for an allocation with its own OS mapping
+ *
+ * The mapping starts with an ordinary (allocated) block header, so code
+ * that looks at the header of a user pointer sees a plain large block.
+ */
+struct LargeAllocation {
+    void* data;             ///< Pointer handed to the caller
+    char* base;             ///< Start of the mapping (data may sit further in when over-aligned)
+    size_t mapped_size;     ///< Bytes mapped, header included
+};
+
+/**
+ * @brief Mapping hook type
+ *
+ * Told about every extra segment and large allocation a heap maps or
+ * unmaps, so an owner of several heaps can route pointers without asking
+ * each one. Runs inside the heap call that changed the mapping, with the
+ * heap's lock held if it has one, so it must not allocate from that heap.
+ *
+ * @param context Value passed to MemoryAllocator::setMappingHook()
+ * @param base Start of the mapping
+ * @param size Bytes mapped
+ * @param mapped true once the range is mapped, false just before it is unmapped
+ */
+using MappingHook = void (*)(void* context, const void* base, size_t size,
+                             bool mapped);
+
+/**
+ * @enum PlacementPolicy
+ * @brief Which free block a request is carved from
+ *
+ * Every policy shares the split and coalesce code. The first four search
+ * the segregated free lists; Tlsf keeps its own two-level index, built
+ * when the policy is selected.
+ */
+enum class PlacementPolicy : uint8_t {
+    FirstFit,               ///< First fit in the request's size class, else the smallest larger class (default)
+    NextFit,                ///< Lowest-address fit after the previous placement, wrapping around
+    BestFit,                ///< Smallest block that fits
+    AddressOrderedFirstFit, ///< Lowest-address block that fits
+    Tlsf                    ///< Two-level segregated fit: O(1) bitmap lookups, bounded worst case
+};
+
+/**
+ * @brief Name of a placement policy, for diagnostics and command lines
+ */
+const char* placementPolicyName(PlacementPolicy policy);
+
+/**
+ * @struct AllocatorOptions
+ * @brief Construction options for an owned-heap MemoryAllocator
+ */
+struct AllocatorOptions {
+    size_t heap_size = 1024 * 1024;     ///< Initial heap size (1 MB)
+    size_t alignment = 8;               ///< Alignment of every returned pointer (8 or 16)
+    bool growable = false;              ///< Map extra segments when the heap is full
+    size_t segment_size = 0;            ///< Minimum extra segment size (0 = heap_size)
+    bool release_empty_segments = true; ///< Unmap trailing segments once fully free
+    size_t purge_threshold = 4 * 1024 * 1024; ///< Freed bytes that trigger a purge (0 = never on free)
+    uint32_t purge_interval_ms = 1000;  ///< Purge older dirty memory below the threshold (0 = off)
+    size_t purge_min_block = 64 * 1024; ///< Free blocks smaller than this stay resident
+    bool lazy_purge = false;            ///< Use MADV_FREE instead of MADV_DONTNEED
+    bool huge_pages = false;            ///< Map 2 MB-aligned, huge-page backed memory when available
+    size_t large_threshold = 256 * 1024; ///< Larger requests get their own mapping (0 = off)
+    PlacementPolicy placement = PlacementPolicy::FirstFit; ///< Free block search strategy
+    int numa_node = OS_NO_NUMA_NODE;    ///< Place heap, segment and large pages on this node
+    bool hardened = false;              ///< Validate and poison every free, quarantine a sample of them (see quarantine_sample)
+    size_t quarantine_bytes = 256 * 1024; ///< Hardened heaps: most freed bytes held back (0 = no quarantine)
+    uint32_t quarantine_sample = 64;    ///< Hardened heaps: quarantine one free in this many (1 = every free)
 };
 
 /**
@@ -68,25 +284,79 @@ struct MemoryStats {
     size_t free_block_count;     ///< Number of free blocks
     size_t coalesce_count;       ///< Number of coalescing operations
     size_t split_count;          ///< Number of split operations
+    size_t segment_count;        ///< Number of heap segments (including the primary)
+    size_t purge_count;          ///< Number of purge passes over the free blocks
+    size_t purged_bytes;         ///< Bytes handed back to the OS by purges (cumulative)
+    size_t huge_page_bytes;      ///< Heap bytes that obtained huge pages
+    size_t large_count;          ///< Live allocations with their own mapping
+    size_t large_bytes;          ///< Bytes mapped for those allocations (not in the heap totals)
+    size_t realloc_in_place;     ///< Reallocs that resized without copying elsewhere
+    size_t realloc_moved;        ///< Reallocs that had to allocate, copy and free
+    size_t calloc_zero_hits;     ///< Callocs served from known-zero memory without a memset
+    size_t largest_free_block;   ///< Biggest single free block (computed by getStats())
+    size_t placement_searches;   ///< Free block searches made by the placement policy
+    size_t placement_steps;      ///< Free blocks those searches examined
+    size_t quarantined_blocks;   ///< Freed blocks a hardened heap is holding back (counted as used)
+    size_t quarantined_bytes;    ///< Data bytes of those blocks
+
+    /**
+     * @brief Average cost of a placement search
+     * @return Free blocks examined per search
+     */
+    double getAverageSearchLength() const {
+        if (placement_searches == 0) return 0.0;
+        return static_cast<double>(placement_steps) / placement_searches;
+    }
     
     /**
-     * @brief Calculate fragmentation ratio
-     * @return Fragmentation as percentage (0-100)
+     * @brief Calculate external fragmentation
+     *
+     * The share of free memory that the largest request which could still
+     * succeed cannot use: 0 when all free memory is one block, close to
+     * 100 when it is scattered over many small ones.
+     *
+     * @return 100 * (1 - largest free block / free memory), 0-100
      */
     double getFragmentationRatio() const {
         if (free_memory == 0) return 0.0;
-        // Fragmentation = (free blocks - 1) / free blocks * 100
-        // More free blocks = more fragmentation
-        if (free_block_count <= 1) return 0.0;
-        return (static_cast<double>(free_block_count - 1) / free_block_count) * 100.0;
+        return (1.0 - static_cast<double>(largest_free_block) / free_memory) * 100.0;
     }
 };
 
+/**
+ * @enum HeapMapKind
+ * @brief What a HeapMapEntry describes
+ */
+enum class HeapMapKind : uint32_t {
+    Segment,    ///< Start of a segment; size is the segment's bytes
+    Used,       ///< Allocated block
+    Free,       ///< Free block
+    Large       ///< Allocation with its own mapping; size is the mapped bytes
+};
+
+/**
+ * @struct HeapMapEntry
+ * @brief One record of MemoryAllocator::heapMap()
+ *
+ * Fixed 24-byte layout, so a map can be written out as raw records and
+ * rendered offline.
+ */
+struct HeapMapEntry {
+    uint64_t offset;        ///< Block header offset from its segment's start (0 for Segment and Large)
+    uint64_t size;          ///< Data bytes of the block
+    uint32_t segment;       ///< Index of the segment in heap order (0 = primary)
+    HeapMapKind kind;       ///< What the entry describes
+};
+
+static_assert(sizeof(HeapMapEntry) == 24, "HeapMapEntry is a fixed 24-byte record");
+
 /**
  * @class MemoryAllocator
  * @brief Custom memory allocator with malloc/free implementation
  * 
- * This allocator uses a first-fit strategy with a free list.
+ * This allocator uses segregated free lists: free blocks are kept on
+ * power-of-two size-class lists with a bitmap of non-empty classes, so
+ * finding a fit does not depend on the number of allocated blocks.
  * Features include:
  * - Block splitting for efficient memory usage
  * - Block coalescing to reduce fragmentation
@@ -100,16 +370,65 @@ public:
     /// Default heap size (1 MB)
     static constexpr size_t DEFAULT_HEAP_SIZE = 1024 * 1024;
     
-    /// Alignment requirement (8 bytes for 64-bit systems)
+    /// Minimum alignment (8 bytes for 64-bit systems); see AllocatorOptions::alignment
     static constexpr size_t ALIGNMENT = 8;
 
+    /// Number of power-of-two size classes (one bit each in the bitmap)
+    static constexpr size_t NUM_SIZE_CLASSES = 64;
+
+    /// Blocks examined in the request's own class before moving up a class
+    static constexpr size_t MAX_CLASS_SCAN = 8;
+
+    /// log2 of the TLSF second-level lists per size class
+    static constexpr size_t TLSF_SL_LOG2 = 4;
+
+    /// TLSF second-level lists per size class (each covers 1/16 of the class)
+    static constexpr size_t TLSF_SL_COUNT = size_t(1) << TLSF_SL_LOG2;
+
+    /// Most freed blocks a hardened heap holds back before reusing them
+    static constexpr size_t QUARANTINE_SLOTS = 32;
+
+    /// Byte a hardened heap writes over freed data
+    static constexpr unsigned char POISON_BYTE = 0xDF;
+
+    /// Leading bytes poisoned on every hardened free, and checked when a block leaves the quarantine
+    static constexpr size_t POISON_CHECK_BYTES = 256;
+
 private:
+    struct TlsfIndex;
+
+    /// A quarantined block and its size when it went in, which a damaged
+    /// header cannot change
+    struct QuarantineEntry {
+        MemoryBlock* block;
+        size_t size;
+    };
+
     char* heap_start_;          ///< Start of the managed heap
     char* heap_end_;            ///< End of the managed heap
     size_t heap_size_;          ///< Total heap size
-    MemoryBlock* free_list_;    ///< Head of the free block list
+    HeapSegment primary_;       ///< The initial heap; extra segments chain after it
+    AllocatorOptions options_;  ///< Growth behaviour
+    MemoryBlock* size_classes_[NUM_SIZE_CLASSES]; ///< Free list per size class
+    uint64_t class_bitmap_;     ///< Bit i set when size_classes_[i] is non-empty
+    uintptr_t next_fit_rover_;  ///< Address of the last NextFit placement
+    MemoryBlock* address_tree_; ///< Cartesian tree of free blocks (NextFit and AddressOrderedFirstFit only)
+    TlsfIndex* tlsf_;           ///< Two-level index inside the heap (Tlsf policy only)
     MemoryStats stats_;         ///< Memory statistics
     bool owns_memory_;          ///< Whether allocator owns the heap memory
+    size_t dirty_bytes_;        ///< Bytes freed since the last purge
+    uint64_t last_purge_ms_;    ///< Monotonic time of the last purge
+    uint32_t frees_since_clock_; ///< Frees since the purge timer was last read
+    LargeAllocation* large_table_; ///< Large allocations, sorted by address
+    size_t large_count_;        ///< Entries in use in large_table_
+    size_t large_capacity_;     ///< Entries large_table_'s mapping can hold
+    bool numa_bound_;           ///< Whether the primary heap's pages are bound to numa_node
+    uint64_t canary_secret_;    ///< Per-heap key of the header canaries (hardened only)
+    QuarantineEntry quarantine_[QUARANTINE_SLOTS]; ///< Ring of quarantined blocks, oldest at head
+    size_t quarantine_head_;    ///< Slot of the oldest quarantined block
+    uint32_t frees_to_quarantine_; ///< Hardened frees left before the next one is quarantined
+    MappingHook mapping_hook_;  ///< Told about extra segments and large mappings (may be null)
+    void* mapping_context_;     ///< First argument of mapping_hook_
 
 public:
     /**
@@ -117,6 +436,12 @@ public:
      * @param heap_size Size of the heap to manage (default: 1MB)
      */
     explicit MemoryAllocator(size_t heap_size = DEFAULT_HEAP_SIZE);
+
+    /**
+     * @brief Construct an allocator that owns its heap, with options
+     * @param options Initial size and growth behaviour
+     */
+    explicit MemoryAllocator(const AllocatorOptions& options);
     
     /**
      * @brief Construct allocator with external memory
@@ -150,17 +475,92 @@ public:
      * @param ptr Pointer to memory previously allocated by my_malloc
      */
     void my_free(void* ptr);
+
+    /**
+     * @brief Deallocate memory whose allocation size the caller knows
+     *
+     * Sizes above the large threshold go straight to the large-mapping
+     * table without searching the heap segments. Debug builds check that
+     * the size matches the block and reject the free if it does not.
+     *
+     * @param ptr Pointer to memory previously allocated by this heap
+     * @param size Size originally requested (or last passed to my_realloc)
+     */
+    void my_free_sized(void* ptr, size_t size);
     
     /**
      * @brief Reallocate memory to a new size
+     *
+     * Shrinking splits the tail off as a free block. Growing first tries
+     * to absorb a free next block, then a free previous block (plus the
+     * next one if needed, moving the data down with memmove), and only
+     * then falls back to allocate, copy and free.
+     *
      * @param ptr Pointer to existing allocation (can be nullptr)
      * @param new_size New size in bytes
      * @return Pointer to reallocated memory, or nullptr on failure
      */
     void* my_realloc(void* ptr, size_t new_size);
-    
+
+    /**
+     * @brief Allocate memory whose address is a multiple of an alignment
+     *
+     * The gap in front of the aligned payload is split off as a free
+     * block rather than wasted. The result is released with my_free().
+     * Reallocating it keeps only the heap's default alignment.
+     *
+     * @param alignment Required alignment (a power of two)
+     * @param size Number of bytes to allocate
+     * @return Aligned pointer, or nullptr on failure
+     */
+    void* my_aligned_alloc(size_t alignment, size_t size);
+
+    /**
+     * @brief posix_memalign()-style aligned allocation
+     * @param memptr Receives the allocation (nullptr for a zero size)
+     * @param alignment Power of two that is a multiple of sizeof(void*)
+     * @param size Number of bytes to allocate
+     * @return 0 on success, EINVAL for a bad alignment, ENOMEM when out of memory
+     */
+    int my_posix_memalign(void** memptr, size_t alignment, size_t size);
+
+    /**
+     * @brief Allocate count blocks of one size in a single pass
+     *
+     * Each free block found is carved into as many objects as it holds
+     * before the next search, so a burst usually costs one lookup and
+     * returns physically adjacent blocks. Traced and profiled as one
+     * malloc per block.
+     *
+     * @param size Size of each block
+     * @param count Number of blocks wanted
+     * @param out Receives the allocated pointers
+     * @return Number of blocks actually allocated
+     */
+    size_t my_malloc_batch(size_t size, size_t count, void** out);
+
+    /**
+     * @brief Free a group of pointers in one sweep
+     *
+     * Pointers are sorted by address and every run of physically adjacent
+     * blocks is merged into one free block before it is coalesced, so the
+     * statistics and free lists are touched once per run. Traced and
+     * profiled as one free per pointer.
+     *
+     * @param ptrs Pointers to free (the array is reordered; nullptrs are skipped)
+     * @param count Number of pointers
+     */
+    void my_free_batch(void** ptrs, size_t count);
+
     /**
      * @brief Allocate and zero-initialize memory (custom calloc)
+     *
+     * Memory that is known to be zero is not cleared again: large
+     * requests get a fresh mapping, and free blocks carved from a newly
+     * mapped segment or from pages an eager purge dropped keep their ZERO
+     * flag until they are handed out. Everything else is cleared, with
+     * streaming stores that bypass the cache for very large blocks.
+     *
      * @param count Number of elements
      * @param size Size of each element
      * @return Pointer to allocated and zeroed memory
@@ -169,66 +569,557 @@ public:
     
     /**
      * @brief Get current memory statistics
+     *
+     * Statistics are maintained incrementally; only largest_free_block is
+     * found at read time, by scanning the highest non-empty size class.
+     *
      * @return MemoryStats structure with current state
      */
-    MemoryStats getStats() const { return stats_; }
+    MemoryStats getStats() const;
+
+    /**
+     * @brief Snapshot every segment, block and large mapping
+     *
+     * Each segment contributes a Segment entry followed by its blocks in
+     * address order; large mappings come last. Nothing is allocated and
+     * no I/O happens, so a caller holding the heap's lock copies the map
+     * quickly and formats it afterwards.
+     *
+     * @param out Array receiving the first capacity entries (may be nullptr if capacity is 0)
+     * @param capacity Entries available in out
+     * @return Entries in the full map (more than capacity if out was too small)
+     */
+    size_t heapMap(HeapMapEntry* out, size_t capacity) const;
+
+    /**
+     * @brief Recount every block and compare against the running statistics
+     *
+     * Walks the whole heap; intended for tests and debugging only.
+     *
+     * @return true if block counts and byte totals match the heap contents
+     */
+    bool verifyStats() const;
     
     /**
-     * @brief Print detailed memory statistics to stdout
+     * @brief Print detailed memory statistics to stdout (diagnostics.cpp)
      */
     void printStats() const;
     
     /**
-     * @brief Print a visual representation of the heap
+     * @brief Print a visual representation of the heap (diagnostics.cpp)
      */
     void printHeapLayout() const;
     
+    /**
+     * @brief Change how free blocks are chosen
+     *
+     * Takes effect with the next allocation; the free blocks already in
+     * the heap stay where they are. Switching to or from Tlsf re-indexes
+     * every free block once. The TLSF index takes one allocated block of
+     * the heap itself (about 8 KB, counted in used_memory), so it also
+     * works on external memory without any OS call.
+     *
+     * @param policy New placement policy
+     * @return false if the heap has no room for the TLSF index (the
+     *         policy is then unchanged)
+     */
+    bool setPlacementPolicy(PlacementPolicy policy);
+
+    /// Current placement policy
+    PlacementPolicy placementPolicy() const { return options_.placement; }
+
     /**
      * @brief Reset the allocator to initial state
+     *
+     * Frees every allocation at once without visiting any block: extra
+     * segments and large mappings are unmapped and the primary heap is
+     * reformatted as one free block. Cost is O(segments + large mappings),
+     * which makes a whole heap usable as an arena that is wiped per request.
+     * A hardened heap's quarantine is dropped along with everything else.
      */
     void reset();
+
+    /**
+     * @brief Return as much free memory to the OS as possible
+     *
+     * Unmaps every entirely free extra segment and purges the page-aligned
+     * interior of every free block, ignoring the purge thresholds. A
+     * hardened heap empties its quarantine first. Does nothing to the
+     * memory of an allocator built on external memory.
+     *
+     * @return Number of bytes released or purged
+     */
+    size_t trim();
+
+    /**
+     * @brief Free every block a hardened heap is holding in quarantine
+     *
+     * Each block's poison is checked on the way out, as on eviction.
+     *
+     * @return Number of data bytes returned to the free lists
+     */
+    size_t flushQuarantine();
+
+    /**
+     * @brief Check whether the heap runs the hardened-mode checks
+     * @return true if constructed with AllocatorOptions::hardened
+     */
+    bool isHardened() const { return options_.hardened; }
     
     /**
      * @brief Check if a pointer is valid (within heap bounds)
      * @param ptr Pointer to check
-     * @return true if pointer is within managed heap
+     * @return true if pointer is within one of the heap's segments or is
+     *         a live large allocation
      */
     bool isValidPointer(void* ptr) const;
 
+    /**
+     * @brief Check if a pointer is a live large allocation
+     * @param ptr Pointer to check
+     * @return true if ptr was served by its own mapping
+     */
+    bool isLargeAllocation(void* ptr) const {
+        return findLarge(ptr) != NO_LARGE;
+    }
+
+    /// Start of the primary heap segment
+    const char* heapStart() const { return heap_start_; }
+
+    /// End of the primary heap segment (one past the last byte)
+    const char* heapEnd() const { return heap_end_; }
+
+    /**
+     * @brief Check whether the heap may map extra segments
+     * @return true if constructed with AllocatorOptions::growable
+     */
+    bool isGrowable() const { return options_.growable; }
+
+    /// Alignment every allocation satisfies (8 or 16)
+    size_t alignment() const { return options_.alignment; }
+
+    /**
+     * @brief Install the hook told about extra segments and large mappings
+     *
+     * Mappings that already exist are not reported.
+     *
+     * @param hook New hook, or nullptr for none
+     * @param context First argument passed to the hook
+     */
+    void setMappingHook(MappingHook hook, void* context) {
+        mapping_hook_ = hook;
+        mapping_context_ = context;
+    }
+
+    /// NUMA node the heap's pages are placed on (OS_NO_NUMA_NODE if none)
+    int numaNode() const { return options_.numa_node; }
+
+    /**
+     * @brief Check whether the OS accepted the NUMA placement
+     * @return true if numaNode() is set and mbind() applied to the primary heap
+     */
+    bool isNumaBound() const { return numa_bound_; }
+
+    /**
+     * @brief Kind of pages backing the primary heap
+     * @return HugePageBacking::None unless huge pages were requested and obtained
+     */
+    HugePageBacking hugePageBacking() const { return primary_.backing; }
+
 private:
+    /// Compaction relocates its blocks with slideBlock()
+    friend class MovableHeap;
+
+    /**
+     * @brief Move an allocated block down over the free block in front of it
+     *
+     * The data slides to the start of that free block and the hole
+     * reappears above it, merged with a free successor. Walking blocks in
+     * address order and sliding each one packs them at the bottom of their
+     * segment. Every pointer into the block is invalidated, so this is only
+     * for MovableHeap, which updates the one handle to each block. The new
+     * address has the heap's base alignment only, which is all a block
+     * from my_malloc() was promised. The move is traced as a realloc, and
+     * a profiler sample follows the block.
+     *
+     * @param ptr Allocated heap block
+     * @return The block's new address, or ptr itself if the block is not
+     *         preceded by a free block or is a large mapping
+     */
+    void* slideBlock(void* ptr);
+
     /**
      * @brief Initialize the heap with a single free block
+     * @param zeroed true if the heap memory is freshly mapped (all zero)
+     */
+    void initializeHeap(bool zeroed);
+
+    /**
+     * @brief Lay out a segment as one free block followed by its sentinel
+     * @param segment Segment whose start/end are already set
+     * @param zeroed true if the segment memory is freshly mapped (all zero)
+     * @return The segment's free block (not yet on a size-class list)
+     */
+    static MemoryBlock* formatSegment(HeapSegment* segment, bool zeroed);
+
+    /**
+     * @brief Bind a fresh mapping to options_.numa_node before it is touched
+     * @return true if the OS applied the policy
+     */
+    bool bindToNode(void* memory, size_t size) const;
+
+    /// Tell the mapping hook, if any, about a mapping
+    void notifyMapping(const void* base, size_t size, bool mapped) const {
+        if (mapping_hook_) mapping_hook_(mapping_context_, base, size, mapped);
+    }
+
+    /**
+     * @brief my_free() without profiling
+     * @param ptr Pointer to release (non-null)
+     * @return true if the block was released, false if ptr was rejected
+     */
+    bool releaseBlock(void* ptr);
+
+    /**
+     * @brief Return an allocated heap block to the free lists
+     *
+     * The tail of releaseBlock() once the pointer has been validated:
+     * statistics, coalescing, segment release and purging.
+     *
+     * @param block Allocated block of one of the heap segments
+     */
+    void freeHeapBlock(MemoryBlock* block);
+
+    /**
+     * @brief Canary of a block header at its address with its current size
+     * @return 16-bit value keyed by canary_secret_
+     */
+    uint16_t blockCanary(const MemoryBlock* block) const;
+
+    /// Stamp an allocated block with its canary once its size is final (hardened heaps only)
+    void stampBlock(MemoryBlock* block) {
+        if (options_.hardened) block->setCanary(blockCanary(block));
+    }
+
+    /**
+     * @brief Hardened-mode validation of a pointer about to be freed
+     *
+     * The pointer must be aligned and carry the canary of a block header
+     * of its size at its address, the block must not be free or
+     * quarantined, it must end inside the segment, and a footer in front
+     * must describe the free block that ends at it.
+     *
+     * @param ptr Pointer inside one of the heap segments
+     * @param segment The segment holding ptr
+     * @return AllocError::None if the block may be released, otherwise
+     *         InvalidPointer, DoubleFree or CorruptedBlock
+     */
+    AllocError checkBlock(void* ptr, const HeapSegment* segment) const;
+
+    /**
+     * @brief Poison a freed block and hold it back, evicting the oldest ones
+     * @param block Validated allocated block
+     */
+    void quarantineBlock(MemoryBlock* block);
+
+    /**
+     * @brief Release the oldest quarantined block, checking its poison
+     * @return Data bytes of the released block
+     */
+    size_t evictQuarantine();
+
+    /**
+     * @brief my_realloc() without profiling
+     */
+    void* reallocBlock(void* ptr, size_t new_size);
+
+    /**
+     * @brief my_malloc_batch() without the tracing and profiling
+     */
+    size_t carveBatch(size_t size, size_t count, void** out);
+
+    /**
+     * @brief Usable size of an allocated block, for the profiler
+     * @param ptr Any pointer
+     * @return Block size, or 0 for nullptr, foreign or free pointers
+     */
+    size_t liveBlockSize(void* ptr) const;
+
+    /**
+     * @brief Allocate a heap block (my_malloc() below the large threshold)
+     * @param size Requested size in bytes (non-zero)
+     * @param zeroed Set to whether the block's data is zero past its first
+     *               sizeof(FreeLinks) bytes (may be nullptr)
+     * @return Pointer to the data, or nullptr if out of memory
+     */
+    void* allocateBlock(size_t size, bool* zeroed);
+
+    /**
+     * @brief Map an extra segment large enough for a block of the given size
+     * @param size Data size the new segment must be able to hold
+     * @return true if a segment was added
+     */
+    bool addSegment(size_t size);
+
+    /**
+     * @brief Unmap a segment if it holds nothing but one free block
+     * @param link Pointer to the list link that refers to the segment
+     * @return true if the segment was unmapped and unlinked
+     */
+    bool releaseIfEmpty(HeapSegment** link);
+
+    /**
+     * @brief Unmap the newest extra segments while they are entirely free
+     */
+    void releaseTrailingSegments();
+
+    /**
+     * @brief Unmap every extra segment
+     */
+    void releaseAllSegments();
+
+    /// Returned by findLarge() for pointers that are not large allocations
+    static constexpr size_t NO_LARGE = static_cast<size_t>(-1);
+
+    /**
+     * @brief Check if a pointer lies inside one of the heap segments
+     * @param ptr Pointer to check
+     * @return true if ptr is inside a segment's blocks
+     */
+    bool inHeapSegments(const void* ptr) const;
+
+    /**
+     * @brief Find the segment holding a data pointer
+     * @return The segment, or nullptr if ptr is in none of them
+     */
+    const HeapSegment* findSegment(const void* ptr) const;
+
+    /**
+     * @brief Serve a request with its own page-aligned mapping
+     * @param size Requested size
+     * @param alignment Required data alignment (0 for the default)
+     * @return Pointer to the data, or nullptr if the OS refused
+     */
+    void* allocateLarge(size_t size, size_t alignment = 0);
+
+    /**
+     * @brief Turn the front of an allocated block into a free block
+     * @param block Allocated block, already counted as used
+     * @param gap Bytes to give up (at least a header plus MIN_BLOCK_SIZE)
+     * @return The allocated block that now starts gap bytes further on
+     */
+    MemoryBlock* splitLeading(MemoryBlock* block, size_t gap);
+
+    /**
+     * @brief Unmap a large allocation and drop it from the side table
+     * @param index Side-table index
+     */
+    void freeLarge(size_t index);
+
+    /**
+     * @brief Resize a large allocation by remapping its pages
+     * @param index Side-table index
+     * @param new_size Requested size
+     * @return Pointer to the (possibly moved) data, or nullptr on failure
+     */
+    void* reallocLarge(size_t index, size_t new_size);
+
+    /**
+     * @brief Look up a large allocation by its data pointer
+     * @param ptr Pointer to look up
+     * @return Side-table index, or NO_LARGE
      */
-    void initializeHeap();
+    size_t findLarge(const void* ptr) const;
+
+    /**
+     * @brief Add an entry to the side table, keeping it sorted
+     * @param entry Entry to add (capacity must already be available)
+     */
+    void insertLarge(const LargeAllocation& entry);
+
+    /**
+     * @brief Double the side table's capacity
+     * @return true on success
+     */
+    bool growLargeTable();
+
+    /**
+     * @brief Unmap every large allocation and the side table itself
+     */
+    void releaseAllLarge();
+
+    /**
+     * @brief Smallest unit the heap maps and purges in
+     * @return The huge page size when huge pages were requested, else the OS page size
+     */
+    size_t pageGranule() const;
+
+    /**
+     * @brief Purge free memory once the byte or time threshold is reached
+     */
+    void maybePurge();
+
+    /**
+     * @brief Purge the interior of every free block of at least a given size
+     * @param min_block Smallest block size worth purging
+     * @return Number of bytes purged
+     */
+    size_t purgeFreeBlocks(size_t min_block);
     
     /**
-     * @brief Find a suitable free block (first-fit strategy)
+     * @brief Find a suitable free block with the placement policy
+     *
+     * Counts the search and the blocks it examined in the statistics.
+     *
      * @param size Required size
      * @return Pointer to suitable block, or nullptr if none found
      */
     MemoryBlock* findFreeBlock(size_t size);
+
+    /**
+     * @brief FirstFit: segregated fit
+     *
+     * Scans at most MAX_CLASS_SCAN blocks of the request's own size class,
+     * then takes the head of the smallest non-empty larger class, whose
+     * blocks are all guaranteed to fit.
+     */
+    MemoryBlock* findFirstFit(size_t size, size_t& steps);
+
+    /**
+     * @brief BestFit: the smallest block that fits
+     *
+     * The classes already order blocks by size to within a factor of two,
+     * so the best fit is in the request's own class or is the smallest
+     * block of the next non-empty class; at most two lists are scanned.
+     */
+    MemoryBlock* findBestFit(size_t size, size_t& steps);
+
+    /**
+     * @brief NextFit and AddressOrderedFirstFit: the lowest-address fit
+     *
+     * Under these policies the free blocks form a Cartesian tree, a binary
+     * search tree by address in which no block is larger than its parent
+     * (Stephenson's "fast fits"). The search is one walk down from the
+     * root, leaving any subtree whose root is too small.
+     *
+     * @param after Prefer blocks above this address (0 = any); wraps
+     *              around to the lowest fit when none is above it
+     */
+    MemoryBlock* findLowestAddressFit(size_t size, uintptr_t after, size_t& steps);
+
+    /**
+     * @brief Tlsf: head of the first list whose blocks all fit
+     *
+     * Rounds the request up to the next second-level boundary, then finds
+     * the list with two find-first-set operations. Only when that fails
+     * are up to MAX_CLASS_SCAN blocks of the request's own list tried.
+     */
+    MemoryBlock* findTlsfFit(size_t size, size_t& steps);
+
+    /**
+     * @brief Carve the TLSF index from the heap and index every free block
+     * @return false if no free block can hold the index
+     */
+    bool enableTlsf();
+
+    /**
+     * @brief Move every free block back to the size classes and free the index
+     */
+    void disableTlsf();
+
+    /**
+     * @brief Call visit(block) for every free block that may be of size
+     *        class first_class or above
+     */
+    template <typename Visit>
+    void forEachFreeBlock(size_t first_class, Visit visit);
+
+    /// The placement policy keeps the free blocks in the address tree
+    bool addressOrdered() const {
+        return options_.placement == PlacementPolicy::NextFit ||
+               options_.placement == PlacementPolicy::AddressOrderedFirstFit;
+    }
+
+    /**
+     * @brief Rebuild the size classes or the address tree from the segments,
+     *        after the placement policy moved between them
+     */
+    void reindexFreeBlocks();
+
+    /**
+     * @brief Insert a free block into the address tree
+     *
+     * Descends by address to the first node the block outranks, then
+     * splits that subtree around the block's address into its children.
+     */
+    void insertTreeBlock(MemoryBlock* block);
+
+    /**
+     * @brief Remove a free block from the address tree, merging its children
+     */
+    void removeTreeBlock(MemoryBlock* block);
+
+    /**
+     * @brief Map a block size to its size class
+     * @param size Block data size
+     * @return Index of the class holding blocks of this size
+     */
+    static size_t sizeClassIndex(size_t size);
+
+    /**
+     * @brief Push a free block onto its size-class list (or into the address tree)
+     * @param block Free block to insert
+     */
+    void insertFreeBlock(MemoryBlock* block);
+
+    /**
+     * @brief Unlink a free block from its size-class list (or the address tree)
+     * @param block Free block to remove
+     */
+    void removeFreeBlock(MemoryBlock* block);
     
+    /**
+     * @brief Mark a block allocated and clear its footer in the next block
+     * @param block Block leaving the free lists
+     */
+    void markAllocated(MemoryBlock* block);
+
+    /**
+     * @brief Mark a block free and write its footer into the next block
+     * @param block Block becoming available
+     */
+    void markFree(MemoryBlock* block);
+
     /**
      * @brief Split a block if it's larger than needed
+     *
+     * The remainder becomes a free block on its size-class list.
+     *
      * @param block Block to potentially split
      * @param size Required size for the first part
+     * @param zeroed true if the block was a ZERO free block, whose tail
+     *               then stays known-zero
      * @return true if split occurred
      */
-    bool splitBlock(MemoryBlock* block, size_t size);
+    bool splitBlock(MemoryBlock* block, size_t size, bool zeroed = false);
     
     /**
      * @brief Coalesce a block with adjacent free blocks
+     *
+     * The merged block is inserted into its size-class list. It keeps the
+     * ZERO flag only if every part had it.
+     *
      * @param block Block to coalesce
      * @return Pointer to the resulting (possibly larger) block
      */
     MemoryBlock* coalesceBlock(MemoryBlock* block);
     
     /**
-     * @brief Align size to ALIGNMENT boundary
+     * @brief Align size to the heap's alignment
      * @param size Size to align
      * @return Aligned size
      */
-    static size_t alignSize(size_t size);
+    size_t alignSize(size_t size) const;
     
     /**
      * @brief Update statistics after allocation
@@ -241,15 +1132,14 @@ private:
      * @param size Freed size
      */
     void updateStatsAfterFree(size_t size);
-    
-    /**
-     * @brief Recalculate block counts for statistics
-     */
-    void recalculateBlockCounts();
 };
 
 /**
  * @brief Global allocator instance for convenience functions
+ *
+ * The global functions are backed by an ArenaSet (see arena_set.hpp);
+ * this points at its first arena, which is the whole heap unless
+ * initGlobalArenas() was used.
  */
 extern MemoryAllocator* g_allocator;
 
@@ -264,8 +1154,47 @@ void initGlobalAllocator(size_t heap_size = MemoryAllocator::DEFAULT_HEAP_SIZE);
  */
 void destroyGlobalAllocator();
 
+/**
+ * @brief Take every global allocator lock, e.g. in a pthread_atfork() handler
+ *
+ * Blocks all other allocation until unlockGlobalAllocator().
+ */
+void lockGlobalAllocator();
+
+/**
+ * @brief Release the locks taken by lockGlobalAllocator()
+ */
+void unlockGlobalAllocator();
+
+/**
+ * @brief Return the calling thread's cached blocks to the global allocator
+ *
+ * Threads flush automatically when they exit; this is useful before
+ * inspecting global statistics.
+ */
+void flushThreadCache();
+
+/**
+ * @brief Return free global heap memory to the OS, like malloc_trim()
+ *
+ * Flushes the calling thread's cache first so its blocks can be purged.
+ *
+ * @return Bytes released or purged
+ */
+size_t trimGlobalAllocator();
+
+/// Alignment of every pointer from the global functions: alignof(max_align_t)
+/// and __STDCPP_DEFAULT_NEW_ALIGNMENT__, both 16 on x86-64
+constexpr size_t GLOBAL_ALIGNMENT = 16;
+
 /**
  * @brief Global malloc function using global allocator
+ *
+ * The global functions are thread-safe. Small requests are served from
+ * a per-thread ThreadCache without locking; everything else takes the
+ * lock of one arena of the global ArenaSet. initGlobalAllocator() and
+ * destroyGlobalAllocator() must not race with allocation calls.
+ *
  * @param size Number of bytes to allocate
  * @return Pointer to allocated memory
  */
@@ -277,6 +1206,30 @@ void* custom_malloc(size_t size);
  */
 void custom_free(void* ptr);
 
+/**
+ * @brief Global sized free, the target of C++14 sized operator delete
+ *
+ * Small blocks go to the thread cache by size without reading their header.
+ *
+ * @param ptr Pointer to free
+ * @param size Size originally requested for ptr
+ */
+void custom_free_sized(void* ptr, size_t size);
+
+/**
+ * @brief Global malloc placing the memory on one NUMA node
+ *
+ * Allocates from that node's arenas only, bypassing the thread cache;
+ * free it with custom_free(). Nodes other than 0 exist only once the
+ * global arenas use ArenaSet::Assignment::NumaNode, via
+ * initGlobalArenas() or CUSTOMALLOC_NUMA=1 in the environment.
+ *
+ * @param size Number of bytes to allocate
+ * @param node Node index below g_arenas->nodeCount()
+ * @return Pointer to allocated memory, or nullptr for an unknown node
+ */
+void* custom_malloc_on_node(size_t size, int node);
+
 /**
  * @brief Global realloc function using global allocator
  * @param ptr Existing pointer
@@ -293,6 +1246,30 @@ void* custom_realloc(void* ptr, size_t size);
  */
 void* custom_calloc(size_t count, size_t size);
 
+/**
+ * @brief Global aligned_alloc function using global allocator
+ * @param alignment Required alignment (a power of two)
+ * @param size Number of bytes to allocate
+ * @return Aligned pointer, or nullptr on failure
+ */
+void* custom_aligned_alloc(size_t alignment, size_t size);
+
+/**
+ * @brief Global posix_memalign function using global allocator
+ * @param memptr Receives the allocation
+ * @param alignment Power of two that is a multiple of sizeof(void*)
+ * @param size Number of bytes to allocate
+ * @return 0, EINVAL or ENOMEM
+ */
+int custom_posix_memalign(void** memptr, size_t alignment, size_t size);
+
+/**
+ * @brief Global malloc_usable_size function using global allocator
+ * @param ptr Live pointer from the global allocator
+ * @return Bytes usable at ptr (0 for nullptr or a foreign pointer)
+ */
+size_t custom_usable_size(void* ptr);
+
 } // namespace CustomAllocator
 
 #endif // MEMORY_ALLOCATOR_HPP
@@ -0,0 +1,179 @@
+/**
+ * @file memory_resource.hpp
+ * @brief Custom Memory Allocator - std::pmr and STL Allocator Adapters
+ *
+ * Puts standard containers on any allocator in this project:
+ * - Resource: a std::pmr::memory_resource over a heap, an arena set, a
+ *   monotonic arena, a fixed pool, a buddy or slab allocator, or the
+ *   global thread-cached allocator
+ * - StlAllocator<T>: a classic allocator for containers that are not pmr
+ *
+ * Both honour the alignment of the element type: over-aligned requests
+ * go through my_aligned_alloc() rather than being silently misaligned.
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef MEMORY_RESOURCE_HPP
+#define MEMORY_RESOURCE_HPP
+
+#include "arena_set.hpp"
+#include "buddy_allocator.hpp"
+#include "fixed_pool.hpp"
+#include "memory_allocator.hpp"
+#include "monotonic_arena.hpp"
+#include "slab_allocator.hpp"
+
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+
+namespace CustomAllocator {
+
+/**
+ * @class Resource
+ * @brief std::pmr::memory_resource backed by one of the project's allocators
+ *
+ * The resource does not own its backend, which must outlive it. Thread
+ * safety is that of the backend: the global allocator and ArenaSet are
+ * thread-safe, MemoryAllocator and MonotonicArena are not.
+ * Deallocation passes the size on (my_free_sized()), and is a no-op for a
+ * monotonic arena. A fixed pool only serves requests that fit one slot.
+ * Buddy and slab allocators are not thread-safe either, and a slab
+ * allocator only serves requests of up to 512 bytes.
+ */
+class Resource : public std::pmr::memory_resource {
+public:
+    /**
+     * @brief Resource over the global custom_* functions (thread caches)
+     */
+    Resource() noexcept;
+
+    /**
+     * @brief Resource over a single heap
+     * @param heap Allocator serving every request
+     */
+    explicit Resource(MemoryAllocator& heap) noexcept;
+
+    /**
+     * @brief Resource over a set of locked arenas
+     * @param arenas Arenas serving every request
+     */
+    explicit Resource(ArenaSet& arenas) noexcept;
+
+    /**
+     * @brief Resource over a bump-pointer arena
+     * @param arena Arena serving every request; memory returns on its release()
+     */
+    explicit Resource(MonotonicArena& arena) noexcept;
+
+    /**
+     * @brief Resource over a fixed-size pool (e.g. for list or map nodes)
+     * @param pool Pool whose slots serve every request
+     */
+    explicit Resource(FixedPool& pool) noexcept;
+
+    /**
+     * @brief Resource over a buddy allocator (e.g. for page-sized buffers)
+     * @param buddy Allocator serving every request, rounded up to a power of two
+     */
+    explicit Resource(BuddyAllocator& buddy) noexcept;
+
+    /**
+     * @brief Resource over a slab allocator (e.g. for list, map and tree nodes)
+     * @param slabs Allocator serving every request of up to 512 bytes
+     */
+    explicit Resource(SlabAllocator& slabs) noexcept;
+
+protected:
+    /**
+     * @brief Allocate from the backend
+     * @throws std::bad_alloc if the backend cannot serve the request
+     */
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+
+    /// Equal when both resources draw from the same backend object
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    /// Kind of allocator behind the resource
+    enum class Backend { Global, Heap, Arenas, Monotonic, Pool, Buddy, Slab };
+
+    Backend backend_;   ///< Kind of backend
+    void* target_;      ///< Backend object (nullptr for Global)
+};
+
+/**
+ * @brief Shared resource over the global custom_* functions
+ * @return Resource that lives for the whole program
+ */
+Resource& globalResource() noexcept;
+
+/**
+ * @class StlAllocator
+ * @brief Standard allocator drawing from a Resource
+ *
+ * Like std::pmr::polymorphic_allocator, the resource does not propagate
+ * on container copy, move or swap, and allocators compare equal when
+ * their resources do.
+ *
+ * @tparam T Element type
+ */
+template <typename T>
+class StlAllocator {
+public:
+    using value_type = T;
+
+    /// Allocate from the global resource
+    StlAllocator() noexcept : resource_(&globalResource()) {}
+
+    /// Allocate from the given resource (which must outlive the allocator)
+    StlAllocator(Resource& resource) noexcept : resource_(&resource) {}
+
+    template <typename U>
+    StlAllocator(const StlAllocator<U>& other) noexcept
+        : resource_(other.resource()) {}
+
+    /**
+     * @brief Allocate storage for n objects, aligned for T
+     * @throws std::bad_array_new_length if n * sizeof(T) overflows
+     * @throws std::bad_alloc if the resource is out of memory
+     */
+    T* allocate(size_t n) {
+        if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * @brief Release storage from allocate(n)
+     */
+    void deallocate(T* ptr, size_t n) noexcept {
+        resource_->deallocate(ptr, n * sizeof(T), alignof(T));
+    }
+
+    /// Resource this allocator draws from
+    Resource* resource() const noexcept { return resource_; }
+
+private:
+    Resource* resource_;    ///< Source of all memory
+};
+
+template <typename T, typename U>
+bool operator==(const StlAllocator<T>& a, const StlAllocator<U>& b) noexcept {
+    return a.resource() == b.resource() || a.resource()->is_equal(*b.resource());
+}
+
+template <typename T, typename U>
+bool operator!=(const StlAllocator<T>& a, const StlAllocator<U>& b) noexcept {
+    return !(a == b);
+}
+
+} // namespace CustomAllocator
+
+#endif // MEMORY_RESOURCE_HPP
@@ -0,0 +1,168 @@
+/**
+ * @file monotonic_arena.hpp
+ * @brief Custom Memory Allocator - Bump-Pointer Monotonic Arena
+ *
+ * Scratch memory whose allocations all die together:
+ * - allocate() is an aligned pointer bump inside the current chunk
+ * - Chunks come from a parent MemoryAllocator and are chained on demand
+ * - Individual frees are no-ops; release() returns every chunk at once
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef MONOTONIC_ARENA_HPP
+#define MONOTONIC_ARENA_HPP
+
+#include "memory_allocator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace CustomAllocator {
+
+/**
+ * @struct ArenaStats
+ * @brief Utilization of a MonotonicArena
+ */
+struct ArenaStats {
+    size_t chunk_count;          ///< Chunks currently held
+    size_t reserved_bytes;       ///< Bytes taken from the parent, chunk headers included
+    size_t allocated_bytes;      ///< Bytes handed out since the last release()
+    size_t total_allocations;    ///< Successful allocate() calls since the last release()
+    size_t release_count;        ///< release() calls that returned chunks
+
+    /**
+     * @brief Calculate how much of the reserved memory is in use
+     * @return Allocated bytes as percentage of reserved bytes (0-100)
+     */
+    double getUtilization() const {
+        if (reserved_bytes == 0) return 0.0;
+        return (static_cast<double>(allocated_bytes) / reserved_bytes) * 100.0;
+    }
+};
+
+/**
+ * @class MonotonicArena
+ * @brief Bump allocator over chunks of a parent MemoryAllocator
+ *
+ * Memory is never reused until release(), which hands all chunks back to
+ * the parent in O(chunks). Requests larger than the chunk size get a
+ * chunk of their own, so they do not waste the rest of the current one.
+ * The arena is not thread-safe; use one per thread or per request.
+ */
+class MonotonicArena {
+public:
+    /// Default size of each chunk taken from the parent (64 KB)
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    /**
+     * @brief Create an empty arena; the first chunk is taken on first use
+     * @param parent Allocator providing the chunks
+     * @param chunk_size Bytes to take from the parent per chunk
+     * @throws std::invalid_argument if chunk_size cannot hold a chunk header
+     */
+    explicit MonotonicArena(MemoryAllocator& parent,
+                            size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    /**
+     * @brief Destructor - returns every chunk to the parent
+     */
+    ~MonotonicArena();
+
+    // Disable copy and move operations (allocations point into the chunks)
+    MonotonicArena(const MonotonicArena&) = delete;
+    MonotonicArena& operator=(const MonotonicArena&) = delete;
+
+    /**
+     * @brief Bump-allocate memory from the current chunk
+     * @param size Number of bytes to allocate
+     * @param alignment Required alignment (a power of two)
+     * @return Pointer to the memory, or nullptr if the parent is out of memory
+     */
+    void* allocate(size_t size, size_t alignment = MemoryAllocator::ALIGNMENT) {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor_) + alignment - 1) &
+                            ~(static_cast<uintptr_t>(alignment) - 1);
+        if (alignment != 0 && (alignment & (alignment - 1)) == 0 && size != 0 &&
+            aligned <= reinterpret_cast<uintptr_t>(end_) &&
+            size <= reinterpret_cast<uintptr_t>(end_) - aligned) {
+            cursor_ = reinterpret_cast<char*>(aligned + size);
+            allocated_bytes_ += size;
+            total_allocations_++;
+            return reinterpret_cast<void*>(aligned);
+        }
+        return allocateSlow(size, alignment);
+    }
+
+    /**
+     * @brief Allocate and construct an object (never destroyed individually)
+     * @return Pointer to the new object, or nullptr if out of memory
+     */
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        return memory ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    /**
+     * @brief Return every chunk to the parent, invalidating all allocations
+     */
+    void release();
+
+    /**
+     * @brief Check if a pointer lies inside one of this arena's chunks
+     * @param ptr Pointer to check
+     * @return true if ptr was handed out by this arena
+     */
+    bool owns(const void* ptr) const;
+
+    /// Bytes taken from the parent per regular chunk
+    size_t chunkSize() const { return chunk_size_; }
+
+    /**
+     * @brief Get current arena utilization
+     * @return ArenaStats snapshot
+     */
+    ArenaStats getStats() const;
+
+    /**
+     * @brief Print arena utilization to stdout (diagnostics.cpp)
+     */
+    void printStats() const;
+
+private:
+    /**
+     * @struct Chunk
+     * @brief Header at the front of every chunk
+     */
+    struct Chunk {
+        Chunk* prev;        ///< Previously taken chunk
+        size_t size;        ///< Bytes taken from the parent, header included
+
+        char* begin() { return reinterpret_cast<char*>(this + 1); }
+        char* end() { return reinterpret_cast<char*>(this) + size; }
+    };
+
+    /**
+     * @brief Take a new chunk (or a dedicated one) and allocate from it
+     */
+    void* allocateSlow(size_t size, size_t alignment);
+
+    MemoryAllocator& parent_;   ///< Allocator owning the chunks
+    size_t chunk_size_;         ///< Bytes per regular chunk
+    Chunk* chunks_;             ///< Every chunk, newest first
+    char* cursor_;              ///< Next free byte in the chunk being bumped
+    char* end_;                 ///< End of the chunk being bumped
+
+    size_t chunk_count_;        ///< Chunks currently held
+    size_t reserved_bytes_;     ///< Bytes taken from the parent
+    size_t allocated_bytes_;    ///< Bytes handed out since the last release
+    size_t total_allocations_;  ///< Allocations since the last release
+    size_t release_count_;      ///< release() calls that returned chunks
+};
+
+} // namespace CustomAllocator
+
+#endif // MONOTONIC_ARENA_HPP
@@ -0,0 +1,254 @@
+/**
+ * @file movable_heap.hpp
+ * @brief Custom Memory Allocator - Relocatable Blocks and Compaction
+ *
+ * Blocks reached through handles instead of raw pointers, so the heap
+ * can move them and rebuild large free regions:
+ * - alloc_movable() returns a Handle; pin() yields its current address and
+ *   keeps it in place until unpin()
+ * - compact() slides unpinned blocks down over the holes in front of
+ *   them, in address order, stopping when its time budget runs out and
+ *   resuming there on the next call
+ * - An optional background thread compacts whenever fragmentation passes
+ *   a threshold, taking the lock once per block moved
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef MOVABLE_HEAP_HPP
+#define MOVABLE_HEAP_HPP
+
+#include "memory_allocator.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CustomAllocator {
+
+/**
+ * @struct Handle
+ * @brief Stable reference to a relocatable block of a MovableHeap
+ *
+ * A slot index plus the slot's generation, so a handle to a freed block
+ * stays detectably stale after its slot is reused.
+ */
+struct Handle {
+    uint32_t index = 0;        ///< Slot in the handle table
+    uint32_t generation = 0;   ///< Generation of the slot (0 = null handle)
+
+    /// True unless this is the null handle
+    explicit operator bool() const { return generation != 0; }
+
+    bool operator==(const Handle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+/**
+ * @struct MovableStats
+ * @brief Handle and compaction counters of a MovableHeap
+ */
+struct MovableStats {
+    size_t live_handles;         ///< Blocks allocated and not yet freed
+    size_t pinned_handles;       ///< Live blocks with at least one pin
+    size_t live_bytes;           ///< Bytes requested by the live blocks
+    size_t blocks_moved;         ///< Blocks relocated by compaction (cumulative)
+    size_t bytes_moved;          ///< Bytes copied by those relocations
+    size_t compaction_passes;    ///< Complete passes over the heap
+    size_t free_bytes;           ///< Free bytes in the heap
+    size_t largest_free_block;   ///< Largest request the heap can serve without growing
+
+    /**
+     * @brief External fragmentation: free memory outside the largest free block
+     * @return (1 - largest_free_block / free_bytes) as a percentage (0-100)
+     */
+    double getFragmentationRatio() const {
+        if (free_bytes == 0) return 0.0;
+        return (1.0 - static_cast<double>(largest_free_block) / free_bytes) * 100.0;
+    }
+};
+
+/**
+ * @class MovableHeap
+ * @brief A locked heap of relocatable, handle-addressed blocks
+ *
+ * The blocks live in a MemoryAllocator of their own, which uses
+ * AddressOrderedFirstFit placement so new blocks fill the lowest holes,
+ * and which has no large-allocation path so every block can move.
+ * Compaction packs the blocks of each segment towards its start; a pinned
+ * block stays where it is and the blocks above it pack against it.
+ * Blocks never move between segments, so a growable heap's extra
+ * segments are released only once their own blocks are freed.
+ *
+ * All methods are thread-safe. A pointer from pin() is valid until the
+ * matching unpin(); after that the block may move at any time.
+ */
+class MovableHeap {
+public:
+    /**
+     * @brief Create the heap
+     * @param options Heap geometry; placement and large_threshold are overridden
+     * @throws std::bad_alloc / std::invalid_argument like MemoryAllocator
+     */
+    explicit MovableHeap(const AllocatorOptions& options = AllocatorOptions());
+
+    /**
+     * @brief Destructor - stops the background compactor and frees the heap
+     */
+    ~MovableHeap();
+
+    // Disable copy and move operations (the compactor thread points at this)
+    MovableHeap(const MovableHeap&) = delete;
+    MovableHeap& operator=(const MovableHeap&) = delete;
+
+    /**
+     * @brief Allocate a relocatable block
+     * @param size Number of bytes
+     * @return Handle to the block, or a null handle if out of memory
+     */
+    Handle alloc_movable(size_t size);
+
+    /**
+     * @brief Free a block; its handle becomes stale
+     * @param handle Handle from alloc_movable() (null is ignored). Freeing a
+     *        stale handle reports InvalidPointer; a pinned block is freed
+     *        anyway and its pins are dropped.
+     */
+    void free_movable(Handle handle);
+
+    /**
+     * @brief Pin a block in place and get its address
+     *
+     * Pins nest; the block may move again once every pin is released.
+     *
+     * @param handle Live handle
+     * @return Current address of the block, or nullptr for a stale handle
+     */
+    void* pin(Handle handle);
+
+    /**
+     * @brief Release one pin taken with pin()
+     * @param handle Pinned handle
+     */
+    void unpin(Handle handle);
+
+    /**
+     * @brief Check whether a handle refers to a live block
+     */
+    bool isLive(Handle handle) const;
+
+    /**
+     * @brief Size requested for a block
+     * @return Bytes, or 0 for a stale handle
+     */
+    size_t movableSize(Handle handle) const;
+
+    /**
+     * @brief Slide unpinned blocks down over the free space in front of them
+     *
+     * Visits the blocks in address order from where the previous call
+     * stopped, taking the lock for each block separately so other threads
+     * are held up by at most one move.
+     *
+     * @param budget_us Time limit in microseconds (0 = finish the pass)
+     * @return Bytes moved by this call
+     */
+    size_t compact(uint64_t budget_us = 0);
+
+    /**
+     * @brief Start a thread that compacts in the background
+     *
+     * Every interval it checks the heap's fragmentation ratio and, above
+     * the threshold, runs compact(budget_us). Restarts the thread if one
+     * is already running.
+     *
+     * @param interval_ms Time between checks
+     * @param budget_us Time budget of each compaction step
+     * @param min_fragmentation Fragmentation percentage that triggers a step
+     */
+    void startBackgroundCompaction(uint32_t interval_ms = 100,
+                                   uint64_t budget_us = 1000,
+                                   double min_fragmentation = 10.0);
+
+    /**
+     * @brief Stop the background thread and wait for it
+     */
+    void stopBackgroundCompaction();
+
+    /**
+     * @brief Get handle and compaction counters
+     * @return MovableStats snapshot
+     */
+    MovableStats getStats() const;
+
+    /**
+     * @brief Get the underlying heap's statistics
+     * @return MemoryStats snapshot taken under the lock
+     */
+    MemoryStats heapStats() const;
+
+    /**
+     * @brief Check every live handle against the heap
+     * @return true if each live block is an allocated heap block large
+     *         enough for its size, no two handles share a block and the
+     *         heap's own statistics check out
+     */
+    bool verify() const;
+
+    /**
+     * @brief Print handle and compaction counters (diagnostics.cpp)
+     */
+    void printStats() const;
+
+private:
+    /// End of the free-slot chain
+    static constexpr uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+    /**
+     * @struct Slot
+     * @brief One handle table entry
+     */
+    struct Slot {
+        void* data;             ///< Current address (nullptr while the slot is free)
+        size_t size;            ///< Bytes requested
+        uint32_t generation;    ///< Bumped each time the slot is freed
+        uint32_t pins;          ///< Outstanding pin() calls
+        uint32_t next_free;     ///< Next free slot while this one is free
+    };
+
+    /// The slot of a live handle, or nullptr if it is stale (lock held)
+    Slot* liveSlot(Handle handle);
+    const Slot* liveSlot(Handle handle) const;
+
+    /// Body of the background thread
+    void backgroundLoop(uint32_t interval_ms, uint64_t budget_us,
+                        double min_fragmentation);
+
+    MemoryAllocator heap_;              ///< Heap holding the blocks
+    std::vector<Slot> slots_;           ///< Handle table
+    uint32_t free_slot_;                ///< Head of the free-slot chain
+    size_t live_handles_;               ///< Live blocks
+    size_t pinned_handles_;             ///< Live blocks with pins
+    size_t live_bytes_;                 ///< Bytes requested by live blocks
+    size_t blocks_moved_;               ///< Blocks relocated
+    size_t bytes_moved_;                ///< Bytes relocated
+    size_t passes_;                     ///< Complete compaction passes
+    uintptr_t cursor_;                  ///< Address the current pass resumes at
+    mutable std::mutex lock_;           ///< Guards the heap and the table
+
+    std::mutex compact_lock_;           ///< One compaction pass at a time
+    std::thread worker_;                ///< Background compactor
+    std::mutex worker_lock_;            ///< Guards stop_ for the worker
+    std::condition_variable worker_wake_; ///< Wakes the worker to stop
+    bool stop_;                         ///< Tells the worker to exit
+};
+
+} // namespace CustomAllocator
+
+#endif // MOVABLE_HEAP_HPP
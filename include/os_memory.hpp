@@ -0,0 +1,142 @@
+/**
+ * @file os_memory.hpp
+ * @brief Custom Memory Allocator - Operating System Memory Interface
+ *
+ * Thin portability layer over the platform's virtual memory calls
+ * (mmap/munmap on POSIX, VirtualAlloc/VirtualFree on Windows), used
+ * when the allocator needs memory directly from the OS, plus the NUMA
+ * topology queries and page binding used by node-local heaps.
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef OS_MEMORY_HPP
+#define OS_MEMORY_HPP
+
+#include <cstddef>
+
+namespace CustomAllocator {
+
+/// Huge page size requested by osMapHugeMemory() (2 MB)
+constexpr size_t OS_HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/// NUMA node value meaning "no preference" (the OS default policy)
+constexpr int OS_NO_NUMA_NODE = -1;
+
+/**
+ * @enum HugePageBacking
+ * @brief What kind of pages a mapping actually received
+ */
+enum class HugePageBacking {
+    None,           ///< Regular pages (huge pages unavailable)
+    Transparent,    ///< 2 MB-aligned and advised for transparent huge pages
+    Explicit        ///< Reserved huge pages (MAP_HUGETLB / MEM_LARGE_PAGES)
+};
+
+/**
+ * @brief Get the OS page size
+ * @return Page size in bytes
+ */
+size_t osPageSize();
+
+/**
+ * @brief Map fresh, zero-filled, read-write memory from the OS
+ * @param size Number of bytes (rounded up to whole pages internally)
+ * @return Page-aligned pointer, or nullptr on failure
+ */
+void* osMapMemory(size_t size);
+
+/**
+ * @brief Map memory backed by huge pages where the OS provides them
+ *
+ * Tries reserved huge pages first, then a 2 MB-aligned mapping advised
+ * for transparent huge pages, and finally falls back to osMapMemory().
+ * The result is released with osUnmapMemory() like any other mapping.
+ *
+ * @param size Number of bytes (a multiple of OS_HUGE_PAGE_SIZE)
+ * @param backing Receives the kind of pages obtained
+ * @return Pointer to the mapping, or nullptr on failure
+ */
+void* osMapHugeMemory(size_t size, HugePageBacking* backing);
+
+/**
+ * @brief Name of a huge page backing, for diagnostics
+ * @param backing Backing to describe
+ * @return Static, human-readable string
+ */
+const char* hugePageBackingName(HugePageBacking backing);
+
+/**
+ * @brief Return memory obtained from osMapMemory to the OS
+ * @param ptr Pointer returned by osMapMemory
+ * @param size Size passed to osMapMemory
+ */
+void osUnmapMemory(void* ptr, size_t size);
+
+/**
+ * @brief Resize a mapping, moving it if necessary
+ *
+ * Uses mremap() where available so the pages move without being copied;
+ * elsewhere maps a new range, copies and unmaps the old one.
+ *
+ * @param ptr Mapping returned by osMapMemory
+ * @param old_size Current size of the mapping
+ * @param new_size Requested size of the mapping
+ * @return New address of the mapping, or nullptr (old mapping intact)
+ */
+void* osRemapMemory(void* ptr, size_t old_size, size_t new_size);
+
+/**
+ * @brief Let the OS reclaim the physical pages behind a mapped range
+ *
+ * The range stays mapped and usable; its contents are undefined
+ * afterwards. Eager purges (MADV_DONTNEED) drop the resident set at once,
+ * lazy ones (MADV_FREE) only when the OS is under memory pressure.
+ *
+ * @param ptr Page-aligned start of the range
+ * @param size Number of bytes (a multiple of the page size)
+ * @param lazy Prefer a lazy purge where the platform has one
+ * @return true if the range now reads back as zero (an eager purge of
+ *         private anonymous memory)
+ */
+bool osPurgeMemory(void* ptr, size_t size, bool lazy = false);
+
+/**
+ * @brief Number of NUMA nodes the OS reports
+ *
+ * Read once from /sys/devices/system/node/possible on Linux; 1 on other
+ * platforms or when the topology cannot be read.
+ *
+ * @return Node count (at least 1)
+ */
+size_t osNumaNodeCount();
+
+/**
+ * @brief NUMA node of the CPU the calling thread is running on
+ *
+ * Uses getcpu(), a vDSO call on current glibc. The answer can be stale
+ * as soon as it returns if the scheduler migrates the thread.
+ *
+ * @return Node index below osNumaNodeCount() (0 when unknown)
+ */
+int osCurrentNumaNode();
+
+/**
+ * @brief Ask the OS to place a mapping's pages on one NUMA node
+ *
+ * Sets an MPOL_PREFERRED policy with mbind(), so pages are allocated on
+ * the node when they are first touched and spill to other nodes only if
+ * it runs out of memory. Call it before the range is written.
+ *
+ * @param ptr Page-aligned start of the range
+ * @param size Number of bytes
+ * @param node Node index below osNumaNodeCount()
+ * @return true if the policy was applied (false without NUMA support,
+ *         e.g. on a kernel built without it or in a sandbox)
+ */
+bool osBindMemory(void* ptr, size_t size, int node);
+
+} // namespace CustomAllocator
+
+#endif // OS_MEMORY_HPP
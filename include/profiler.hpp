@@ -0,0 +1,258 @@
+/**
+ * @file profiler.hpp
+ * @brief Custom Memory Allocator - Allocation Profiler
+ *
+ * Optional instrumentation of the allocation entry points:
+ * - Allocation and free counts per power-of-two size class
+ * - Latency histograms of allocations and frees, in CPU cycles (rdtsc)
+ * - Live bytes and their high-water mark
+ * - Poisson-sampled allocation stacks, one every sample_interval bytes on
+ *   average (like jemalloc's prof.lg_sample), written out in the pprof
+ *   heap profile format by writeHeapProfile() in diagnostics.hpp
+ *
+ * Compiled in with CUSTOM_ALLOC_PROFILING (CMake option
+ * ALLOCATOR_PROFILING) and off until startProfiling(). While it is off,
+ * each entry point pays a single relaxed atomic load.
+ *
+ * The MemoryAllocator my_* entry points and the global custom_* functions
+ * are profiled, the batch calls once per block. A call made from inside
+ * another profiled call (an ArenaSet or the thread cache reaching the
+ * heap) is not counted twice, and a thread cache flush is not counted at
+ * all: its blocks were counted when the program freed them.
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace CustomAllocator {
+
+/// Size classes tracked by the profiler: class i counts sizes [2^i, 2^(i+1))
+constexpr size_t PROFILE_SIZE_CLASSES = 64;
+
+/// Latency buckets: bucket i counts calls of [2^i, 2^(i+1)) cycles
+constexpr size_t PROFILE_LATENCY_BUCKETS = 32;
+
+/// Deepest call stack kept per sample
+constexpr size_t PROFILE_MAX_FRAMES = 32;
+
+/**
+ * @struct ProfileOptions
+ * @brief Settings for startProfiling()
+ */
+struct ProfileOptions {
+    size_t sample_interval = 512 * 1024;    ///< Mean bytes between sampled stacks (0 = no stacks)
+};
+
+/**
+ * @struct ProfileSnapshot
+ * @brief Counters gathered since the last resetProfile()
+ *
+ * Sizes are usable sizes, so a block is counted in the same class when it
+ * is allocated and when it is freed.
+ */
+struct ProfileSnapshot {
+    uint64_t alloc_count[PROFILE_SIZE_CLASSES];         ///< Allocations per size class
+    uint64_t free_count[PROFILE_SIZE_CLASSES];          ///< Frees per size class
+    uint64_t alloc_cycles[PROFILE_LATENCY_BUCKETS];     ///< Allocation latency histogram
+    uint64_t free_cycles[PROFILE_LATENCY_BUCKETS];      ///< Free latency histogram
+    size_t live_bytes;          ///< Usable bytes allocated and not yet freed
+    size_t peak_live_bytes;     ///< High-water mark of live_bytes
+    size_t live_samples;        ///< Sampled allocations that are still live
+    size_t dropped_samples;     ///< Samples lost because the sample table was full
+    size_t sample_interval;     ///< Interval the samples were taken with
+
+    /// Total allocations over all size classes
+    uint64_t totalAllocations() const {
+        uint64_t total = 0;
+        for (uint64_t count : alloc_count) total += count;
+        return total;
+    }
+
+    /// Total frees over all size classes
+    uint64_t totalFrees() const {
+        uint64_t total = 0;
+        for (uint64_t count : free_count) total += count;
+        return total;
+    }
+};
+
+/**
+ * @struct HeapSample
+ * @brief One sampled allocation that is still live
+ */
+struct HeapSample {
+    const void* ptr;                        ///< Sampled allocation
+    size_t size;                            ///< Bytes requested
+    size_t depth;                           ///< Valid entries in frames
+    void* frames[PROFILE_MAX_FRAMES];       ///< Return addresses, innermost first
+};
+
+/**
+ * @brief Turn profiling on, keeping counters from earlier runs
+ * @param options Sampling settings
+ * @return false if the profiler was compiled out
+ */
+bool startProfiling(const ProfileOptions& options = ProfileOptions()) noexcept;
+
+/**
+ * @brief Turn profiling off; the counters and live samples stay readable
+ */
+void stopProfiling() noexcept;
+
+/**
+ * @brief Clear all counters, the high-water mark and the live samples
+ */
+void resetProfile() noexcept;
+
+/**
+ * @brief Copy of the current counters
+ */
+ProfileSnapshot profileSnapshot() noexcept;
+
+/**
+ * @brief Copy the live sampled allocations
+ * @param out Array receiving up to capacity samples
+ * @param capacity Entries available in out
+ * @return Number of samples copied
+ */
+size_t heapSamples(HeapSample* out, size_t capacity) noexcept;
+
+namespace detail {
+
+#if defined(CUSTOM_ALLOC_PROFILING)
+/// True between startProfiling() and stopProfiling()
+extern std::atomic<bool> g_profiling;
+#endif
+
+/// Start of a profiled call (0 if this thread is already inside one)
+uint64_t profileEnter() noexcept;
+
+/// End of a profiled call that allocated usable bytes at ptr
+void profileAllocated(uint64_t start, const void* ptr, size_t requested,
+                      size_t usable) noexcept;
+
+/// End of a profiled call that freed usable bytes at ptr
+void profileFreed(uint64_t start, const void* ptr, size_t usable) noexcept;
+
+/// End of a profiled realloc that moved or resized old_ptr to new_ptr
+void profileReallocated(uint64_t start, const void* old_ptr, size_t old_usable,
+                        const void* new_ptr, size_t requested,
+                        size_t new_usable) noexcept;
+
+/// Start time that charges each of count batch events an even share of
+/// the cycles since start
+uint64_t profileBatchStart(uint64_t start, size_t count) noexcept;
+
+/// One allocation made by a profiled batch call; the call stays open
+void profileBatchAllocated(uint64_t start, const void* ptr, size_t requested,
+                           size_t usable) noexcept;
+
+/// One free made by a profiled batch call; the call stays open
+void profileBatchFreed(uint64_t start, const void* ptr, size_t usable) noexcept;
+
+/// A block moved from old_ptr to new_ptr without being freed; its sample
+/// (if any) follows it
+void profileMoved(const void* old_ptr, const void* new_ptr) noexcept;
+
+/// End of a profiled call without an event to record
+void profileLeave() noexcept;
+
+} // namespace detail
+
+/**
+ * @brief Profiling is on
+ */
+inline bool profilingEnabled() noexcept {
+#if defined(CUSTOM_ALLOC_PROFILING)
+    return detail::g_profiling.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
+
+/**
+ * @class ProfileScope
+ * @brief Times one allocator entry point while profiling is on
+ *
+ * Declared at the top of an entry point; the call then reports its event
+ * with allocated() or freed(). Callers only compute the usable size when
+ * active() is true, so a disabled profiler costs nothing more.
+ */
+class ProfileScope {
+public:
+    ProfileScope() noexcept
+        : start_(profilingEnabled() ? detail::profileEnter() : 0) {}
+
+    ~ProfileScope() {
+        if (start_) detail::profileLeave();
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    /// This call is the outermost profiled call on its thread
+    bool active() const noexcept { return start_ != 0; }
+
+    /// Record an allocation (a nullptr result records nothing)
+    void allocated(const void* ptr, size_t requested, size_t usable) noexcept {
+        if (start_) {
+            detail::profileAllocated(start_, ptr, requested, usable);
+            start_ = 0;
+        }
+    }
+
+    /// Record a free (usable 0, e.g. an invalid pointer, records nothing)
+    void freed(const void* ptr, size_t usable) noexcept {
+        if (start_) {
+            detail::profileFreed(start_, ptr, usable);
+            start_ = 0;
+        }
+    }
+
+    /// Record a successful realloc: a free of the old block (untimed) and
+    /// an allocation of the new one
+    void reallocated(const void* old_ptr, size_t old_usable, const void* new_ptr,
+                     size_t requested, size_t new_usable) noexcept {
+        if (start_) {
+            detail::profileReallocated(start_, old_ptr, old_usable, new_ptr,
+                                       requested, new_usable);
+            start_ = 0;
+        }
+    }
+
+    /// Record a relocation (MovableHeap compaction): nothing is counted,
+    /// but a sample of the block moves with it
+    void moved(const void* old_ptr, const void* new_ptr) noexcept {
+        if (start_) detail::profileMoved(old_ptr, new_ptr);
+    }
+
+    /// Split the call's cycles between the count events of a batch call,
+    /// each then reported with batchAllocated() or batchFreed()
+    void beginBatch(size_t count) noexcept {
+        if (start_ && count) start_ = detail::profileBatchStart(start_, count);
+    }
+
+    /// Record one allocation of a batch call
+    void batchAllocated(const void* ptr, size_t requested, size_t usable) noexcept {
+        if (start_) detail::profileBatchAllocated(start_, ptr, requested, usable);
+    }
+
+    /// Record one free of a batch call
+    void batchFreed(const void* ptr, size_t usable) noexcept {
+        if (start_) detail::profileBatchFreed(start_, ptr, usable);
+    }
+
+private:
+    uint64_t start_;    ///< Cycle count at entry, 0 when not profiling
+};
+
+} // namespace CustomAllocator
+
+#endif // PROFILER_HPP
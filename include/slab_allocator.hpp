@@ -0,0 +1,236 @@
+/**
+ * @file slab_allocator.hpp
+ * @brief Custom Memory Allocator - Slab Allocator for Small Objects
+ *
+ * Headerless objects of up to 512 bytes for node-heavy data structures:
+ * - Each slab is one aligned run (a page to 1 MB, 64 KB by default) taken
+ *   from a parent MemoryAllocator, holding objects of one size class
+ * - Free slots are bits in an occupancy bitmap at the front of the slab,
+ *   found with a find-first-set (SSE2 skips full 128-bit spans)
+ * - deallocate() finds the slab by masking the address, so objects carry
+ *   no MemoryBlock header and sit back to back
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef SLAB_ALLOCATOR_HPP
+#define SLAB_ALLOCATOR_HPP
+
+#include "memory_allocator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace CustomAllocator {
+
+/**
+ * @struct SlabStats
+ * @brief Utilization of a SlabAllocator
+ */
+struct SlabStats {
+    size_t slab_size;            ///< Bytes per slab
+    size_t slab_count;           ///< Slabs currently held, empty ones included
+    size_t empty_slabs;          ///< Slabs kept with no live objects
+    size_t objects_in_use;       ///< Live objects
+    size_t object_bytes;         ///< Bytes of live objects (sizes rounded up to their class)
+    size_t total_allocations;    ///< Successful allocate() calls
+    size_t total_frees;          ///< Successful deallocate() calls
+    size_t failed_allocations;   ///< allocate() calls that returned nullptr
+
+    /**
+     * @brief Calculate how much of the slabs' memory holds live objects
+     * @return Object bytes as percentage of slab bytes (0-100)
+     */
+    double getUtilization() const {
+        if (slab_count == 0) return 0.0;
+        return (static_cast<double>(object_bytes) / (slab_count * slab_size)) * 100.0;
+    }
+};
+
+/**
+ * @class SlabAllocator
+ * @brief Size-class slabs of small objects over a parent MemoryAllocator
+ *
+ * Requests are rounded up to one of NUM_CLASSES sizes: multiples of 16 up
+ * to 128 bytes, then of 32 up to 256 and of 64 up to 512. Objects are
+ * 16-byte aligned.
+ *
+ * A slab is on exactly one list: its class's partial list (some objects
+ * free) or full list, or the shared empty list. Allocation takes the
+ * first partial slab of the class, then an empty slab reformatted for it,
+ * then a new slab from the parent. Up to max_empty slabs stay on the
+ * empty list when their last object is freed; the rest go back to the
+ * parent at once, and trim() returns them all.
+ *
+ * Pointers passed to deallocate() must come from a SlabAllocator: the
+ * slab header is read straight from the masked address. The header's
+ * owner pointer catches an object freed to the wrong slab allocator.
+ * The allocator is not thread-safe; use one per thread or per structure.
+ */
+class SlabAllocator {
+public:
+    /// Default bytes per slab (64 KB)
+    static constexpr size_t DEFAULT_SLAB_SIZE = 64 * 1024;
+
+    /// Largest request a slab serves
+    static constexpr size_t MAX_OBJECT_SIZE = 512;
+
+    /// Number of object size classes
+    static constexpr size_t NUM_CLASSES = 16;
+
+    /// Empty slabs kept for reuse by default
+    static constexpr size_t DEFAULT_MAX_EMPTY = 4;
+
+    /**
+     * @brief Create a slab allocator; slabs are taken on first use
+     * @param parent Allocator providing the slabs
+     * @param slab_size Bytes per slab, a power of two from 4 KB to 1 MB
+     * @param max_empty Empty slabs kept instead of returned to the parent
+     * @throws std::invalid_argument for an unsupported slab size
+     */
+    explicit SlabAllocator(MemoryAllocator& parent,
+                           size_t slab_size = DEFAULT_SLAB_SIZE,
+                           size_t max_empty = DEFAULT_MAX_EMPTY);
+
+    /**
+     * @brief Destructor - returns every slab to the parent
+     */
+    ~SlabAllocator();
+
+    // Disable copy and move operations (slabs point back at their owner)
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    /**
+     * @brief Allocate a small object
+     * @param size Bytes requested (1 to MAX_OBJECT_SIZE)
+     * @return 16-byte aligned object, or nullptr for size 0, a size above
+     *         MAX_OBJECT_SIZE or a parent out of memory (OutOfMemory)
+     */
+    void* allocate(size_t size);
+
+    /**
+     * @brief Free an object; an emptied slab is kept or returned
+     * @param ptr Pointer returned by allocate() (can be nullptr)
+     */
+    void deallocate(void* ptr);
+
+    /**
+     * @brief Allocate an object and construct it
+     * @return Pointer to the new object, or nullptr if out of memory
+     */
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(sizeof(T) <= MAX_OBJECT_SIZE, "Slab objects are at most 512 bytes");
+        static_assert(alignof(T) <= 16, "Slab objects are 16-byte aligned");
+        void* memory = allocate(sizeof(T));
+        return memory ? new (memory) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    /**
+     * @brief Destroy an object created with create() and free it
+     * @param object Object to destroy (can be nullptr)
+     */
+    template <typename T>
+    void destroy(T* object) {
+        if (object) {
+            object->~T();
+            deallocate(object);
+        }
+    }
+
+    /**
+     * @brief Check if a pointer is a live object of this allocator
+     *
+     * Walks every slab, so meant for assertions and tests; deallocate()
+     * relies on the address mask instead.
+     */
+    bool owns(const void* ptr) const;
+
+    /**
+     * @brief Usable size of an object
+     * @param ptr Pointer returned by allocate()
+     * @return Size of its class (at least the size requested)
+     */
+    size_t objectSize(const void* ptr) const;
+
+    /**
+     * @brief Object size of a size class
+     * @param index Class index below NUM_CLASSES
+     */
+    static size_t classSize(size_t index);
+
+    /// Bytes per slab
+    size_t slabSize() const { return slab_size_; }
+
+    /**
+     * @brief Return every empty slab to the parent
+     * @return Bytes returned
+     */
+    size_t trim();
+
+    /**
+     * @brief Get current utilization
+     * @return SlabStats snapshot
+     */
+    SlabStats getStats() const;
+
+    /**
+     * @brief Check every slab's bitmap and list against its counters
+     * @return true if the bitmaps, lists and statistics all agree
+     */
+    bool verify() const;
+
+    /**
+     * @brief Print utilization to stdout (diagnostics.cpp)
+     */
+    void printStats() const;
+
+private:
+    struct Slab;
+
+    /// Class index of a request of 1 to MAX_OBJECT_SIZE bytes
+    static size_t classIndex(size_t size);
+
+    /**
+     * @brief Take a slab for a class: an empty one if kept, else a new one
+     * @return Formatted slab, or nullptr if the parent is out of memory
+     */
+    Slab* takeSlab(size_t size_class);
+
+    /**
+     * @brief Set a slab up for a class with every object free
+     */
+    void formatSlab(Slab* slab, size_t size_class);
+
+    /// Return a slab to the parent
+    void releaseSlab(Slab* slab);
+
+    /// Put a slab at the head of a list
+    static void pushSlab(Slab*& head, Slab* slab);
+
+    /// Take a slab off a list
+    static void unlinkSlab(Slab*& head, Slab* slab);
+
+    MemoryAllocator& parent_;           ///< Allocator owning the slabs
+    size_t slab_size_;                  ///< Bytes per slab (also its alignment)
+    size_t max_empty_;                  ///< Empty slabs to keep
+    Slab* partial_[NUM_CLASSES];        ///< Slabs with live and free objects, per class
+    Slab* full_[NUM_CLASSES];           ///< Slabs with no free object, per class
+    Slab* empty_;                       ///< Slabs with no live object
+
+    size_t slab_count_;                 ///< Slabs held
+    size_t empty_count_;                ///< Slabs on empty_
+    size_t objects_in_use_;             ///< Live objects
+    size_t object_bytes_;               ///< Bytes of live objects
+    size_t allocations_;                ///< Successful allocations
+    size_t frees_;                      ///< Successful frees
+    size_t failures_;                   ///< Failed allocations
+};
+
+} // namespace CustomAllocator
+
+#endif // SLAB_ALLOCATOR_HPP
@@ -0,0 +1,172 @@
+/**
+ * @file thread_cache.hpp
+ * @brief Custom Memory Allocator - Per-Thread Block Cache
+ *
+ * A small tcache-style frontend that sits in front of a shared ArenaSet:
+ * - One LIFO bin of allocated-but-unused blocks per 16-byte size class
+ * - Hits are served with no locking at all
+ * - Misses refill, and overflowing bins drain, in batches under the arena locks
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef THREAD_CACHE_HPP
+#define THREAD_CACHE_HPP
+
+#include "arena_set.hpp"
+#include "memory_allocator.hpp"
+
+#include <cstddef>
+
+namespace CustomAllocator {
+
+/**
+ * @class ThreadCache
+ * @brief Cache of small blocks owned by a single thread
+ *
+ * Cached blocks remain allocated from the heap's point of view (they are
+ * counted in used_memory), so any thread's cache may hold any block of
+ * the shared arenas. A block freed by another thread simply lands in the
+ * freeing thread's cache, and draining routes every block back to the
+ * arena that owns it. The cache only ever reads a block's size word
+ * and writes its data, never the header, so it needs no lock while other
+ * threads split and merge the neighbouring blocks.
+ *
+ * Like tcache, each cached block's data carries the cache's key, which
+ * catches a block being freed twice into the same cache.
+ *
+ * The cache is not thread-safe itself; each instance must only be used
+ * by the thread that owns it.
+ */
+class ThreadCache {
+public:
+    /// Granularity of the cache size classes
+    static constexpr size_t SIZE_STEP = 16;
+
+    /// Number of size classes (bins)
+    static constexpr size_t NUM_BINS = 32;
+
+    /// Largest request served from the cache (512 bytes)
+    static constexpr size_t MAX_CACHED_SIZE = SIZE_STEP * NUM_BINS;
+
+    /// Maximum number of blocks held per bin
+    static constexpr size_t BIN_CAPACITY = 64;
+
+    /// Blocks moved to or from the heap per refill / drain
+    static constexpr size_t BATCH_SIZE = 32;
+
+    ThreadCache();
+    ~ThreadCache() = default;
+
+    ThreadCache(const ThreadCache&) = delete;
+    ThreadCache& operator=(const ThreadCache&) = delete;
+
+    /**
+     * @brief Allocate a small block, refilling the bin from the arenas on a miss
+     * @param size Requested size (must be <= MAX_CACHED_SIZE)
+     * @param arenas Shared arenas backing this cache
+     * @return Pointer to usable memory, or nullptr if the arenas are exhausted
+     */
+    void* allocate(size_t size, ArenaSet& arenas);
+
+    /**
+     * @brief Cache a block instead of returning it to the heap
+     *
+     * A full bin first drains BATCH_SIZE blocks back to their arenas.
+     *
+     * @param ptr Pointer previously returned by the arenas or a cache
+     * @param arenas Shared arenas backing this cache
+     * @return false if the block is too large to cache (caller frees it)
+     */
+    bool deallocate(void* ptr, ArenaSet& arenas);
+
+    /**
+     * @brief Cache a block whose request size the caller knows
+     *
+     * The bin is picked from the size, so the block header is not read
+     * (debug builds still check it). Only valid for blocks that hold their
+     * whole bin, which is true of everything the global layer hands out.
+     *
+     * @param ptr Pointer previously returned by the arenas or a cache
+     * @param size Size originally requested for the block
+     * @param arenas Shared arenas backing this cache
+     * @return false if the block is too large to cache (caller frees it)
+     */
+    bool deallocateSized(void* ptr, size_t size, ArenaSet& arenas);
+
+    /**
+     * @brief Return every cached block to its arena
+     * @param arenas Shared arenas backing this cache
+     */
+    void flush(ArenaSet& arenas);
+
+    /**
+     * @brief Forget all cached blocks without touching them
+     *
+     * Used when the heap they came from has been destroyed.
+     */
+    void discard();
+
+    /**
+     * @brief Get the number of blocks currently cached
+     * @return Total blocks across all bins
+     */
+    size_t cachedBlocks() const;
+
+private:
+    /**
+     * @struct Entry
+     * @brief Data of a cached block
+     */
+    struct Entry {
+        Entry* next;        ///< Next cached block in the bin
+        const void* key;    ///< Owning cache, for double-free detection
+    };
+
+    /**
+     * @struct Bin
+     * @brief Singly-linked stack threaded through the cached blocks' data
+     */
+    struct Bin {
+        Entry* head;        ///< Most recently cached block
+        size_t count;       ///< Number of blocks in this bin
+    };
+
+    Bin bins_[NUM_BINS];    ///< One bin per size class
+
+    /**
+     * @brief Pop up to count blocks off a bin and free them to their arenas
+     * @param bin Bin to drain
+     * @param count Maximum number of blocks to return
+     * @param arenas Shared arenas backing this cache
+     */
+    static void drainBin(Bin& bin, size_t count, ArenaSet& arenas);
+
+    /**
+     * @brief Cache a freed block in its bin, draining the bin when full
+     */
+    void cacheBlock(Bin& bin, void* ptr, ArenaSet& arenas);
+
+    /// Key stamped into entries cached by this instance
+    const void* key() const { return this; }
+
+    /**
+     * @brief Push a block onto a bin, stamping it with this cache's key
+     */
+    void push(Bin& bin, void* ptr);
+
+    /**
+     * @brief Pop the most recently cached block from a bin
+     */
+    static void* pop(Bin& bin);
+
+    /**
+     * @brief Check whether a block is already cached here
+     */
+    bool contains(const Bin& bin, const void* ptr) const;
+};
+
+} // namespace CustomAllocator
+
+#endif // THREAD_CACHE_HPP
@@ -0,0 +1,192 @@
+/**
+ * @file tracer.hpp
+ * @brief Custom Memory Allocator - Allocation Tracer
+ *
+ * Optional recording of every allocator call for offline replay:
+ * - One fixed-size TraceRecord per malloc, calloc, aligned alloc, realloc
+ *   and free: operation, size, pointers, thread and timestamp
+ * - Records go to a lock-free ring buffer; a background thread drains it
+ *   to the trace file, so the calling thread never waits on I/O
+ * - The alloc_replay tool (tools/alloc_replay.cpp) replays a trace against
+ *   any heap configuration or the system malloc
+ *
+ * Compiled in with CUSTOM_ALLOC_TRACING (CMake option ALLOCATOR_TRACING)
+ * and off until startTracing(). While it is off, each entry point pays a
+ * single relaxed atomic load.
+ *
+ * The calls traced are the same as the profiler's: the MemoryAllocator
+ * my_* entry points and the global custom_* functions, each counted once
+ * however many layers it passes through. The batch calls record a Malloc
+ * or Free per block, and a thread cache flush records nothing, since its
+ * frees were recorded as the program made them.
+ *
+ * @author Custom Memory Allocator Project
+ * @date 2025
+ */
+
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace CustomAllocator {
+
+/// Version written into trace file headers
+constexpr uint32_t TRACE_VERSION = 1;
+
+/**
+ * @enum TraceOp
+ * @brief Allocator call a TraceRecord describes
+ */
+enum class TraceOp : uint8_t {
+    Malloc,         ///< malloc(size)
+    Calloc,         ///< calloc with count * size = size bytes
+    AlignedAlloc,   ///< aligned_alloc(ptr, size): ptr holds the alignment
+    Realloc,        ///< realloc(ptr, size); result 0 when size 0 freed ptr. Also a block moved by MovableHeap compaction
+    Free            ///< free(ptr), sized or not
+};
+
+/**
+ * @struct TraceRecord
+ * @brief One traced call, as stored in the ring buffer and the trace file
+ *
+ * Only calls that succeeded are recorded. Pointers are the addresses the
+ * traced process saw; a replay uses them as ids to pair each free with
+ * its allocation.
+ */
+struct TraceRecord {
+    uint64_t timestamp;     ///< Nanoseconds since startTracing()
+    uint64_t ptr;           ///< Pointer passed in (Realloc, Free), alignment (AlignedAlloc)
+    uint64_t result;        ///< Pointer returned (0 for Free)
+    uint64_t size;          ///< Bytes requested
+    uint32_t thread;        ///< Dense id of the calling thread, from 1 in order of first call
+    TraceOp op;             ///< Call recorded
+    uint8_t reserved[3];    ///< Zero
+};
+
+static_assert(sizeof(TraceRecord) == 40, "TraceRecord is a fixed 40-byte record");
+
+/**
+ * @struct TraceFileHeader
+ * @brief Start of a trace file; TraceRecords follow until end of file
+ *
+ * Everything is in host byte order.
+ */
+struct TraceFileHeader {
+    char magic[4];          ///< "CATR"
+    uint32_t version;       ///< TRACE_VERSION
+    uint64_t record_size;   ///< sizeof(TraceRecord)
+    uint64_t start_time;    ///< Wall-clock nanoseconds since the epoch at startTracing()
+};
+
+static_assert(sizeof(TraceFileHeader) == 24, "TraceFileHeader is 24 bytes");
+
+/**
+ * @struct TraceOptions
+ * @brief Settings for startTracing()
+ */
+struct TraceOptions {
+    size_t buffer_records = 64 * 1024;  ///< Ring buffer capacity (rounded up to a power of two)
+    uint32_t flush_interval_ms = 10;    ///< How often the writer drains the ring buffer
+};
+
+/**
+ * @struct TraceStats
+ * @brief Counters of the current (or last) trace
+ */
+struct TraceStats {
+    uint64_t recorded;      ///< Records put into the ring buffer
+    uint64_t dropped;       ///< Records lost because the ring buffer was full
+    uint64_t written;       ///< Records written to the file
+};
+
+/**
+ * @brief Start tracing into a new file
+ *
+ * The file is created (or truncated) and its header written before this
+ * returns; a writer thread then drains records to it until stopTracing().
+ *
+ * @param path File to write
+ * @param options Buffer settings
+ * @return false if the tracer was compiled out, a trace is already
+ *         running, or the file or buffer could not be set up
+ */
+bool startTracing(const char* path, const TraceOptions& options = TraceOptions()) noexcept;
+
+/**
+ * @brief Stop tracing, write every buffered record and close the file
+ */
+void stopTracing() noexcept;
+
+/**
+ * @brief Counters of the current trace, or of the last one once stopped
+ */
+TraceStats traceStats() noexcept;
+
+namespace detail {
+
+#if defined(CUSTOM_ALLOC_TRACING)
+/// True between startTracing() and stopTracing()
+extern std::atomic<bool> g_tracing;
+#endif
+
+/// Start of a traced call (false if this thread is already inside one)
+bool traceEnter() noexcept;
+
+/// Record a call made by the outermost traced call on this thread
+void traceRecord(TraceOp op, const void* ptr, const void* result,
+                 size_t size) noexcept;
+
+/// End of a traced call
+void traceLeave() noexcept;
+
+} // namespace detail
+
+/**
+ * @brief Tracing is on
+ */
+inline bool tracingEnabled() noexcept {
+#if defined(CUSTOM_ALLOC_TRACING)
+    return detail::g_tracing.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+}
+
+/**
+ * @class TraceScope
+ * @brief Records one allocator entry point while tracing is on
+ *
+ * Declared next to the entry point's ProfileScope; the call then reports
+ * what it did with record(). Calls nested inside it record nothing.
+ */
+class TraceScope {
+public:
+    TraceScope() noexcept : active_(tracingEnabled() && detail::traceEnter()) {}
+
+    ~TraceScope() {
+        if (active_) detail::traceLeave();
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    /// This call is the outermost traced call on its thread
+    bool active() const noexcept { return active_; }
+
+    /// Record the call; failed allocations and failed reallocs record nothing
+    void record(TraceOp op, const void* ptr, const void* result, size_t size) noexcept {
+        if (active_) {
+            detail::traceRecord(op, ptr, result, size);
+        }
+    }
+
+private:
+    bool active_;   ///< This call is the outermost traced call on its thread
+};
+
+} // namespace CustomAllocator
+
+#endif // TRACER_HPP
@@ -0,0 +1,67 @@
+/**
+ * @file allocator_error.cpp
+ * @brief Custom Memory Allocator - Error Codes and Error Hook
+ *
+ * Thread-local last error and the process-wide error hook. Nothing here
+ * performs I/O, so failure paths stay as cheap as a nullptr return.
+ */
+
+#include "allocator_error.hpp"
+
+#include <atomic>
+
+namespace CustomAllocator {
+
+namespace {
+
+/// Most recent error on this thread
+thread_local AllocError t_last_error = AllocError::None;
+
+/// Hook called for every error (nullptr = silent)
+std::atomic<ErrorHandler> g_error_handler{nullptr};
+
+} // namespace
+
+AllocError last_error() noexcept { return t_last_error; }
+
+void clear_last_error() noexcept { t_last_error = AllocError::None; }
+
+ErrorHandler on_error(ErrorHandler handler) noexcept {
+  return g_error_handler.exchange(handler, std::memory_order_acq_rel);
+}
+
+const char *errorName(AllocError error) noexcept {
+  switch (error) {
+  case AllocError::None:
+    return "No error";
+  case AllocError::OutOfMemory:
+    return "Out of memory";
+  case AllocError::InvalidPointer:
+    return "Invalid pointer";
+  case AllocError::DoubleFree:
+    return "Double free";
+  case AllocError::SizeOverflow:
+    return "Size overflow";
+  case AllocError::InvalidAlignment:
+    return "Invalid alignment";
+  case AllocError::SizeMismatch:
+    return "Size mismatch";
+  case AllocError::CorruptedBlock:
+    return "Corrupted block";
+  case AllocError::UseAfterFree:
+    return "Use after free";
+  }
+  return "Unknown error";
+}
+
+void reportError(AllocError error, const char *function, const void *ptr,
+                 size_t size) noexcept {
+  t_last_error = error;
+
+  ErrorHandler handler = g_error_handler.load(std::memory_order_acquire);
+  if (handler) {
+    handler(ErrorInfo{error, function, ptr, size});
+  }
+}
+
+} // namespace CustomAllocator
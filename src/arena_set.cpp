@@ -0,0 +1,503 @@
+/**
+ * @file arena_set.cpp
+ * @brief Custom Memory Allocator - Sharded Arenas Implementation
+ *
+ * Thread-to-arena assignment (including NUMA node-local arenas),
+ * address-range routing of frees, and per-arena locking.
+ */
+
+#include "arena_set.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace CustomAllocator {
+
+namespace {
+
+/// Hands out round-robin slots to threads in creation order
+std::atomic<size_t> g_next_thread_slot{0};
+
+/// The calling thread's round-robin slot (assigned on first use)
+size_t threadSlot() {
+  static thread_local size_t slot =
+      g_next_thread_slot.fetch_add(1, std::memory_order_relaxed);
+  return slot;
+}
+
+/// Add one arena's counters to a running total
+void addStats(MemoryStats &total, const MemoryStats &stats) {
+  total.total_heap_size += stats.total_heap_size;
+  total.used_memory += stats.used_memory;
+  total.free_memory += stats.free_memory;
+  total.total_allocations += stats.total_allocations;
+  total.total_frees += stats.total_frees;
+  total.block_count += stats.block_count;
+  total.free_block_count += stats.free_block_count;
+  total.coalesce_count += stats.coalesce_count;
+  total.split_count += stats.split_count;
+  total.segment_count += stats.segment_count;
+  total.purge_count += stats.purge_count;
+  total.purged_bytes += stats.purged_bytes;
+  total.huge_page_bytes += stats.huge_page_bytes;
+  total.large_count += stats.large_count;
+  total.large_bytes += stats.large_bytes;
+  total.realloc_in_place += stats.realloc_in_place;
+  total.realloc_moved += stats.realloc_moved;
+  total.calloc_zero_hits += stats.calloc_zero_hits;
+  total.placement_searches += stats.placement_searches;
+  total.placement_steps += stats.placement_steps;
+  total.quarantined_blocks += stats.quarantined_blocks;
+  total.quarantined_bytes += stats.quarantined_bytes;
+  total.largest_free_block =
+      std::max(total.largest_free_block, stats.largest_free_block);
+}
+
+} // namespace
+
+//=============================================================================
+// ArenaSet - Construction
+//=============================================================================
+
+ArenaSet::ArenaSet(size_t arena_count, size_t heap_size, Assignment assignment)
+    : ArenaSet(arena_count,
+               [heap_size]() {
+                 // Arenas grow with extra OS segments rather than running dry
+                 AllocatorOptions options;
+                 options.heap_size = heap_size;
+                 options.growable = true;
+                 return options;
+               }(),
+               assignment) {}
+
+ArenaSet::ArenaSet(size_t arena_count, const AllocatorOptions &arena_options,
+                   Assignment assignment)
+    : assignment_(assignment), node_count_(1), mappings_(nullptr),
+      mapping_count_(0), mapping_capacity_(0), mappings_complete_(true) {
+  if (arena_count == 0) {
+    throw std::invalid_argument("ArenaSet needs at least one arena");
+  }
+
+  // Interleave the nodes: arena i lives on node i % node_count_
+  if (assignment == Assignment::NumaNode) {
+    node_count_ = osNumaNodeCount();
+    arena_count = (arena_count + node_count_ - 1) / node_count_ * node_count_;
+  }
+
+  AllocatorOptions options = arena_options;
+  arenas_.reserve(arena_count);
+  ranges_.reserve(arena_count);
+  for (size_t i = 0; i < arena_count; i++) {
+    if (assignment == Assignment::NumaNode) {
+      options.numa_node = arenaNode(i);
+    }
+    arenas_.push_back(std::make_unique<Arena>(options, this, i));
+    MemoryAllocator &heap = arenas_.back()->heap;
+    heap.setMappingHook(&ArenaSet::onMapping, arenas_.back().get());
+    ranges_.push_back({heap.heapStart(), heap.heapEnd(), i});
+  }
+
+  // Sorted, non-overlapping ranges allow a binary search per free
+  std::sort(ranges_.begin(), ranges_.end(),
+            [](const Range &a, const Range &b) { return a.start < b.start; });
+}
+
+ArenaSet::~ArenaSet() {
+  // The heaps report their mappings going away, so they go first
+  arenas_.clear();
+  if (mappings_) {
+    osUnmapMemory(mappings_, mapping_capacity_ * sizeof(Range));
+  }
+}
+
+//=============================================================================
+// Mapping Table
+//=============================================================================
+
+void ArenaSet::onMapping(void *context, const void *base, size_t size,
+                         bool mapped) {
+  const Arena &arena = *static_cast<Arena *>(context);
+  ArenaSet &set = *arena.owner;
+  const char *start = static_cast<const char *>(base);
+
+  std::lock_guard<std::mutex> guard(set.mappings_lock_);
+  Range *end = set.mappings_ + set.mapping_count_;
+  Range *it = std::lower_bound(
+      set.mappings_, end, start,
+      [](const Range &range, const char *value) { return range.start < value; });
+
+  if (!mapped) {
+    if (it != end && it->start == start) {
+      std::copy(it + 1, end, it);
+      set.mapping_count_--;
+    }
+    return;
+  }
+
+  // Without room the range goes unrecorded and lookups fall back to
+  // asking every arena
+  if (set.mapping_count_ == set.mapping_capacity_) {
+    size_t position = static_cast<size_t>(it - set.mappings_);
+    if (!set.growMappings()) {
+      set.mappings_complete_ = false;
+      return;
+    }
+    end = set.mappings_ + set.mapping_count_;
+    it = set.mappings_ + position;
+  }
+  std::copy_backward(it, end, end + 1);
+  *it = {start, start + size, arena.index};
+  set.mapping_count_++;
+}
+
+bool ArenaSet::growMappings() {
+  // Like the heaps' large tables, the table never calls back into malloc
+  size_t capacity = mapping_capacity_ ? mapping_capacity_ * 2
+                                      : osPageSize() / sizeof(Range);
+  size_t bytes = capacity * sizeof(Range);
+  void *table = mappings_ ? osRemapMemory(mappings_,
+                                          mapping_capacity_ * sizeof(Range),
+                                          bytes)
+                          : osMapMemory(bytes);
+  if (!table) {
+    return false;
+  }
+
+  mappings_ = static_cast<Range *>(table);
+  mapping_capacity_ = capacity;
+  return true;
+}
+
+//=============================================================================
+// Routing
+//=============================================================================
+
+size_t ArenaSet::currentArenaIndex() const {
+#if defined(__linux__)
+  if (assignment_ == Assignment::CpuId) {
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+      return static_cast<size_t>(cpu) % arenas_.size();
+    }
+  }
+#endif
+  if (assignment_ == Assignment::NumaNode) {
+    // Threads of one node share its arenas round-robin
+    size_t per_node = arenas_.size() / node_count_;
+    return static_cast<size_t>(osCurrentNumaNode()) +
+           node_count_ * (threadSlot() % per_node);
+  }
+  return threadSlot() % arenas_.size();
+}
+
+size_t ArenaSet::spillIndex(size_t first, size_t i) const {
+  // i % per_node steps through one node's arenas, i / per_node moves on to
+  // the next node; with one node this is plain (first + i) % size
+  size_t per_node = arenas_.size() / node_count_;
+  return (first + (i % per_node) * node_count_ + i / per_node) %
+         arenas_.size();
+}
+
+size_t ArenaSet::arenaIndexFor(const void *ptr) const {
+  const char *p = static_cast<const char *>(ptr);
+
+  // Last range starting at or before p
+  auto it = std::upper_bound(
+      ranges_.begin(), ranges_.end(), p,
+      [](const char *value, const Range &range) { return value < range.start; });
+  if (it != ranges_.begin()) {
+    --it;
+    // Primary heaps never move, so this needs no lock
+    if (p >= it->start + sizeof(MemoryBlock) &&
+        p < it->end - sizeof(MemoryBlock)) {
+      return it->index;
+    }
+  }
+
+  // Extra segments and large mappings come and go under the arena locks;
+  // the table they report to has a lock of its own, held for one search.
+  // (A plain mutex: a child can release it after fork(), a rwlock not.)
+  {
+    std::lock_guard<std::mutex> guard(mappings_lock_);
+    const Range *begin = mappings_;
+    const Range *end = mappings_ + mapping_count_;
+    const Range *range = std::upper_bound(
+        begin, end, p,
+        [](const char *value, const Range &entry) { return value < entry.start; });
+    if (range != begin && p < (--range)->end) {
+      return range->index;
+    }
+    if (mappings_complete_) {
+      return NO_ARENA;
+    }
+  }
+
+  // Some mapping went unrecorded: ask each heap under its lock
+  for (size_t i = 0; i < arenas_.size(); i++) {
+    std::lock_guard<std::mutex> guard(arenas_[i]->lock);
+    if (arenas_[i]->heap.isValidPointer(const_cast<void *>(ptr))) {
+      return i;
+    }
+  }
+  return NO_ARENA;
+}
+
+//=============================================================================
+// Allocation Functions
+//=============================================================================
+
+void *ArenaSet::my_malloc(size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  // Start at the thread's own arena; spill into the others when it is full
+  size_t first = currentArenaIndex();
+  for (size_t i = 0; i < arenas_.size(); i++) {
+    Arena &arena = *arenas_[spillIndex(first, i)];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    if (void *ptr = arena.heap.my_malloc(size)) {
+      return ptr;
+    }
+  }
+  return nullptr;
+}
+
+void *ArenaSet::my_malloc_on_node(size_t size, int node) {
+  if (size == 0) {
+    return nullptr;
+  }
+  if (node < 0 || static_cast<size_t>(node) >= node_count_) {
+    reportError(AllocError::OutOfMemory, "ArenaSet::my_malloc_on_node",
+                nullptr, size);
+    return nullptr;
+  }
+
+  // The node's arenas, starting from the calling thread's slot
+  size_t per_node = arenas_.size() / node_count_;
+  size_t slot = threadSlot();
+  for (size_t i = 0; i < per_node; i++) {
+    Arena &arena =
+        *arenas_[static_cast<size_t>(node) + node_count_ * ((slot + i) % per_node)];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    if (void *ptr = arena.heap.my_malloc(size)) {
+      return ptr;
+    }
+  }
+  return nullptr;
+}
+
+void ArenaSet::my_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  size_t index = arenaIndexFor(ptr);
+  if (index == NO_ARENA) {
+    reportError(AllocError::InvalidPointer, "ArenaSet::my_free", ptr);
+    return;
+  }
+  freeInArena(index, ptr);
+}
+
+void ArenaSet::my_free_sized(void *ptr, size_t size) {
+  if (!ptr) {
+    return;
+  }
+
+  size_t index = arenaIndexFor(ptr);
+  if (index == NO_ARENA) {
+    reportError(AllocError::InvalidPointer, "ArenaSet::my_free_sized", ptr);
+    return;
+  }
+  freeSizedInArena(index, ptr, size);
+}
+
+void ArenaSet::freeInArena(size_t index, void *ptr) {
+  Arena &arena = *arenas_[index];
+  std::lock_guard<std::mutex> guard(arena.lock);
+  arena.heap.my_free(ptr);
+}
+
+void ArenaSet::freeSizedInArena(size_t index, void *ptr, size_t size) {
+  Arena &arena = *arenas_[index];
+  std::lock_guard<std::mutex> guard(arena.lock);
+  arena.heap.my_free_sized(ptr, size);
+}
+
+void *ArenaSet::my_realloc(void *ptr, size_t new_size) {
+  if (!ptr) {
+    return my_malloc(new_size);
+  }
+  if (new_size == 0) {
+    my_free(ptr);
+    return nullptr;
+  }
+
+  size_t index = arenaIndexFor(ptr);
+  if (index == NO_ARENA) {
+    reportError(AllocError::InvalidPointer, "ArenaSet::my_realloc", ptr);
+    return nullptr;
+  }
+
+  // Try to stay within the owning arena first
+  size_t old_size;
+  {
+    Arena &arena = *arenas_[index];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    clear_last_error();
+    if (void *new_ptr = arena.heap.my_realloc(ptr, new_size)) {
+      return new_ptr;
+    }
+
+    // A pointer the heap rejected must not be copied out of
+    if (last_error() != AllocError::OutOfMemory) {
+      return nullptr;
+    }
+    old_size = MemoryBlock::fromData(ptr)->size();
+  }
+
+  // The owning arena is full: move the data to another arena
+  void *new_ptr = my_malloc(new_size);
+  if (!new_ptr) {
+    return nullptr;
+  }
+  std::memcpy(new_ptr, ptr, std::min(old_size, new_size));
+  freeInArena(index, ptr);
+  return new_ptr;
+}
+
+void *ArenaSet::my_calloc(size_t count, size_t size) {
+  if (count == 0 || size == 0) {
+    return nullptr;
+  }
+
+  size_t first = currentArenaIndex();
+  for (size_t i = 0; i < arenas_.size(); i++) {
+    Arena &arena = *arenas_[spillIndex(first, i)];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    if (void *ptr = arena.heap.my_calloc(count, size)) {
+      return ptr;
+    }
+  }
+  return nullptr;
+}
+
+void *ArenaSet::my_aligned_alloc(size_t alignment, size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  size_t first = currentArenaIndex();
+  for (size_t i = 0; i < arenas_.size(); i++) {
+    Arena &arena = *arenas_[spillIndex(first, i)];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    if (void *ptr = arena.heap.my_aligned_alloc(alignment, size)) {
+      return ptr;
+    }
+  }
+  return nullptr;
+}
+
+size_t ArenaSet::allocateBatch(size_t size, size_t count, void **out) {
+  Arena &arena = *arenas_[currentArenaIndex()];
+  std::lock_guard<std::mutex> guard(arena.lock);
+
+  return arena.heap.my_malloc_batch(size, count, out);
+}
+
+void ArenaSet::freeBatch(void **ptrs, size_t count) {
+  // Arena ranges are disjoint, so sorting groups pointers by arena
+  std::sort(ptrs, ptrs + count);
+
+  size_t i = 0;
+  while (i < count) {
+    size_t index = arenaIndexFor(ptrs[i]);
+    if (index == NO_ARENA) {
+      my_free(ptrs[i++]); // Reports the invalid pointer
+      continue;
+    }
+
+    Arena &arena = *arenas_[index];
+    std::lock_guard<std::mutex> guard(arena.lock);
+    size_t begin = i;
+    while (i < count && arena.heap.isValidPointer(ptrs[i])) {
+      i++;
+    }
+    arena.heap.my_free_batch(ptrs + begin, i - begin);
+  }
+}
+
+void ArenaSet::lockAll() {
+  // Arena calls update the table under their own lock, so it comes last
+  for (const auto &arena : arenas_) {
+    arena->lock.lock();
+  }
+  mappings_lock_.lock();
+}
+
+void ArenaSet::unlockAll() {
+  mappings_lock_.unlock();
+  for (auto it = arenas_.rbegin(); it != arenas_.rend(); ++it) {
+    (*it)->lock.unlock();
+  }
+}
+
+//=============================================================================
+// Statistics
+//=============================================================================
+
+size_t ArenaSet::trim() {
+  size_t released = 0;
+  for (const auto &arena : arenas_) {
+    std::lock_guard<std::mutex> guard(arena->lock);
+    released += arena->heap.trim();
+  }
+  return released;
+}
+
+bool ArenaSet::setPlacementPolicy(PlacementPolicy policy) {
+  bool switched = true;
+  for (const auto &arena : arenas_) {
+    std::lock_guard<std::mutex> guard(arena->lock);
+    switched = arena->heap.setPlacementPolicy(policy) && switched;
+  }
+  return switched;
+}
+
+MemoryStats ArenaSet::getArenaStats(size_t index) const {
+  std::lock_guard<std::mutex> guard(arenas_[index]->lock);
+  return arenas_[index]->heap.getStats();
+}
+
+size_t ArenaSet::heapMap(size_t index, HeapMapEntry *out,
+                         size_t capacity) const {
+  std::lock_guard<std::mutex> guard(arenas_[index]->lock);
+  return arenas_[index]->heap.heapMap(out, capacity);
+}
+
+MemoryStats ArenaSet::getNodeStats(int node) const {
+  MemoryStats total{};
+  for (size_t i = 0; i < arenas_.size(); i++) {
+    if (arenaNode(i) == node) {
+      addStats(total, getArenaStats(i));
+    }
+  }
+  return total;
+}
+
+MemoryStats ArenaSet::getStats() const {
+  MemoryStats total{};
+  for (size_t i = 0; i < arenas_.size(); i++) {
+    addStats(total, getArenaStats(i));
+  }
+  return total;
+}
+
+} // namespace CustomAllocator
@@ -0,0 +1,410 @@
+/**
+ * @file buddy_allocator.cpp
+ * @brief Custom Memory Allocator - Buddy-System Block Allocator
+ *
+ * Splitting, buddy merging and the bitmaps kept outside the heap.
+ */
+
+#include "buddy_allocator.hpp"
+
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace CustomAllocator {
+
+namespace {
+
+/// Index of the lowest set bit (value must be non-zero)
+inline size_t lowestSetBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#else
+  return static_cast<size_t>(__builtin_ctzll(value));
+#endif
+}
+
+/// Index of the highest set bit (value must be non-zero)
+inline size_t highestSetBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return index;
+#else
+  return 63 - static_cast<size_t>(__builtin_clzll(value));
+#endif
+}
+
+inline bool isPowerOfTwo(size_t value) {
+  return value && !(value & (value - 1));
+}
+
+inline uintptr_t alignUp(uintptr_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+}
+
+} // namespace
+
+//=============================================================================
+// BuddyAllocator - Constructors and Destructor
+//=============================================================================
+
+BuddyAllocator::BuddyAllocator(const BuddyOptions &options)
+    : heap_start_(nullptr), heap_size_(0), min_block_(0), min_shift_(0),
+      max_order_(0), mapping_(nullptr), mapping_size_(0),
+      backing_(HugePageBacking::None) {
+  setGeometry(options.min_block, options.max_block);
+  if (options.heap_size < min_block_) {
+    throw std::invalid_argument("Heap size too small");
+  }
+  while ((min_block_ << max_order_) > options.heap_size) {
+    max_order_--;
+  }
+  const size_t max_block = min_block_ << max_order_;
+  heap_size_ = options.heap_size & ~(max_block - 1);
+
+  // Metadata first, then the heap on the next max_block boundary
+  const size_t metadata = metadataSize(heap_size_ >> min_shift_, max_order_);
+  if (heap_size_ > SIZE_MAX - metadata - 2 * max_block) {
+    throw std::bad_alloc();
+  }
+  mapping_size_ = metadata + max_block + heap_size_;
+  if (options.huge_pages) {
+    mapping_size_ = alignUp(mapping_size_, OS_HUGE_PAGE_SIZE);
+    mapping_ = osMapHugeMemory(mapping_size_, &backing_);
+  } else {
+    mapping_ = osMapMemory(mapping_size_);
+  }
+  if (!mapping_) {
+    throw std::bad_alloc();
+  }
+
+  char *base = static_cast<char *>(mapping_);
+  heap_start_ = reinterpret_cast<char *>(
+      alignUp(reinterpret_cast<uintptr_t>(base + metadata), max_block));
+  initialize(base);
+}
+
+BuddyAllocator::BuddyAllocator(void *memory, size_t size, size_t min_block,
+                               size_t max_block)
+    : heap_start_(nullptr), heap_size_(0), min_block_(0), min_shift_(0),
+      max_order_(0), mapping_(nullptr), mapping_size_(0),
+      backing_(HugePageBacking::None) {
+  if (!memory) {
+    throw std::invalid_argument("Invalid memory region");
+  }
+  setGeometry(min_block, max_block);
+
+  // Size the metadata for the whole region; the heap is a little smaller
+  uintptr_t start = reinterpret_cast<uintptr_t>(memory);
+  uintptr_t end = start + size;
+  uintptr_t metadata = alignUp(start, alignof(uint64_t));
+  size_t metadata_size = metadataSize(size >> min_shift_, max_order_);
+  if (end < start || metadata > end || end - metadata < metadata_size) {
+    throw std::invalid_argument("Invalid memory region");
+  }
+  uintptr_t heap = alignUp(metadata + metadata_size, min_block_);
+  if (heap > end || end - heap < min_block_) {
+    throw std::invalid_argument("Invalid memory region");
+  }
+
+  const size_t available = end - heap;
+  while ((min_block_ << max_order_) > available) {
+    max_order_--;
+  }
+  heap_start_ = reinterpret_cast<char *>(heap);
+  heap_size_ = available & ~((min_block_ << max_order_) - 1);
+  initialize(reinterpret_cast<char *>(metadata));
+}
+
+BuddyAllocator::~BuddyAllocator() {
+  if (mapping_) {
+    osUnmapMemory(mapping_, mapping_size_);
+  }
+}
+
+//=============================================================================
+// Initialization
+//=============================================================================
+
+size_t BuddyAllocator::metadataSize(size_t units, size_t max_order) {
+  size_t words = 0;
+  for (size_t order = 0; order <= max_order; order++) {
+    words += ((units >> order) + 63) / 64;
+  }
+  return words * sizeof(uint64_t) + alignUp(units, sizeof(uint64_t));
+}
+
+void BuddyAllocator::setGeometry(size_t min_block, size_t max_block) {
+  if (!isPowerOfTwo(min_block) || min_block < sizeof(FreeNode) ||
+      !isPowerOfTwo(max_block) || max_block < min_block) {
+    throw std::invalid_argument("Invalid buddy geometry");
+  }
+  min_block_ = min_block;
+  min_shift_ = highestSetBit(min_block);
+  max_order_ = highestSetBit(max_block) - min_shift_;
+  if (max_order_ >= MAX_ORDERS) {
+    throw std::invalid_argument("Invalid buddy geometry");
+  }
+}
+
+void BuddyAllocator::initialize(char *metadata) {
+  const size_t units = heap_size_ >> min_shift_;
+
+  // One free bitmap per order, then the order byte of every unit
+  uint64_t *words = reinterpret_cast<uint64_t *>(metadata);
+  for (size_t order = 0; order < MAX_ORDERS; order++) {
+    free_lists_[order] = nullptr;
+    if (order > max_order_) {
+      free_bits_[order] = nullptr;
+      continue;
+    }
+    size_t count = ((units >> order) + 63) / 64;
+    std::memset(words, 0, count * sizeof(uint64_t));
+    free_bits_[order] = words;
+    words += count;
+  }
+  orders_ = reinterpret_cast<uint8_t *>(words);
+  std::memset(orders_, 0, units);
+
+  nonempty_ = 0;
+  used_bytes_ = 0;
+  free_blocks_ = 0;
+  allocations_ = 0;
+  frees_ = 0;
+  failures_ = 0;
+  splits_ = 0;
+  merges_ = 0;
+
+  // Push from the top so the lowest block is handed out first
+  const size_t max_block = min_block_ << max_order_;
+  for (size_t offset = heap_size_; offset != 0; offset -= max_block) {
+    pushFree(offset - max_block, max_order_);
+  }
+}
+
+//=============================================================================
+// Allocation Functions
+//=============================================================================
+
+void *BuddyAllocator::allocate(size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  size_t order = size <= min_block_ ? 0 : highestSetBit(size - 1) + 1 - min_shift_;
+  uint32_t candidates =
+      order <= max_order_ ? nonempty_ & (~0u << order) : 0;
+  if (!candidates) {
+    failures_++;
+    reportError(AllocError::OutOfMemory, "BuddyAllocator::allocate", nullptr,
+                size);
+    return nullptr;
+  }
+
+  // Smallest free block that fits, halved until it matches the request
+  size_t current = lowestSetBit(candidates);
+  size_t offset = static_cast<size_t>(
+      reinterpret_cast<char *>(free_lists_[current]) - heap_start_);
+  removeFree(offset, current);
+  while (current > order) {
+    current--;
+    pushFree(offset + (min_block_ << current), current);
+    splits_++;
+  }
+
+  orders_[offset >> min_shift_] = static_cast<uint8_t>(order + 1);
+  used_bytes_ += min_block_ << order;
+  allocations_++;
+  return heap_start_ + offset;
+}
+
+void BuddyAllocator::deallocate(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  size_t offset = owns(ptr) ? static_cast<size_t>(static_cast<char *>(ptr) -
+                                                  heap_start_)
+                            : 1;
+  if (offset & (min_block_ - 1)) {
+    reportError(AllocError::InvalidPointer, "BuddyAllocator::deallocate", ptr);
+    return;
+  }
+
+  size_t unit = offset >> min_shift_;
+  if (orders_[unit] == 0) {
+    // Inside a free block: freed before, perhaps merged since
+    for (size_t order = 0; order <= max_order_; order++) {
+      if (isFree(offset & ~((min_block_ << order) - 1), order)) {
+        reportError(AllocError::DoubleFree, "BuddyAllocator::deallocate", ptr);
+        return;
+      }
+    }
+    reportError(AllocError::InvalidPointer, "BuddyAllocator::deallocate", ptr);
+    return;
+  }
+
+  size_t order = orders_[unit] - 1u;
+  orders_[unit] = 0;
+  used_bytes_ -= min_block_ << order;
+  frees_++;
+
+  // Merge upwards while the buddy is free as a whole block of this order
+  while (order < max_order_) {
+    size_t buddy = offset ^ (min_block_ << order);
+    if (!isFree(buddy, order)) {
+      break;
+    }
+    removeFree(buddy, order);
+    offset &= ~(min_block_ << order);
+    order++;
+    merges_++;
+  }
+  pushFree(offset, order);
+}
+
+//=============================================================================
+// Free Lists
+//=============================================================================
+
+void BuddyAllocator::pushFree(size_t offset, size_t order) {
+  FreeNode *node = reinterpret_cast<FreeNode *>(heap_start_ + offset);
+  node->prev = nullptr;
+  node->next = free_lists_[order];
+  if (node->next) {
+    node->next->prev = node;
+  }
+  free_lists_[order] = node;
+
+  size_t index = offset >> (min_shift_ + order);
+  free_bits_[order][index / 64] |= uint64_t(1) << (index % 64);
+  nonempty_ |= 1u << order;
+  free_blocks_++;
+}
+
+void BuddyAllocator::removeFree(size_t offset, size_t order) {
+  FreeNode *node = reinterpret_cast<FreeNode *>(heap_start_ + offset);
+  if (node->prev) {
+    node->prev->next = node->next;
+  } else {
+    free_lists_[order] = node->next;
+    if (!node->next) {
+      nonempty_ &= ~(1u << order);
+    }
+  }
+  if (node->next) {
+    node->next->prev = node->prev;
+  }
+
+  size_t index = offset >> (min_shift_ + order);
+  free_bits_[order][index / 64] &= ~(uint64_t(1) << (index % 64));
+  free_blocks_--;
+}
+
+//=============================================================================
+// Utility Functions
+//=============================================================================
+
+size_t BuddyAllocator::blockSize(const void *ptr) const {
+  if (!owns(ptr)) {
+    return 0;
+  }
+  size_t offset =
+      static_cast<size_t>(static_cast<const char *>(ptr) - heap_start_);
+  if (offset & (min_block_ - 1)) {
+    return 0;
+  }
+  uint8_t order = orders_[offset >> min_shift_];
+  return order ? min_block_ << (order - 1u) : 0;
+}
+
+bool BuddyAllocator::owns(const void *ptr) const {
+  const char *p = static_cast<const char *>(ptr);
+  return p >= heap_start_ && p < heap_start_ + heap_size_;
+}
+
+BuddyStats BuddyAllocator::getStats() const {
+  BuddyStats stats{};
+  stats.heap_size = heap_size_;
+  stats.min_block = min_block_;
+  stats.max_block = maxBlock();
+  stats.used_bytes = used_bytes_;
+  stats.free_bytes = heap_size_ - used_bytes_;
+  stats.largest_free_block =
+      nonempty_ ? min_block_ << highestSetBit(nonempty_) : 0;
+  stats.free_blocks = free_blocks_;
+  stats.total_allocations = allocations_;
+  stats.total_frees = frees_;
+  stats.failed_allocations = failures_;
+  stats.split_count = splits_;
+  stats.merge_count = merges_;
+  return stats;
+}
+
+bool BuddyAllocator::verify() const {
+  size_t free_bytes = 0;
+  size_t listed = 0;
+  const size_t units = heap_size_ >> min_shift_;
+
+  for (size_t order = 0; order < MAX_ORDERS; order++) {
+    if (order > max_order_) {
+      if (free_lists_[order] || (nonempty_ >> order) & 1) {
+        return false;
+      }
+      continue;
+    }
+
+    const size_t block = min_block_ << order;
+    size_t count = 0;
+    const FreeNode *prev = nullptr;
+    for (const FreeNode *node = free_lists_[order]; node; node = node->next) {
+      size_t offset = static_cast<size_t>(
+          reinterpret_cast<const char *>(node) - heap_start_);
+      if (node->prev != prev || offset >= heap_size_ || (offset & (block - 1)) ||
+          !isFree(offset, order) || orders_[offset >> min_shift_] != 0) {
+        return false;
+      }
+      // A free block whose buddy is free too should have merged
+      if (order < max_order_ && isFree(offset ^ block, order)) {
+        return false;
+      }
+      prev = node;
+      count++;
+    }
+
+    size_t bits = 0;
+    for (size_t i = 0; i < ((units >> order) + 63) / 64; i++) {
+      for (uint64_t word = free_bits_[order][i]; word; word &= word - 1) {
+        bits++;
+      }
+    }
+    if (bits != count || ((nonempty_ >> order) & 1) != (count != 0)) {
+      return false;
+    }
+    free_bytes += count * block;
+    listed += count;
+  }
+
+  size_t used = 0;
+  for (size_t unit = 0; unit < units; unit++) {
+    if (orders_[unit]) {
+      size_t order = orders_[unit] - 1u;
+      if (order > max_order_ || (unit & ((size_t(1) << order) - 1))) {
+        return false;
+      }
+      used += min_block_ << order;
+    }
+  }
+
+  return used == used_bytes_ && used + free_bytes == heap_size_ &&
+         listed == free_blocks_;
+}
+
+} // namespace CustomAllocator
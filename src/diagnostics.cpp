@@ -0,0 +1,650 @@
+/**
+ * @file diagnostics.cpp
+ * @brief Custom Memory Allocator - Console Diagnostics
+ *
+ * Everything that writes to the console or a stream: the printing error
+ * hook, the statistics and layout printers of the allocators, and the
+ * profiler reports.
+ */
+
+#include "diagnostics.hpp"
+#include "arena_set.hpp"
+#include "buddy_allocator.hpp"
+#include "fixed_pool.hpp"
+#include "memory_allocator.hpp"
+#include "monotonic_arena.hpp"
+#include "movable_heap.hpp"
+#include "slab_allocator.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace CustomAllocator {
+
+namespace {
+
+/// One "║  text ... ║" row of the 62-column boxes (text is ASCII)
+void printBoxRow(const std::string &text) {
+  std::cout << "║  " << std::left << std::setw(60) << text << std::right
+            << "║\n";
+}
+
+} // namespace
+
+//=============================================================================
+// Error Reporting
+//=============================================================================
+
+void printErrorHandler(const ErrorInfo &info) {
+  const char *function = info.function ? info.function : "allocator";
+
+  switch (info.error) {
+  case AllocError::None:
+    return;
+  case AllocError::OutOfMemory:
+    std::cerr << "[" << function << "] ERROR: Out of memory! Requested: "
+              << info.size << " bytes\n";
+    return;
+  case AllocError::InvalidPointer:
+    std::cerr << "[" << function << "] ERROR: Invalid pointer!\n";
+    return;
+  case AllocError::DoubleFree:
+    std::cerr << "[" << function << "] WARNING: Double free detected!\n";
+    return;
+  case AllocError::SizeOverflow:
+    std::cerr << "[" << function << "] ERROR: Size overflow!\n";
+    return;
+  case AllocError::InvalidAlignment:
+    std::cerr << "[" << function
+              << "] ERROR: Alignment must be a power of two! Got: "
+              << info.size << "\n";
+    return;
+  case AllocError::SizeMismatch:
+    std::cerr << "[" << function << "] ERROR: Size mismatch! Freed as "
+              << info.size << " bytes\n";
+    return;
+  case AllocError::CorruptedBlock:
+    std::cerr << "[" << function << "] ERROR: Corrupted block header!\n";
+    return;
+  case AllocError::UseAfterFree:
+    std::cerr << "[" << function << "] ERROR: Use after free detected!\n";
+    return;
+  }
+}
+
+//=============================================================================
+// MemoryAllocator - Statistics and Debugging
+//=============================================================================
+
+void MemoryAllocator::printStats() const {
+  const MemoryStats stats = getStats();
+
+  std::cout << "\n";
+  std::cout
+      << "╔══════════════════════════════════════════════════════════════╗\n";
+  std::cout
+      << "║           CUSTOM MEMORY ALLOCATOR - STATISTICS               ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Heap Size:          " << std::setw(12)
+            << stats.total_heap_size << " bytes                    ║\n";
+  std::cout << "║  Used Memory:        " << std::setw(12) << stats.used_memory
+            << " bytes                    ║\n";
+  std::cout << "║  Free Memory:        " << std::setw(12) << stats.free_memory
+            << " bytes                    ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Total Allocations:  " << std::setw(12)
+            << stats.total_allocations << "                          ║\n";
+  std::cout << "║  Total Frees:        " << std::setw(12) << stats.total_frees
+            << "                          ║\n";
+  std::cout << "║  Active Allocations: " << std::setw(12)
+            << (stats.total_allocations - stats.total_frees)
+            << "                          ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Total Blocks:       " << std::setw(12) << stats.block_count
+            << "                          ║\n";
+  std::cout << "║  Free Blocks:        " << std::setw(12)
+            << stats.free_block_count << "                          ║\n";
+  std::cout << "║  Largest Free Block: " << std::setw(12)
+            << stats.largest_free_block << " bytes                    ║\n";
+  std::cout << "║  Split Operations:   " << std::setw(12) << stats.split_count
+            << "                          ║\n";
+  std::cout << "║  Coalesce Operations:" << std::setw(12)
+            << stats.coalesce_count << "                          ║\n";
+  std::cout << "║  Heap Segments:      " << std::setw(12) << stats.segment_count
+            << "                          ║\n";
+  std::cout << "║  Purged to OS:       " << std::setw(12) << stats.purged_bytes
+            << " bytes                    ║\n";
+  std::cout << "║  Realloc In Place:   " << std::setw(12)
+            << stats.realloc_in_place << "                          ║\n";
+  std::cout << "║  Realloc Moved:      " << std::setw(12) << stats.realloc_moved
+            << "                          ║\n";
+  std::cout << "║  Calloc Zero Hits:   " << std::setw(12)
+            << stats.calloc_zero_hits << "                          ║\n";
+  std::cout << "║  Search Steps/Alloc: " << std::setw(12) << std::fixed
+            << std::setprecision(2) << stats.getAverageSearchLength()
+            << std::defaultfloat << "                          ║\n";
+  std::cout << "║  Large Mappings:     " << std::setw(12) << stats.large_count
+            << "                          ║\n";
+  std::cout << "║  Huge Pages:         " << std::setw(12)
+            << hugePageBackingName(primary_.backing)
+            << "                          ║\n";
+  std::cout << "║  Placement:          " << std::setw(15)
+            << placementPolicyName(options_.placement)
+            << "                       ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Fragmentation:      " << std::setw(11) << std::fixed
+            << std::setprecision(2) << stats.getFragmentationRatio()
+            << "%                         ║\n";
+  std::cout
+      << "╚══════════════════════════════════════════════════════════════╝\n";
+  std::cout << "\n";
+}
+
+void MemoryAllocator::printHeapLayout() const {
+  std::cout << "\n";
+  std::cout
+      << "═══════════════════════════════════════════════════════════════\n";
+  std::cout
+      << "                    HEAP MEMORY LAYOUT                         \n";
+  std::cout
+      << "═══════════════════════════════════════════════════════════════\n";
+  std::cout << "  Address          Size        Status      Block #\n";
+  std::cout
+      << "───────────────────────────────────────────────────────────────\n";
+
+  // Copy the map first so the formatting below works on a snapshot
+  std::vector<HeapMapEntry> map(heapMap(nullptr, 0));
+  map.resize(heapMap(map.data(), map.size()));
+
+  int block_num = 0;
+  for (const HeapMapEntry &entry : map) {
+    switch (entry.kind) {
+    case HeapMapKind::Segment:
+      if (primary_.next) {
+        std::cout << "  Segment #" << entry.segment
+                  << (entry.segment ? " (mapped)" : " (primary)") << ", "
+                  << entry.size << " B\n";
+      }
+      break;
+    case HeapMapKind::Used:
+    case HeapMapKind::Free:
+      std::cout << "  0x" << std::hex << std::setw(8) << std::setfill('0')
+                << entry.offset << std::dec << std::setfill(' ') << "    "
+                << std::setw(10) << entry.size << " B"
+                << "    "
+                << (entry.kind == HeapMapKind::Free ? "[FREE]    "
+                                                    : "[USED]    ")
+                << "    #" << block_num++ << "\n";
+      break;
+    case HeapMapKind::Large:
+      std::cout << "  (own mapping)    " << std::setw(10) << entry.size
+                << " B    [LARGE]\n";
+      break;
+    }
+  }
+
+  std::cout
+      << "───────────────────────────────────────────────────────────────\n";
+  std::cout << "  Legend: [FREE] = Available   [USED] = Allocated   [LARGE] = "
+               "Mapped\n";
+  std::cout
+      << "═══════════════════════════════════════════════════════════════\n";
+  std::cout << "\n";
+}
+
+//=============================================================================
+// FixedPool - Statistics
+//=============================================================================
+
+void FixedPool::printStats() const {
+  PoolStats stats = getStats();
+
+  std::cout << "\n";
+  std::cout
+      << "╔══════════════════════════════════════════════════════════════╗\n";
+  std::cout
+      << "║              FIXED-SIZE POOL - STATISTICS                    ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Slot Size:          " << std::setw(12) << stats.slot_size
+            << " bytes                    ║\n";
+  std::cout << "║  Capacity:           " << std::setw(12) << stats.capacity
+            << " slots                    ║\n";
+  std::cout << "║  Region Size:        " << std::setw(12) << stats.region_size
+            << " bytes                    ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  In Use:             " << std::setw(12) << stats.in_use
+            << "                          ║\n";
+  std::cout << "║  Peak In Use:        " << std::setw(12) << stats.peak_in_use
+            << "                          ║\n";
+  std::cout << "║  Total Allocations:  " << std::setw(12)
+            << stats.total_allocations << "                          ║\n";
+  std::cout << "║  Total Frees:        " << std::setw(12) << stats.total_frees
+            << "                          ║\n";
+  std::cout << "║  Failed Allocations: " << std::setw(12)
+            << stats.failed_allocations << "                          ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Utilization:        " << std::setw(11) << std::fixed
+            << std::setprecision(2) << stats.getUtilization()
+            << "%                         ║\n";
+  std::cout
+      << "╚══════════════════════════════════════════════════════════════╝\n";
+  std::cout << "\n";
+}
+
+//=============================================================================
+// MonotonicArena - Statistics
+//=============================================================================
+
+void MonotonicArena::printStats() const {
+  ArenaStats stats = getStats();
+
+  std::cout << "\n";
+  std::cout
+      << "╔══════════════════════════════════════════════════════════════╗\n";
+  std::cout
+      << "║              MONOTONIC ARENA - STATISTICS                    ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Chunk Size:         " << std::setw(12) << chunk_size_
+            << " bytes                    ║\n";
+  std::cout << "║  Chunks:             " << std::setw(12) << stats.chunk_count
+            << "                          ║\n";
+  std::cout << "║  Reserved:           " << std::setw(12)
+            << stats.reserved_bytes << " bytes                    ║\n";
+  std::cout << "║  Allocated:          " << std::setw(12)
+            << stats.allocated_bytes << " bytes                    ║\n";
+  std::cout << "║  Allocations:        " << std::setw(12)
+            << stats.total_allocations << "                          ║\n";
+  std::cout << "║  Releases:           " << std::setw(12) << stats.release_count
+            << "                          ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Utilization:        " << std::setw(11) << std::fixed
+            << std::setprecision(2) << stats.getUtilization()
+            << "%                         ║\n";
+  std::cout
+      << "╚══════════════════════════════════════════════════════════════╝\n";
+  std::cout << "\n";
+}
+
+//=============================================================================
+// BuddyAllocator - Statistics
+//=============================================================================
+
+void BuddyAllocator::printStats() const {
+  BuddyStats stats = getStats();
+
+  std::cout << "\n";
+  std::cout
+      << "╔══════════════════════════════════════════════════════════════╗\n";
+  std::cout
+      << "║              BUDDY ALLOCATOR - STATISTICS                    ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Heap Size:          " << std::setw(12) << stats.heap_size
+            << " bytes                    ║\n";
+  std::cout << "║  Min Block:          " << std::setw(12) << stats.min_block
+            << " bytes                    ║\n";
+  std::cout << "║  Max Block:          " << std::setw(12) << stats.max_block
+            << " bytes                    ║\n";
+  std::cout << "║  Huge Pages:         " << std::setw(12)
+            << hugePageBackingName(backing_)
+            << "                          ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Used:               " << std::setw(12) << stats.used_bytes
+            << " bytes                    ║\n";
+  std::cout << "║  Free:               " << std::setw(12) << stats.free_bytes
+            << " bytes                    ║\n";
+  std::cout << "║  Largest Free Block: " << std::setw(12)
+            << stats.largest_free_block << " bytes                    ║\n";
+  std::cout << "║  Free Blocks:        " << std::setw(12) << stats.free_blocks
+            << "                          ║\n";
+  std::cout << "║  Total Allocations:  " << std::setw(12)
+            << stats.total_allocations << "                          ║\n";
+  std::cout << "║  Total Frees:        " << std::setw(12) << stats.total_frees
+            << "                          ║\n";
+  std::cout << "║  Failed Allocations: " << std::setw(12)
+            << stats.failed_allocations << "                          ║\n";
+  std::cout << "║  Splits:             " << std::setw(12) << stats.split_count
+            << "                          ║\n";
+  std::cout << "║  Merges:             " << std::setw(12) << stats.merge_count
+            << "                          ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Utilization:        " << std::setw(11) << std::fixed
+            << std::setprecision(2) << stats.getUtilization()
+            << "%                         ║\n";
+  std::cout << "║  Fragmentation:      " << std::setw(11) << std::fixed
+            << std::setprecision(2) << stats.getFragmentationRatio()
+            << "%                         ║\n";
+  std::cout
+      << "╚══════════════════════════════════════════════════════════════╝\n";
+  std::cout << "\n";
+}
+
+//=============================================================================
+// SlabAllocator - Statistics
+//=============================================================================
+
+void SlabAllocator::printStats() const {
+  SlabStats stats = getStats();
+
+  std::cout << "\n";
+  std::cout
+      << "╔══════════════════════════════════════════════════════════════╗\n";
+  std::cout
+      << "║              SLAB ALLOCATOR - STATISTICS                     ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Slab Size:          " << std::setw(12) << stats.slab_size
+            << " bytes                    ║\n";
+  std::cout << "║  Slabs:              " << std::setw(12) << stats.slab_count
+            << "                          ║\n";
+  std::cout << "║  Empty Slabs:        " << std::setw(12) << stats.empty_slabs
+            << "                          ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Objects In Use:     " << std::setw(12)
+            << stats.objects_in_use << "                          ║\n";
+  std::cout << "║  Object Bytes:       " << std::setw(12) << stats.object_bytes
+            << " bytes                    ║\n";
+  std::cout << "║  Total Allocations:  " << std::setw(12)
+            << stats.total_allocations << "                          ║\n";
+  std::cout << "║  Total Frees:        " << std::setw(12) << stats.total_frees
+            << "                          ║\n";
+  std::cout << "║  Failed Allocations: " << std::setw(12)
+            << stats.failed_allocations << "                          ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Utilization:        " << std::setw(11) << std::fixed
+            << std::setprecision(2) << stats.getUtilization()
+            << "%                         ║\n";
+  std::cout
+      << "╚══════════════════════════════════════════════════════════════╝\n";
+  std::cout << "\n";
+}
+
+//=============================================================================
+// MovableHeap - Statistics
+//=============================================================================
+
+void MovableHeap::printStats() const {
+  MovableStats stats = getStats();
+
+  std::cout << "\n";
+  std::cout
+      << "╔══════════════════════════════════════════════════════════════╗\n";
+  std::cout
+      << "║              MOVABLE HEAP - STATISTICS                       ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Live Handles:       " << std::setw(12) << stats.live_handles
+            << "                          ║\n";
+  std::cout << "║  Pinned Handles:     " << std::setw(12)
+            << stats.pinned_handles << "                          ║\n";
+  std::cout << "║  Live Bytes:         " << std::setw(12) << stats.live_bytes
+            << " bytes                    ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Blocks Moved:       " << std::setw(12) << stats.blocks_moved
+            << "                          ║\n";
+  std::cout << "║  Bytes Moved:        " << std::setw(12) << stats.bytes_moved
+            << " bytes                    ║\n";
+  std::cout << "║  Compaction Passes:  " << std::setw(12)
+            << stats.compaction_passes << "                          ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::cout << "║  Free Bytes:         " << std::setw(12) << stats.free_bytes
+            << " bytes                    ║\n";
+  std::cout << "║  Largest Free Block: " << std::setw(12)
+            << stats.largest_free_block << " bytes                    ║\n";
+  std::cout << "║  Fragmentation:      " << std::setw(11) << std::fixed
+            << std::setprecision(2) << stats.getFragmentationRatio()
+            << "%                         ║\n";
+  std::cout
+      << "╚══════════════════════════════════════════════════════════════╝\n";
+  std::cout << "\n";
+}
+
+//=============================================================================
+// Machine-Readable Exports
+//=============================================================================
+
+namespace {
+
+/// One exported MemoryStats field
+struct StatField {
+  const char *name;                 ///< JSON key and metric suffix
+  size_t MemoryStats::*member;      ///< Field holding the value
+  bool counter;                     ///< Only ever grows (Prometheus counter)
+  const char *help;                 ///< Prometheus HELP text
+};
+
+const StatField STAT_FIELDS[] = {
+    {"total_heap_size", &MemoryStats::total_heap_size, false,
+     "Total heap size in bytes"},
+    {"used_memory", &MemoryStats::used_memory, false,
+     "Bytes currently allocated"},
+    {"free_memory", &MemoryStats::free_memory, false,
+     "Bytes currently available"},
+    {"largest_free_block", &MemoryStats::largest_free_block, false,
+     "Bytes in the biggest free block"},
+    {"block_count", &MemoryStats::block_count, false, "Blocks in the heap"},
+    {"free_block_count", &MemoryStats::free_block_count, false,
+     "Free blocks in the heap"},
+    {"segment_count", &MemoryStats::segment_count, false,
+     "Heap segments, the primary included"},
+    {"huge_page_bytes", &MemoryStats::huge_page_bytes, false,
+     "Heap bytes backed by huge pages"},
+    {"large_count", &MemoryStats::large_count, false,
+     "Live allocations with their own mapping"},
+    {"large_bytes", &MemoryStats::large_bytes, false,
+     "Bytes mapped for large allocations"},
+    {"quarantined_blocks", &MemoryStats::quarantined_blocks, false,
+     "Freed blocks held in the hardened-mode quarantine"},
+    {"quarantined_bytes", &MemoryStats::quarantined_bytes, false,
+     "Bytes held in the hardened-mode quarantine"},
+    {"allocations", &MemoryStats::total_allocations, true,
+     "Successful allocations"},
+    {"frees", &MemoryStats::total_frees, true, "Successful frees"},
+    {"splits", &MemoryStats::split_count, true, "Block splits"},
+    {"coalesces", &MemoryStats::coalesce_count, true, "Block coalesces"},
+    {"purges", &MemoryStats::purge_count, true, "Purge passes"},
+    {"purged_bytes", &MemoryStats::purged_bytes, true,
+     "Bytes returned to the OS by purges"},
+    {"realloc_in_place", &MemoryStats::realloc_in_place, true,
+     "Reallocs that resized without moving"},
+    {"realloc_moved", &MemoryStats::realloc_moved, true,
+     "Reallocs that allocated, copied and freed"},
+    {"calloc_zero_hits", &MemoryStats::calloc_zero_hits, true,
+     "Callocs served from known-zero memory"},
+    {"placement_searches", &MemoryStats::placement_searches, true,
+     "Free block searches by the placement policy"},
+    {"placement_steps", &MemoryStats::placement_steps, true,
+     "Free blocks examined by placement searches"},
+};
+
+/// Header of a writeHeapMap() dump
+struct HeapMapHeader {
+  char magic[4];            ///< "CAHM"
+  uint32_t version;         ///< HEAP_MAP_VERSION
+  uint64_t entry_count;     ///< HeapMapEntry records that follow
+  uint64_t entry_size;      ///< sizeof(HeapMapEntry)
+};
+
+static_assert(sizeof(HeapMapHeader) == 24, "HeapMapHeader is 24 bytes");
+
+bool writeHeapMapEntries(const std::vector<HeapMapEntry> &map,
+                         std::ostream &out) {
+  HeapMapHeader header = {{'C', 'A', 'H', 'M'},
+                          HEAP_MAP_VERSION,
+                          map.size(),
+                          sizeof(HeapMapEntry)};
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(map.data()),
+            static_cast<std::streamsize>(map.size() * sizeof(HeapMapEntry)));
+  return static_cast<bool>(out);
+}
+
+} // namespace
+
+bool writeStatsJson(const MemoryStats &stats, std::ostream &out) {
+  out << "{";
+  for (const StatField &field : STAT_FIELDS) {
+    out << "\"" << field.name << "\":" << stats.*field.member << ",";
+  }
+  out << "\"active_allocations\":"
+      << (stats.total_allocations - stats.total_frees) << ","
+      << "\"fragmentation_percent\":" << std::fixed << std::setprecision(2)
+      << stats.getFragmentationRatio() << "}\n";
+  return static_cast<bool>(out);
+}
+
+bool writeStatsPrometheus(const MemoryStats &stats, std::ostream &out,
+                          const std::string &prefix) {
+  for (const StatField &field : STAT_FIELDS) {
+    std::string metric = prefix + "_" + field.name;
+    if (field.counter) {
+      metric += "_total";
+    }
+    out << "# HELP " << metric << " " << field.help << "\n"
+        << "# TYPE " << metric << (field.counter ? " counter\n" : " gauge\n")
+        << metric << " " << stats.*field.member << "\n";
+  }
+  std::string metric = prefix + "_fragmentation_ratio";
+  out << "# HELP " << metric
+      << " Share of free memory outside the largest free block\n"
+      << "# TYPE " << metric << " gauge\n"
+      << metric << " " << std::fixed << std::setprecision(4)
+      << stats.getFragmentationRatio() / 100.0 << "\n";
+  return static_cast<bool>(out);
+}
+
+bool writeHeapMap(const MemoryAllocator &heap, std::ostream &out) {
+  std::vector<HeapMapEntry> map(heap.heapMap(nullptr, 0));
+  map.resize(heap.heapMap(map.data(), map.size()));
+  return writeHeapMapEntries(map, out);
+}
+
+bool writeHeapMap(const ArenaSet &arenas, size_t index, std::ostream &out) {
+  // The map can grow between the two calls; retry until it fits
+  std::vector<HeapMapEntry> map(arenas.heapMap(index, nullptr, 0));
+  size_t count;
+  while ((count = arenas.heapMap(index, map.data(), map.size())) >
+         map.size()) {
+    map.resize(count);
+  }
+  map.resize(count);
+  return writeHeapMapEntries(map, out);
+}
+
+//=============================================================================
+// Profiler Reports
+//=============================================================================
+
+void printProfile(const ProfileSnapshot &profile) {
+  std::cout << "\n";
+  std::cout
+      << "╔══════════════════════════════════════════════════════════════╗\n";
+  std::cout
+      << "║              ALLOCATION PROFILE                              ║\n";
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  std::ostringstream row;
+  row << "Live Bytes:         " << std::setw(12) << profile.live_bytes;
+  printBoxRow(row.str());
+  row.str("");
+  row << "Peak Live Bytes:    " << std::setw(12) << profile.peak_live_bytes;
+  printBoxRow(row.str());
+  row.str("");
+  row << "Live Samples:       " << std::setw(12) << profile.live_samples
+      << " (every ~" << profile.sample_interval << " bytes)";
+  printBoxRow(row.str());
+
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  printBoxRow("Size Class              Allocs         Frees");
+  for (size_t i = 0; i < PROFILE_SIZE_CLASSES; i++) {
+    if (!profile.alloc_count[i] && !profile.free_count[i]) {
+      continue;
+    }
+    row.str("");
+    row << ">= " << std::setw(12) << std::left << (uint64_t(1) << i)
+        << std::right << std::setw(14) << profile.alloc_count[i]
+        << std::setw(14) << profile.free_count[i];
+    printBoxRow(row.str());
+  }
+
+  std::cout
+      << "╠══════════════════════════════════════════════════════════════╣\n";
+  printBoxRow("Cycles                  Allocs         Frees");
+  for (size_t i = 0; i < PROFILE_LATENCY_BUCKETS; i++) {
+    if (!profile.alloc_cycles[i] && !profile.free_cycles[i]) {
+      continue;
+    }
+    row.str("");
+    row << ">= " << std::setw(12) << std::left << (uint64_t(1) << i)
+        << std::right << std::setw(14) << profile.alloc_cycles[i]
+        << std::setw(14) << profile.free_cycles[i];
+    printBoxRow(row.str());
+  }
+  std::cout
+      << "╚══════════════════════════════════════════════════════════════╝\n";
+  std::cout << "\n";
+}
+
+bool writeHeapProfile(std::ostream &out) {
+  // Identical stacks are merged into one record, as pprof expects
+  std::vector<HeapSample> samples(profileSnapshot().live_samples + 64);
+  samples.resize(heapSamples(samples.data(), samples.size()));
+
+  std::map<std::vector<void *>, std::pair<size_t, size_t>> stacks;
+  size_t total_count = 0;
+  size_t total_bytes = 0;
+  for (const HeapSample &sample : samples) {
+    std::pair<size_t, size_t> &record = stacks[std::vector<void *>(
+        sample.frames, sample.frames + sample.depth)];
+    record.first++;
+    record.second += sample.size;
+    total_count++;
+    total_bytes += sample.size;
+  }
+
+  // gperftools' legacy text format; heap_v2 tells pprof how to unsample
+  out << "heap profile: " << total_count << ": " << total_bytes << " ["
+      << total_count << ": " << total_bytes << "] @ heap_v2/"
+      << profileSnapshot().sample_interval << "\n";
+  for (const auto &stack : stacks) {
+    out << std::setw(6) << stack.second.first << ": " << std::setw(8)
+        << stack.second.second << " [" << std::setw(6) << stack.second.first
+        << ": " << std::setw(8) << stack.second.second << "] @";
+    for (void *frame : stack.first) {
+      out << " " << frame;
+    }
+    out << "\n";
+  }
+
+  // The mappings let pprof symbolize the addresses
+  out << "\nMAPPED_LIBRARIES:\n";
+#if defined(__linux__)
+  std::ifstream maps("/proc/self/maps");
+  out << maps.rdbuf();
+#endif
+  return static_cast<bool>(out);
+}
+
+} // namespace CustomAllocator
@@ -0,0 +1,143 @@
+/**
+ * @file fixed_pool.cpp
+ * @brief Custom Memory Allocator - Lock-Free Fixed-Size Object Pool
+ *
+ * Treiber stack of slot indices with a version-tagged head.
+ */
+
+#include "fixed_pool.hpp"
+
+#include <stdexcept>
+
+namespace CustomAllocator {
+
+//=============================================================================
+// FixedPool - Constructor and Destructor
+//=============================================================================
+
+FixedPool::FixedPool(MemoryAllocator &parent, size_t object_size,
+                     size_t capacity)
+    : parent_(parent), region_(nullptr), region_size_(0), next_(nullptr),
+      slots_(nullptr), slot_size_(0), capacity_(capacity), head_(0),
+      in_use_(0), peak_in_use_(0), allocations_(0), frees_(0), failures_(0) {
+  if (object_size == 0 || capacity == 0 || capacity >= NO_SLOT) {
+    throw std::invalid_argument("Invalid pool geometry");
+  }
+
+  // Slots keep the parent's alignment, whatever it was configured with
+  const size_t alignment = parent_.alignment();
+  slot_size_ = (object_size + alignment - 1) & ~(alignment - 1);
+  size_t links_size =
+      (capacity * sizeof(std::atomic<uint32_t>) + alignment - 1) &
+      ~(alignment - 1);
+  if (slot_size_ > (SIZE_MAX - links_size) / capacity) {
+    throw std::invalid_argument("Invalid pool geometry");
+  }
+
+  // One parent allocation: the link array followed by the slots
+  region_size_ = links_size + slot_size_ * capacity;
+  region_ = parent_.my_malloc(region_size_);
+  if (!region_) {
+    throw std::bad_alloc();
+  }
+
+  next_ = static_cast<std::atomic<uint32_t> *>(region_);
+  slots_ = static_cast<char *>(region_) + links_size;
+
+  // Initially every slot is free, in address order
+  for (size_t i = 0; i < capacity_; i++) {
+    uint32_t next = i + 1 < capacity_ ? static_cast<uint32_t>(i + 1) : NO_SLOT;
+    new (&next_[i]) std::atomic<uint32_t>(next);
+  }
+  head_.store(makeHead(0, 0), std::memory_order_relaxed);
+}
+
+FixedPool::~FixedPool() {
+  if (region_) {
+    parent_.my_free(region_);
+  }
+}
+
+//=============================================================================
+// Allocation Functions
+//=============================================================================
+
+void *FixedPool::allocate() {
+  uint64_t head = head_.load(std::memory_order_acquire);
+
+  for (;;) {
+    uint32_t index = static_cast<uint32_t>(head);
+    if (index == NO_SLOT) {
+      failures_.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    // A stale link is harmless: the tag makes the CAS fail if head moved
+    uint32_t next = next_[index].load(std::memory_order_relaxed);
+    uint64_t new_head = makeHead(next, static_cast<uint32_t>(head >> 32) + 1);
+    if (head_.compare_exchange_weak(head, new_head, std::memory_order_acquire,
+                                    std::memory_order_acquire)) {
+      size_t in_use = in_use_.fetch_add(1, std::memory_order_relaxed) + 1;
+      size_t peak = peak_in_use_.load(std::memory_order_relaxed);
+      while (in_use > peak && !peak_in_use_.compare_exchange_weak(
+                                  peak, in_use, std::memory_order_relaxed)) {
+      }
+      allocations_.fetch_add(1, std::memory_order_relaxed);
+      return slots_ + static_cast<size_t>(index) * slot_size_;
+    }
+  }
+}
+
+void FixedPool::deallocate(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  if (!owns(ptr)) {
+    reportError(AllocError::InvalidPointer, "FixedPool::deallocate", ptr);
+    return;
+  }
+
+  uint32_t index = static_cast<uint32_t>(
+      (static_cast<char *>(ptr) - slots_) / slot_size_);
+
+  uint64_t head = head_.load(std::memory_order_relaxed);
+  for (;;) {
+    next_[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+    uint64_t new_head = makeHead(index, static_cast<uint32_t>(head >> 32) + 1);
+    if (head_.compare_exchange_weak(head, new_head, std::memory_order_release,
+                                    std::memory_order_relaxed)) {
+      break;
+    }
+  }
+
+  in_use_.fetch_sub(1, std::memory_order_relaxed);
+  frees_.fetch_add(1, std::memory_order_relaxed);
+}
+
+//=============================================================================
+// Utility Functions
+//=============================================================================
+
+bool FixedPool::owns(const void *ptr) const {
+  const char *p = static_cast<const char *>(ptr);
+  if (p < slots_ || p >= slots_ + slot_size_ * capacity_) {
+    return false;
+  }
+  return (p - slots_) % slot_size_ == 0;
+}
+
+PoolStats FixedPool::getStats() const {
+  PoolStats stats{};
+  stats.slot_size = slot_size_;
+  stats.capacity = capacity_;
+  stats.in_use = in_use_.load(std::memory_order_relaxed);
+  stats.peak_in_use = peak_in_use_.load(std::memory_order_relaxed);
+  stats.total_allocations = allocations_.load(std::memory_order_relaxed);
+  stats.total_frees = frees_.load(std::memory_order_relaxed);
+  stats.failed_allocations = failures_.load(std::memory_order_relaxed);
+  stats.region_size = region_size_;
+  return stats;
+}
+
+} // namespace CustomAllocator
@@ -0,0 +1,404 @@
+/**
+ * @file global_allocator.cpp
+ * @brief Custom Memory Allocator - Global Allocator Functions
+ *
+ * The thread-safe custom_* entry points: a per-thread ThreadCache in
+ * front of the global ArenaSet.
+ */
+
+#include "arena_set.hpp"
+#include "memory_allocator.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
+#include "thread_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace CustomAllocator {
+
+// Global allocator instances
+MemoryAllocator *g_allocator = nullptr;
+ArenaSet *g_arenas = nullptr;
+
+namespace {
+
+/// Serializes creation and destruction of the global arenas
+std::mutex g_init_mutex;
+
+/// Bumped whenever g_arenas is destroyed, invalidating cached blocks
+std::atomic<uint64_t> g_arenas_generation{1};
+
+/// Set while this thread builds or destroys a global ArenaSet. Once
+/// operator new is replaced, the set's own allocations come back through
+/// custom_malloc and must not recurse into the arenas being built.
+thread_local bool t_bootstrapping = false;
+
+/// Static memory for those allocations; it is never reused
+constexpr size_t BOOTSTRAP_HEAP_SIZE = 64 * 1024;
+alignas(64) char g_bootstrap_heap[BOOTSTRAP_HEAP_SIZE];
+std::atomic<size_t> g_bootstrap_used{0};
+
+/// Marks the calling thread as bootstrapping for the current scope
+struct BootstrapScope {
+  bool saved = t_bootstrapping;
+  BootstrapScope() { t_bootstrapping = true; }
+  ~BootstrapScope() { t_bootstrapping = saved; }
+};
+
+inline bool inBootstrapHeap(const void *ptr) {
+  const char *p = static_cast<const char *>(ptr);
+  return p >= g_bootstrap_heap && p < g_bootstrap_heap + BOOTSTRAP_HEAP_SIZE;
+}
+
+/// Bump allocation from the bootstrap heap, with the size stored in front
+void *bootstrapAllocate(size_t size, size_t alignment = 16) {
+  if (size > BOOTSTRAP_HEAP_SIZE || alignment > 64 ||
+      (alignment & (alignment - 1)) != 0) {
+    return nullptr;
+  }
+  alignment = std::max<size_t>(alignment, 16);
+
+  size_t offset = g_bootstrap_used.load(std::memory_order_relaxed);
+  size_t start;
+  do {
+    start = (offset + sizeof(size_t) + alignment - 1) & ~(alignment - 1);
+    if (start + size > BOOTSTRAP_HEAP_SIZE) {
+      return nullptr;
+    }
+  } while (!g_bootstrap_used.compare_exchange_weak(offset, start + size));
+
+  char *data = g_bootstrap_heap + start;
+  std::memcpy(data - sizeof(size_t), &size, sizeof(size_t));
+  return data;
+}
+
+inline size_t bootstrapSize(const void *ptr) {
+  size_t size;
+  std::memcpy(&size, static_cast<const char *>(ptr) - sizeof(size_t),
+              sizeof(size_t));
+  return size;
+}
+
+/**
+ * @struct LocalCache
+ * @brief Thread-local cache bound to one global arena generation
+ */
+struct LocalCache {
+  ThreadCache cache;
+  uint64_t generation = 0;
+
+  /// Drop blocks that belong to destroyed global arenas
+  ThreadCache &current() {
+    uint64_t now = g_arenas_generation.load(std::memory_order_acquire);
+    if (generation != now) {
+      cache.discard();
+      generation = now;
+    }
+    return cache;
+  }
+
+  ~LocalCache() { flush(); }
+
+  void flush() {
+    std::lock_guard<std::mutex> guard(g_init_mutex);
+    if (g_arenas &&
+        generation == g_arenas_generation.load(std::memory_order_acquire)) {
+      cache.flush(*g_arenas);
+    }
+    cache.discard();
+  }
+};
+
+thread_local LocalCache t_cache;
+
+/// Replace the global arenas (caller holds g_init_mutex)
+void resetGlobalArenasLocked(ArenaSet *arenas) {
+  if (g_arenas) {
+    BootstrapScope bootstrap;
+    delete g_arenas;
+    g_arenas_generation.fetch_add(1, std::memory_order_acq_rel);
+  }
+  g_arenas = arenas;
+  g_allocator = arenas ? &arenas->arena(0) : nullptr;
+}
+
+static_assert(alignof(std::max_align_t) <= GLOBAL_ALIGNMENT,
+              "malloc() alignment exceeds what a heap can guarantee");
+
+/// Options of the global arenas. malloc() and operator new promise
+/// GLOBAL_ALIGNMENT, so the arenas do not use the heap default of 8.
+AllocatorOptions globalArenaOptions(size_t heap_size) {
+  AllocatorOptions options;
+  options.heap_size = heap_size;
+  options.alignment = GLOBAL_ALIGNMENT;
+  options.growable = true;
+  return options;
+}
+
+/// The global arenas, created with default settings on first use.
+/// CUSTOMALLOC_NUMA=1 makes them one node-bound arena per NUMA node.
+ArenaSet &globalArenas() {
+  ArenaSet *arenas = g_arenas;
+  if (!arenas) {
+    std::lock_guard<std::mutex> guard(g_init_mutex);
+    if (!g_arenas) {
+      BootstrapScope bootstrap;
+      const char *numa = std::getenv("CUSTOMALLOC_NUMA");
+      resetGlobalArenasLocked(
+          numa && *numa == '1'
+              ? new ArenaSet(osNumaNodeCount(),
+                             globalArenaOptions(
+                                 MemoryAllocator::DEFAULT_HEAP_SIZE),
+                             ArenaSet::Assignment::NumaNode)
+              : new ArenaSet(1, globalArenaOptions(
+                                    MemoryAllocator::DEFAULT_HEAP_SIZE)));
+    }
+    arenas = g_arenas;
+  }
+  return *arenas;
+}
+
+/// Round small requests up to their cache bin, so every small block holds
+/// a whole bin and a sized free can pick the bin without the header
+inline size_t cacheBinSize(size_t size) {
+  if (size == 0 || size > ThreadCache::MAX_CACHED_SIZE) {
+    return size;
+  }
+  return (size + ThreadCache::SIZE_STEP - 1) & ~(ThreadCache::SIZE_STEP - 1);
+}
+
+} // namespace
+
+//=============================================================================
+// Global Functions
+//=============================================================================
+
+void initGlobalAllocator(size_t heap_size) { initGlobalArenas(1, heap_size); }
+
+void initGlobalArenas(size_t arena_count, size_t heap_size,
+                      ArenaSet::Assignment assignment) {
+  ArenaSet *arenas;
+  {
+    BootstrapScope bootstrap;
+    arenas = new ArenaSet(arena_count, globalArenaOptions(heap_size),
+                          assignment);
+  }
+  std::lock_guard<std::mutex> guard(g_init_mutex);
+  resetGlobalArenasLocked(arenas);
+}
+
+void destroyGlobalAllocator() {
+  std::lock_guard<std::mutex> guard(g_init_mutex);
+  resetGlobalArenasLocked(nullptr);
+}
+
+void lockGlobalAllocator() {
+  g_init_mutex.lock();
+  if (g_arenas) {
+    g_arenas->lockAll();
+  }
+}
+
+void unlockGlobalAllocator() {
+  if (g_arenas) {
+    g_arenas->unlockAll();
+  }
+  g_init_mutex.unlock();
+}
+
+void flushThreadCache() { t_cache.flush(); }
+
+size_t trimGlobalAllocator() {
+  ArenaSet *arenas = g_arenas;
+  if (!arenas) {
+    return 0;
+  }
+
+  t_cache.flush();
+  return arenas->trim();
+}
+
+void *custom_malloc(size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  if (t_bootstrapping) {
+    return bootstrapAllocate(size);
+  }
+
+  // The cache path never reaches the heap, so it is profiled here
+  ProfileScope profile;
+  TraceScope trace;
+  ArenaSet &arenas = globalArenas();
+  void *ptr = size <= ThreadCache::MAX_CACHED_SIZE
+                  ? t_cache.current().allocate(size, arenas)
+                  : arenas.my_malloc(size);
+  trace.record(TraceOp::Malloc, nullptr, ptr, size);
+  if (profile.active()) {
+    profile.allocated(ptr, size, ptr ? MemoryBlock::fromData(ptr)->size() : 0);
+  }
+  return ptr;
+}
+
+void custom_free(void *ptr) {
+  ArenaSet *arenas = g_arenas;
+  if (!ptr || !arenas || inBootstrapHeap(ptr)) {
+    return;
+  }
+
+  // Blocks of another NUMA node skip the cache and go straight home
+  ProfileScope profile;
+  TraceScope trace;
+  size_t index = arenas->arenaIndexFor(ptr);
+  bool valid = index != ArenaSet::NO_ARENA;
+  size_t usable =
+      profile.active() && valid ? MemoryBlock::fromData(ptr)->size() : 0;
+  if (!valid) {
+    arenas->my_free(ptr); // Reports the invalid pointer
+  } else if (!arenas->isNodeLocal(index) ||
+             !t_cache.current().deallocate(ptr, *arenas)) {
+    arenas->freeInArena(index, ptr);
+  }
+  trace.record(TraceOp::Free, ptr, nullptr, 0);
+  profile.freed(ptr, usable);
+}
+
+void custom_free_sized(void *ptr, size_t size) {
+  ArenaSet *arenas = g_arenas;
+  if (!ptr || !arenas || inBootstrapHeap(ptr)) {
+    return;
+  }
+
+  ProfileScope profile;
+  TraceScope trace;
+  size_t index = arenas->arenaIndexFor(ptr);
+  bool valid = index != ArenaSet::NO_ARENA;
+  size_t usable =
+      profile.active() && valid ? MemoryBlock::fromData(ptr)->size() : 0;
+  if (!valid) {
+    arenas->my_free_sized(ptr, size); // Reports the invalid pointer
+  } else if (!arenas->isNodeLocal(index) ||
+             !t_cache.current().deallocateSized(ptr, size, *arenas)) {
+    arenas->freeSizedInArena(index, ptr, size);
+  }
+  trace.record(TraceOp::Free, ptr, nullptr, size);
+  profile.freed(ptr, usable);
+}
+
+void *custom_malloc_on_node(size_t size, int node) {
+  if (size == 0) {
+    return nullptr;
+  }
+  if (t_bootstrapping) {
+    return bootstrapAllocate(size);
+  }
+
+  // Bypasses the thread cache, whose blocks may come from any node
+  ProfileScope profile;
+  TraceScope trace;
+  void *ptr = globalArenas().my_malloc_on_node(cacheBinSize(size), node);
+  trace.record(TraceOp::Malloc, nullptr, ptr, size);
+  if (profile.active()) {
+    profile.allocated(ptr, size, ptr ? MemoryBlock::fromData(ptr)->size() : 0);
+  }
+  return ptr;
+}
+
+void *custom_realloc(void *ptr, size_t size) {
+  if (!ptr) {
+    return custom_malloc(size);
+  }
+
+  // Bootstrap blocks are never resized in place
+  if (inBootstrapHeap(ptr)) {
+    void *moved = size ? custom_malloc(size) : nullptr;
+    if (moved) {
+      std::memcpy(moved, ptr, std::min(size, bootstrapSize(ptr)));
+    }
+    return moved;
+  }
+  return globalArenas().my_realloc(ptr, cacheBinSize(size));
+}
+
+void *custom_calloc(size_t count, size_t size) {
+  size_t total_size = count * size;
+  if (count != 0 && total_size / count != size) {
+    reportError(AllocError::SizeOverflow, "custom_calloc", nullptr, size);
+    return nullptr;
+  }
+
+  if (t_bootstrapping) {
+    void *ptr = custom_malloc(total_size);
+    if (ptr) {
+      std::memset(ptr, 0, total_size);
+    }
+    return ptr;
+  }
+
+  // Cached blocks are recycled, so they always need clearing; larger
+  // requests let the heap skip memory it knows is zero
+  TraceScope trace;
+  void *ptr;
+  if (total_size <= ThreadCache::MAX_CACHED_SIZE) {
+    ptr = custom_malloc(total_size);
+    if (ptr) {
+      std::memset(ptr, 0, total_size);
+    }
+  } else {
+    ptr = globalArenas().my_calloc(count, size);
+  }
+  trace.record(TraceOp::Calloc, nullptr, ptr, total_size);
+  return ptr;
+}
+
+void *custom_aligned_alloc(size_t alignment, size_t size) {
+  if (t_bootstrapping) {
+    return size ? bootstrapAllocate(size, alignment) : nullptr;
+  }
+
+  // Aligned requests bypass the thread cache; freeing them may refill it
+  return globalArenas().my_aligned_alloc(alignment, cacheBinSize(size));
+}
+
+int custom_posix_memalign(void **memptr, size_t alignment, size_t size) {
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0 ||
+      alignment % sizeof(void *) != 0) {
+    return EINVAL;
+  }
+
+  *memptr = nullptr;
+  if (size == 0) {
+    return 0;
+  }
+
+  void *ptr = custom_aligned_alloc(alignment, size);
+  if (!ptr) {
+    return ENOMEM;
+  }
+  *memptr = ptr;
+  return 0;
+}
+
+size_t custom_usable_size(void *ptr) {
+  if (!ptr) {
+    return 0;
+  }
+  if (inBootstrapHeap(ptr)) {
+    return bootstrapSize(ptr);
+  }
+
+  // Heap blocks and large mappings both carry an ordinary block header
+  ArenaSet *arenas = g_arenas;
+  if (!arenas || !arenas->isValidPointer(ptr)) {
+    return 0;
+  }
+  return MemoryBlock::fromData(ptr)->size();
+}
+
+} // namespace CustomAllocator
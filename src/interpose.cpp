@@ -0,0 +1,258 @@
+/**
+ * @file interpose.cpp
+ * @brief Custom Memory Allocator - malloc and operator new/delete Replacement
+ *
+ * Built into libcustomalloc.so only. Preloading that library
+ * (LD_PRELOAD=libcustomalloc.so ./program) routes the C allocation
+ * functions and every global operator new/delete of an unmodified
+ * program to the custom_* entry points.
+ */
+
+#include "memory_allocator.hpp"
+#include "tracer.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define CUSTOM_ALLOC_EXPORT __attribute__((visibility("default")))
+
+using CustomAllocator::custom_aligned_alloc;
+using CustomAllocator::custom_calloc;
+using CustomAllocator::custom_free;
+using CustomAllocator::custom_free_sized;
+using CustomAllocator::custom_malloc;
+using CustomAllocator::custom_posix_memalign;
+using CustomAllocator::custom_realloc;
+using CustomAllocator::custom_usable_size;
+
+namespace {
+
+/// The C functions hand out a unique pointer even for a zero size
+inline size_t nonZero(size_t size) { return size ? size : 1; }
+
+inline bool isPowerOfTwo(size_t value) {
+  return value != 0 && (value & (value - 1)) == 0;
+}
+
+/// operator new semantics: retry through the new_handler, then throw
+void *allocateOrThrow(size_t size, size_t alignment = 0) {
+  for (;;) {
+    void *ptr = alignment ? custom_aligned_alloc(alignment, nonZero(size))
+                          : custom_malloc(nonZero(size));
+    if (ptr) {
+      return ptr;
+    }
+
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+    handler();
+  }
+}
+
+void *allocateOrNull(size_t size, size_t alignment = 0) noexcept {
+  try {
+    return allocateOrThrow(size, alignment);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+/// A child must not inherit arena locks held by threads that do not exist
+/// in it, so fork() waits for every lock and both sides release them
+__attribute__((constructor)) void registerForkHandlers() {
+  pthread_atfork(CustomAllocator::lockGlobalAllocator,
+                 CustomAllocator::unlockGlobalAllocator,
+                 CustomAllocator::unlockGlobalAllocator);
+}
+
+/// CUSTOMALLOC_TRACE=path records the whole run for alloc_replay
+__attribute__((constructor)) void startTraceFromEnvironment() {
+  const char *path = std::getenv("CUSTOMALLOC_TRACE");
+  if (path && *path) {
+    CustomAllocator::startTracing(path);
+  }
+}
+
+} // namespace
+
+//=============================================================================
+// C Allocation Functions
+//=============================================================================
+
+extern "C" {
+
+CUSTOM_ALLOC_EXPORT void *malloc(size_t size) noexcept {
+  void *ptr = custom_malloc(nonZero(size));
+  if (!ptr) {
+    errno = ENOMEM;
+  }
+  return ptr;
+}
+
+CUSTOM_ALLOC_EXPORT void free(void *ptr) noexcept { custom_free(ptr); }
+
+CUSTOM_ALLOC_EXPORT void *calloc(size_t count, size_t size) noexcept {
+  void *ptr = count && size ? custom_calloc(count, size) : custom_calloc(1, 1);
+  if (!ptr) {
+    errno = ENOMEM;
+  }
+  return ptr;
+}
+
+CUSTOM_ALLOC_EXPORT void *realloc(void *ptr, size_t size) noexcept {
+  if (ptr && size == 0) {
+    custom_free(ptr);
+    return nullptr;
+  }
+
+  void *moved = custom_realloc(ptr, nonZero(size));
+  if (!moved) {
+    errno = ENOMEM;
+  }
+  return moved;
+}
+
+CUSTOM_ALLOC_EXPORT int posix_memalign(void **memptr, size_t alignment,
+                                       size_t size) noexcept {
+  return custom_posix_memalign(memptr, alignment, nonZero(size));
+}
+
+CUSTOM_ALLOC_EXPORT void *aligned_alloc(size_t alignment,
+                                        size_t size) noexcept {
+  if (!isPowerOfTwo(alignment)) {
+    errno = EINVAL;
+    return nullptr;
+  }
+
+  void *ptr = custom_aligned_alloc(alignment, nonZero(size));
+  if (!ptr) {
+    errno = ENOMEM;
+  }
+  return ptr;
+}
+
+CUSTOM_ALLOC_EXPORT void *memalign(size_t alignment, size_t size) noexcept {
+  return aligned_alloc(alignment, size);
+}
+
+CUSTOM_ALLOC_EXPORT void *valloc(size_t size) noexcept {
+  return aligned_alloc(static_cast<size_t>(sysconf(_SC_PAGESIZE)), size);
+}
+
+CUSTOM_ALLOC_EXPORT void *pvalloc(size_t size) noexcept {
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  if (size > SIZE_MAX - page) {
+    errno = ENOMEM;
+    return nullptr;
+  }
+  return aligned_alloc(page, (nonZero(size) + page - 1) & ~(page - 1));
+}
+
+CUSTOM_ALLOC_EXPORT size_t malloc_usable_size(void *ptr) noexcept {
+  return custom_usable_size(ptr);
+}
+
+} // extern "C"
+
+//=============================================================================
+// Global operator new / delete
+//=============================================================================
+
+CUSTOM_ALLOC_EXPORT void *operator new(size_t size) {
+  return allocateOrThrow(size);
+}
+
+CUSTOM_ALLOC_EXPORT void *operator new[](size_t size) {
+  return allocateOrThrow(size);
+}
+
+CUSTOM_ALLOC_EXPORT void *operator new(size_t size,
+                                       const std::nothrow_t &) noexcept {
+  return allocateOrNull(size);
+}
+
+CUSTOM_ALLOC_EXPORT void *operator new[](size_t size,
+                                         const std::nothrow_t &) noexcept {
+  return allocateOrNull(size);
+}
+
+CUSTOM_ALLOC_EXPORT void *operator new(size_t size, std::align_val_t al) {
+  return allocateOrThrow(size, static_cast<size_t>(al));
+}
+
+CUSTOM_ALLOC_EXPORT void *operator new[](size_t size, std::align_val_t al) {
+  return allocateOrThrow(size, static_cast<size_t>(al));
+}
+
+CUSTOM_ALLOC_EXPORT void *operator new(size_t size, std::align_val_t al,
+                                       const std::nothrow_t &) noexcept {
+  return allocateOrNull(size, static_cast<size_t>(al));
+}
+
+CUSTOM_ALLOC_EXPORT void *operator new[](size_t size, std::align_val_t al,
+                                         const std::nothrow_t &) noexcept {
+  return allocateOrNull(size, static_cast<size_t>(al));
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete(void *ptr) noexcept {
+  custom_free(ptr);
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete[](void *ptr) noexcept {
+  custom_free(ptr);
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete(void *ptr,
+                                         const std::nothrow_t &) noexcept {
+  custom_free(ptr);
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete[](void *ptr,
+                                           const std::nothrow_t &) noexcept {
+  custom_free(ptr);
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete(void *ptr, size_t size) noexcept {
+  custom_free_sized(ptr, nonZero(size));
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete[](void *ptr, size_t size) noexcept {
+  custom_free_sized(ptr, nonZero(size));
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete(void *ptr, std::align_val_t) noexcept {
+  custom_free(ptr);
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete[](void *ptr,
+                                           std::align_val_t) noexcept {
+  custom_free(ptr);
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete(void *ptr, std::align_val_t,
+                                         const std::nothrow_t &) noexcept {
+  custom_free(ptr);
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete[](void *ptr, std::align_val_t,
+                                           const std::nothrow_t &) noexcept {
+  custom_free(ptr);
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete(void *ptr, size_t size,
+                                         std::align_val_t) noexcept {
+  custom_free_sized(ptr, nonZero(size));
+}
+
+CUSTOM_ALLOC_EXPORT void operator delete[](void *ptr, size_t size,
+                                           std::align_val_t) noexcept {
+  custom_free_sized(ptr, nonZero(size));
+}
@@ -9,14 +9,45 @@
  * - Edge cases and error handling
  */
 
+#include "arena_set.hpp"
+#include "buddy_allocator.hpp"
+#include "diagnostics.hpp"
+#include "fixed_pool.hpp"
 #include "memory_allocator.hpp"
+#include "memory_resource.hpp"
+#include "monotonic_arena.hpp"
+#include "movable_heap.hpp"
+#include "profiler.hpp"
+#include "slab_allocator.hpp"
+#include "tracer.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 
 using namespace CustomAllocator;
 
@@ -494,80 +525,3597 @@ bool testGlobalAllocator() {
   return true;
 }
 
-//=============================================================================
-// Main Entry Point
-//=============================================================================
+/**
+ * Test 11: Segregated Free Lists
+ */
+bool testSegregatedFit() {
+  printTestHeader("Segregated Size-Class Free Lists");
 
-int main() {
-  std::cout << "\n";
-  std::cout << "╔══════════════════════════════════════════════════════════════"
-               "════╗\n";
-  std::cout << "║                                                              "
-               "    ║\n";
-  std::cout << "║            CUSTOM MEMORY ALLOCATOR - C++ IMPLEMENTATION      "
-               "    ║\n";
-  std::cout << "║                                                              "
-               "    ║\n";
-  std::cout << "║  Features:                                                   "
-               "    ║\n";
-  std::cout << "║    • Custom malloc() and free() functions                    "
-               "    ║\n";
-  std::cout << "║    • Block splitting for efficient memory usage              "
-               "    ║\n";
-  std::cout << "║    • Block coalescing to minimize fragmentation              "
-               "    ║\n";
-  std::cout << "║    • Memory statistics and heap visualization                "
-               "    ║\n";
-  std::cout << "║                                                              "
-               "    ║\n";
-  std::cout << "╚══════════════════════════════════════════════════════════════"
-               "════╝\n";
+  MemoryAllocator allocator(64 * 1024);
 
-  int passed = 0;
-  int failed = 0;
+  printSectionHeader("Allocating 256 small blocks and freeing every other one");
+  std::vector<void *> blocks;
+  for (int i = 0; i < 256; i++) {
+    void *p = allocator.my_malloc(32);
+    if (!p) {
+      TEST_FAILED("Allocation failed at block " + std::to_string(i));
+      return false;
+    }
+    blocks.push_back(p);
+  }
+  std::vector<void *> holes;
+  for (size_t i = 0; i < blocks.size(); i += 2) {
+    allocator.my_free(blocks[i]);
+    holes.push_back(blocks[i]);
+    blocks[i] = nullptr;
+  }
 
-  // Run all tests
-  if (testBasicAllocation())
-    passed++;
-  else
-    failed++;
-  if (testMultipleAllocations())
-    passed++;
-  else
-    failed++;
-  if (testBlockSplitting())
-    passed++;
-  else
-    failed++;
-  if (testBlockCoalescing())
-    passed++;
-  else
-    failed++;
-  if (testFragmentation())
-    passed++;
-  else
-    failed++;
-  if (testRealloc())
-    passed++;
-  else
-    failed++;
-  if (testCalloc())
-    passed++;
-  else
-    failed++;
-  if (testEdgeCases())
-    passed++;
-  else
-    failed++;
-  if (testMemoryReuse())
-    passed++;
-  else
-    failed++;
-  if (testGlobalAllocator())
-    passed++;
-  else
-    failed++;
+  printSectionHeader("Small request should reuse a freed 32-byte hole");
+  void *small = allocator.my_malloc(32);
+  if (std::find(holes.begin(), holes.end(), small) == holes.end()) {
+    TEST_FAILED("Small allocation did not come from a freed hole");
+    return false;
+  }
+
+  printSectionHeader("Large request should skip the holes");
+  void *large = allocator.my_malloc(4096);
+  if (!large || large < blocks.back()) {
+    TEST_FAILED("Large allocation did not come from the tail block");
+    return false;
+  }
+
+  auto stats = allocator.getStats();
+  std::cout << "  Free blocks: " << stats.free_block_count
+            << ", total blocks: " << stats.block_count << "\n";
+
+  allocator.my_free(small);
+  allocator.my_free(large);
+  for (void *p : blocks) {
+    allocator.my_free(p);
+  }
+
+  stats = allocator.getStats();
+  if (stats.free_block_count != 1 || stats.block_count != 1) {
+    TEST_FAILED("Heap did not coalesce back into a single block");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 12: Incremental Statistics
+ */
+bool testIncrementalStats() {
+  printTestHeader("Incremental Statistics Bookkeeping");
+
+  MemoryAllocator allocator(32 * 1024);
+
+  printSectionHeader("Random malloc/realloc/free sequence");
+  std::vector<void *> live;
+  unsigned seed = 12345;
+  auto next_random = [&seed]() {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) & 0x7fff;
+  };
+
+  for (int i = 0; i < 2000; i++) {
+    unsigned op = next_random() % 4;
+    if (op < 2 || live.empty()) {
+      void *p = allocator.my_malloc(1 + next_random() % 300);
+      if (p) {
+        live.push_back(p);
+      }
+    } else if (op == 2) {
+      size_t index = next_random() % live.size();
+      void *p = allocator.my_realloc(live[index], 1 + next_random() % 600);
+      if (p) {
+        live[index] = p;
+      }
+    } else {
+      size_t index = next_random() % live.size();
+      allocator.my_free(live[index]);
+      live[index] = live.back();
+      live.pop_back();
+    }
+
+    if (!allocator.verifyStats()) {
+      TEST_FAILED("Statistics diverged from heap at step " +
+                  std::to_string(i));
+      return false;
+    }
+  }
+  std::cout << "  Statistics matched a full recount after every operation\n";
+
+  for (void *p : live) {
+    allocator.my_free(p);
+  }
+  allocator.printStats();
+
+  if (!allocator.verifyStats() || allocator.getStats().block_count != 1) {
+    TEST_FAILED("Statistics wrong after freeing everything");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 13: Boundary Tags on External Memory
+ */
+bool testBoundaryTags() {
+  printTestHeader("Boundary-Tag Headers on External Memory");
+
+  alignas(16) static char region[2048];
+  MemoryAllocator allocator(region, sizeof(region));
+
+  printSectionHeader("Header overhead for minimum-size blocks");
+  std::cout << "  sizeof(MemoryBlock) = " << sizeof(MemoryBlock) << " bytes\n";
+  char *a = static_cast<char *>(allocator.my_malloc(16));
+  char *b = static_cast<char *>(allocator.my_malloc(16));
+  char *c = static_cast<char *>(allocator.my_malloc(16));
+  if (!a || !b || !c) {
+    TEST_FAILED("Allocation from external region failed");
+    return false;
+  }
+  if (b - a != static_cast<std::ptrdiff_t>(16 + sizeof(MemoryBlock))) {
+    TEST_FAILED("Unexpected per-block overhead");
+    return false;
+  }
+  std::cout << "  Consecutive 16-byte blocks are " << (b - a)
+            << " bytes apart\n";
+
+  printSectionHeader("Freeing outer blocks, then the middle one");
+  allocator.my_free(a);
+  allocator.my_free(c);
+  allocator.my_free(b);
+  allocator.printHeapLayout();
+
+  auto stats = allocator.getStats();
+  if (!allocator.verifyStats() || stats.block_count != 1 ||
+      stats.free_memory != sizeof(region) - 2 * sizeof(MemoryBlock)) {
+    TEST_FAILED("Neighbours were not merged through the boundary tags");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 14: Thread-Local Caches
+ */
+bool testThreadCaches() {
+  printTestHeader("Thread-Local Caches and Cross-Thread Frees");
+
+  initGlobalArenas(2, 512 * 1024);
+
+  constexpr int kThreads = 4;
+  constexpr int kObjects = 2000;
+  std::mutex handoff_mutex;
+  std::vector<void *> handoff;
+  bool data_valid = true;
+
+  printSectionHeader("4 threads allocating, freeing, and trading blocks");
+  auto worker = [&](int id) {
+    std::vector<void *> mine;
+    for (int i = 0; i < kObjects; i++) {
+      size_t size = 8 + static_cast<size_t>((i * 7 + id) % 300);
+      unsigned char *p = static_cast<unsigned char *>(custom_malloc(size));
+      if (!p) {
+        continue;
+      }
+      std::memset(p, id, size);
+      mine.push_back(p);
+    }
+
+    // Hand every other block to whichever thread frees next
+    std::vector<void *> to_free;
+    {
+      std::lock_guard<std::mutex> guard(handoff_mutex);
+      for (size_t i = 0; i < mine.size(); i++) {
+        if (i % 2) {
+          handoff.push_back(mine[i]);
+        } else {
+          to_free.push_back(mine[i]);
+        }
+      }
+      size_t take = std::min(handoff.size(), mine.size() / 2);
+      to_free.insert(to_free.end(), handoff.end() - take, handoff.end());
+      handoff.resize(handoff.size() - take);
+    }
+
+    for (void *p : to_free) {
+      if (static_cast<unsigned char *>(p)[0] > kThreads) {
+        data_valid = false;
+      }
+      custom_free(p);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back(worker, t + 1);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (void *p : handoff) {
+    custom_free(p);
+  }
+  flushThreadCache();
+
+  auto stats = g_arenas->getStats();
+  std::cout << "  Allocations: " << stats.total_allocations
+            << ", frees: " << stats.total_frees << "\n";
+  bool consistent = g_arenas->arena(0).verifyStats() &&
+                    g_arenas->arena(1).verifyStats() &&
+                    stats.used_memory == 0 && stats.block_count == 2;
+  destroyGlobalAllocator();
+
+  if (!data_valid) {
+    TEST_FAILED("Block contents were corrupted");
+    return false;
+  }
+  if (!consistent) {
+    TEST_FAILED("Cached blocks were not all returned to the heap");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 15: Per-Arena Sharding
+ */
+bool testArenaSet() {
+  printTestHeader("Arena Sharding with Per-Arena Locks");
+
+  ArenaSet arenas(4, 64 * 1024);
+
+  printSectionHeader("Routing pointers to their owning arena");
+  void *p = arenas.my_malloc(100);
+  size_t owner = arenas.arenaIndexFor(p);
+  int stack_value = 0;
+  if (owner != arenas.currentArenaIndex() ||
+      arenas.arenaIndexFor(&stack_value) != ArenaSet::NO_ARENA) {
+    TEST_FAILED("Address-range lookup returned the wrong arena");
+    return false;
+  }
+  std::cout << "  Pointer " << p << " belongs to arena " << owner << "\n";
+  arenas.my_free(p);
+
+  printSectionHeader("Large mappings and extra segments found without arena locks");
+  void *large = arenas.my_malloc(512 * 1024);
+  std::vector<void *> spilled;
+  while (arenas.getArenaStats(owner).segment_count < 2) {
+    spilled.push_back(arenas.my_malloc(4096));
+  }
+  void *extra = spilled.back();
+  for (size_t i = 0; i < arenas.arenaCount(); i++) {
+    arenas.arenaLock(i).lock();
+  }
+  std::atomic<bool> routed{false};
+  std::thread lookup([&]() {
+    routed = arenas.arenaIndexFor(large) == owner &&
+             arenas.arenaIndexFor(extra) == owner;
+  });
+  for (int i = 0; i < 2000 && !routed; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  bool unblocked = routed;
+  for (size_t i = 0; i < arenas.arenaCount(); i++) {
+    arenas.arenaLock(i).unlock();
+  }
+  lookup.join();
+  if (!unblocked || !routed) {
+    TEST_FAILED("Routing a large or segment pointer needed the arena locks");
+    return false;
+  }
+  arenas.my_free(large);
+  for (void *block : spilled) {
+    arenas.my_free(block);
+  }
+  if (arenas.getArenaStats(owner).large_count != 0 ||
+      arenas.getArenaStats(owner).used_memory != 0) {
+    TEST_FAILED("Table-routed frees did not reach the owning arena");
+    return false;
+  }
+  std::cout << "  Large and segment pointers routed while every arena was locked\n";
+
+  printSectionHeader("4 threads freeing each other's blocks");
+  constexpr int kThreads = 4;
+  std::vector<std::vector<void *>> produced(kThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&arenas, &produced, t]() {
+      for (int i = 0; i < 500; i++) {
+        void *block = arenas.my_malloc(16 + (i % 64) * 8);
+        if (block) {
+          produced[t].push_back(block);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  threads.clear();
+
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&arenas, &produced, t]() {
+      for (void *block : produced[(t + 1) % kThreads]) {
+        arenas.my_free(block);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  for (size_t i = 0; i < arenas.arenaCount(); i++) {
+    auto stats = arenas.getArenaStats(i);
+    std::cout << "  Arena " << i << ": " << stats.total_allocations
+              << " allocations, " << stats.used_memory << " bytes in use\n";
+    if (stats.used_memory != 0 || stats.block_count != 1) {
+      TEST_FAILED("Arena " + std::to_string(i) + " was not fully freed");
+      return false;
+    }
+  }
+
+  printSectionHeader("Realloc moves arenas only when the owner is full");
+  {
+    AllocatorOptions options;
+    options.heap_size = 16 * 1024;
+    options.large_threshold = 0;
+    options.hardened = true;
+    ArenaSet hardened(2, options);
+
+    // A rejected pointer must fail, not be copied into a fresh block
+    char *freed = static_cast<char *>(hardened.my_malloc(64));
+    std::memset(freed, 0x5A, 64);
+    hardened.my_free(freed);
+    clear_last_error();
+    bool stale = hardened.my_realloc(freed, 128) == nullptr &&
+                 last_error() == AllocError::UseAfterFree;
+    char *live = static_cast<char *>(hardened.my_malloc(64));
+    std::memset(live, 0, 64);
+    clear_last_error();
+    bool interior = hardened.my_realloc(live + 32, 64) == nullptr &&
+                    last_error() == AllocError::CorruptedBlock;
+
+    // A full owner still hands the data to the other arena
+    char *filler = static_cast<char *>(hardened.my_malloc(12 * 1024));
+    size_t home = hardened.arenaIndexFor(live);
+    std::memset(live, 0x42, 64);
+    char *moved = static_cast<char *>(hardened.my_realloc(live, 8 * 1024));
+    bool spilled = moved && hardened.arenaIndexFor(moved) != home &&
+                   moved[63] == 0x42;
+
+    std::cout << "  Freed: " << (stale ? "rejected" : "copied")
+              << ", interior: " << (interior ? "rejected" : "copied")
+              << ", full owner: " << (spilled ? "moved" : "failed") << "\n";
+    hardened.my_free(moved);
+    hardened.my_free(filler);
+    if (!stale || !interior || !spilled) {
+      TEST_FAILED("Realloc fell back to another arena on a bad pointer");
+      return false;
+    }
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 16: Lock-Free Fixed-Size Pool
+ */
+bool testFixedPool() {
+  printTestHeader("Lock-Free Fixed-Size Object Pool");
+
+  struct Message {
+    int id;
+    char payload[20];
+  };
+
+  MemoryAllocator allocator(256 * 1024);
+  FixedPool pool(allocator, sizeof(Message), 1024);
+
+  printSectionHeader("Objects are packed with no per-object header");
+  Message *a = pool.create<Message>();
+  Message *b = pool.create<Message>();
+  if (!a || !b ||
+      reinterpret_cast<char *>(b) - reinterpret_cast<char *>(a) !=
+          static_cast<std::ptrdiff_t>(pool.slotSize())) {
+    TEST_FAILED("Slots are not adjacent");
+    return false;
+  }
+  std::cout << "  Slot size: " << pool.slotSize() << " bytes for a "
+            << sizeof(Message) << "-byte object\n";
+  pool.destroy(a);
+  pool.destroy(b);
+
+  printSectionHeader("Slots keep a 16-byte parent's alignment");
+  AllocatorOptions aligned_options;
+  aligned_options.alignment = 16;
+  MemoryAllocator aligned_parent(aligned_options);
+  FixedPool aligned_pool(aligned_parent, 24, 5);
+  for (int i = 0; i < 5; i++) {
+    void *slot = aligned_pool.allocate();
+    if (!slot || reinterpret_cast<uintptr_t>(slot) % 16 != 0) {
+      TEST_FAILED("Pool slot lost the parent's 16-byte alignment");
+      return false;
+    }
+  }
+  std::cout << "  24-byte objects in " << aligned_pool.slotSize()
+            << "-byte, 16-aligned slots\n";
+
+  printSectionHeader("4 threads hammering the pool concurrently");
+  std::atomic<bool> corrupted{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&pool, &corrupted, t]() {
+      std::vector<Message *> held;
+      for (int i = 0; i < 20000; i++) {
+        if (held.size() < 200 && (i % 3) != 2) {
+          Message *m = pool.create<Message>();
+          if (m) {
+            m->id = t * 1000000 + i;
+            held.push_back(m);
+          }
+        } else if (!held.empty()) {
+          Message *m = held.back();
+          held.pop_back();
+          if (m->id / 1000000 != t) {
+            corrupted = true;
+          }
+          pool.destroy(m);
+        }
+      }
+      for (Message *m : held) {
+        pool.destroy(m);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  pool.printStats();
+  PoolStats stats = pool.getStats();
+  if (corrupted || stats.in_use != 0 ||
+      stats.total_allocations != stats.total_frees) {
+    TEST_FAILED("Pool handed out a slot twice or lost one");
+    return false;
+  }
+
+  printSectionHeader("Exhausting the pool");
+  std::vector<void *> slots;
+  while (void *slot = pool.allocate()) {
+    slots.push_back(slot);
+  }
+  if (slots.size() != pool.capacity()) {
+    TEST_FAILED("Pool capacity mismatch");
+    return false;
+  }
+  for (void *slot : slots) {
+    pool.deallocate(slot);
+  }
+  std::cout << "  Parent heap in use: " << allocator.getStats().used_memory
+            << " bytes (one region)\n";
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 17: Growable heap backed by OS segments
+ */
+bool testGrowableHeap() {
+  printTestHeader("Growable Heap with OS Segments");
 
+  AllocatorOptions options;
+  options.heap_size = 4096;
+  options.growable = true;
+  MemoryAllocator allocator(options);
+
+  printSectionHeader("Allocating far more than the initial 4 KB");
+  std::vector<void *> ptrs;
+  for (int i = 0; i < 64; i++) {
+    void *ptr = allocator.my_malloc(1024);
+    if (!ptr) {
+      TEST_FAILED("Growable heap ran out of memory");
+      return false;
+    }
+    std::memset(ptr, i, 1024);
+    ptrs.push_back(ptr);
+  }
+
+  MemoryStats stats = allocator.getStats();
+  std::cout << "  64 x 1 KB allocated across " << stats.segment_count
+            << " segments\n";
+  if (stats.segment_count < 2 || !allocator.verifyStats()) {
+    TEST_FAILED("Heap did not grow consistently");
+    return false;
+  }
+  for (void *ptr : ptrs) {
+    if (!allocator.isValidPointer(ptr)) {
+      TEST_FAILED("Pointer in an extra segment was rejected");
+      return false;
+    }
+  }
+
+  printSectionHeader("A single block larger than the default segment");
+  void *big = allocator.my_malloc(64 * 1024);
+  if (!big || !allocator.isValidPointer(big)) {
+    TEST_FAILED("Oversized request did not get its own segment");
+    return false;
+  }
+  allocator.my_free(big);
+
+  printSectionHeader("Freeing everything releases the extra segments");
+  for (void *ptr : ptrs) {
+    allocator.my_free(ptr);
+  }
+  stats = allocator.getStats();
+  std::cout << "  Segments after freeing: " << stats.segment_count << "\n";
+  if (stats.segment_count != 1 || stats.used_memory != 0 ||
+      stats.total_heap_size != 4096 || !allocator.verifyStats()) {
+    TEST_FAILED("Empty segments were not returned to the OS");
+    return false;
+  }
+
+  printSectionHeader("A fixed-size heap still fails cleanly");
+  MemoryAllocator fixed(4096);
+  if (fixed.isGrowable() || fixed.my_malloc(8192) != nullptr) {
+    TEST_FAILED("Fixed heap grew");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 18: Returning free pages to the OS
+ */
+bool testPurgeAndTrim() {
+  printTestHeader("Purging Free Pages and trim()");
+
+  AllocatorOptions options;
+  options.heap_size = 8 * 1024 * 1024;
+  options.purge_threshold = 1024 * 1024;
+  options.purge_interval_ms = 0;
+  options.large_threshold = 0; // Keep the 2 MB block in the heap
+  MemoryAllocator allocator(options);
+
+  printSectionHeader("Freeing 2 MB crosses the 1 MB purge threshold");
+  const size_t big_size = 2 * 1024 * 1024;
+  char *big = static_cast<char *>(allocator.my_malloc(big_size));
+  if (!big) {
+    TEST_FAILED("Allocation failed");
+    return false;
+  }
+  std::memset(big, 0xAB, big_size);
+  allocator.my_free(big);
+
+  MemoryStats stats = allocator.getStats();
+  std::cout << "  Purges: " << stats.purge_count
+            << ", bytes purged: " << stats.purged_bytes << "\n";
+  if (stats.purge_count != 1 || stats.purged_bytes < big_size / 2 ||
+      !allocator.verifyStats()) {
+    TEST_FAILED("Free block was not purged");
+    return false;
+  }
+
+#if defined(__linux__)
+  // The purged pages must no longer be resident
+  const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  char *probe = reinterpret_cast<char *>(
+      (reinterpret_cast<uintptr_t>(big) + 64 * 1024) & ~(page - 1));
+  unsigned char residency = 1;
+  if (mincore(probe, page, &residency) != 0 || (residency & 1)) {
+    TEST_FAILED("Purged page is still resident");
+    return false;
+  }
+  std::cout << "  Probe page is no longer resident\n";
+#endif
+
+  printSectionHeader("Purged memory is reusable");
+  char *again = static_cast<char *>(allocator.my_malloc(big_size));
+  if (!again) {
+    TEST_FAILED("Reallocation after purge failed");
+    return false;
+  }
+  std::memset(again, 0x5A, big_size);
+  if (again[big_size - 1] != 0x5A) {
+    TEST_FAILED("Purged memory is not writable");
+    return false;
+  }
+  allocator.my_free(again);
+
+  printSectionHeader("trim() releases empty segments anywhere in the list");
+  AllocatorOptions growable;
+  growable.heap_size = 64 * 1024;
+  growable.growable = true;
+  growable.release_empty_segments = false;
+  MemoryAllocator heap(growable);
+
+  std::vector<void *> ptrs;
+  for (int i = 0; i < 6; i++) {
+    ptrs.push_back(heap.my_malloc(48 * 1024));
+  }
+  for (void *ptr : ptrs) {
+    heap.my_free(ptr);
+  }
+  size_t before = heap.getStats().segment_count;
+  size_t released = heap.trim();
+  stats = heap.getStats();
+  std::cout << "  Segments: " << before << " -> " << stats.segment_count
+            << ", released " << released << " bytes\n";
+  if (before < 2 || stats.segment_count != 1 || released == 0 ||
+      !heap.verifyStats()) {
+    TEST_FAILED("trim() left empty segments mapped");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 19: Huge-page backed heap
+ */
+bool testHugePages() {
+  printTestHeader("Huge-Page Backed Heap");
+
+  AllocatorOptions options;
+  options.heap_size = 3 * 1024 * 1024;
+  options.huge_pages = true;
+  options.growable = true;
+  options.large_threshold = 0;
+  MemoryAllocator allocator(options);
+
+  printSectionHeader("Heap is rounded up to whole 2 MB pages");
+  HugePageBacking backing = allocator.hugePageBacking();
+  MemoryStats stats = allocator.getStats();
+  std::cout << "  Huge pages obtained: " << hugePageBackingName(backing)
+            << ", heap " << stats.total_heap_size << " bytes\n";
+  if (stats.total_heap_size % OS_HUGE_PAGE_SIZE != 0) {
+    TEST_FAILED("Heap size is not a multiple of the huge page size");
+    return false;
+  }
+  if (backing != HugePageBacking::None &&
+      (reinterpret_cast<uintptr_t>(allocator.heapStart()) %
+           OS_HUGE_PAGE_SIZE != 0 ||
+       stats.huge_page_bytes != stats.total_heap_size)) {
+    TEST_FAILED("Huge-page heap is not 2 MB aligned");
+    return false;
+  }
+
+  printSectionHeader("Extra segments are huge pages too");
+  std::vector<void *> ptrs;
+  for (int i = 0; i < 6; i++) {
+    void *ptr = allocator.my_malloc(1024 * 1024);
+    if (!ptr) {
+      TEST_FAILED("Allocation failed");
+      return false;
+    }
+    std::memset(ptr, i, 1024 * 1024);
+    ptrs.push_back(ptr);
+  }
+  stats = allocator.getStats();
+  std::cout << "  Segments: " << stats.segment_count
+            << ", huge-page bytes: " << stats.huge_page_bytes << "\n";
+  if (stats.segment_count < 2 || stats.total_heap_size % OS_HUGE_PAGE_SIZE ||
+      !allocator.verifyStats()) {
+    TEST_FAILED("Extra segments are not whole huge pages");
+    return false;
+  }
+  for (void *ptr : ptrs) {
+    allocator.my_free(ptr);
+  }
+  if (allocator.getStats().segment_count != 1 || !allocator.verifyStats()) {
+    TEST_FAILED("Huge-page segments were not released");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 20: Large allocations with their own mappings
+ */
+bool testLargeAllocations() {
+  printTestHeader("Large-Allocation Path");
+
+  AllocatorOptions options;
+  options.heap_size = 256 * 1024;
+  options.large_threshold = 64 * 1024;
+  MemoryAllocator allocator(options);
+
+  printSectionHeader("Requests above the threshold bypass the heap");
+  char *large = static_cast<char *>(allocator.my_malloc(1024 * 1024));
+  if (!large || !allocator.isLargeAllocation(large) ||
+      !allocator.isValidPointer(large)) {
+    TEST_FAILED("Large request was not given its own mapping");
+    return false;
+  }
+  MemoryStats stats = allocator.getStats();
+  if (stats.used_memory != 0 || stats.large_count != 1 ||
+      stats.large_bytes < 1024 * 1024) {
+    TEST_FAILED("Large allocation touched the heap");
+    return false;
+  }
+  std::memset(large, 0x42, 1024 * 1024);
+  std::cout << "  1 MB served from a " << stats.large_bytes
+            << "-byte mapping; heap untouched\n";
+
+  printSectionHeader("Realloc grows the mapping without losing data");
+  large = static_cast<char *>(allocator.my_realloc(large, 8 * 1024 * 1024));
+  if (!large || !allocator.isLargeAllocation(large) || large[0] != 0x42 ||
+      large[1024 * 1024 - 1] != 0x42) {
+    TEST_FAILED("Large realloc lost data");
+    return false;
+  }
+  large[8 * 1024 * 1024 - 1] = 1;
+  clear_last_error();
+  if (allocator.my_realloc(large, SIZE_MAX - 64) ||
+      last_error() != AllocError::SizeOverflow || large[0] != 0x42) {
+    TEST_FAILED("Overflowing large realloc was not reported");
+    return false;
+  }
+
+  printSectionHeader("Shrinking below the threshold moves back into the heap");
+  char *small = static_cast<char *>(allocator.my_realloc(large, 1024));
+  if (!small || allocator.isLargeAllocation(small) || small[1023] != 0x42 ||
+      allocator.getStats().large_count != 0) {
+    TEST_FAILED("Shrunk allocation did not return to the heap");
+    return false;
+  }
+
+  printSectionHeader("Growing past the threshold leaves the heap");
+  std::memset(small, 0x17, 1024);
+  large = static_cast<char *>(allocator.my_realloc(small, 512 * 1024));
+  if (!large || !allocator.isLargeAllocation(large) || large[1023] != 0x17 ||
+      allocator.getStats().used_memory != 0) {
+    TEST_FAILED("Grown allocation stayed in the heap");
+    return false;
+  }
+
+  printSectionHeader("Many large allocations, freed out of order");
+  std::vector<void *> ptrs;
+  for (int i = 0; i < 300; i++) {
+    ptrs.push_back(allocator.my_malloc(128 * 1024 + i));
+  }
+  for (size_t i = 0; i < ptrs.size(); i += 2) {
+    allocator.my_free(ptrs[i]);
+  }
+  for (size_t i = 1; i < ptrs.size(); i += 2) {
+    allocator.my_free(ptrs[i]);
+  }
+  allocator.my_free(large);
+
+  stats = allocator.getStats();
+  if (stats.large_count != 0 || stats.large_bytes != 0 ||
+      stats.total_allocations != stats.total_frees ||
+      !allocator.verifyStats()) {
+    TEST_FAILED("Large allocations leaked");
+    return false;
+  }
+  std::cout << "  All " << stats.total_allocations
+            << " allocations returned\n";
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 21: In-place realloc in both directions
+ */
+bool testInPlaceRealloc() {
+  printTestHeader("In-Place Realloc (Shrink, Forward, Backward)");
+
+  MemoryAllocator allocator(8192);
+
+  printSectionHeader("Shrinking returns the tail to the free lists");
+  char *p = static_cast<char *>(allocator.my_malloc(1024));
+  char *guard = static_cast<char *>(allocator.my_malloc(64));
+  size_t free_before = allocator.getStats().free_memory;
+  if (allocator.my_realloc(p, 100) != p ||
+      allocator.getStats().free_memory <= free_before ||
+      !allocator.verifyStats()) {
+    TEST_FAILED("Shrunk tail was not split off");
+    return false;
+  }
+  std::cout << "  Free memory " << free_before << " -> "
+            << allocator.getStats().free_memory << " bytes\n";
+  allocator.my_free(p);
+  allocator.my_free(guard);
+
+  printSectionHeader("Growing forwards into a free next block");
+  p = static_cast<char *>(allocator.my_malloc(64));
+  char *q = static_cast<char *>(allocator.my_malloc(256));
+  guard = static_cast<char *>(allocator.my_malloc(64));
+  std::memset(p, 'F', 64);
+  allocator.my_free(q);
+  char *grown = static_cast<char *>(allocator.my_realloc(p, 200));
+  if (grown != p || grown[63] != 'F' || !allocator.verifyStats()) {
+    TEST_FAILED("Forward growth moved the data");
+    return false;
+  }
+  allocator.my_free(grown);
+  allocator.my_free(guard);
+
+  printSectionHeader("Growing backwards into a free previous block");
+  p = static_cast<char *>(allocator.my_malloc(256));
+  q = static_cast<char *>(allocator.my_malloc(64));
+  guard = static_cast<char *>(allocator.my_malloc(64));
+  for (int i = 0; i < 64; i++) {
+    q[i] = static_cast<char>(i);
+  }
+  allocator.my_free(p);
+  grown = static_cast<char *>(allocator.my_realloc(q, 200));
+  if (grown != p || !allocator.verifyStats()) {
+    TEST_FAILED("Backward growth did not reuse the previous block");
+    return false;
+  }
+  for (int i = 0; i < 64; i++) {
+    if (grown[i] != static_cast<char>(i)) {
+      TEST_FAILED("Data corrupted by memmove");
+      return false;
+    }
+  }
+  allocator.my_free(grown);
+  allocator.my_free(guard);
+
+  printSectionHeader("Growing into both neighbours at once");
+  p = static_cast<char *>(allocator.my_malloc(128));
+  q = static_cast<char *>(allocator.my_malloc(64));
+  char *r = static_cast<char *>(allocator.my_malloc(128));
+  guard = static_cast<char *>(allocator.my_malloc(64));
+  std::memset(q, 'B', 64);
+  allocator.my_free(p);
+  allocator.my_free(r);
+  grown = static_cast<char *>(allocator.my_realloc(q, 300));
+  if (grown != p || grown[0] != 'B' || grown[63] != 'B' ||
+      !allocator.verifyStats()) {
+    TEST_FAILED("Two-sided growth failed");
+    return false;
+  }
+
+  MemoryStats stats = allocator.getStats();
+  std::cout << "  In place: " << stats.realloc_in_place
+            << ", moved: " << stats.realloc_moved << "\n";
+  if (stats.realloc_in_place != 4 || stats.realloc_moved != 0) {
+    TEST_FAILED("Realloc counters are wrong");
+    return false;
+  }
+
+  printSectionHeader("No room on either side falls back to a copy");
+  char *moved = static_cast<char *>(allocator.my_realloc(grown, 2048));
+  if (!moved || moved == grown || moved[63] != 'B' ||
+      allocator.getStats().realloc_moved != 1) {
+    TEST_FAILED("Fallback realloc was not counted as a move");
+    return false;
+  }
+  allocator.my_free(moved);
+  allocator.my_free(guard);
+
+  if (!allocator.verifyStats() || allocator.getStats().used_memory != 0) {
+    TEST_FAILED("Heap not empty after freeing everything");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 22: Over-aligned allocation
+ */
+bool testAlignedAlloc() {
+  printTestHeader("Aligned Allocation (my_aligned_alloc / posix_memalign)");
+
+  MemoryAllocator allocator(64 * 1024);
+
+  printSectionHeader("The leading gap becomes a free block");
+  void *page_aligned = allocator.my_aligned_alloc(4096, 100);
+  MemoryStats stats = allocator.getStats();
+  if (!page_aligned || reinterpret_cast<uintptr_t>(page_aligned) % 4096 != 0 ||
+      stats.free_block_count != 2 || !allocator.verifyStats()) {
+    TEST_FAILED("Page-aligned allocation wasted its leading gap");
+    return false;
+  }
+  std::cout << "  4096-aligned block at offset "
+            << (static_cast<char *>(page_aligned) - allocator.heapStart())
+            << ", gap kept as a free block\n";
+  allocator.my_free(page_aligned);
+
+  printSectionHeader("Alignments from 16 to 4096 bytes");
+  std::vector<void *> ptrs;
+  for (size_t alignment = 16; alignment <= 4096; alignment *= 2) {
+    for (size_t size : {1, 24, 100, 1000}) {
+      void *ptr = allocator.my_aligned_alloc(alignment, size);
+      if (!ptr || reinterpret_cast<uintptr_t>(ptr) % alignment != 0) {
+        TEST_FAILED("Misaligned pointer for alignment " +
+                    std::to_string(alignment));
+        return false;
+      }
+      std::memset(ptr, 0xCD, size);
+      ptrs.push_back(ptr);
+    }
+  }
+  if (!allocator.verifyStats()) {
+    TEST_FAILED("Statistics diverged after aligned allocations");
+    return false;
+  }
+  for (void *ptr : ptrs) {
+    allocator.my_free(ptr);
+  }
+  stats = allocator.getStats();
+  if (stats.used_memory != 0 || stats.block_count != 1) {
+    TEST_FAILED("Aligned blocks did not coalesce back");
+    return false;
+  }
+
+  printSectionHeader("posix_memalign() argument checking");
+  void *ptr = nullptr;
+  if (allocator.my_posix_memalign(&ptr, 24, 64) != EINVAL ||
+      allocator.my_posix_memalign(&ptr, 4, 64) != EINVAL ||
+      allocator.my_posix_memalign(&ptr, 64, 64) != 0 ||
+      reinterpret_cast<uintptr_t>(ptr) % 64 != 0) {
+    TEST_FAILED("posix_memalign() semantics");
+    return false;
+  }
+  allocator.my_free(ptr);
+
+  printSectionHeader("Over-aligned large allocations");
+  char *large = static_cast<char *>(allocator.my_aligned_alloc(8192, 1 << 20));
+  if (!large || reinterpret_cast<uintptr_t>(large) % 8192 != 0 ||
+      !allocator.isLargeAllocation(large)) {
+    TEST_FAILED("Large aligned allocation");
+    return false;
+  }
+  large[0] = 'L';
+  large = static_cast<char *>(allocator.my_realloc(large, 4 << 20));
+  if (!large || large[0] != 'L') {
+    TEST_FAILED("Realloc of an aligned large allocation lost data");
+    return false;
+  }
+  allocator.my_free(large);
+
+  printSectionHeader("16-byte default alignment");
+  AllocatorOptions options;
+  options.heap_size = 64 * 1024;
+  options.alignment = 16;
+  options.growable = true;
+  MemoryAllocator simd(options);
+  ptrs.clear();
+  for (size_t size = 1; size < 2000; size += 37) {
+    void *p = simd.my_malloc(size);
+    if (!p || reinterpret_cast<uintptr_t>(p) % 16 != 0) {
+      TEST_FAILED("Pointer not 16-byte aligned");
+      return false;
+    }
+    ptrs.push_back(p);
+  }
+  for (size_t i = 0; i < ptrs.size(); i += 2) {
+    ptrs[i] = simd.my_realloc(ptrs[i], 3000);
+    if (reinterpret_cast<uintptr_t>(ptrs[i]) % 16 != 0) {
+      TEST_FAILED("Realloc broke 16-byte alignment");
+      return false;
+    }
+  }
+  for (void *p : ptrs) {
+    simd.my_free(p);
+  }
+  if (!simd.verifyStats()) {
+    TEST_FAILED("Statistics wrong on a 16-byte aligned heap");
+    return false;
+  }
+
+  bool rejected = false;
+  try {
+    options.alignment = 32;
+    MemoryAllocator invalid(options);
+  } catch (const std::invalid_argument &) {
+    rejected = true;
+  }
+  if (!rejected) {
+    TEST_FAILED("Unsupported default alignment accepted");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 23: Batch allocation and free
+ */
+bool testBatchAlloc() {
+  printTestHeader("Batch Allocation and Free");
+
+  MemoryAllocator allocator(64 * 1024);
+  const size_t kObjects = 32;
+  void *ptrs[kObjects];
+
+  printSectionHeader("One block carved into a run of objects");
+  size_t got = allocator.my_malloc_batch(48, kObjects, ptrs);
+  MemoryStats stats = allocator.getStats();
+  if (got != kObjects || stats.total_allocations != kObjects ||
+      stats.block_count != kObjects + 1 || !allocator.verifyStats()) {
+    TEST_FAILED("Batch allocation returned the wrong blocks");
+    return false;
+  }
+  for (size_t i = 1; i < kObjects; i++) {
+    if (static_cast<char *>(ptrs[i]) - static_cast<char *>(ptrs[i - 1]) !=
+        static_cast<ptrdiff_t>(48 + sizeof(MemoryBlock))) {
+      TEST_FAILED("Batch objects are not physically adjacent");
+      return false;
+    }
+  }
+  for (size_t i = 0; i < kObjects; i++) {
+    std::memset(ptrs[i], static_cast<int>(i), 48);
+  }
+  std::cout << "  " << got << " blocks of 48 bytes carved from one free block\n";
+
+  printSectionHeader("Freeing the run in any order merges it in one sweep");
+  std::reverse(ptrs, ptrs + kObjects);
+  std::swap(ptrs[3], ptrs[17]);
+  allocator.my_free_batch(ptrs, kObjects);
+  stats = allocator.getStats();
+  if (stats.used_memory != 0 || stats.block_count != 1 ||
+      stats.total_frees != kObjects || !allocator.verifyStats()) {
+    TEST_FAILED("Batch free did not coalesce the run");
+    return false;
+  }
+
+  printSectionHeader("Interleaved batches free as separate runs");
+  void *first[8];
+  void *keep = nullptr;
+  allocator.my_malloc_batch(64, 8, first);
+  keep = allocator.my_malloc(64);
+  void *second[8];
+  allocator.my_malloc_batch(64, 8, second);
+  void *mixed[16];
+  for (size_t i = 0; i < 8; i++) {
+    mixed[2 * i] = second[i];
+    mixed[2 * i + 1] = first[i];
+  }
+  allocator.my_free_batch(mixed, 16);
+  stats = allocator.getStats();
+  if (stats.block_count != 3 || stats.free_block_count != 2 ||
+      !allocator.verifyStats()) {
+    TEST_FAILED("Runs around a live block merged incorrectly");
+    return false;
+  }
+  allocator.my_free(keep);
+
+  printSectionHeader("Duplicates, nullptrs and foreign pointers");
+  void *pair[2];
+  allocator.my_malloc_batch(32, 2, pair);
+  int local = 0;
+  void *messy[5] = {pair[0], nullptr, pair[1], pair[0], &local};
+  allocator.my_free_batch(messy, 5);
+  stats = allocator.getStats();
+  if (stats.used_memory != 0 || stats.block_count != 1 ||
+      !allocator.verifyStats()) {
+    TEST_FAILED("Bad entries corrupted the heap");
+    return false;
+  }
+
+  // A duplicate inside a run is reported at its own entry
+  static const void *s_reported = nullptr;
+  allocator.my_malloc_batch(32, 2, pair);
+  void *repeated[3] = {pair[1], pair[0], pair[1]};
+  ErrorHandler previous =
+      on_error([](const ErrorInfo &info) { s_reported = info.ptr; });
+  allocator.my_free_batch(repeated, 3);
+  on_error(previous);
+  if (s_reported != std::max(pair[0], pair[1]) ||
+      allocator.getStats().used_memory != 0) {
+    TEST_FAILED("Duplicate was reported at the wrong pointer");
+    return false;
+  }
+
+  printSectionHeader("A full heap hands out what it can");
+  MemoryAllocator small(4096);
+  void *many[256];
+  got = small.my_malloc_batch(100, 256, many);
+  if (got == 0 || got == 256 || !small.verifyStats()) {
+    TEST_FAILED("Partial batch on a full heap");
+    return false;
+  }
+  small.my_free_batch(many, got);
+  if (small.getStats().used_memory != 0 || !small.verifyStats()) {
+    TEST_FAILED("Partial batch did not free cleanly");
+    return false;
+  }
+  std::cout << "  " << got << " of 256 blocks fit in a 4 KB heap\n";
+
+  printSectionHeader("Growable heaps map a segment sized for the batch");
+  AllocatorOptions options;
+  options.heap_size = 4096;
+  options.growable = true;
+  MemoryAllocator growable(options);
+  got = growable.my_malloc_batch(256, 200, many);
+  stats = growable.getStats();
+  if (got != 200 || stats.segment_count != 2 || !growable.verifyStats()) {
+    TEST_FAILED("Growable batch allocation");
+    return false;
+  }
+  growable.my_free_batch(many, got);
+  stats = growable.getStats();
+  if (stats.used_memory != 0 || stats.segment_count != 1 ||
+      !growable.verifyStats()) {
+    TEST_FAILED("Batch free did not release the extra segment");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 24: Sized deallocation
+ */
+bool testSizedFree() {
+  printTestHeader("Sized Deallocation (my_free_sized / custom_free_sized)");
+
+  MemoryAllocator allocator(64 * 1024);
+
+  printSectionHeader("Heap blocks and large mappings");
+  void *small = allocator.my_malloc(100);
+  void *large = allocator.my_malloc(1 << 20);
+  allocator.my_free_sized(small, 100);
+  allocator.my_free_sized(large, 1 << 20);
+  MemoryStats stats = allocator.getStats();
+  if (stats.used_memory != 0 || stats.large_count != 0 ||
+      !allocator.verifyStats()) {
+    TEST_FAILED("Sized free did not release both kinds of block");
+    return false;
+  }
+
+#ifdef DEBUG_MODE
+  printSectionHeader("Debug builds reject a mismatched size");
+  void *block = allocator.my_malloc(64);
+  allocator.my_free_sized(block, 1000);
+  if (allocator.getStats().used_memory == 0) {
+    TEST_FAILED("Mismatched size was accepted");
+    return false;
+  }
+  allocator.my_free_sized(block, 64);
+  if (allocator.getStats().used_memory != 0) {
+    TEST_FAILED("Matching size was rejected");
+    return false;
+  }
+#endif
+
+  printSectionHeader("Thread cache bins picked from the size alone");
+  initGlobalArenas(1, 256 * 1024);
+  std::vector<std::pair<void *, size_t>> blocks;
+  for (size_t size = 1; size <= 600; size += 13) {
+    blocks.push_back({custom_malloc(size), size});
+  }
+  for (size_t size = 1; size <= 512; size += 31) {
+    void *p = custom_realloc(custom_malloc(600), size);
+    blocks.push_back({p, size});
+    blocks.push_back({custom_aligned_alloc(64, size), size});
+  }
+  for (auto &entry : blocks) {
+    std::memset(entry.first, 0x5A, entry.second);
+    custom_free_sized(entry.first, entry.second);
+  }
+
+  // Blocks coming back out of the bins must still hold their requests
+  bool holds = true;
+  for (auto &entry : blocks) {
+    entry.first = custom_malloc(entry.second);
+    if (!entry.first ||
+        MemoryBlock::fromData(entry.first)->size() < entry.second) {
+      holds = false;
+    }
+  }
+  for (auto &entry : blocks) {
+    custom_free_sized(entry.first, entry.second);
+  }
+  flushThreadCache();
+
+  stats = g_arenas->getStats();
+  bool consistent = g_arenas->arena(0).verifyStats() &&
+                    stats.used_memory == 0 && stats.block_count == 1;
+  destroyGlobalAllocator();
+
+  if (!holds) {
+    TEST_FAILED("A sized free put a block in a bin it cannot serve");
+    return false;
+  }
+  if (!consistent) {
+    TEST_FAILED("Sized frees left blocks behind");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+namespace {
+
+/// Check custom_malloc, custom_calloc and custom_realloc results for the
+/// 16-byte alignment malloc() promises, over small, heap and large sizes
+bool globalResultsAligned() {
+  std::vector<void *> blocks;
+  bool aligned = true;
+  auto check = [&](void *ptr) {
+    aligned = aligned && ptr && reinterpret_cast<uintptr_t>(ptr) % 16 == 0;
+    blocks.push_back(ptr);
+  };
+  for (size_t size = 1; size <= 1500; size += 7) {
+    check(custom_malloc(size));
+    check(custom_calloc(1, size));
+  }
+  check(custom_malloc(300 * 1024));
+  check(custom_calloc(3, 100 * 1024));
+  for (void *&ptr : blocks) {
+    ptr = custom_realloc(ptr, 24 + (reinterpret_cast<uintptr_t>(ptr) >> 4) % 900);
+    aligned = aligned && ptr && reinterpret_cast<uintptr_t>(ptr) % 16 == 0;
+  }
+  for (void *ptr : blocks) {
+    custom_free(ptr);
+  }
+  flushThreadCache();
+  return aligned;
+}
+
+} // namespace
+
+/**
+ * Test 25: Preload library support
+ */
+bool testInterposeSupport() {
+  printTestHeader("Preload Library Support (usable size, fork locks)");
+
+  initGlobalArenas(2, 256 * 1024);
+
+  printSectionHeader("malloc_usable_size() for every kind of block");
+  void *cached = custom_malloc(100);
+  void *heap = custom_malloc(4000);
+  void *large = custom_malloc(1 << 20);
+  int local = 0;
+  std::cout << "  100 B -> " << custom_usable_size(cached) << ", 4000 B -> "
+            << custom_usable_size(heap) << ", 1 MB -> "
+            << custom_usable_size(large) << "\n";
+  if (custom_usable_size(cached) != 112 || custom_usable_size(heap) < 4000 ||
+      custom_usable_size(large) < (1 << 20) ||
+      custom_usable_size(&local) != 0 || custom_usable_size(nullptr) != 0) {
+    TEST_FAILED("Usable sizes are wrong");
+    return false;
+  }
+  std::memset(heap, 0x11, custom_usable_size(heap));
+
+  printSectionHeader("Every result meets alignof(max_align_t)");
+  if (!globalResultsAligned()) {
+    TEST_FAILED("A global allocation is not 16-byte aligned");
+    return false;
+  }
+
+  printSectionHeader("fork() handlers hold every lock");
+  std::atomic<bool> allocated{false};
+  lockGlobalAllocator();
+  std::thread blocked([&]() {
+    void *p = custom_malloc(10000);
+    allocated = true;
+    custom_free(p);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  bool waited = !allocated;
+  unlockGlobalAllocator();
+  blocked.join();
+  if (!waited || !allocated) {
+    TEST_FAILED("Allocation did not wait for the global locks");
+    return false;
+  }
+
+  custom_free(cached);
+  custom_free(heap);
+  custom_free(large);
+  flushThreadCache();
+  MemoryStats stats = g_arenas->getStats();
+  destroyGlobalAllocator();
+  if (stats.used_memory != 0 || stats.large_count != 0) {
+    TEST_FAILED("Blocks leaked");
+    return false;
+  }
+
+  // The arenas created on first use, as in the preloaded library
+  bool lazy_aligned = globalResultsAligned();
+  destroyGlobalAllocator();
+  if (!lazy_aligned) {
+    TEST_FAILED("Default global arenas are not 16-byte aligned");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 26: Monotonic arena
+ */
+bool testMonotonicArena() {
+  printTestHeader("Monotonic Arena (bump allocation, bulk release)");
+
+  MemoryAllocator parent(512 * 1024);
+
+  printSectionHeader("Allocations are consecutive pointer bumps");
+  MonotonicArena arena(parent, 4096);
+  char *first = static_cast<char *>(arena.allocate(24));
+  char *second = static_cast<char *>(arena.allocate(40));
+  char *third = static_cast<char *>(arena.allocate(8));
+  if (!first || second != first + 24 || third != second + 40 ||
+      parent.getStats().total_allocations != 1) {
+    TEST_FAILED("Arena allocations are not bumped from one chunk");
+    return false;
+  }
+
+  printSectionHeader("Alignment and typed construction");
+  arena.allocate(3, 1);
+  void *line = arena.allocate(64, 64);
+  double *value = arena.create<double>(2.5);
+  if (reinterpret_cast<uintptr_t>(line) % 64 != 0 ||
+      reinterpret_cast<uintptr_t>(value) % alignof(double) != 0 ||
+      *value != 2.5 || arena.allocate(16, 24) != nullptr) {
+    TEST_FAILED("Arena alignment handling");
+    return false;
+  }
+
+  printSectionHeader("Chunks chain when one fills up");
+  for (int i = 0; i < 1000; i++) {
+    char *p = static_cast<char *>(arena.allocate(100));
+    if (!p || !arena.owns(p)) {
+      TEST_FAILED("Arena failed to chain a new chunk");
+      return false;
+    }
+    std::memset(p, i & 0xFF, 100);
+  }
+  size_t chunks = arena.getStats().chunk_count;
+  std::cout << "  1000 x 100 B over " << chunks << " chunks of 4 KB\n";
+
+  printSectionHeader("Oversized requests keep the current chunk");
+  char *before = static_cast<char *>(arena.allocate(8));
+  void *big = arena.allocate(64 * 1024);
+  char *after = static_cast<char *>(arena.allocate(8));
+  ArenaStats stats = arena.getStats();
+  if (!big || after != before + 8 || stats.chunk_count != chunks + 1) {
+    TEST_FAILED("Oversized request wasted the current chunk");
+    return false;
+  }
+  arena.printStats();
+
+  printSectionHeader("release() returns every chunk");
+  arena.release();
+  MemoryStats parent_stats = parent.getStats();
+  if (parent_stats.used_memory != 0 || parent_stats.block_count != 1 ||
+      !parent.verifyStats() || arena.getStats().chunk_count != 0 ||
+      arena.owns(first)) {
+    TEST_FAILED("release() left chunks behind");
+    return false;
+  }
+  if (!arena.allocate(32) || arena.getStats().release_count != 1) {
+    TEST_FAILED("Arena unusable after release()");
+    return false;
+  }
+
+  printSectionHeader("reset() wipes a whole heap at once");
+  AllocatorOptions options;
+  options.heap_size = 64 * 1024;
+  options.growable = true;
+  MemoryAllocator scratch(options);
+  for (int i = 0; i < 2000; i++) {
+    scratch.my_malloc(64 + i % 200);
+  }
+  scratch.my_malloc(1 << 20);
+  scratch.reset();
+  MemoryStats scratch_stats = scratch.getStats();
+  if (scratch_stats.used_memory != 0 || scratch_stats.block_count != 1 ||
+      scratch_stats.segment_count != 1 || scratch_stats.large_count != 0 ||
+      !scratch.verifyStats()) {
+    TEST_FAILED("reset() did not wipe the heap");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 27: STL adapters
+ */
+bool testStlAdapters() {
+  printTestHeader("STL Adapters (pmr Resource / StlAllocator)");
+
+  MemoryAllocator heap(1024 * 1024);
+  Resource heap_resource(heap);
+
+  printSectionHeader("std::vector and std::unordered_map on one heap");
+  {
+    std::vector<int, StlAllocator<int>> numbers{StlAllocator<int>(heap_resource)};
+    for (int i = 0; i < 10000; i++) {
+      numbers.push_back(i);
+    }
+    using Entry = std::pair<const int, int>;
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                       StlAllocator<Entry>>
+        table(16, std::hash<int>(), std::equal_to<int>(),
+              StlAllocator<Entry>(heap_resource));
+    for (int i = 0; i < 1000; i++) {
+      table[i] = numbers[static_cast<size_t>(i)] * 2;
+    }
+    if (table[999] != 1998 || heap.getStats().used_memory == 0) {
+      TEST_FAILED("Containers did not allocate from the heap");
+      return false;
+    }
+    std::cout << "  Heap holds " << heap.getStats().used_memory
+              << " bytes for the vector and map\n";
+  }
+  if (heap.getStats().used_memory != 0 || !heap.verifyStats()) {
+    TEST_FAILED("Containers leaked heap memory");
+    return false;
+  }
+
+  printSectionHeader("Over-aligned element types");
+  struct alignas(64) CacheLine {
+    char bytes[64];
+  };
+  {
+    std::vector<CacheLine, StlAllocator<CacheLine>> lines{
+        StlAllocator<CacheLine>(heap_resource)};
+    for (int i = 0; i < 100; i++) {
+      lines.emplace_back();
+      if (reinterpret_cast<uintptr_t>(lines.data()) % 64 != 0) {
+        TEST_FAILED("Over-aligned elements were misaligned");
+        return false;
+      }
+    }
+  }
+  if (heap.getStats().used_memory != 0) {
+    TEST_FAILED("Aligned storage leaked");
+    return false;
+  }
+
+  printSectionHeader("std::pmr containers on an arena and a pool");
+  MonotonicArena scratch(heap, 16 * 1024);
+  Resource arena_resource(scratch);
+  {
+    std::pmr::vector<std::pmr::string> words(&arena_resource);
+    for (int i = 0; i < 500; i++) {
+      words.emplace_back(std::string(40, static_cast<char>('a' + i % 26)));
+    }
+    if (words[27][0] != 'b' || scratch.getStats().total_allocations == 0) {
+      TEST_FAILED("pmr containers did not use the arena");
+      return false;
+    }
+  }
+  scratch.release();
+
+  FixedPool nodes(heap, 64, 256);
+  Resource pool_resource(nodes);
+  {
+    std::pmr::list<int> list(&pool_resource);
+    for (int i = 0; i < 200; i++) {
+      list.push_back(i);
+    }
+    if (nodes.getStats().in_use != 200) {
+      TEST_FAILED("List nodes did not come from the pool");
+      return false;
+    }
+    bool rejected = false;
+    try {
+      void *oversized = pool_resource.allocate(128);
+      pool_resource.deallocate(oversized, 128);
+    } catch (const std::bad_alloc &) {
+      rejected = true;
+    }
+    if (!rejected) {
+      TEST_FAILED("Pool resource served an oversized request");
+      return false;
+    }
+  }
+
+  // Slots carry the parent heap's alignment, not the default 8
+  {
+    AllocatorOptions aligned_options;
+    aligned_options.alignment = 16;
+    MemoryAllocator aligned_heap(aligned_options);
+    FixedPool aligned_nodes(aligned_heap, 32, 4);
+    Resource aligned_resource(aligned_nodes);
+    void *slot = nullptr;
+    try {
+      slot = aligned_resource.allocate(32, 16);
+    } catch (const std::bad_alloc &) {
+    }
+    bool over_aligned = false;
+    try {
+      aligned_resource.deallocate(aligned_resource.allocate(32, 32), 32, 32);
+    } catch (const std::bad_alloc &) {
+      over_aligned = true;
+    }
+    if (!slot || reinterpret_cast<uintptr_t>(slot) % 16 != 0 ||
+        !over_aligned) {
+      TEST_FAILED("Pool resource ignored the slots' 16-byte alignment");
+      return false;
+    }
+    aligned_resource.deallocate(slot, 32, 16);
+  }
+
+  printSectionHeader("Allocator equality follows the backend");
+  Resource same_heap(heap);
+  StlAllocator<int> a(heap_resource);
+  StlAllocator<double> b(same_heap);
+  StlAllocator<int> c(arena_resource);
+  if (a != b || a == c || !heap_resource.is_equal(same_heap)) {
+    TEST_FAILED("Allocator equality");
+    return false;
+  }
+
+  printSectionHeader("The global resource uses the thread caches");
+  initGlobalAllocator(256 * 1024);
+  {
+    std::vector<long, StlAllocator<long>> global_numbers;
+    for (long i = 0; i < 1000; i++) {
+      global_numbers.push_back(i);
+    }
+    std::pmr::vector<int> pmr_numbers(&globalResource());
+    pmr_numbers.assign(100, 7);
+  }
+
+  // alignof(max_align_t) is what the global arenas give every block, so
+  // such requests still come from the thread cache
+  void *cached = custom_malloc(48);
+  custom_free(cached);
+  void *aligned = globalResource().allocate(48, alignof(std::max_align_t));
+  bool from_cache = aligned == cached;
+  globalResource().deallocate(aligned, 48, alignof(std::max_align_t));
+  flushThreadCache();
+  bool clean = g_arenas->getStats().used_memory == 0;
+  destroyGlobalAllocator();
+  if (!from_cache) {
+    TEST_FAILED("A 16-aligned request bypassed the thread cache");
+    return false;
+  }
+  if (!clean) {
+    TEST_FAILED("Global resource leaked");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+namespace {
+
+/// Errors seen by the recording hook in testErrorReporting
+std::vector<ErrorInfo> g_recorded_errors;
+
+void recordError(const ErrorInfo &info) { g_recorded_errors.push_back(info); }
+
+} // namespace
+
+/**
+ * Test 28: Error codes and the on_error hook
+ */
+bool testErrorReporting() {
+  printTestHeader("Error Codes and the on_error Hook");
+
+  ErrorHandler previous = on_error(recordError);
+  g_recorded_errors.clear();
+  clear_last_error();
+
+  MemoryAllocator allocator(4096);
+  int local = 0;
+
+  printSectionHeader("Each failure sets last_error()");
+  struct Case {
+    const char *name;
+    AllocError expected;
+    std::function<void()> run;
+  };
+  void *block = allocator.my_malloc(64);
+  allocator.my_free(block);
+  std::vector<Case> cases = {
+      {"Out of memory", AllocError::OutOfMemory,
+       [&]() { allocator.my_malloc(8000); }},
+      {"Invalid pointer", AllocError::InvalidPointer,
+       [&]() { allocator.my_free(&local); }},
+      {"Double free", AllocError::DoubleFree,
+       [&]() { allocator.my_free(block); }},
+      {"Size overflow", AllocError::SizeOverflow,
+       [&]() { allocator.my_calloc(SIZE_MAX / 2, 4); }},
+      {"Invalid alignment", AllocError::InvalidAlignment,
+       [&]() { allocator.my_aligned_alloc(24, 64); }},
+  };
+  for (const Case &test_case : cases) {
+    clear_last_error();
+    test_case.run();
+    std::cout << "  " << std::left << std::setw(18) << test_case.name
+              << std::right << " -> " << errorName(last_error()) << "\n";
+    if (last_error() != test_case.expected) {
+      TEST_FAILED(std::string("Wrong error code for ") + test_case.name);
+      on_error(previous);
+      return false;
+    }
+  }
+
+  printSectionHeader("The hook sees every error with its details");
+  bool details = g_recorded_errors.size() == cases.size() &&
+                 g_recorded_errors[0].size == 8000 &&
+                 std::string(g_recorded_errors[1].function) == "my_free" &&
+                 g_recorded_errors[1].ptr == &local &&
+                 g_recorded_errors[2].ptr == block;
+  if (!details) {
+    TEST_FAILED("Hook received wrong error details");
+    on_error(previous);
+    return false;
+  }
+
+  printSectionHeader("Success leaves the last error in place");
+  void *ok = allocator.my_malloc(32);
+  if (!ok || last_error() != AllocError::InvalidAlignment) {
+    TEST_FAILED("A successful call changed last_error()");
+    on_error(previous);
+    return false;
+  }
+  allocator.my_free(ok);
+
+  printSectionHeader("Silent by default: no hook, just the code");
+  on_error(nullptr);
+  g_recorded_errors.clear();
+  allocator.my_free(&local);
+  bool silent =
+      g_recorded_errors.empty() && last_error() == AllocError::InvalidPointer;
+
+  // Error codes are per thread
+  AllocError other_thread = AllocError::OutOfMemory;
+  std::thread([&]() { other_thread = last_error(); }).join();
+
+  on_error(previous);
+  clear_last_error();
+  if (!silent || other_thread != AllocError::None) {
+    TEST_FAILED("Errors leaked past a removed hook or across threads");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 29: Lazy-Zeroing Calloc
+ */
+bool testLazyZeroCalloc() {
+  printTestHeader("Lazy-Zeroing Calloc");
+
+  auto allZero = [](const void *ptr, size_t size) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(ptr);
+    return std::all_of(bytes, bytes + size,
+                       [](unsigned char b) { return b == 0; });
+  };
+
+  printSectionHeader("Fresh heap memory needs no memset");
+  MemoryAllocator allocator(64 * 1024);
+  void *first[4];
+  for (void *&ptr : first) {
+    ptr = allocator.my_calloc(25, sizeof(int));
+    if (!ptr || !allZero(ptr, 25 * sizeof(int))) {
+      TEST_FAILED("Calloc from a fresh heap is not zero");
+      return false;
+    }
+    std::memset(ptr, 0xAB, 25 * sizeof(int));
+  }
+  MemoryStats stats = allocator.getStats();
+  std::cout << "  Zero hits after 4 callocs: " << stats.calloc_zero_hits
+            << "\n";
+  if (stats.calloc_zero_hits != 4 || !allocator.verifyStats()) {
+    TEST_FAILED("Carving the fresh block lost its zero state");
+    return false;
+  }
+
+  printSectionHeader("Recycled blocks are cleared");
+  allocator.my_free(first[1]);
+  void *reused = allocator.my_calloc(25, sizeof(int));
+  if (reused != first[1] || !allZero(reused, 25 * sizeof(int)) ||
+      allocator.getStats().calloc_zero_hits != 4) {
+    TEST_FAILED("Recycled block was not cleared");
+    return false;
+  }
+
+  // A dirty block merged with the zero tail dirties the merge
+  allocator.my_free(first[3]);
+  void *merged = allocator.my_calloc(1, 4096);
+  if (!merged || !allZero(merged, 4096) ||
+      allocator.getStats().calloc_zero_hits != 4 || !allocator.verifyStats()) {
+    TEST_FAILED("Merged dirty block was trusted as zero");
+    return false;
+  }
+  allocator.my_free(merged);
+  allocator.my_free(reused);
+  allocator.my_free(first[0]);
+  allocator.my_free(first[2]);
+
+  printSectionHeader("Large callocs use fresh mappings");
+  AllocatorOptions large_options;
+  large_options.heap_size = 64 * 1024;
+  MemoryAllocator large_heap(large_options);
+  const size_t large_size = 1024 * 1024;
+  void *large = large_heap.my_calloc(1, large_size);
+  if (!large || !allZero(large, large_size) ||
+      large_heap.getStats().calloc_zero_hits != 1) {
+    TEST_FAILED("Large calloc was not served from a fresh mapping");
+    return false;
+  }
+  large_heap.my_free(large);
+
+  printSectionHeader("Dirty 2 MB block is cleared with streaming stores");
+  AllocatorOptions options;
+  options.heap_size = 8 * 1024 * 1024;
+  options.large_threshold = 0; // Keep the big blocks in the heap
+  MemoryAllocator heap(options);
+  const size_t big_size = 2 * 1024 * 1024;
+  char *big = static_cast<char *>(heap.my_malloc(big_size));
+  if (!big) {
+    TEST_FAILED("Allocation failed");
+    return false;
+  }
+  std::memset(big, 0xCD, big_size);
+  heap.my_free(big);
+
+  char *cleared = static_cast<char *>(heap.my_calloc(1, big_size - 3));
+  if (cleared != big || !allZero(cleared, big_size - 3) ||
+      heap.getStats().calloc_zero_hits != 0) {
+    TEST_FAILED("Dirty block was not fully cleared");
+    return false;
+  }
+  std::memset(cleared, 0xEF, big_size);
+  heap.my_free(cleared);
+
+#if defined(__linux__)
+  printSectionHeader("Eagerly purged blocks become known-zero");
+  heap.trim();
+  char *purged = static_cast<char *>(heap.my_calloc(1, big_size));
+  std::cout << "  Zero hits after trim(): " << heap.getStats().calloc_zero_hits
+            << "\n";
+  if (purged != big || !allZero(purged, big_size) ||
+      heap.getStats().calloc_zero_hits != 1 || !heap.verifyStats()) {
+    TEST_FAILED("Purged block was not reused as known-zero");
+    return false;
+  }
+  heap.my_free(purged);
+#endif
+
+  printSectionHeader("reset() memory is no longer known-zero");
+  char *dirty = static_cast<char *>(heap.my_malloc(4096));
+  std::memset(dirty, 0x77, 4096);
+  heap.reset();
+  char *after_reset = static_cast<char *>(heap.my_calloc(1, 4096));
+  if (!after_reset || !allZero(after_reset, 4096) ||
+      heap.getStats().calloc_zero_hits != 0) {
+    TEST_FAILED("Calloc after reset() returned stale data");
+    return false;
+  }
+  heap.my_free(after_reset);
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 30: Allocation Profiler
+ */
+bool testProfiler() {
+  printTestHeader("Allocation Profiler");
+
+  resetProfile();
+  ProfileOptions options;
+  options.sample_interval = 0;
+  if (!startProfiling(options)) {
+    std::cout << "  Profiler compiled out (ALLOCATOR_PROFILING=OFF)\n";
+    TEST_PASSED();
+    return true;
+  }
+
+  auto histogramTotal = [](const uint64_t *buckets) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < PROFILE_LATENCY_BUCKETS; i++) {
+      total += buckets[i];
+    }
+    return total;
+  };
+
+  printSectionHeader("Size classes, latency and live bytes");
+  MemoryAllocator allocator(256 * 1024);
+  void *small[8];
+  for (void *&ptr : small) {
+    ptr = allocator.my_malloc(40);
+  }
+  void *big = allocator.my_malloc(5000);
+
+  ProfileSnapshot profile = profileSnapshot();
+  if (profile.alloc_count[5] != 8 || profile.alloc_count[12] != 1 ||
+      profile.live_bytes != 8 * 40 + 5000 ||
+      histogramTotal(profile.alloc_cycles) != 9) {
+    TEST_FAILED("Allocations were not counted per size class");
+    return false;
+  }
+
+  for (void *ptr : small) {
+    allocator.my_free(ptr);
+  }
+  allocator.my_free(big);
+  allocator.my_free(big); // A double free is not a free
+  profile = profileSnapshot();
+  std::cout << "  Live: " << profile.live_bytes
+            << " bytes, peak: " << profile.peak_live_bytes << " bytes\n";
+  if (profile.free_count[5] != 8 || profile.free_count[12] != 1 ||
+      profile.live_bytes != 0 || profile.peak_live_bytes != 8 * 40 + 5000 ||
+      histogramTotal(profile.free_cycles) != 9) {
+    TEST_FAILED("Frees or the high-water mark are wrong");
+    return false;
+  }
+
+  void *grown = allocator.my_realloc(allocator.my_calloc(4, 8), 200);
+  profile = profileSnapshot();
+  if (!grown || profile.totalAllocations() != 11 ||
+      profile.totalFrees() != 10 || profile.live_bytes != 200) {
+    TEST_FAILED("calloc/realloc were not accounted");
+    return false;
+  }
+  allocator.my_free(grown);
+
+  printSectionHeader("Nested calls are counted once");
+  uint64_t before = profileSnapshot().totalAllocations();
+  void *cached = custom_malloc(100);
+  void *uncached = custom_malloc(4000);
+  custom_free(cached);
+  custom_free(uncached);
+  profile = profileSnapshot();
+  if (profile.totalAllocations() != before + 2 ||
+      profile.totalFrees() != 13 || profile.live_bytes != 0) {
+    TEST_FAILED("Global calls were counted at more than one layer");
+    return false;
+  }
+
+  printSectionHeader("Batches count every block, cache flushes none");
+  // Class 5 so far: the eight 40-byte blocks and the 32-byte calloc
+  void *batch[6];
+  size_t carved = allocator.my_malloc_batch(40, 5, batch);
+  profile = profileSnapshot();
+  if (carved != 5 || profile.alloc_count[5] != 8 + 1 + 5 ||
+      profile.live_bytes != 5 * 40) {
+    TEST_FAILED("Batch allocations were not counted per block");
+    return false;
+  }
+  batch[5] = batch[2]; // A pointer listed twice is freed once
+  allocator.my_free_batch(batch, 6);
+  for (int i = 0; i < 4; i++) {
+    custom_free(custom_malloc(100));
+  }
+  uint64_t frees = profileSnapshot().totalFrees();
+  flushThreadCache();
+  profile = profileSnapshot();
+  if (profile.free_count[5] != 8 + 1 + 5 || profile.live_bytes != 0 ||
+      frees != 13 + 5 + 4 || profile.totalFrees() != frees) {
+    TEST_FAILED("Batch frees or the cache flush were miscounted");
+    return false;
+  }
+
+  printSectionHeader("Sampled stacks in pprof format");
+  stopProfiling();
+  resetProfile();
+  options.sample_interval = 1; // Every allocation
+  startProfiling(options);
+
+  void *sampled[10];
+  for (void *&ptr : sampled) {
+    ptr = allocator.my_malloc(64);
+  }
+  for (size_t i = 0; i < 4; i++) {
+    allocator.my_free(sampled[i]);
+  }
+
+  HeapSample samples[16];
+  size_t live = heapSamples(samples, 16);
+  std::ostringstream heap_profile;
+  writeHeapProfile(heap_profile);
+  std::string text = heap_profile.str();
+  std::cout << "  Live samples: " << live << ", first line: "
+            << text.substr(0, text.find('\n')) << "\n";
+  if (live != 6 || profileSnapshot().live_samples != 6 ||
+      text.rfind("heap profile: 6: 384 [6: 384] @ heap_v2/1\n", 0) != 0 ||
+      text.find("MAPPED_LIBRARIES:") == std::string::npos) {
+    TEST_FAILED("Samples or the heap profile are wrong");
+    return false;
+  }
+#if defined(__GLIBC__)
+  if (samples[0].depth == 0) {
+    TEST_FAILED("Samples carry no call stack");
+    return false;
+  }
+#endif
+
+  for (size_t i = 4; i < 10; i++) {
+    allocator.my_free(sampled[i]);
+  }
+  profile = profileSnapshot();
+  printProfile(profile);
+  if (profile.live_samples != 0) {
+    TEST_FAILED("Freed allocations are still sampled");
+    return false;
+  }
+
+  printSectionHeader("Stopped profiler records nothing");
+  stopProfiling();
+  allocator.my_free(allocator.my_malloc(64));
+  if (profileSnapshot().totalAllocations() != profile.totalAllocations()) {
+    TEST_FAILED("Allocation counted while profiling was off");
+    return false;
+  }
+  resetProfile();
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 31: Machine-Readable Statistics and Heap Map
+ */
+bool testStatsExport() {
+  printTestHeader("Stats Export and Binary Heap Map");
+
+  printSectionHeader("External fragmentation from the largest free block");
+  MemoryAllocator allocator(64 * 1024);
+  if (allocator.getStats().getFragmentationRatio() != 0.0) {
+    TEST_FAILED("A fresh heap reports fragmentation");
+    return false;
+  }
+
+  void *blocks[4];
+  for (void *&ptr : blocks) {
+    ptr = allocator.my_malloc(1000);
+  }
+  allocator.my_free(blocks[0]);
+  allocator.my_free(blocks[2]);
+  void *large = allocator.my_malloc(300 * 1024);
+
+  MemoryStats stats = allocator.getStats();
+  std::vector<HeapMapEntry> map(allocator.heapMap(nullptr, 0));
+  if (allocator.heapMap(map.data(), map.size()) != map.size() ||
+      map.empty() || map[0].kind != HeapMapKind::Segment) {
+    TEST_FAILED("Heap map does not start with its segment");
+    return false;
+  }
+
+  size_t used = 0, free_bytes = 0, largest = 0, large_count = 0;
+  uint64_t last_offset = 0;
+  for (size_t i = 1; i < map.size(); i++) {
+    if (map[i].kind == HeapMapKind::Large) {
+      large_count++;
+      continue;
+    }
+    if (map[i].offset <= last_offset && i > 1) {
+      TEST_FAILED("Heap map blocks are not in address order");
+      return false;
+    }
+    last_offset = map[i].offset;
+    if (map[i].kind == HeapMapKind::Free) {
+      free_bytes += map[i].size;
+      largest = std::max<size_t>(largest, map[i].size);
+    } else {
+      used += map[i].size;
+    }
+  }
+  double expected = (1.0 - static_cast<double>(largest) / free_bytes) * 100.0;
+  std::cout << "  Largest free block: " << stats.largest_free_block << " of "
+            << stats.free_memory << " free bytes (" << std::fixed
+            << std::setprecision(2) << stats.getFragmentationRatio()
+            << "% fragmented)\n";
+  if (stats.largest_free_block != largest || stats.free_memory != free_bytes ||
+      stats.used_memory != used || large_count != 1 ||
+      stats.getFragmentationRatio() != expected) {
+    TEST_FAILED("Largest free block or heap map disagree with the heap");
+    return false;
+  }
+
+  printSectionHeader("JSON and Prometheus exports");
+  std::ostringstream json;
+  writeStatsJson(stats, json);
+  std::ostringstream prometheus;
+  writeStatsPrometheus(stats, prometheus);
+  std::string text = json.str();
+  std::cout << "  " << text.substr(0, 60) << "...\n";
+  if (text.front() != '{' || text.find("}\n") != text.size() - 2 ||
+      text.find("\"largest_free_block\":" + std::to_string(largest) + ",") ==
+          std::string::npos ||
+      text.find("\"allocations\":5,") == std::string::npos ||
+      prometheus.str().find("# TYPE customalloc_allocations_total counter\n"
+                            "customalloc_allocations_total 5\n") ==
+          std::string::npos ||
+      prometheus.str().find("# TYPE customalloc_used_memory gauge\n") ==
+          std::string::npos) {
+    TEST_FAILED("Exported counters are missing or wrong");
+    return false;
+  }
+
+  printSectionHeader("Binary heap map dump");
+  std::ostringstream dump;
+  writeHeapMap(allocator, dump);
+  std::string bytes = dump.str();
+  uint64_t count = 0;
+  std::memcpy(&count, bytes.data() + 8, sizeof(count));
+  std::cout << "  " << bytes.size() << " bytes, " << count << " entries\n";
+  if (bytes.compare(0, 4, "CAHM") != 0 || count != map.size() ||
+      bytes.size() != 24 + count * sizeof(HeapMapEntry) ||
+      std::memcmp(bytes.data() + 24, map.data(),
+                  map.size() * sizeof(HeapMapEntry)) != 0) {
+    TEST_FAILED("Heap map dump is malformed");
+    return false;
+  }
+
+  ArenaSet arenas(2, 64 * 1024);
+  void *arena_block = arenas.my_malloc(100);
+  std::ostringstream arena_dump;
+  writeHeapMap(arenas, arenas.arenaIndexFor(arena_block), arena_dump);
+  std::memcpy(&count, arena_dump.str().data() + 8, sizeof(count));
+  if (count < 3 || arenas.getStats().largest_free_block == 0) {
+    TEST_FAILED("Arena heap map or stats are incomplete");
+    return false;
+  }
+  arenas.my_free(arena_block);
+
+  allocator.my_free(large);
+  allocator.my_free(blocks[1]);
+  allocator.my_free(blocks[3]);
+  if (allocator.getStats().getFragmentationRatio() != 0.0) {
+    TEST_FAILED("Coalesced heap still reports fragmentation");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 32: Allocation Trace Recording
+ */
+bool testTracer() {
+  printTestHeader("Allocation Trace Ring Buffer");
+
+  const char *path = "alloc_trace_test.bin";
+  if (!startTracing(path)) {
+    std::cout << "  Tracer compiled out (ALLOCATOR_TRACING=OFF)\n";
+    TEST_PASSED();
+    return true;
+  }
+  if (startTracing(path)) {
+    TEST_FAILED("A second trace started while one was running");
+    return false;
+  }
+
+  printSectionHeader("Recording every entry point once");
+  MemoryAllocator allocator(256 * 1024);
+  void *a = allocator.my_malloc(100);
+  void *b = allocator.my_calloc(10, 30);
+  void *c = allocator.my_aligned_alloc(256, 64);
+  void *grown = allocator.my_realloc(a, 2000);
+  allocator.my_free(b);
+  allocator.my_free_sized(c, 64);
+  allocator.my_free(grown);
+  allocator.my_malloc(SIZE_MAX / 2); // Failed calls are not recorded
+  void *pair[2];
+  allocator.my_malloc_batch(48, 2, pair); // One record per block
+  int local = 0;
+  void *batch[4] = {pair[0], pair[1], pair[0], &local}; // Released ones only
+  allocator.my_free_batch(batch, 4);
+  void *global = custom_malloc(4000); // Reaches three layers, recorded once
+  custom_free(global);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([]() {
+      for (int i = 0; i < 100; i++) {
+        custom_free(custom_malloc(64));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+#if defined(__linux__)
+  printSectionHeader("A forked child stops tracing without the writer");
+  std::cout.flush();
+  std::fflush(nullptr);
+  pid_t child = fork();
+  if (child == 0) {
+    // Tracing is off here, and stopping it again at exit() must neither
+    // join the writer that was not copied nor write the parent's records
+    bool stopped = !tracingEnabled();
+    custom_free(custom_malloc(64));
+    stopTracing();
+    std::exit(stopped ? 0 : 1);
+  }
+  int status = -1;
+  for (int i = 0; child > 0 && i < 500; i++) {
+    if (waitpid(child, &status, WNOHANG) == child) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (child <= 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    if (child > 0) {
+      kill(child, SIGKILL);
+      waitpid(child, &status, 0);
+    }
+    TEST_FAILED("Forked child hung or kept tracing");
+    return false;
+  }
+#endif
+  stopTracing();
+
+  TraceStats stats = traceStats();
+  std::cout << "  Recorded: " << stats.recorded << ", written: "
+            << stats.written << ", dropped: " << stats.dropped << "\n";
+  if (stats.recorded != 13 + 800 || stats.written != stats.recorded ||
+      stats.dropped != 0) {
+    TEST_FAILED("Trace counters are wrong");
+    return false;
+  }
+
+  printSectionHeader("Reading the trace file back");
+  std::vector<char> bytes;
+  if (std::FILE *file = std::fopen(path, "rb")) {
+    char chunk[4096];
+    size_t got;
+    while ((got = std::fread(chunk, 1, sizeof(chunk), file)) > 0) {
+      bytes.insert(bytes.end(), chunk, chunk + got);
+    }
+    std::fclose(file);
+  }
+  std::remove(path);
+
+  TraceFileHeader header;
+  if (bytes.size() != sizeof(header) + stats.written * sizeof(TraceRecord)) {
+    TEST_FAILED("Trace file has the wrong length");
+    return false;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  std::vector<TraceRecord> records(stats.written);
+  std::memcpy(records.data(), bytes.data() + sizeof(header),
+              records.size() * sizeof(TraceRecord));
+
+  const TraceOp expected[] = {TraceOp::Malloc, TraceOp::Calloc,
+                              TraceOp::AlignedAlloc, TraceOp::Realloc,
+                              TraceOp::Free, TraceOp::Free, TraceOp::Free,
+                              TraceOp::Malloc, TraceOp::Malloc,
+                              TraceOp::Free, TraceOp::Free,
+                              TraceOp::Malloc, TraceOp::Free};
+  for (size_t i = 0; i < 13; i++) {
+    if (records[i].op != expected[i] || records[i].thread != 1 ||
+        (i && records[i].timestamp < records[i - 1].timestamp)) {
+      TEST_FAILED("Records are out of order or mislabelled");
+      return false;
+    }
+  }
+  if (std::memcmp(header.magic, "CATR", 4) != 0 ||
+      header.version != TRACE_VERSION ||
+      records[0].result != reinterpret_cast<uintptr_t>(a) ||
+      records[1].size != 300 || records[2].ptr != 256 ||
+      records[3].ptr != reinterpret_cast<uintptr_t>(a) ||
+      records[3].result != reinterpret_cast<uintptr_t>(grown) ||
+      records[5].size != 64 || records[7].size != 48 ||
+      records[9].ptr != records[7].result ||
+      records[12].ptr != reinterpret_cast<uintptr_t>(global)) {
+    TEST_FAILED("Record contents do not match the calls");
+    return false;
+  }
+
+  size_t worker_records = 0;
+  for (size_t i = 13; i < records.size(); i++) {
+    worker_records += records[i].thread >= 2 && records[i].thread <= 5;
+  }
+  std::cout << "  " << records.size() << " records, " << worker_records
+            << " from the worker threads\n";
+  if (worker_records != 800) {
+    TEST_FAILED("Worker thread records are missing");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 33: Placement Policies
+ */
+bool testPlacementPolicies() {
+  printTestHeader("First/Next/Best/Address-Ordered Fit");
+
+  // Free holes of 1000, 300, 600 and 300 bytes, lowest address first,
+  // separated by live blocks so they cannot coalesce
+  auto makeHoles = [](MemoryAllocator &heap, void *holes[4]) {
+    const size_t sizes[4] = {1000, 300, 600, 300};
+    void *guards[5];
+    for (size_t i = 0; i < 4; i++) {
+      guards[i] = heap.my_malloc(64);
+      holes[i] = heap.my_malloc(sizes[i]);
+    }
+    guards[4] = heap.my_malloc(64);
+    for (size_t i = 0; i < 4; i++) {
+      heap.my_free(holes[i]);
+    }
+    (void)guards;
+  };
+
+  printSectionHeader("Each policy picks its own hole");
+  auto inside = [](void *ptr, void *hole, size_t size) {
+    return ptr > hole && static_cast<char *>(ptr) < static_cast<char *>(hole) + size;
+  };
+  const PlacementPolicy policies[] = {
+      PlacementPolicy::FirstFit, PlacementPolicy::NextFit,
+      PlacementPolicy::BestFit, PlacementPolicy::AddressOrderedFirstFit,
+      PlacementPolicy::Tlsf};
+  for (PlacementPolicy policy : policies) {
+    AllocatorOptions options;
+    options.heap_size = 64 * 1024;
+    options.placement = policy;
+    MemoryAllocator heap(options);
+    void *holes[4];
+    makeHoles(heap, holes);
+    heap.my_malloc(heap.getStats().largest_free_block); // Fill the tail
+
+    void *a = heap.my_malloc(600);
+    void *b = heap.my_malloc(500);
+    void *c = heap.my_malloc(200);
+    MemoryStats stats = heap.getStats();
+    auto holeOf = [&](void *ptr) {
+      long index = std::find(holes, holes + 4, ptr) - holes;
+      return index < 4 ? std::to_string(index) : std::string("rest");
+    };
+    std::cout << "  " << std::setw(16) << std::left
+              << placementPolicyName(policy) << std::right << " holes "
+              << holeOf(a) << ", " << holeOf(b) << ", " << holeOf(c) << " ("
+              << std::fixed << std::setprecision(2)
+              << stats.getAverageSearchLength() << " steps/search)\n";
+
+    bool picked = false;
+    switch (policy) {
+    case PlacementPolicy::FirstFit:
+      // Newest block of the request's class, else the next class's head
+      picked = a == holes[2] && b == holes[0] && inside(c, holes[0], 1000);
+      break;
+    case PlacementPolicy::NextFit:
+      // Wraps to the bottom, then keeps moving up past hole 2
+      picked = a == holes[0] && b == holes[2] && c == holes[3];
+      break;
+    case PlacementPolicy::BestFit:
+      picked = a == holes[2] && b == holes[0] &&
+               (c == holes[1] || c == holes[3]);
+      break;
+    case PlacementPolicy::AddressOrderedFirstFit:
+      picked = a == holes[0] && b == holes[2] && inside(c, holes[0], 1000);
+      break;
+    case PlacementPolicy::Tlsf:
+      // The first list whose every block fits: 600 skips its own list
+      picked = a == holes[0] && b == holes[2] &&
+               (c == holes[1] || c == holes[3]);
+      break;
+    }
+    if (!picked || stats.placement_searches < 3 || !heap.verifyStats()) {
+      TEST_FAILED("Policy chose the wrong free block");
+      return false;
+    }
+  }
+
+  printSectionHeader("Switching policy on a live heap");
+  MemoryAllocator heap(64 * 1024);
+  void *holes[4];
+  makeHoles(heap, holes);
+  heap.setPlacementPolicy(PlacementPolicy::BestFit);
+  void *tight = heap.my_malloc(600);
+  if (heap.placementPolicy() != PlacementPolicy::BestFit ||
+      tight != holes[2] || !heap.verifyStats()) {
+    TEST_FAILED("Best fit after switching missed the exact hole");
+    return false;
+  }
+
+  printSectionHeader("Address tree agrees with a full scan");
+  for (PlacementPolicy policy : {PlacementPolicy::AddressOrderedFirstFit,
+                                 PlacementPolicy::NextFit}) {
+    AllocatorOptions options;
+    options.heap_size = 1024 * 1024;
+    options.placement = policy;
+    MemoryAllocator tree_heap(options);
+    std::vector<void *> live(1024, nullptr);
+    live[0] = tree_heap.my_malloc(64);
+    char *base = static_cast<char *>(live[0]) - sizeof(MemoryBlock);
+    char *rover = base;
+    std::vector<HeapMapEntry> map(4096);
+    unsigned seed = 11;
+    for (int i = 0; i < 5000; i++) {
+      seed = seed * 1103515245u + 12345u;
+      size_t slot = (seed >> 16) % live.size();
+      if (live[slot]) {
+        tree_heap.my_free(live[slot]);
+        live[slot] = nullptr;
+        continue;
+      }
+
+      // The lowest fit above the last placement (NextFit), else the lowest
+      size_t size = 16 + 8 * ((seed >> 8) % 64);
+      size_t entries = tree_heap.heapMap(map.data(), map.size());
+      char *lowest = nullptr;
+      char *above = nullptr;
+      for (size_t e = 0; e < entries && e < map.size(); e++) {
+        char *block = base + map[e].offset;
+        if (map[e].kind != HeapMapKind::Free || map[e].size < size) {
+          continue;
+        }
+        lowest = lowest ? lowest : block;
+        if (!above && block > rover) {
+          above = block;
+        }
+      }
+      char *expected = policy == PlacementPolicy::NextFit && above ? above
+                                                                    : lowest;
+      live[slot] = tree_heap.my_malloc(size);
+      char *got = live[slot] ? static_cast<char *>(live[slot]) -
+                                   sizeof(MemoryBlock)
+                             : nullptr;
+      if (got != expected) {
+        TEST_FAILED("Address tree placed a block the scan would not");
+        return false;
+      }
+      rover = got ? got : rover;
+    }
+
+    MemoryStats stats = tree_heap.getStats();
+    std::cout << "  " << std::setw(16) << std::left
+              << placementPolicyName(policy) << std::right << " "
+              << stats.free_block_count << " free blocks, " << std::fixed
+              << std::setprecision(2) << stats.getAverageSearchLength()
+              << " steps/search\n";
+    size_t largest = stats.largest_free_block;
+    tree_heap.setPlacementPolicy(PlacementPolicy::FirstFit);
+    bool same = tree_heap.getStats().largest_free_block == largest;
+    tree_heap.setPlacementPolicy(policy);
+    if (stats.getAverageSearchLength() > 32 || !same ||
+        tree_heap.getStats().largest_free_block != largest ||
+        !tree_heap.verifyStats()) {
+      TEST_FAILED("Address tree searches too far or lost blocks");
+      return false;
+    }
+    for (void *ptr : live) {
+      tree_heap.my_free(ptr);
+    }
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 34: TLSF Placement
+ */
+bool testTlsf() {
+  printTestHeader("TLSF Placement");
+
+  printSectionHeader("External memory, no OS calls");
+  alignas(16) static char region[512 * 1024];
+  MemoryAllocator heap(region, sizeof(region));
+  if (!heap.setPlacementPolicy(PlacementPolicy::Tlsf) ||
+      heap.placementPolicy() != PlacementPolicy::Tlsf ||
+      heap.getStats().used_memory == 0 ||
+      heap.getStats().total_allocations != 0 || !heap.verifyStats()) {
+    TEST_FAILED("TLSF index was not carved from the region");
+    return false;
+  }
+  std::cout << "  Index block: " << heap.getStats().used_memory << " bytes\n";
+
+  // Random sizes, never more than about half the region live
+  unsigned seed = 2025;
+  auto next_random = [&seed]() {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) & 0x7fff;
+  };
+  std::vector<void *> live(256, nullptr);
+  for (int i = 0; i < 20000; i++) {
+    size_t slot = next_random() % live.size();
+    if (live[slot]) {
+      heap.my_free(live[slot]);
+      live[slot] = nullptr;
+    } else {
+      size_t size = 1 + next_random() % (next_random() % 8 ? 256 : 2048);
+      live[slot] = heap.my_malloc(size);
+      if (!live[slot]) {
+        TEST_FAILED("TLSF allocation failed with room to spare");
+        return false;
+      }
+      std::memset(live[slot], 0x5a, size);
+    }
+    if (i % 1000 == 0 && !heap.verifyStats()) {
+      TEST_FAILED("Statistics drifted under TLSF");
+      return false;
+    }
+  }
+
+  // With room to spare every search is a single bitmap lookup
+  MemoryStats stats = heap.getStats();
+  std::cout << "  Searches:    " << stats.placement_searches << ", steps "
+            << stats.placement_steps << "\n";
+  if (stats.placement_steps != stats.placement_searches) {
+    TEST_FAILED("TLSF searched more than one list per allocation");
+    return false;
+  }
+
+  for (void *&ptr : live) {
+    heap.my_free(ptr);
+    ptr = nullptr;
+  }
+
+  printSectionHeader("Bounded fallback and switching back");
+  // Only blocks in the request's own list are left
+  void *exact[3];
+  for (void *&ptr : exact) {
+    ptr = heap.my_malloc(1000);
+  }
+  heap.my_malloc(heap.getStats().largest_free_block);
+  heap.my_free(exact[1]);
+  void *again = heap.my_malloc(1000);
+  if (again != exact[1] || !heap.verifyStats()) {
+    TEST_FAILED("Fallback scan missed a block of the request's own list");
+    return false;
+  }
+
+  heap.reset();
+  if (heap.placementPolicy() != PlacementPolicy::Tlsf ||
+      heap.getStats().used_memory == 0 || !heap.verifyStats()) {
+    TEST_FAILED("reset() dropped the TLSF index");
+    return false;
+  }
+  void *kept = heap.my_malloc(4096);
+  if (!heap.setPlacementPolicy(PlacementPolicy::FirstFit) ||
+      heap.getStats().used_memory != 4096 ||
+      heap.getStats().total_frees != 0 || !heap.verifyStats()) {
+    TEST_FAILED("Switching back did not free the index");
+    return false;
+  }
+  heap.my_free(kept);
+  if (heap.getStats().free_block_count != 1) {
+    TEST_FAILED("Index block did not coalesce back into the heap");
+    return false;
+  }
+
+  alignas(16) static char tiny[4096];
+  MemoryAllocator small(tiny, sizeof(tiny));
+  if (small.setPlacementPolicy(PlacementPolicy::Tlsf) ||
+      small.placementPolicy() != PlacementPolicy::FirstFit) {
+    TEST_FAILED("TLSF claimed an index that cannot fit");
+    return false;
+  }
+
+  printSectionHeader("Growable heap");
+  AllocatorOptions options;
+  options.heap_size = 64 * 1024;
+  options.growable = true;
+  options.placement = PlacementPolicy::Tlsf;
+  MemoryAllocator grown(options);
+  std::vector<void *> pages;
+  for (int i = 0; i < 100; i++) {
+    pages.push_back(grown.my_malloc(4096));
+  }
+  MemoryAllocator moved(std::move(grown));
+  size_t segments = moved.getStats().segment_count;
+  for (void *ptr : pages) {
+    moved.my_free(ptr);
+  }
+  if (segments < 2 || !moved.my_malloc(100) || !moved.verifyStats()) {
+    TEST_FAILED("TLSF heap did not grow and shrink cleanly");
+    return false;
+  }
+
+  options.heap_size = 4096;
+  options.growable = false;
+  try {
+    MemoryAllocator cramped(options);
+    TEST_FAILED("TLSF heap without room for its index was created");
+    return false;
+  } catch (const std::invalid_argument &) {
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 35: Buddy Allocator
+ */
+bool testBuddyAllocator() {
+  printTestHeader("Buddy Allocator");
+
+  auto aligned = [](const void *ptr, size_t alignment) {
+    return (reinterpret_cast<uintptr_t>(ptr) & (alignment - 1)) == 0;
+  };
+
+  printSectionHeader("Power-of-two blocks, naturally aligned");
+  BuddyAllocator buddy;
+  const size_t max_blocks = buddy.heapSize() / buddy.maxBlock();
+  void *page = buddy.allocate(3000);
+  void *buffer = buddy.allocate(1024 * 1024);
+  void *odd = buddy.allocate(5000);
+  if (buddy.blockSize(page) != 4096 || buddy.blockSize(odd) != 8192 ||
+      buddy.blockSize(buffer) != 1024 * 1024 || !aligned(page, 4096) ||
+      !aligned(odd, 8192) || !aligned(buffer, 1024 * 1024) ||
+      buddy.getStats().used_bytes != 4096 + 8192 + 1024 * 1024 ||
+      !buddy.verify()) {
+    TEST_FAILED("Blocks were not rounded up or not aligned to their size");
+    return false;
+  }
+  std::cout << "  3000 -> " << buddy.blockSize(page) << ", 5000 -> "
+            << buddy.blockSize(odd) << ", 1 MB at " << buffer << "\n";
+
+  printSectionHeader("Buddies merge back");
+  for (void *ptr : {page, buffer, odd}) {
+    buddy.deallocate(ptr);
+  }
+  // On a whole heap two pages are the halves of one split 8 KB block
+  void *left = buddy.allocate(4096);
+  void *right = buddy.allocate(4096);
+  if (static_cast<char *>(right) - static_cast<char *>(left) != 4096 ||
+      !aligned(left, 8192)) {
+    TEST_FAILED("Consecutive pages did not come from one split");
+    return false;
+  }
+  buddy.deallocate(right);
+  buddy.deallocate(left);
+  BuddyStats stats = buddy.getStats();
+  if (stats.used_bytes != 0 || stats.free_blocks != max_blocks ||
+      stats.largest_free_block != buddy.maxBlock() ||
+      stats.merge_count == 0 || stats.merge_count != stats.split_count ||
+      !buddy.verify()) {
+    TEST_FAILED("Freed buddies did not coalesce into whole blocks");
+    return false;
+  }
+  std::cout << "  Splits " << stats.split_count << ", merges "
+            << stats.merge_count << "\n";
+
+  printSectionHeader("Random 4 KB - 1 MB buffers");
+  unsigned seed = 2026;
+  auto next_random = [&seed]() {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 16) & 0x7fff;
+  };
+  std::vector<void *> live(64, nullptr);
+  for (int i = 0; i < 5000; i++) {
+    size_t slot = next_random() % live.size();
+    if (live[slot]) {
+      buddy.deallocate(live[slot]);
+      live[slot] = nullptr;
+      continue;
+    }
+    size_t size = size_t(4096) << (next_random() % 9);
+    live[slot] = buddy.allocate(size - next_random() % 1024);
+    if (live[slot]) {
+      if (!aligned(live[slot], size)) {
+        TEST_FAILED("Buffer not aligned to its block size");
+        return false;
+      }
+      static_cast<char *>(live[slot])[size - 1] = 1;
+    }
+    if (i % 500 == 0 && !buddy.verify()) {
+      TEST_FAILED("Free lists and bitmaps disagree");
+      return false;
+    }
+  }
+  std::cout << "  Fragmentation with buffers live: " << std::fixed
+            << std::setprecision(2) << buddy.getStats().getFragmentationRatio()
+            << "%\n";
+  for (void *ptr : live) {
+    buddy.deallocate(ptr);
+  }
+  if (buddy.getStats().free_blocks != max_blocks || !buddy.verify()) {
+    TEST_FAILED("Heap did not return to whole max-size blocks");
+    return false;
+  }
+
+  printSectionHeader("Errors");
+  void *block = buddy.allocate(8192);
+  clear_last_error();
+  buddy.deallocate(static_cast<char *>(block) + 4096);
+  bool interior = last_error() == AllocError::InvalidPointer;
+  buddy.deallocate(block);
+  buddy.deallocate(block);
+  bool twice = last_error() == AllocError::DoubleFree;
+  bool too_big = !buddy.allocate(buddy.maxBlock() + 1) &&
+                 last_error() == AllocError::OutOfMemory;
+  clear_last_error();
+  if (!interior || !twice || !too_big || !buddy.verify()) {
+    TEST_FAILED("Bad frees or oversized requests were not reported");
+    return false;
+  }
+
+  printSectionHeader("External memory");
+  alignas(4096) static char region[256 * 1024];
+  BuddyAllocator external(region, sizeof(region), 4096, 64 * 1024);
+  std::vector<void *> pages;
+  while (void *ptr = external.allocate(4096)) {
+    pages.push_back(ptr);
+  }
+  clear_last_error();
+  bool inside = std::all_of(pages.begin(), pages.end(), [&](void *ptr) {
+    return ptr >= region && ptr < region + sizeof(region);
+  });
+  std::cout << "  " << pages.size() << " pages in a "
+            << external.heapSize() / 1024 << " KB heap\n";
+  if (!inside || pages.size() != external.heapSize() / 4096 ||
+      external.heapSize() % (64 * 1024) || external.heapSize() == 0 ||
+      external.getStats().failed_allocations != 1) {
+    TEST_FAILED("External heap was not carved from the region");
+    return false;
+  }
+  for (void *ptr : pages) {
+    external.deallocate(ptr);
+  }
+
+  Resource resource(external);
+  void *pmr = resource.allocate(10000, 64);
+  bool rounded = external.blockSize(pmr) == 16384;
+  resource.deallocate(pmr, 10000, 64);
+  if (!rounded || external.getStats().used_bytes != 0 || !external.verify()) {
+    TEST_FAILED("Resource over the buddy allocator misbehaved");
+    return false;
+  }
+
+  try {
+    BuddyOptions options;
+    options.min_block = 3000;
+    BuddyAllocator bad(options);
+    TEST_FAILED("Non-power-of-two geometry was accepted");
+    return false;
+  } catch (const std::invalid_argument &) {
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+bool testSlabAllocator() {
+  printTestHeader("Slab Allocator");
+
+  auto aligned = [](const void *ptr, size_t alignment) {
+    return (reinterpret_cast<uintptr_t>(ptr) & (alignment - 1)) == 0;
+  };
+
+  MemoryAllocator parent(4 * 1024 * 1024);
+
+  printSectionHeader("Size classes, no per-object header");
+  {
+    SlabAllocator slabs(parent);
+    const size_t requests[] = {1, 16, 17, 100, 129, 300, 500, 512};
+    const size_t expected[] = {16, 16, 32, 112, 160, 320, 512, 512};
+    for (size_t i = 0; i < 8; i++) {
+      void *ptr = slabs.allocate(requests[i]);
+      if (!ptr || slabs.objectSize(ptr) != expected[i] || !aligned(ptr, 16) ||
+          !slabs.owns(ptr)) {
+        TEST_FAILED("Request not rounded up to its class");
+        return false;
+      }
+      slabs.deallocate(ptr);
+    }
+    void *first = slabs.allocate(64);
+    void *second = slabs.allocate(64);
+    if (static_cast<char *>(second) - static_cast<char *>(first) != 64) {
+      TEST_FAILED("Objects of one class were not back to back");
+      return false;
+    }
+    std::cout << "  Two 64-byte objects 64 bytes apart, slab of "
+              << slabs.slabSize() / 1024 << " KB\n";
+    slabs.deallocate(first);
+    slabs.deallocate(second);
+    if (slabs.owns(first) || !slabs.verify()) {
+      TEST_FAILED("Freed object still reported as live");
+      return false;
+    }
+  }
+  if (parent.getStats().used_memory != 0) {
+    TEST_FAILED("Destructor did not return the slabs to the parent");
+    return false;
+  }
+
+  printSectionHeader("Full, partial and empty slabs");
+  {
+    SlabAllocator slabs(parent, 4096, 1);
+    std::vector<void *> objects;
+    for (int i = 0; i < 100; i++) {
+      objects.push_back(slabs.allocate(256));
+    }
+    SlabStats stats = slabs.getStats();
+    std::cout << "  100 x 256 B in " << stats.slab_count
+              << " slabs of 4 KB, utilization " << std::fixed
+              << std::setprecision(2) << stats.getUtilization() << "%\n";
+    if (stats.slab_count < 7 || stats.objects_in_use != 100 ||
+        stats.object_bytes != 100 * 256 || !slabs.verify()) {
+      TEST_FAILED("Slabs did not fill up one after another");
+      return false;
+    }
+    for (void *ptr : objects) {
+      slabs.deallocate(ptr);
+    }
+    stats = slabs.getStats();
+    if (stats.slab_count != 1 || stats.empty_slabs != 1 ||
+        stats.objects_in_use != 0 || !slabs.verify()) {
+      TEST_FAILED("Empty slabs beyond max_empty were kept");
+      return false;
+    }
+    // A kept empty slab is reformatted for whichever class needs it next
+    void *small = slabs.allocate(16);
+    if (slabs.getStats().slab_count != 1 || slabs.getStats().empty_slabs) {
+      TEST_FAILED("Empty slab was not reused for another class");
+      return false;
+    }
+    slabs.deallocate(small);
+    if (slabs.trim() != 4096 || slabs.getStats().slab_count != 0) {
+      TEST_FAILED("trim() did not release the empty slab");
+      return false;
+    }
+  }
+
+  printSectionHeader("Random small-object workload");
+  {
+    SlabAllocator slabs(parent);
+    unsigned seed = 2027;
+    auto next_random = [&seed]() {
+      seed = seed * 1103515245u + 12345u;
+      return (seed >> 16) & 0x7fff;
+    };
+    std::vector<std::pair<unsigned char *, size_t>> live(2000, {nullptr, 0});
+    for (int i = 0; i < 50000; i++) {
+      auto &slot = live[next_random() % live.size()];
+      if (slot.first) {
+        if (slot.first[0] != static_cast<unsigned char>(slot.second) ||
+            slot.first[slot.second - 1] !=
+                static_cast<unsigned char>(slot.second)) {
+          TEST_FAILED("Object contents were overwritten");
+          return false;
+        }
+        slabs.deallocate(slot.first);
+        slot = {nullptr, 0};
+        continue;
+      }
+      size_t size = 1 + next_random() % SlabAllocator::MAX_OBJECT_SIZE;
+      slot = {static_cast<unsigned char *>(slabs.allocate(size)), size};
+      std::memset(slot.first, static_cast<unsigned char>(size), size);
+      if (i % 5000 == 0 && !slabs.verify()) {
+        TEST_FAILED("Bitmaps and lists disagree");
+        return false;
+      }
+    }
+    SlabStats stats = slabs.getStats();
+    std::cout << "  " << stats.objects_in_use << " objects live in "
+              << stats.slab_count << " slabs, utilization " << std::fixed
+              << std::setprecision(2) << stats.getUtilization() << "%\n";
+    for (auto &slot : live) {
+      slabs.deallocate(slot.first);
+    }
+    stats = slabs.getStats();
+    if (stats.objects_in_use != 0 ||
+        stats.empty_slabs > SlabAllocator::DEFAULT_MAX_EMPTY ||
+        stats.total_allocations != stats.total_frees || !slabs.verify()) {
+      TEST_FAILED("Workload left objects or slabs behind");
+      return false;
+    }
+  }
+
+  printSectionHeader("Errors");
+  {
+    SlabAllocator slabs(parent);
+    SlabAllocator other(parent);
+    void *object = slabs.allocate(48);
+    void *foreign = other.allocate(48);
+    clear_last_error();
+    slabs.deallocate(static_cast<char *>(object) + 8);
+    bool interior = last_error() == AllocError::InvalidPointer;
+    clear_last_error();
+    slabs.deallocate(foreign);
+    bool wrong_owner = last_error() == AllocError::InvalidPointer;
+    slabs.deallocate(object);
+    slabs.deallocate(object); // Its emptied slab is kept, so still mapped
+    bool twice = last_error() == AllocError::DoubleFree;
+    bool too_big = !slabs.allocate(SlabAllocator::MAX_OBJECT_SIZE + 1) &&
+                   last_error() == AllocError::OutOfMemory &&
+                   slabs.getStats().failed_allocations == 1;
+    clear_last_error();
+    other.deallocate(foreign);
+    if (!interior || !wrong_owner || !twice || !too_big || !slabs.verify() ||
+        !other.verify()) {
+      TEST_FAILED("Bad frees or oversized requests were not reported");
+      return false;
+    }
+  }
+
+  printSectionHeader("pmr list nodes on slabs");
+  {
+    SlabAllocator slabs(parent);
+    Resource resource(slabs);
+    std::pmr::list<int> list(&resource);
+    for (int i = 0; i < 1000; i++) {
+      list.push_back(i);
+    }
+    size_t nodes = slabs.getStats().objects_in_use;
+    long sum = 0;
+    for (int value : list) {
+      sum += value;
+    }
+    list.clear();
+    if (nodes != 1000 || sum != 999L * 1000 / 2 ||
+        slabs.getStats().objects_in_use != 0) {
+      TEST_FAILED("List nodes did not come from the slabs");
+      return false;
+    }
+    std::cout << "  1000 nodes of " << slabs.classSize(0) << "+ bytes served\n";
+  }
+
+  for (size_t bad_size : {size_t(3000), size_t(2048), size_t(2 * 1024 * 1024)}) {
+    try {
+      SlabAllocator bad(parent, bad_size);
+      TEST_FAILED("Unsupported slab size was accepted");
+      return false;
+    } catch (const std::invalid_argument &) {
+    }
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+bool testNumaArenas() {
+  printTestHeader("NUMA Node-Local Arenas");
+
+  printSectionHeader("Topology");
+  const size_t nodes = osNumaNodeCount();
+  const int current = osCurrentNumaNode();
+  std::cout << "  " << nodes << " node(s), this thread runs on node "
+            << current << "\n";
+  if (nodes == 0 || current < 0 || static_cast<size_t>(current) >= nodes) {
+    TEST_FAILED("Current node outside the reported topology");
+    return false;
+  }
+
+  printSectionHeader("Arenas interleaved over the nodes");
+  ArenaSet arenas(3, 256 * 1024, ArenaSet::Assignment::NumaNode);
+  if (arenas.nodeCount() != nodes || arenas.arenaCount() % nodes != 0 ||
+      arenas.arenaCount() < 3) {
+    TEST_FAILED("Arena count was not rounded up to whole nodes");
+    return false;
+  }
+  size_t bound = 0;
+  for (size_t i = 0; i < arenas.arenaCount(); i++) {
+    if (arenas.arena(i).numaNode() != arenas.arenaNode(i)) {
+      TEST_FAILED("Arena heap was not placed on its node");
+      return false;
+    }
+    bound += arenas.arena(i).isNumaBound();
+  }
+  std::cout << "  " << arenas.arenaCount() << " arenas, " << bound
+            << " accepted by mbind()\n";
+
+  printSectionHeader("Thread arenas and explicit nodes");
+  void *local = arenas.my_malloc(200);
+  size_t home = arenas.arenaIndexFor(local);
+  if (arenas.arenaNode(home) != current || !arenas.isNodeLocal(home)) {
+    TEST_FAILED("Thread was not served from its own node");
+    return false;
+  }
+  std::vector<void *> placed;
+  for (size_t node = 0; node < nodes; node++) {
+    void *ptr = arenas.my_malloc_on_node(300, static_cast<int>(node));
+    if (!ptr || arenas.arenaNode(arenas.arenaIndexFor(ptr)) !=
+                    static_cast<int>(node)) {
+      TEST_FAILED("my_malloc_on_node() left its node");
+      return false;
+    }
+    placed.push_back(ptr);
+  }
+  void *big = arenas.my_malloc_on_node(1024 * 1024, 0); // Own mapping, bound too
+  clear_last_error();
+  bool rejected = !arenas.my_malloc_on_node(64, static_cast<int>(nodes)) &&
+                  last_error() == AllocError::OutOfMemory;
+  clear_last_error();
+  if (!big || arenas.arenaNode(arenas.arenaIndexFor(big)) != 0 || !rejected) {
+    TEST_FAILED("Node allocations misrouted or unknown node accepted");
+    return false;
+  }
+
+  printSectionHeader("Per-node statistics");
+  MemoryStats total = arenas.getStats();
+  size_t used = 0;
+  for (size_t node = 0; node < nodes; node++) {
+    MemoryStats stats = arenas.getNodeStats(static_cast<int>(node));
+    std::cout << "  Node " << node << ": " << stats.used_memory
+              << " bytes in use, " << stats.segment_count << " segments\n";
+    used += stats.used_memory;
+  }
+  if (used != total.used_memory || used == 0) {
+    TEST_FAILED("Node statistics do not add up to the set");
+    return false;
+  }
+
+  // Frees find the owning arena by address from any thread
+  std::thread remote([&]() {
+    arenas.my_free(local);
+    arenas.my_free(big);
+    for (void *ptr : placed) {
+      arenas.my_free(ptr);
+    }
+  });
+  remote.join();
+  if (arenas.getStats().used_memory != 0) {
+    TEST_FAILED("Blocks were not freed back to their arenas");
+    return false;
+  }
+
+  printSectionHeader("Global functions");
+  initGlobalArenas(nodes, 256 * 1024, ArenaSet::Assignment::NumaNode);
+  void *global_block = custom_malloc_on_node(48, 0);
+  bool on_node = global_block &&
+                 g_arenas->arenaNode(g_arenas->arenaIndexFor(global_block)) == 0;
+  custom_free(global_block);
+  bool unknown = !custom_malloc_on_node(48, static_cast<int>(nodes));
+  clear_last_error();
+  flushThreadCache();
+  size_t left = g_arenas->getStats().used_memory;
+  destroyGlobalAllocator();
+  if (!on_node || !unknown || left != 0) {
+    TEST_FAILED("custom_malloc_on_node() misbehaved");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 38: Movable Heap
+ */
+bool testMovableHeap() {
+  printTestHeader("Movable Handles and Compaction");
+
+  printSectionHeader("A block slides over the hole in front, traced");
+  {
+    ProfileOptions every_block;
+    every_block.sample_interval = 1;
+    resetProfile();
+    bool profiling = startProfiling(every_block);
+    MovableHeap heap;
+    Handle hole = heap.alloc_movable(200);
+    Handle block = heap.alloc_movable(64);
+    Handle guard = heap.alloc_movable(32);
+    char *hole_data = static_cast<char *>(heap.pin(hole));
+    heap.unpin(hole);
+    char *block_data = static_cast<char *>(heap.pin(block));
+    std::memset(block_data, 0x5A, 64);
+    heap.unpin(block);
+    void *guard_data = heap.pin(guard);
+    heap.unpin(guard);
+    heap.free_movable(hole);
+
+    // The block moves into the hole, then the guard follows it down
+    const char *path = "movable_trace_test.bin";
+    bool tracing = startTracing(path);
+    heap.compact();
+    stopTracing();
+    char *moved = static_cast<char *>(heap.pin(block));
+    bool kept = std::all_of(moved, moved + 64, [](char c) { return c == 0x5A; });
+    heap.unpin(block);
+
+    // Its profiler sample follows it rather than dangling at the old address
+    HeapSample samples[4];
+    size_t sampled = heapSamples(samples, 4);
+    bool followed = !profiling ||
+                    std::any_of(samples, samples + sampled,
+                                [&](const HeapSample &sample) {
+                                  return sample.ptr == moved && sample.size == 64;
+                                });
+    stopProfiling();
+    resetProfile();
+
+    bool traced = true;
+    if (tracing) {
+      TraceRecord records[2] = {};
+      if (std::FILE *file = std::fopen(path, "rb")) {
+        std::fseek(file, sizeof(TraceFileHeader), SEEK_SET);
+        traced = std::fread(records, sizeof(TraceRecord), 2, file) == 2;
+        std::fclose(file);
+      }
+      std::remove(path);
+      traced = traced && traceStats().recorded == 2 &&
+               records[0].op == TraceOp::Realloc &&
+               records[0].ptr == reinterpret_cast<uintptr_t>(block_data) &&
+               records[0].result == reinterpret_cast<uintptr_t>(moved) &&
+               records[0].size == 64 &&
+               records[1].ptr == reinterpret_cast<uintptr_t>(guard_data);
+    }
+    if (moved != hole_data || !kept || !traced || !followed ||
+        !heap.verify()) {
+      TEST_FAILED("Block did not slide into the hole intact and traced");
+      return false;
+    }
+    heap.free_movable(block);
+    heap.free_movable(guard);
+  }
+
+  auto fill = [](void *data, size_t size, uint32_t seed) {
+    std::memset(data, static_cast<int>(seed & 0xFF), size);
+  };
+  auto check = [](const void *data, size_t size, uint32_t seed) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    return std::all_of(bytes, bytes + size, [seed](unsigned char c) {
+      return c == static_cast<unsigned char>(seed & 0xFF);
+    });
+  };
+
+  MovableHeap heap;
+  std::vector<Handle> handles;
+  auto fragment = [&]() {
+    for (uint32_t i = 0; i < 2000; i++) {
+      size_t size = 32 + (i * 37) % 225;
+      Handle handle = heap.alloc_movable(size);
+      void *data = heap.pin(handle);
+      fill(data, size, i);
+      heap.unpin(handle);
+      handles.push_back(handle);
+    }
+    // Every other block goes, leaving holes too small for the next request
+    for (size_t i = 0; i < handles.size(); i += 2) {
+      heap.free_movable(handles[i]);
+    }
+  };
+  auto contentsIntact = [&]() {
+    for (size_t i = 1; i < handles.size(); i += 2) {
+      void *data = heap.pin(handles[i]);
+      bool intact = data && check(data, heap.movableSize(handles[i]),
+                                  static_cast<uint32_t>(i));
+      heap.unpin(handles[i]);
+      if (!intact) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  printSectionHeader("Full pass around a pinned block");
+  fragment();
+  Handle anchor = handles[501];
+  void *pinned = heap.pin(anchor);
+  MovableStats before = heap.getStats();
+  size_t moved = heap.compact();
+  MovableStats after = heap.getStats();
+  std::cout << "  Fragmentation " << std::fixed << std::setprecision(2)
+            << before.getFragmentationRatio() << "% -> "
+            << after.getFragmentationRatio() << "%, " << after.blocks_moved
+            << " blocks (" << moved << " bytes) moved\n";
+  if (after.getFragmentationRatio() >= before.getFragmentationRatio() / 2 ||
+      after.largest_free_block <= before.largest_free_block ||
+      after.compaction_passes != 1 || moved == 0 ||
+      heap.pin(anchor) != pinned || !contentsIntact() || !heap.verify()) {
+    TEST_FAILED("Compaction did not pack the unpinned blocks");
+    return false;
+  }
+  heap.unpin(anchor);
+  heap.unpin(anchor);
+
+  printSectionHeader("Incremental passes under a time budget");
+  for (size_t i = 1; i < handles.size(); i += 4) {
+    heap.free_movable(handles[i]);
+  }
+  size_t calls = 0;
+  size_t passes = heap.getStats().compaction_passes;
+  while (heap.getStats().compaction_passes == passes && calls < 100000) {
+    heap.compact(1);
+    calls++;
+  }
+  std::cout << "  Pass finished after " << calls << " calls of 1 us\n";
+  if (heap.getStats().compaction_passes != passes + 1 || !heap.verify()) {
+    TEST_FAILED("Budgeted compaction never completed a pass");
+    return false;
+  }
+  for (size_t i = 3; i < handles.size(); i += 4) {
+    void *data = heap.pin(handles[i]);
+    bool intact = check(data, heap.movableSize(handles[i]),
+                        static_cast<uint32_t>(i));
+    heap.unpin(handles[i]);
+    if (!intact) {
+      TEST_FAILED("Block contents changed while moving");
+      return false;
+    }
+  }
+
+  printSectionHeader("Stale handles");
+  Handle gone = handles[3];
+  heap.free_movable(gone);
+  clear_last_error();
+  bool stale = !heap.pin(gone) && last_error() == AllocError::InvalidPointer &&
+               !heap.isLive(gone) && heap.movableSize(gone) == 0;
+  clear_last_error();
+  heap.free_movable(gone);
+  bool twice = last_error() == AllocError::InvalidPointer;
+  clear_last_error();
+  Handle reused = heap.alloc_movable(40); // Takes the freed slot
+  if (!stale || !twice || reused.index != gone.index ||
+      reused == gone || heap.isLive(gone) || !heap.isLive(reused)) {
+    TEST_FAILED("Stale handles were not detected");
+    return false;
+  }
+  heap.free_movable(reused);
+
+  printSectionHeader("Background compactor");
+  for (Handle handle : handles) {
+    if (heap.isLive(handle)) {
+      heap.free_movable(handle);
+    }
+  }
+  handles.clear();
+  fragment();
+  size_t moved_before = heap.getStats().blocks_moved;
+  heap.startBackgroundCompaction(1, 200, 1.0);
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  bool readable = true;
+  while (heap.getStats().blocks_moved == moved_before &&
+         std::chrono::steady_clock::now() < deadline) {
+    readable = readable && contentsIntact(); // Pins race with the worker
+  }
+  heap.stopBackgroundCompaction();
+  MovableStats background = heap.getStats();
+  std::cout << "  Worker moved " << background.blocks_moved - moved_before
+            << " blocks, fragmentation now " << std::fixed
+            << std::setprecision(2) << background.getFragmentationRatio()
+            << "%\n";
+  if (background.blocks_moved == moved_before || !readable ||
+      !contentsIntact() || !heap.verify()) {
+    TEST_FAILED("Background compaction did not move blocks safely");
+    return false;
+  }
+  for (Handle handle : handles) {
+    heap.free_movable(handle); // Freed halves report stale handles
+  }
+  clear_last_error();
+  if (heap.getStats().live_handles != 0 || heap.heapStats().used_memory != 0) {
+    TEST_FAILED("Freeing every handle left memory in use");
+    return false;
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+/**
+ * Test 39: Hardened Mode
+ */
+bool testHardenedMode() {
+  printTestHeader("Hardened Mode: Canaries, Validation and Quarantine");
+
+  AllocatorOptions options;
+  options.hardened = true;
+  options.quarantine_bytes = 4096;
+  options.quarantine_sample = 1;
+  MemoryAllocator heap(options);
+  auto failsWith = [](AllocError expected) {
+    bool matched = last_error() == expected;
+    clear_last_error();
+    return matched;
+  };
+
+  printSectionHeader("A freed block is poisoned and held back");
+  {
+    unsigned char *data = static_cast<unsigned char *>(heap.my_malloc(64));
+    std::memset(data, 0x11, 64);
+    heap.my_free(data);
+    MemoryStats stats = heap.getStats();
+    bool poisoned = std::all_of(data, data + 64, [](unsigned char c) {
+      return c == MemoryAllocator::POISON_BYTE;
+    });
+    if (!heap.isHardened() || !poisoned || stats.quarantined_blocks != 1 ||
+        stats.quarantined_bytes != 64 || stats.used_memory != 64 ||
+        !heap.verifyStats()) {
+      TEST_FAILED("Freed block was not quarantined");
+      return false;
+    }
+
+    // The quarantine bit catches the second free before any reuse
+    clear_last_error();
+    heap.my_free(data);
+    bool double_free = failsWith(AllocError::DoubleFree);
+    bool stale_realloc = heap.my_realloc(data, 128) == nullptr &&
+                         failsWith(AllocError::UseAfterFree);
+    if (!double_free || !stale_realloc) {
+      TEST_FAILED("Free or realloc of a quarantined block went through");
+      return false;
+    }
+  }
+
+  printSectionHeader("Only block starts with intact headers are freed");
+  {
+    char *data = static_cast<char *>(heap.my_malloc(64));
+    char *next = static_cast<char *>(heap.my_malloc(32));
+    heap.my_free(data + 4);
+    bool misaligned = failsWith(AllocError::InvalidPointer);
+    heap.my_free(data + 16);
+    bool interior = failsWith(AllocError::CorruptedBlock);
+
+    // Overrun the first block into the header of the next one
+    unsigned char header[sizeof(MemoryBlock)];
+    std::memcpy(header, next - sizeof(MemoryBlock), sizeof(header));
+    std::memset(data, 'x', 64 + sizeof(MemoryBlock));
+    heap.my_free(next);
+    bool overrun = failsWith(AllocError::CorruptedBlock);
+    std::memcpy(next - sizeof(MemoryBlock), header, sizeof(header));
+
+    std::cout << "  Misaligned: " << (misaligned ? "rejected" : "accepted")
+              << ", interior: " << (interior ? "rejected" : "accepted")
+              << ", overrun header: " << (overrun ? "rejected" : "accepted")
+              << "\n";
+    if (!misaligned || !interior || !overrun || !heap.verifyStats()) {
+      TEST_FAILED("A bad pointer or header passed validation");
+      return false;
+    }
+    heap.my_free(next);
+    heap.my_free(data);
+    if (last_error() != AllocError::None) {
+      TEST_FAILED("Valid frees were rejected");
+      return false;
+    }
+  }
+
+  printSectionHeader("A write after free shows when the block leaves");
+  {
+    char *data = static_cast<char *>(heap.my_malloc(48));
+    heap.my_free(data);
+    data[10] = 1;
+    heap.flushQuarantine();
+    if (!failsWith(AllocError::UseAfterFree) ||
+        heap.getStats().quarantined_blocks != 0 || !heap.verifyStats()) {
+      TEST_FAILED("Damaged poison was not reported");
+      return false;
+    }
+  }
+
+  printSectionHeader("A header overwritten in quarantine is leaked exactly");
+  {
+    char *data = static_cast<char *>(heap.my_malloc(64));
+    heap.my_free(data);
+    MemoryBlock *header = MemoryBlock::fromData(data);
+    size_t saved = header->size_flags;
+    header->size_flags = ~size_t(0) << 12; // A wild write over the size
+    heap.flushQuarantine();
+    MemoryStats stats = heap.getStats();
+    bool reported = failsWith(AllocError::CorruptedBlock);
+
+    // Put the header back so the leaked block can be freed for real
+    header->size_flags = saved;
+    header->setQuarantined(false);
+    heap.my_free(data);
+    heap.flushQuarantine();
+    if (!reported || stats.quarantined_blocks != 0 ||
+        stats.quarantined_bytes != 0 || last_error() != AllocError::None ||
+        !heap.verifyStats()) {
+      TEST_FAILED("Corrupted size threw off the quarantine's byte count");
+      return false;
+    }
+  }
+
+  printSectionHeader("The quarantine stays within its slots and bytes");
+  {
+    std::vector<void *> blocks;
+    for (int i = 0; i < 40; i++) {
+      blocks.push_back(heap.my_malloc(16));
+    }
+    for (void *block : blocks) {
+      heap.my_free(block);
+    }
+    size_t by_slots = heap.getStats().quarantined_blocks;
+
+    void *big = heap.my_malloc(3000);
+    void *bigger = heap.my_malloc(2000);
+    void *huge = heap.my_malloc(8000); // Over the byte budget: freed at once
+    heap.my_free(big);
+    heap.my_free(bigger);
+    heap.my_free(huge);
+    MemoryStats stats = heap.getStats();
+    std::cout << "  After 40 frees: " << by_slots
+              << " quarantined; after big frees: " << stats.quarantined_bytes
+              << " bytes\n";
+    if (by_slots != MemoryAllocator::QUARANTINE_SLOTS ||
+        stats.quarantined_bytes > options.quarantine_bytes ||
+        !heap.verifyStats()) {
+      TEST_FAILED("Quarantine exceeded its bounds");
+      return false;
+    }
+  }
+
+  printSectionHeader("A sampled quarantine holds back one free in N");
+  {
+    AllocatorOptions sampled = options;
+    sampled.quarantine_sample = 4;
+    MemoryAllocator sampled_heap(sampled);
+    void *blocks[8];
+    for (void *&block : blocks) {
+      block = sampled_heap.my_malloc(32);
+    }
+    for (void *block : blocks) {
+      sampled_heap.my_free(block);
+    }
+    MemoryStats stats = sampled_heap.getStats();
+    bool caught = true;
+    sampled_heap.my_free(blocks[0]); // Quarantined: caught by its flag
+    caught = caught && failsWith(AllocError::DoubleFree);
+    sampled_heap.my_free(blocks[1]); // Freed at once: caught as free
+    caught = caught && failsWith(AllocError::DoubleFree);
+    if (stats.quarantined_blocks != 2 || stats.total_frees != 6 || !caught ||
+        !sampled_heap.verifyStats()) {
+      TEST_FAILED("Sampling did not quarantine every fourth free");
+      return false;
+    }
+  }
+
+  printSectionHeader("Blocks freed at once are poisoned up to 256 bytes");
+  {
+    AllocatorOptions sampled = options;
+    sampled.quarantine_sample = 1000;
+    MemoryAllocator sampled_heap(sampled);
+    sampled_heap.my_free(sampled_heap.my_malloc(16)); // Takes the sample
+    unsigned char *data =
+        static_cast<unsigned char *>(sampled_heap.my_malloc(512));
+    void *guard = sampled_heap.my_malloc(16);
+    std::memset(data, 0x11, 512);
+    sampled_heap.my_free(data);
+    auto all = [&](size_t from, size_t to, unsigned char value) {
+      return std::all_of(data + from, data + to,
+                         [value](unsigned char c) { return c == value; });
+    };
+    bool poisoned = all(sizeof(FreeLinks), MemoryAllocator::POISON_CHECK_BYTES,
+                        MemoryAllocator::POISON_BYTE);
+    bool bounded = all(MemoryAllocator::POISON_CHECK_BYTES, 512, 0x11);
+    if (sampled_heap.getStats().quarantined_blocks != 1 || !poisoned ||
+        !bounded || !sampled_heap.verifyStats()) {
+      TEST_FAILED("A block freed at once kept its old contents");
+      return false;
+    }
+    sampled_heap.my_free(guard);
+  }
+
+  printSectionHeader("Every allocation path stamps its blocks");
+  {
+    void *aligned = heap.my_aligned_alloc(256, 100);
+    void *grown = heap.my_realloc(heap.my_malloc(40), 400);
+    void *zeroed = heap.my_calloc(10, 10);
+    void *batch[8];
+    size_t got = heap.my_malloc_batch(24, 8, batch);
+    heap.my_free(aligned);
+    heap.my_free(grown);
+    heap.my_free(zeroed);
+    heap.my_free_batch(batch, got);
+    heap.flushQuarantine();
+    MemoryStats stats = heap.getStats();
+    if (got != 8 || last_error() != AllocError::None ||
+        stats.used_memory != 0 || stats.quarantined_blocks != 0 ||
+        !heap.verifyStats()) {
+      TEST_FAILED("A block handed out by the heap failed validation");
+      return false;
+    }
+  }
+
+  TEST_PASSED();
+  return true;
+}
+
+//=============================================================================
+// Main Entry Point
+//=============================================================================
+
+int main() {
+  std::cout << "\n";
+  std::cout << "╔══════════════════════════════════════════════════════════════"
+               "════╗\n";
+  std::cout << "║                                                              "
+               "    ║\n";
+  std::cout << "║            CUSTOM MEMORY ALLOCATOR - C++ IMPLEMENTATION      "
+               "    ║\n";
+  std::cout << "║                                                              "
+               "    ║\n";
+  std::cout << "║  Features:                                                   "
+               "    ║\n";
+  std::cout << "║    • Custom malloc() and free() functions                    "
+               "    ║\n";
+  std::cout << "║    • Block splitting for efficient memory usage              "
+               "    ║\n";
+  std::cout << "║    • Block coalescing to minimize fragmentation              "
+               "    ║\n";
+  std::cout << "║    • Memory statistics and heap visualization                "
+               "    ║\n";
+  std::cout << "║                                                              "
+               "    ║\n";
+  std::cout << "╚══════════════════════════════════════════════════════════════"
+               "════╝\n";
+
+  // The demos below provoke errors on purpose; show them as they happen
+  on_error(printErrorHandler);
+
+  int passed = 0;
+  int failed = 0;
+
+  // Run all tests
+  if (testBasicAllocation())
+    passed++;
+  else
+    failed++;
+  if (testMultipleAllocations())
+    passed++;
+  else
+    failed++;
+  if (testBlockSplitting())
+    passed++;
+  else
+    failed++;
+  if (testBlockCoalescing())
+    passed++;
+  else
+    failed++;
+  if (testFragmentation())
+    passed++;
+  else
+    failed++;
+  if (testRealloc())
+    passed++;
+  else
+    failed++;
+  if (testCalloc())
+    passed++;
+  else
+    failed++;
+  if (testEdgeCases())
+    passed++;
+  else
+    failed++;
+  if (testMemoryReuse())
+    passed++;
+  else
+    failed++;
+  if (testGlobalAllocator())
+    passed++;
+  else
+    failed++;
+  if (testSegregatedFit())
+    passed++;
+  else
+    failed++;
+  if (testIncrementalStats())
+    passed++;
+  else
+    failed++;
+  if (testBoundaryTags())
+    passed++;
+  else
+    failed++;
+  if (testThreadCaches())
+    passed++;
+  else
+    failed++;
+  if (testArenaSet())
+    passed++;
+  else
+    failed++;
+  if (testFixedPool())
+    passed++;
+  else
+    failed++;
+  if (testGrowableHeap())
+    passed++;
+  else
+    failed++;
+  if (testPurgeAndTrim())
+    passed++;
+  else
+    failed++;
+  if (testHugePages())
+    passed++;
+  else
+    failed++;
+  if (testLargeAllocations())
+    passed++;
+  else
+    failed++;
+  if (testInPlaceRealloc())
+    passed++;
+  else
+    failed++;
+  if (testAlignedAlloc())
+    passed++;
+  else
+    failed++;
+
+  if (testBatchAlloc())
+    passed++;
+  else
+    failed++;
+  if (testSizedFree())
+    passed++;
+  else
+    failed++;
+  if (testInterposeSupport())
+    passed++;
+  else
+    failed++;
+  if (testMonotonicArena())
+    passed++;
+  else
+    failed++;
+  if (testStlAdapters())
+    passed++;
+  else
+    failed++;
+  if (testErrorReporting())
+    passed++;
+  else
+    failed++;
+  if (testLazyZeroCalloc())
+    passed++;
+  else
+    failed++;
+  if (testProfiler())
+    passed++;
+  else
+    failed++;
+  if (testStatsExport())
+    passed++;
+  else
+    failed++;
+  if (testTracer())
+    passed++;
+  else
+    failed++;
+  if (testPlacementPolicies())
+    passed++;
+  else
+    failed++;
+  if (testTlsf())
+    passed++;
+  else
+    failed++;
+  if (testBuddyAllocator())
+    passed++;
+  else
+    failed++;
+  if (testSlabAllocator())
+    passed++;
+  else
+    failed++;
+  if (testNumaArenas())
+    passed++;
+  else
+    failed++;
+  if (testMovableHeap())
+    passed++;
+  else
+    failed++;
+  if (testHardenedMode())
+    passed++;
+  else
+    failed++;
   // Print summary
   std::cout << "\n";
   std::cout << "╔══════════════════════════════════════════════════════════════"
@@ -7,79 +7,386 @@
  */
 
 #include "memory_allocator.hpp"
+#include "os_memory.hpp"
+#include "profiler.hpp"
+#include "tracer.hpp"
 #include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
 #include <cstring>
-
+#include <iterator>
+#include <new>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CUSTOM_ALLOC_STREAMING_STORES 1
+#endif
 
 namespace CustomAllocator {
 
-// Global allocator instance
-MemoryAllocator *g_allocator = nullptr;
+static_assert(sizeof(FreeLinks) <= MemoryAllocator::MIN_BLOCK_SIZE,
+              "Free blocks must be able to hold their size-class links");
+static_assert(MemoryAllocator::ALIGNMENT > MemoryBlock::FLAG_MASK,
+              "Block sizes must leave the flag bits clear");
+
+namespace {
+
+/// Index of the lowest set bit (value must be non-zero)
+inline size_t lowestSetBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#else
+  return static_cast<size_t>(__builtin_ctzll(value));
+#endif
+}
+
+/// Index of the highest set bit (value must be non-zero)
+inline size_t highestSetBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return index;
+#else
+  return 63 - static_cast<size_t>(__builtin_clzll(value));
+#endif
+}
+
+/// Frees between reads of the purge timer
+constexpr uint32_t PURGE_CLOCK_INTERVAL = 64;
+
+/// Monotonic clock in milliseconds
+inline uint64_t nowMs() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+/// Usable size of a block just handed out (0 for nullptr)
+inline size_t allocatedSize(void *ptr) {
+  return ptr ? MemoryBlock::fromData(ptr)->size() : 0;
+}
+
+/// Clears at or above this size use streaming stores instead of memset
+constexpr size_t STREAMING_ZERO_THRESHOLD = 1024 * 1024;
+
+/**
+ * Zero a block for calloc(). Buffers far larger than the cache are
+ * cleared with non-temporal stores, so they neither evict the working set
+ * nor pay for reading the lines in first.
+ */
+inline void zeroFill(void *ptr, size_t size) {
+#if defined(CUSTOM_ALLOC_STREAMING_STORES)
+  if (size >= STREAMING_ZERO_THRESHOLD) {
+    char *bytes = static_cast<char *>(ptr);
+    size_t head = (16 - (reinterpret_cast<uintptr_t>(bytes) & 15)) & 15;
+    std::memset(bytes, 0, head);
+    bytes += head;
+    size -= head;
+
+    const __m128i zero = _mm_setzero_si128();
+    char *end = bytes + (size & ~size_t(63));
+    for (; bytes != end; bytes += 64) {
+      _mm_stream_si128(reinterpret_cast<__m128i *>(bytes), zero);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(bytes + 16), zero);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(bytes + 32), zero);
+      _mm_stream_si128(reinterpret_cast<__m128i *>(bytes + 48), zero);
+    }
+    // Order the weakly-ordered stores before the pointer is published
+    _mm_sfence();
+    std::memset(bytes, 0, size & 63);
+    return;
+  }
+#endif
+  std::memset(ptr, 0, size);
+}
+
+/**
+ * Poison size bytes with four fills of Chunk bytes a third of the span
+ * apart, covering any size from Chunk to four times Chunk with no branch on
+ * its exact length. Fixed sizes compile to inline stores, which for runs
+ * this short cost less than a call into memset.
+ */
+template <size_t Chunk> inline void poisonChunks(char *bytes, size_t size) {
+  constexpr int poison = MemoryAllocator::POISON_BYTE;
+  size_t span = size - Chunk;
+  std::memset(bytes, poison, Chunk);
+  std::memset(bytes + span / 3, poison, Chunk);
+  std::memset(bytes + span * 2 / 3, poison, Chunk);
+  std::memset(bytes + span, poison, Chunk);
+}
+
+/// Poison the first size bytes of a freed block, 16 to 256
+inline void poisonFill(void *ptr, size_t size) {
+  char *bytes = static_cast<char *>(ptr);
+  if (size <= 64) {
+    poisonChunks<16>(bytes, size);
+  } else if (size <= 128) {
+    poisonChunks<32>(bytes, size);
+  } else {
+    poisonChunks<64>(bytes, size);
+  }
+}
+
+/// TLSF list of a block size: size class, then which 16th of the class
+inline void tlsfMapping(size_t size, size_t &fl, size_t &sl) {
+  fl = highestSetBit(static_cast<uint64_t>(size));
+  sl = (size >> (fl - MemoryAllocator::TLSF_SL_LOG2)) &
+       (MemoryAllocator::TLSF_SL_COUNT - 1);
+}
+
+/// Cartesian tree children; the tree reuses a free block's list links
+inline MemoryBlock *&treeLeft(MemoryBlock *block) {
+  return block->links()->prev_free;
+}
+
+inline MemoryBlock *&treeRight(MemoryBlock *block) {
+  return block->links()->next_free;
+}
+
+/**
+ * Heap order of the address tree: the larger block sits above. Equal
+ * sizes are ordered by an address hash, so runs of same-sized holes still
+ * shape a random treap instead of a list.
+ */
+inline bool treeOutranks(const MemoryBlock *a, const MemoryBlock *b) {
+  if (a->size() != b->size()) {
+    return a->size() > b->size();
+  }
+  return reinterpret_cast<uintptr_t>(a) * 0x9E3779B97F4A7C15ull >
+         reinterpret_cast<uintptr_t>(b) * 0x9E3779B97F4A7C15ull;
+}
+
+} // namespace
+
+/**
+ * TLSF free lists: lists[fl][sl] holds the free blocks whose size has
+ * highest bit fl and next TLSF_SL_LOG2 bits sl, with one bitmap bit per
+ * non-empty list and one per size class that has any.
+ */
+struct MemoryAllocator::TlsfIndex {
+  uint64_t fl_bitmap;
+  uint32_t sl_bitmap[NUM_SIZE_CLASSES];
+  MemoryBlock *lists[NUM_SIZE_CLASSES][TLSF_SL_COUNT];
+};
+
+static_assert(MemoryAllocator::TLSF_SL_COUNT <= 32,
+              "Each size class's TLSF lists share one 32-bit bitmap");
+static_assert((MemoryAllocator::MIN_BLOCK_SIZE >> MemoryAllocator::TLSF_SL_LOG2) != 0,
+              "The smallest block must still split into TLSF lists");
+
+const char *placementPolicyName(PlacementPolicy policy) {
+  switch (policy) {
+  case PlacementPolicy::FirstFit:
+    return "first-fit";
+  case PlacementPolicy::NextFit:
+    return "next-fit";
+  case PlacementPolicy::BestFit:
+    return "best-fit";
+  case PlacementPolicy::AddressOrderedFirstFit:
+    return "address-ordered";
+  case PlacementPolicy::Tlsf:
+    return "tlsf";
+  }
+  return "unknown";
+}
 
 //=============================================================================
 // MemoryAllocator - Constructors and Destructor
 //=============================================================================
 
 MemoryAllocator::MemoryAllocator(size_t heap_size)
-    : heap_size_(heap_size), free_list_(nullptr), stats_{}, owns_memory_(true) {
-  // Allocate the heap using system malloc
-  heap_start_ = static_cast<char *>(std::malloc(heap_size));
+    : MemoryAllocator([heap_size]() {
+        AllocatorOptions options;
+        options.heap_size = heap_size;
+        return options;
+      }()) {}
+
+MemoryAllocator::MemoryAllocator(const AllocatorOptions &options)
+    : heap_size_(options.heap_size & ~(options.alignment - 1)), primary_{},
+      options_(options), size_classes_{}, class_bitmap_(0),
+      next_fit_rover_(0), address_tree_(nullptr), tlsf_(nullptr), stats_{},
+      owns_memory_(true), large_table_(nullptr), large_count_(0),
+      large_capacity_(0), numa_bound_(false), canary_secret_(0),
+      quarantine_{}, quarantine_head_(0), mapping_hook_(nullptr),
+      mapping_context_(nullptr) {
+  // Headers are 16 bytes, so 16 is the most every block can share
+  if (options_.alignment != ALIGNMENT && options_.alignment != 16) {
+    throw std::invalid_argument("Alignment must be 8 or 16");
+  }
+  if (heap_size_ < 2 * sizeof(MemoryBlock) + MIN_BLOCK_SIZE) {
+    throw std::invalid_argument("Heap size too small");
+  }
+
+  // Map the heap straight from the OS so free pages can be purged
+  if (options_.huge_pages) {
+    if (heap_size_ > SIZE_MAX - OS_HUGE_PAGE_SIZE) {
+      throw std::bad_alloc();
+    }
+    heap_size_ = (heap_size_ + OS_HUGE_PAGE_SIZE - 1) & ~(OS_HUGE_PAGE_SIZE - 1);
+    heap_start_ = static_cast<char *>(
+        osMapHugeMemory(heap_size_, &primary_.backing));
+  } else {
+    heap_start_ = static_cast<char *>(osMapMemory(heap_size_));
+  }
   if (!heap_start_) {
     throw std::bad_alloc();
   }
-  heap_end_ = heap_start_ + heap_size;
+  heap_end_ = heap_start_ + heap_size_;
+  numa_bound_ = bindToNode(heap_start_, heap_size_);
+
+  // Canaries are keyed per heap, so a header copied from another heap or
+  // forged without the key does not pass
+  if (options_.hardened) {
+    canary_secret_ =
+        (reinterpret_cast<uintptr_t>(heap_start_) ^
+         static_cast<uint64_t>(
+             std::chrono::steady_clock::now().time_since_epoch().count())) *
+        0xBF58476D1CE4E5B9ull;
+  }
 
-  initializeHeap();
+  // Fresh anonymous mappings read as zero
+  initializeHeap(true);
+  if (options_.placement != options.placement) {
+    releaseAllSegments();
+    osUnmapMemory(heap_start_, heap_size_);
+    throw std::invalid_argument("Heap size too small for the TLSF index");
+  }
 }
 
 MemoryAllocator::MemoryAllocator(void *memory, size_t size)
-    : heap_start_(static_cast<char *>(memory)),
-      heap_end_(static_cast<char *>(memory) + size), heap_size_(size),
-      free_list_(nullptr), stats_{}, owns_memory_(false) {
-  if (!memory || size < sizeof(MemoryBlock) + MIN_BLOCK_SIZE) {
+    : heap_start_(nullptr), heap_end_(nullptr), heap_size_(0), primary_{},
+      options_(), size_classes_{}, class_bitmap_(0), next_fit_rover_(0),
+      address_tree_(nullptr), tlsf_(nullptr), stats_{},
+      owns_memory_(false), large_table_(nullptr), large_count_(0),
+      large_capacity_(0), numa_bound_(false), canary_secret_(0),
+      quarantine_{}, quarantine_head_(0), mapping_hook_(nullptr),
+      mapping_context_(nullptr) {
+  if (!memory) {
     throw std::invalid_argument("Invalid memory region");
   }
 
-  initializeHeap();
+  // Headers must be aligned for the size flags to stay in the low bits
+  uintptr_t start = reinterpret_cast<uintptr_t>(memory);
+  uintptr_t aligned = (start + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+  size_t lost = aligned - start;
+  if (size < lost + 2 * sizeof(MemoryBlock) + MIN_BLOCK_SIZE) {
+    throw std::invalid_argument("Invalid memory region");
+  }
+
+  heap_start_ = reinterpret_cast<char *>(aligned);
+  heap_size_ = (size - lost) & ~(ALIGNMENT - 1);
+  heap_end_ = heap_start_ + heap_size_;
+
+  // External memory is a fixed region: never map or purge anything
+  options_.heap_size = heap_size_;
+  options_.alignment = ALIGNMENT;
+  options_.growable = false;
+  options_.huge_pages = false;
+  options_.purge_threshold = 0;
+  options_.purge_interval_ms = 0;
+  options_.large_threshold = 0;
+
+  initializeHeap(false);
 }
 
 MemoryAllocator::~MemoryAllocator() {
+  releaseAllLarge();
+  releaseAllSegments();
   if (owns_memory_ && heap_start_) {
-    std::free(heap_start_);
+    osUnmapMemory(heap_start_, heap_size_);
   }
   heap_start_ = nullptr;
   heap_end_ = nullptr;
-  free_list_ = nullptr;
 }
 
 MemoryAllocator::MemoryAllocator(MemoryAllocator &&other) noexcept
     : heap_start_(other.heap_start_), heap_end_(other.heap_end_),
-      heap_size_(other.heap_size_), free_list_(other.free_list_),
-      stats_(other.stats_), owns_memory_(other.owns_memory_) {
+      heap_size_(other.heap_size_), primary_(other.primary_),
+      options_(other.options_), class_bitmap_(other.class_bitmap_),
+      next_fit_rover_(other.next_fit_rover_),
+      address_tree_(other.address_tree_), tlsf_(other.tlsf_),
+      stats_(other.stats_), owns_memory_(other.owns_memory_),
+      dirty_bytes_(other.dirty_bytes_), last_purge_ms_(other.last_purge_ms_),
+      frees_since_clock_(other.frees_since_clock_),
+      large_table_(other.large_table_), large_count_(other.large_count_),
+      large_capacity_(other.large_capacity_), numa_bound_(other.numa_bound_),
+      canary_secret_(other.canary_secret_),
+      quarantine_head_(other.quarantine_head_),
+      frees_to_quarantine_(other.frees_to_quarantine_),
+      mapping_hook_(other.mapping_hook_),
+      mapping_context_(other.mapping_context_) {
+  std::copy(std::begin(other.size_classes_), std::end(other.size_classes_),
+            std::begin(size_classes_));
+  std::copy(std::begin(other.quarantine_), std::end(other.quarantine_),
+            std::begin(quarantine_));
   other.heap_start_ = nullptr;
   other.heap_end_ = nullptr;
-  other.free_list_ = nullptr;
+  other.primary_ = HeapSegment{};
+  other.class_bitmap_ = 0;
+  other.address_tree_ = nullptr;
+  other.tlsf_ = nullptr;
   other.owns_memory_ = false;
+  other.large_table_ = nullptr;
+  other.large_count_ = 0;
+  other.large_capacity_ = 0;
+  other.mapping_hook_ = nullptr;
 }
 
 MemoryAllocator &MemoryAllocator::operator=(MemoryAllocator &&other) noexcept {
   if (this != &other) {
+    releaseAllLarge();
+    releaseAllSegments();
     if (owns_memory_ && heap_start_) {
-      std::free(heap_start_);
+      osUnmapMemory(heap_start_, heap_size_);
     }
 
     heap_start_ = other.heap_start_;
     heap_end_ = other.heap_end_;
     heap_size_ = other.heap_size_;
-    free_list_ = other.free_list_;
+    primary_ = other.primary_;
+    options_ = other.options_;
+    std::copy(std::begin(other.size_classes_), std::end(other.size_classes_),
+              std::begin(size_classes_));
+    class_bitmap_ = other.class_bitmap_;
+    next_fit_rover_ = other.next_fit_rover_;
+    address_tree_ = other.address_tree_;
+    tlsf_ = other.tlsf_;
     stats_ = other.stats_;
     owns_memory_ = other.owns_memory_;
+    dirty_bytes_ = other.dirty_bytes_;
+    last_purge_ms_ = other.last_purge_ms_;
+    frees_since_clock_ = other.frees_since_clock_;
+    large_table_ = other.large_table_;
+    large_count_ = other.large_count_;
+    large_capacity_ = other.large_capacity_;
+    numa_bound_ = other.numa_bound_;
+    canary_secret_ = other.canary_secret_;
+    std::copy(std::begin(other.quarantine_), std::end(other.quarantine_),
+              std::begin(quarantine_));
+    quarantine_head_ = other.quarantine_head_;
+    frees_to_quarantine_ = other.frees_to_quarantine_;
+    mapping_hook_ = other.mapping_hook_;
+    mapping_context_ = other.mapping_context_;
 
     other.heap_start_ = nullptr;
     other.heap_end_ = nullptr;
-    other.free_list_ = nullptr;
+    other.primary_ = HeapSegment{};
+    other.class_bitmap_ = 0;
+    other.address_tree_ = nullptr;
+    other.tlsf_ = nullptr;
     other.owns_memory_ = false;
+    other.large_table_ = nullptr;
+    other.large_count_ = 0;
+    other.large_capacity_ = 0;
+    other.mapping_hook_ = nullptr;
   }
   return *this;
 }
@@ -88,27 +395,523 @@ MemoryAllocator &MemoryAllocator::operator=(MemoryAllocator &&other) noexcept {
 // Initialization
 //=============================================================================
 
-void MemoryAllocator::initializeHeap() {
-  // Create initial free block spanning the entire heap
-  free_list_ = reinterpret_cast<MemoryBlock *>(heap_start_);
-  free_list_->size = heap_size_ - sizeof(MemoryBlock);
-  free_list_->is_free = true;
-  free_list_->next = nullptr;
-  free_list_->prev = nullptr;
+void MemoryAllocator::initializeHeap(bool zeroed) {
+  // The primary segment is the whole initial heap
+  primary_.next = nullptr;
+  primary_.start = heap_start_;
+  primary_.end = heap_end_;
+  primary_.mapped_size = 0;
+  MemoryBlock *first_block = formatSegment(&primary_, zeroed);
+
+  // Start with empty size classes holding just the initial block; any
+  // TLSF index was inside the old heap contents
+  std::fill(std::begin(size_classes_), std::end(size_classes_), nullptr);
+  class_bitmap_ = 0;
+  next_fit_rover_ = 0;
+  address_tree_ = nullptr;
+  tlsf_ = nullptr;
+  insertFreeBlock(first_block);
 
   // Initialize statistics
   stats_.total_heap_size = heap_size_;
   stats_.used_memory = 0;
-  stats_.free_memory = free_list_->size;
+  stats_.free_memory = first_block->size();
   stats_.total_allocations = 0;
   stats_.total_frees = 0;
   stats_.block_count = 1;
   stats_.free_block_count = 1;
   stats_.coalesce_count = 0;
   stats_.split_count = 0;
+  stats_.segment_count = 1;
+  stats_.purge_count = 0;
+  stats_.purged_bytes = 0;
+  stats_.huge_page_bytes =
+      primary_.backing != HugePageBacking::None ? heap_size_ : 0;
+  stats_.large_count = 0;
+  stats_.large_bytes = 0;
+  stats_.realloc_in_place = 0;
+  stats_.realloc_moved = 0;
+  stats_.calloc_zero_hits = 0;
+  stats_.placement_searches = 0;
+  stats_.placement_steps = 0;
+  stats_.quarantined_blocks = 0;
+  stats_.quarantined_bytes = 0;
+  quarantine_head_ = 0;
+  frees_to_quarantine_ = 1;
+
+  dirty_bytes_ = 0;
+  last_purge_ms_ = nowMs();
+  frees_since_clock_ = 0;
+
+  // The TLSF index is carved from the fresh heap; without room for it the
+  // heap stays first-fit
+  if (options_.placement == PlacementPolicy::Tlsf) {
+    options_.placement = PlacementPolicy::FirstFit;
+    setPlacementPolicy(PlacementPolicy::Tlsf);
+  }
+}
+
+bool MemoryAllocator::bindToNode(void *memory, size_t size) const {
+  // The policy only affects pages faulted in after it is set
+  return options_.numa_node != OS_NO_NUMA_NODE &&
+         osBindMemory(memory, size, options_.numa_node);
+}
+
+MemoryBlock *MemoryAllocator::formatSegment(HeapSegment *segment,
+                                           bool zeroed) {
+  // One free block spanning the segment, minus the end sentinel
+  MemoryBlock *block = segment->firstBlock();
+  block->prev_size = 0;
+  block->size_flags = static_cast<size_t>(segment->end - segment->start) -
+                      2 * sizeof(MemoryBlock);
+
+  // The sentinel is a zero-sized allocated block that stops coalescing
+  segment->sentinel()->size_flags = 0;
+  block->setFree(true);
+  block->setZeroed(zeroed);
+  segment->sentinel()->prev_size = block->size();
+  return block;
+}
+
+void MemoryAllocator::reset() {
+  releaseAllLarge();
+  releaseAllSegments();
+
+  // The primary heap keeps whatever the old allocations wrote
+  initializeHeap(false);
+}
+
+//=============================================================================
+// Heap Segments
+//=============================================================================
+
+bool MemoryAllocator::addSegment(size_t size) {
+  const size_t header_size =
+      (sizeof(HeapSegment) + options_.alignment - 1) &
+      ~(options_.alignment - 1);
+  const size_t overhead = header_size + 2 * sizeof(MemoryBlock);
+  const size_t page = pageGranule();
+
+  size_t wanted = options_.segment_size ? options_.segment_size : heap_size_;
+  if (size > SIZE_MAX - overhead - page) {
+    return false;
+  }
+  wanted = std::max(wanted, size + overhead);
+  wanted = (wanted + page - 1) & ~(page - 1);
+
+  HugePageBacking backing = HugePageBacking::None;
+  char *memory = static_cast<char *>(
+      options_.huge_pages ? osMapHugeMemory(wanted, &backing)
+                          : osMapMemory(wanted));
+  if (!memory) {
+    return false;
+  }
+  bindToNode(memory, wanted);
+  notifyMapping(memory, wanted, true);
+
+  // The descriptor lives at the front of the mapping itself
+  HeapSegment *segment = reinterpret_cast<HeapSegment *>(memory);
+  segment->start = memory + header_size;
+  segment->end = memory + wanted;
+  segment->mapped_size = wanted;
+  segment->backing = backing;
+
+  // Newest segments go first, right after the primary heap
+  segment->next = primary_.next;
+  primary_.next = segment;
+
+  MemoryBlock *block = formatSegment(segment, true);
+  insertFreeBlock(block);
+
+  stats_.total_heap_size += wanted;
+  stats_.free_memory += block->size();
+  stats_.block_count++;
+  stats_.free_block_count++;
+  stats_.segment_count++;
+  if (backing != HugePageBacking::None) {
+    stats_.huge_page_bytes += wanted;
+  }
+  return true;
+}
+
+bool MemoryAllocator::releaseIfEmpty(HeapSegment **link) {
+  HeapSegment *segment = *link;
+  MemoryBlock *block = segment->firstBlock();
+  if (!block->isFree() || block->nextBlock() != segment->sentinel()) {
+    return false; // Still in use
+  }
+
+  removeFreeBlock(block);
+  stats_.total_heap_size -= segment->mapped_size;
+  stats_.free_memory -= block->size();
+  stats_.block_count--;
+  stats_.free_block_count--;
+  stats_.segment_count--;
+  if (segment->backing != HugePageBacking::None) {
+    stats_.huge_page_bytes -= segment->mapped_size;
+  }
+
+  *link = segment->next;
+  notifyMapping(segment, segment->mapped_size, false);
+  osUnmapMemory(segment, segment->mapped_size);
+  return true;
+}
+
+void MemoryAllocator::releaseTrailingSegments() {
+  while (primary_.next && releaseIfEmpty(&primary_.next)) {
+  }
+}
+
+void MemoryAllocator::releaseAllSegments() {
+  HeapSegment *segment = primary_.next;
+  while (segment) {
+    HeapSegment *next = segment->next;
+    notifyMapping(segment, segment->mapped_size, false);
+    osUnmapMemory(segment, segment->mapped_size);
+    segment = next;
+  }
+  primary_.next = nullptr;
+}
+
+//=============================================================================
+// Large Allocations
+//=============================================================================
+
+void *MemoryAllocator::allocateLarge(size_t size, size_t alignment) {
+  const size_t page = osPageSize();
+
+  // The header always fits in front of the data; over-aligned data may
+  // sit up to one alignment into the mapping
+  alignment = std::max(alignment, sizeof(MemoryBlock));
+  if (size > SIZE_MAX - alignment - page) {
+    reportError(AllocError::OutOfMemory, "my_malloc", nullptr, size);
+    return nullptr;
+  }
+  size_t mapped = (size + alignment + page - 1) & ~(page - 1);
+
+  // Make room in the side table first so a mapping is never orphaned
+  char *base = nullptr;
+  if (large_count_ < large_capacity_ || growLargeTable()) {
+    base = static_cast<char *>(osMapMemory(mapped));
+  }
+  if (!base) {
+    reportError(AllocError::OutOfMemory, "my_malloc", nullptr, size);
+    return nullptr;
+  }
+  bindToNode(base, mapped);
+  notifyMapping(base, mapped, true);
+
+  // A plain allocated header keeps fromData() valid on large pointers
+  uintptr_t data = (reinterpret_cast<uintptr_t>(base) + sizeof(MemoryBlock) +
+                    alignment - 1) &
+                   ~(alignment - 1);
+  MemoryBlock *block = MemoryBlock::fromData(reinterpret_cast<void *>(data));
+  block->prev_size = 0;
+  block->size_flags = (base + mapped) - static_cast<char *>(block->getData());
+  insertLarge({block->getData(), base, mapped});
+
+  stats_.total_allocations++;
+  stats_.large_count++;
+  stats_.large_bytes += mapped;
+  return block->getData();
+}
+
+void MemoryAllocator::freeLarge(size_t index) {
+  LargeAllocation large = large_table_[index];
+  std::copy(large_table_ + index + 1, large_table_ + large_count_,
+            large_table_ + index);
+  large_count_--;
+
+  notifyMapping(large.base, large.mapped_size, false);
+  osUnmapMemory(large.base, large.mapped_size);
+  stats_.total_frees++;
+  stats_.large_count--;
+  stats_.large_bytes -= large.mapped_size;
+}
+
+void *MemoryAllocator::reallocLarge(size_t index, size_t new_size) {
+  LargeAllocation large = large_table_[index];
+
+  // Shrunk below the threshold: move back into the heap if it has room
+  size_t offset = static_cast<char *>(large.data) - large.base;
+  if (new_size <= options_.large_threshold) {
+    size_t keep = std::min(new_size, large.mapped_size - offset);
+    void *small = my_malloc(new_size);
+    if (small) {
+      std::memcpy(small, large.data, keep);
+      freeLarge(index);
+      stats_.realloc_moved++;
+      return small;
+    }
+  }
+
+  const size_t page = osPageSize();
+  if (new_size > SIZE_MAX - offset - page) {
+    reportError(AllocError::SizeOverflow, "my_realloc", large.data, new_size);
+    return nullptr;
+  }
+  size_t mapped = (new_size + offset + page - 1) & ~(page - 1);
+  if (mapped == large.mapped_size) {
+    stats_.realloc_in_place++;
+    return large.data;
+  }
+
+  // The pages move with the mapping, so nothing is copied
+  notifyMapping(large.base, large.mapped_size, false);
+  char *base = static_cast<char *>(
+      osRemapMemory(large.base, large.mapped_size, mapped));
+  if (!base) {
+    notifyMapping(large.base, large.mapped_size, true);
+    reportError(AllocError::OutOfMemory, "my_realloc", nullptr, new_size);
+    return nullptr;
+  }
+  notifyMapping(base, mapped, true);
+
+  MemoryBlock *block = MemoryBlock::fromData(base + offset);
+  block->size_flags = mapped - offset;
+
+  // The address may have changed, so re-sort the entry
+  std::copy(large_table_ + index + 1, large_table_ + large_count_,
+            large_table_ + index);
+  large_count_--;
+  insertLarge({block->getData(), base, mapped});
+
+  stats_.large_bytes = stats_.large_bytes - large.mapped_size + mapped;
+  if (block->getData() == large.data) {
+    stats_.realloc_in_place++;
+  } else {
+    stats_.realloc_moved++;
+  }
+  return block->getData();
+}
+
+size_t MemoryAllocator::findLarge(const void *ptr) const {
+  uintptr_t key = reinterpret_cast<uintptr_t>(ptr);
+  const LargeAllocation *begin = large_table_;
+  const LargeAllocation *end = begin + large_count_;
+  const LargeAllocation *it = std::lower_bound(
+      begin, end, key, [](const LargeAllocation &entry, uintptr_t value) {
+        return reinterpret_cast<uintptr_t>(entry.data) < value;
+      });
+  if (it == end || reinterpret_cast<uintptr_t>(it->data) != key) {
+    return NO_LARGE;
+  }
+  return static_cast<size_t>(it - begin);
+}
+
+void MemoryAllocator::insertLarge(const LargeAllocation &entry) {
+  uintptr_t key = reinterpret_cast<uintptr_t>(entry.data);
+  LargeAllocation *end = large_table_ + large_count_;
+  LargeAllocation *it = std::lower_bound(
+      large_table_, end, key, [](const LargeAllocation &other, uintptr_t value) {
+        return reinterpret_cast<uintptr_t>(other.data) < value;
+      });
+  std::copy_backward(it, end, end + 1);
+  *it = entry;
+  large_count_++;
+}
+
+bool MemoryAllocator::growLargeTable() {
+  // The table lives in its own mapping so it never calls back into malloc
+  size_t capacity = large_capacity_
+                        ? large_capacity_ * 2
+                        : osPageSize() / sizeof(LargeAllocation);
+  size_t bytes = capacity * sizeof(LargeAllocation);
+  void *table =
+      large_table_
+          ? osRemapMemory(large_table_,
+                          large_capacity_ * sizeof(LargeAllocation), bytes)
+          : osMapMemory(bytes);
+  if (!table) {
+    return false;
+  }
+
+  large_table_ = static_cast<LargeAllocation *>(table);
+  large_capacity_ = capacity;
+  return true;
+}
+
+void MemoryAllocator::releaseAllLarge() {
+  for (size_t i = 0; i < large_count_; i++) {
+    notifyMapping(large_table_[i].base, large_table_[i].mapped_size, false);
+    osUnmapMemory(large_table_[i].base, large_table_[i].mapped_size);
+  }
+  if (large_table_) {
+    osUnmapMemory(large_table_, large_capacity_ * sizeof(LargeAllocation));
+  }
+  large_table_ = nullptr;
+  large_count_ = 0;
+  large_capacity_ = 0;
+}
+
+//=============================================================================
+// Purging
+//=============================================================================
+
+size_t MemoryAllocator::pageGranule() const {
+  // Purging part of a huge page would split it (or fail outright)
+  return options_.huge_pages ? OS_HUGE_PAGE_SIZE : osPageSize();
+}
+
+void MemoryAllocator::maybePurge() {
+  bool due =
+      options_.purge_threshold && dirty_bytes_ >= options_.purge_threshold;
+
+  // Reading the clock on every free is measurable, so sample it
+  if (!due && options_.purge_interval_ms &&
+      ++frees_since_clock_ >= PURGE_CLOCK_INTERVAL) {
+    frees_since_clock_ = 0;
+    due = dirty_bytes_ >= options_.purge_min_block &&
+          nowMs() - last_purge_ms_ >= options_.purge_interval_ms;
+  }
+
+  if (due) {
+    purgeFreeBlocks(options_.purge_min_block);
+    dirty_bytes_ = 0;
+    last_purge_ms_ = nowMs();
+  }
+}
+
+template <typename Visit>
+void MemoryAllocator::forEachFreeBlock(size_t first_class, Visit visit) {
+  auto visitList = [&](MemoryBlock *head) {
+    for (MemoryBlock *block = head; block; block = block->links()->next_free) {
+      visit(block);
+    }
+  };
+
+  uint64_t classes_mask = ~((uint64_t(1) << first_class) - 1);
+  if (tlsf_) {
+    uint64_t classes = tlsf_->fl_bitmap & classes_mask;
+    while (classes) {
+      size_t fl = lowestSetBit(classes);
+      classes &= classes - 1;
+      for (uint32_t lists = tlsf_->sl_bitmap[fl]; lists; lists &= lists - 1) {
+        visitList(tlsf_->lists[fl][lowestSetBit(lists)]);
+      }
+    }
+    return;
+  }
+
+  // The address tree has no per-class lists; walk the segments instead
+  if (addressOrdered()) {
+    for (HeapSegment *segment = &primary_; segment; segment = segment->next) {
+      for (MemoryBlock *block = segment->firstBlock(); !block->isSentinel();
+           block = block->nextBlock()) {
+        if (block->isFree() && sizeClassIndex(block->size()) >= first_class) {
+          visit(block);
+        }
+      }
+    }
+    return;
+  }
+
+  uint64_t classes = class_bitmap_ & classes_mask;
+  while (classes) {
+    size_t index = lowestSetBit(classes);
+    classes &= classes - 1;
+    visitList(size_classes_[index]);
+  }
+}
+
+size_t MemoryAllocator::purgeFreeBlocks(size_t min_block) {
+  const size_t page = pageGranule();
+  min_block = std::max(min_block, page);
+
+  // Only classes that can hold a block of min_block bytes or more
+  size_t purged = 0;
+  forEachFreeBlock(sizeClassIndex(min_block), [&](MemoryBlock *block) {
+    if (block->size() < min_block) {
+      return;
+    }
+
+    // Keep the free-list links resident; purge whole pages after them
+    uintptr_t data = reinterpret_cast<uintptr_t>(block->getData());
+    uintptr_t begin = (data + sizeof(FreeLinks) + page - 1) & ~(page - 1);
+    uintptr_t end = (data + block->size()) & ~(page - 1);
+    if (end > begin) {
+      bool dropped = osPurgeMemory(reinterpret_cast<void *>(begin),
+                                   end - begin, options_.lazy_purge);
+      purged += end - begin;
+
+      // Clearing the partial pages at either end makes the whole block
+      // known-zero, which calloc() can then skip
+      if (dropped && !block->isZeroed()) {
+        char *links_end = static_cast<char *>(block->getData()) +
+                          sizeof(FreeLinks);
+        std::memset(links_end, 0,
+                    reinterpret_cast<char *>(begin) - links_end);
+        std::memset(reinterpret_cast<void *>(end), 0,
+                    data + block->size() - end);
+        block->setZeroed(true);
+      }
+    }
+  });
+
+  stats_.purge_count++;
+  stats_.purged_bytes += purged;
+  return purged;
+}
+
+size_t MemoryAllocator::trim() {
+  flushQuarantine();
+  if (!owns_memory_) {
+    return 0;
+  }
+
+  // Every empty extra segment goes, not just the trailing ones
+  size_t released = 0;
+  HeapSegment **link = &primary_.next;
+  while (*link) {
+    size_t mapped = (*link)->mapped_size;
+    if (releaseIfEmpty(link)) {
+      released += mapped;
+    } else {
+      link = &(*link)->next;
+    }
+  }
+
+  released += purgeFreeBlocks(pageGranule());
+  dirty_bytes_ = 0;
+  last_purge_ms_ = nowMs();
+  return released;
 }
 
-void MemoryAllocator::reset() { initializeHeap(); }
+void *MemoryAllocator::slideBlock(void *ptr) {
+  if (!ptr || !inHeapSegments(ptr)) {
+    return ptr;
+  }
+  MemoryBlock *block = MemoryBlock::fromData(ptr);
+  if (block->isFree() || !block->isPrevFree()) {
+    return ptr;
+  }
+  ProfileScope profile;
+  TraceScope trace;
+
+  // The hole's own predecessor is allocated (free blocks are coalesced),
+  // so its prev_size of zero carries over to the moved block
+  MemoryBlock *hole = block->prevBlock();
+  size_t hole_size = hole->size();
+  size_t size = block->size();
+  removeFreeBlock(hole);
+
+  // Source and destination overlap whenever the block outgrows the hole
+  MemoryBlock *moved = hole;
+  moved->size_flags = size;
+  stampBlock(moved);
+  std::memmove(moved->getData(), ptr, size);
+
+  // The hole, same size, now sits between the block and its old successor
+  MemoryBlock *freed = moved->nextBlock();
+  freed->prev_size = 0;
+  freed->size_flags = hole_size;
+  markFree(freed);
+  coalesceBlock(freed);
+
+  trace.record(TraceOp::Realloc, ptr, moved->getData(), size);
+  profile.moved(ptr, moved->getData());
+  return moved->getData();
+}
 
 //=============================================================================
 // Core Allocation Functions
@@ -118,7 +921,21 @@ void *MemoryAllocator::my_malloc(size_t size) {
   if (size == 0) {
     return nullptr;
   }
+  ProfileScope profile;
+  TraceScope trace;
+
+  // Large requests get their own mapping and never touch the block lists
+  void *ptr = options_.large_threshold && size > options_.large_threshold
+                  ? allocateLarge(size)
+                  : allocateBlock(size, nullptr);
+  trace.record(TraceOp::Malloc, nullptr, ptr, size);
+  if (profile.active()) {
+    profile.allocated(ptr, size, allocatedSize(ptr));
+  }
+  return ptr;
+}
 
+void *MemoryAllocator::allocateBlock(size_t size, bool *zeroed) {
   // Align the requested size
   size = alignSize(size);
 
@@ -127,24 +944,33 @@ void *MemoryAllocator::my_malloc(size_t size) {
     size = MIN_BLOCK_SIZE;
   }
 
-  // Find a suitable free block using first-fit strategy
+  // Find a suitable free block from the size-class lists
   MemoryBlock *block = findFreeBlock(size);
 
+  // A growable heap maps another segment instead of failing
+  if (!block && options_.growable && addSegment(size)) {
+    block = findFreeBlock(size);
+  }
+
   if (!block) {
     // No suitable block found
-    std::cerr << "[my_malloc] ERROR: Out of memory! Requested: " << size
-              << " bytes\n";
+    reportError(AllocError::OutOfMemory, "my_malloc", nullptr, size);
     return nullptr;
   }
 
-  // Try to split the block if it's too large
-  splitBlock(block, size);
-
-  // Mark as allocated
-  block->is_free = false;
+  // Take the block off its size-class list and mark it allocated
+  bool was_zeroed = block->isZeroed();
+  removeFreeBlock(block);
+  markAllocated(block);
 
   // Update statistics
-  updateStatsAfterAlloc(block->size);
+  updateStatsAfterAlloc(block->size());
+
+  // Try to split the block if it's too large
+  splitBlock(block, size, was_zeroed);
+  if (zeroed) {
+    *zeroed = was_zeroed;
+  }
 
   // Return pointer to data portion (after metadata)
   return block->getData();
@@ -155,32 +981,146 @@ void MemoryAllocator::my_free(void *ptr) {
     return; // free(nullptr) is valid and does nothing
   }
 
-  // Validate pointer
-  if (!isValidPointer(ptr)) {
-    std::cerr << "[my_free] ERROR: Invalid pointer!\n";
-    return;
+  ProfileScope profile;
+  TraceScope trace;
+  size_t usable = profile.active() ? liveBlockSize(ptr) : 0;
+  releaseBlock(ptr);
+  trace.record(TraceOp::Free, ptr, nullptr, 0);
+  profile.freed(ptr, usable);
+}
+
+bool MemoryAllocator::releaseBlock(void *ptr) {
+  // Validate pointer; anything outside the segments may be a large mapping
+  const HeapSegment *segment = findSegment(ptr);
+  if (!segment) {
+    size_t index = findLarge(ptr);
+    if (index == NO_LARGE) {
+      reportError(AllocError::InvalidPointer, "my_free", ptr);
+      return false;
+    }
+    freeLarge(index);
+    return true;
   }
 
   // Get the block metadata
   MemoryBlock *block = MemoryBlock::fromData(ptr);
 
+  // A hardened heap validates the whole header and delays the reuse
+  if (options_.hardened) {
+    AllocError fault = checkBlock(ptr, segment);
+    if (fault != AllocError::None) {
+      reportError(fault, "my_free", ptr);
+      return false;
+    }
+    if (block->size() <= options_.quarantine_bytes &&
+        --frees_to_quarantine_ == 0) {
+      frees_to_quarantine_ = std::max<uint32_t>(options_.quarantine_sample, 1);
+      quarantineBlock(block);
+    } else {
+      // Blocks freed at once are poisoned too, so stale readers never see
+      // old data; the free lists then write their links over the front
+      poisonFill(ptr, std::min(block->size(), POISON_CHECK_BYTES));
+      freeHeapBlock(block);
+    }
+    return true;
+  }
+
   // Check if already free (double-free detection)
-  if (block->is_free) {
-    std::cerr << "[my_free] WARNING: Double free detected!\n";
-    return;
+  if (block->isFree()) {
+    reportError(AllocError::DoubleFree, "my_free", ptr);
+    return false;
   }
 
+  freeHeapBlock(block);
+  return true;
+}
+
+void MemoryAllocator::freeHeapBlock(MemoryBlock *block) {
   // Update statistics before coalescing
-  updateStatsAfterFree(block->size);
+  size_t size = block->size();
+  updateStatsAfterFree(size);
 
   // Mark as free
-  block->is_free = true;
+  markFree(block);
 
   // Coalesce with adjacent free blocks to reduce fragmentation
   coalesceBlock(block);
+
+  // Give fully free trailing segments back to the OS
+  if (options_.release_empty_segments) {
+    releaseTrailingSegments();
+  }
+
+  // Hand large free ranges back to the OS once enough has been freed
+  dirty_bytes_ += size;
+  if (options_.purge_threshold || options_.purge_interval_ms) {
+    maybePurge();
+  }
+}
+
+void MemoryAllocator::my_free_sized(void *ptr, size_t size) {
+  if (!ptr) {
+    return;
+  }
+  ProfileScope profile;
+  TraceScope trace;
+  size_t usable = profile.active() ? liveBlockSize(ptr) : 0;
+
+#ifdef DEBUG_MODE
+  // A wrong size would send the block to the wrong bin or table
+  if (isValidPointer(ptr) && !MemoryBlock::fromData(ptr)->isFree()) {
+    size_t held = MemoryBlock::fromData(ptr)->size();
+    size_t aligned = std::max(alignSize(size), MIN_BLOCK_SIZE);
+    bool matches = held >= size;
+    if (matches && inHeapSegments(ptr)) {
+      // Bin rounding and unsplit remainders leave less than this spare
+      matches = held - aligned < 2 * sizeof(MemoryBlock) + MIN_BLOCK_SIZE;
+    }
+    if (!matches) {
+      reportError(AllocError::SizeMismatch, "my_free_sized", ptr, size);
+      return;
+    }
+  }
+#endif
+
+  // Only large mappings hold more than the threshold; skip the segment walk
+  if (options_.large_threshold && size > options_.large_threshold) {
+    size_t index = findLarge(ptr);
+    if (index != NO_LARGE) {
+      freeLarge(index);
+      trace.record(TraceOp::Free, ptr, nullptr, size);
+      profile.freed(ptr, usable);
+      return;
+    }
+  }
+
+  releaseBlock(ptr);
+  trace.record(TraceOp::Free, ptr, nullptr, size);
+  profile.freed(ptr, usable);
 }
 
 void *MemoryAllocator::my_realloc(void *ptr, size_t new_size) {
+  ProfileScope profile;
+  TraceScope trace;
+  if (!profile.active()) {
+    void *result = reallocBlock(ptr, new_size);
+    trace.record(TraceOp::Realloc, ptr, result, new_size);
+    return result;
+  }
+
+  size_t old_usable = liveBlockSize(ptr);
+  void *result = reallocBlock(ptr, new_size);
+  trace.record(TraceOp::Realloc, ptr, result, new_size);
+  if (result) {
+    profile.reallocated(ptr, old_usable, result, new_size,
+                        allocatedSize(result));
+  } else if (new_size == 0) {
+    profile.freed(ptr, old_usable);
+  }
+  return result;
+}
+
+void *MemoryAllocator::reallocBlock(void *ptr, size_t new_size) {
   // realloc(nullptr, size) is equivalent to malloc(size)
   if (!ptr) {
     return my_malloc(new_size);
@@ -192,35 +1132,96 @@ void *MemoryAllocator::my_realloc(void *ptr, size_t new_size) {
     return nullptr;
   }
 
-  if (!isValidPointer(ptr)) {
-    std::cerr << "[my_realloc] ERROR: Invalid pointer!\n";
-    return nullptr;
+  const HeapSegment *segment = findSegment(ptr);
+  if (!segment) {
+    size_t index = findLarge(ptr);
+    if (index == NO_LARGE) {
+      reportError(AllocError::InvalidPointer, "my_realloc", ptr);
+      return nullptr;
+    }
+    return reallocLarge(index, new_size);
   }
 
   MemoryBlock *block = MemoryBlock::fromData(ptr);
-  size_t old_size = block->size;
+  if (options_.hardened) {
+    AllocError fault = checkBlock(ptr, segment);
+    if (fault != AllocError::None) {
+      // Resizing a freed block is a use after free, not a double free
+      reportError(fault == AllocError::DoubleFree ? AllocError::UseAfterFree
+                                                  : fault,
+                  "my_realloc", ptr);
+      return nullptr;
+    }
+  }
+  size_t old_size = block->size();
+
+  // Growing past the threshold moves the data into its own mapping
+  bool to_large =
+      options_.large_threshold && new_size > options_.large_threshold;
   new_size = alignSize(new_size);
 
-  // If new size fits in current block, just return the same pointer
+  if (new_size < MIN_BLOCK_SIZE) {
+    new_size = MIN_BLOCK_SIZE;
+  }
+
+  // Shrinking: keep the block and give the tail back
   if (new_size <= old_size) {
-    // Could potentially split the block here
+    splitBlock(block, new_size);
+    stats_.realloc_in_place++;
+    return ptr;
+  }
+
+  MemoryBlock *next = block->nextBlock();
+  size_t next_size = next->isFree() ? next->size() : 0;
+  size_t prev_size = block->isPrevFree() ? block->prev_size : 0;
+
+  // Grow forwards into a free next block; the data stays put
+  if (!to_large && next_size &&
+      old_size + sizeof(MemoryBlock) + next_size >= new_size) {
+    size_t combined_size = old_size + sizeof(MemoryBlock) + next_size;
+    removeFreeBlock(next);
+    block->setSize(combined_size);
+    block->nextBlock()->prev_size = 0;
+
+    // The absorbed block and its header become part of this allocation
+    stats_.free_memory -= next_size;
+    stats_.used_memory += combined_size - old_size;
+    stats_.free_block_count--;
+    stats_.block_count--;
+
+    splitBlock(block, new_size);
+    stats_.realloc_in_place++;
     return ptr;
   }
 
-  // Check if we can expand into the next block
-  if (block->next && block->next->is_free) {
-    size_t combined_size = old_size + sizeof(MemoryBlock) + block->next->size;
+  // Grow backwards into a free previous block (and the next one if needed)
+  if (!to_large && prev_size) {
+    size_t combined_size = prev_size + sizeof(MemoryBlock) + old_size;
+    bool take_next = combined_size < new_size && next_size;
+    if (take_next) {
+      combined_size += sizeof(MemoryBlock) + next_size;
+    }
+
     if (combined_size >= new_size) {
-      // Absorb the next block
-      MemoryBlock *next = block->next;
-      block->size = combined_size;
-      block->next = next->next;
-      if (block->next) {
-        block->next->prev = block;
+      MemoryBlock *prev = block->prevBlock();
+      removeFreeBlock(prev);
+      if (take_next) {
+        removeFreeBlock(next);
       }
-      stats_.free_block_count--;
-      stats_.block_count--;
-      return ptr;
+
+      // Regions overlap whenever the previous block is smaller than the data
+      std::memmove(prev->getData(), ptr, old_size);
+      prev->setSize(combined_size);
+      markAllocated(prev);
+
+      stats_.free_memory -= prev_size + (take_next ? next_size : 0);
+      stats_.used_memory += combined_size - old_size;
+      stats_.free_block_count -= take_next ? 2 : 1;
+      stats_.block_count -= take_next ? 2 : 1;
+
+      splitBlock(prev, new_size);
+      stats_.realloc_in_place++;
+      return prev->getData();
     }
   }
 
@@ -233,6 +1234,7 @@ void *MemoryAllocator::my_realloc(void *ptr, size_t new_size) {
   std::memcpy(new_ptr, ptr, old_size);
   my_free(ptr);
 
+  stats_.realloc_moved++;
   return new_ptr;
 }
 
@@ -241,113 +1243,945 @@ void *MemoryAllocator::my_calloc(size_t count, size_t size) {
 
   // Check for overflow
   if (count != 0 && total_size / count != size) {
-    std::cerr << "[my_calloc] ERROR: Size overflow!\n";
+    reportError(AllocError::SizeOverflow, "my_calloc", nullptr, size);
+    return nullptr;
+  }
+
+  if (total_size == 0) {
     return nullptr;
   }
+  ProfileScope profile;
+  TraceScope trace;
+
+  // A large request's fresh mapping is already zero
+  if (options_.large_threshold && total_size > options_.large_threshold) {
+    void *ptr = allocateLarge(total_size);
+    if (ptr) {
+      stats_.calloc_zero_hits++;
+    }
+    trace.record(TraceOp::Calloc, nullptr, ptr, total_size);
+    if (profile.active()) {
+      profile.allocated(ptr, total_size, allocatedSize(ptr));
+    }
+    return ptr;
+  }
 
-  void *ptr = my_malloc(total_size);
-  if (ptr) {
-    std::memset(ptr, 0, total_size);
+  bool zeroed = false;
+  void *ptr = allocateBlock(total_size, &zeroed);
+  if (!ptr) {
+    return nullptr;
   }
 
+  // A known-zero block only has its old free-list links to clear
+  if (zeroed) {
+    std::memset(ptr, 0, std::min(total_size, sizeof(FreeLinks)));
+    stats_.calloc_zero_hits++;
+  } else {
+    zeroFill(ptr, total_size);
+  }
+  trace.record(TraceOp::Calloc, nullptr, ptr, total_size);
+  if (profile.active()) {
+    profile.allocated(ptr, total_size, allocatedSize(ptr));
+  }
   return ptr;
 }
 
+void *MemoryAllocator::my_aligned_alloc(size_t alignment, size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    reportError(AllocError::InvalidAlignment, "my_aligned_alloc", nullptr,
+                alignment);
+    return nullptr;
+  }
+
+  // Every block already satisfies the heap's own alignment
+  if (alignment <= options_.alignment) {
+    return my_malloc(size);
+  }
+  ProfileScope profile;
+  TraceScope trace;
+
+  const size_t min_gap = sizeof(MemoryBlock) + MIN_BLOCK_SIZE;
+  if (size > SIZE_MAX / 2 || alignment > SIZE_MAX / 4) {
+    reportError(AllocError::OutOfMemory, "my_aligned_alloc", nullptr, size);
+    return nullptr;
+  }
+
+  if (options_.large_threshold && size > options_.large_threshold) {
+    void *ptr = allocateLarge(size, alignment);
+    trace.record(TraceOp::AlignedAlloc, reinterpret_cast<void *>(alignment),
+                 ptr, size);
+    if (profile.active()) {
+      profile.allocated(ptr, size, allocatedSize(ptr));
+    }
+    return ptr;
+  }
+
+  const size_t requested = size;
+  size = std::max(alignSize(size), MIN_BLOCK_SIZE);
+
+  // Any block this large fits the payload after the worst-case gap
+  size_t search = size + alignment + min_gap;
+  MemoryBlock *block = findFreeBlock(search);
+  if (!block && options_.growable && addSegment(search)) {
+    block = findFreeBlock(search);
+  }
+
+  if (!block) {
+    reportError(AllocError::OutOfMemory, "my_aligned_alloc", nullptr, size);
+    return nullptr;
+  }
+
+  removeFreeBlock(block);
+  markAllocated(block);
+  updateStatsAfterAlloc(block->size());
+
+  // First aligned address whose gap can stand as a free block of its own
+  uintptr_t data = reinterpret_cast<uintptr_t>(block->getData());
+  uintptr_t aligned = (data + alignment - 1) & ~(alignment - 1);
+  while (aligned != data && aligned - data < min_gap) {
+    aligned += alignment;
+  }
+  if (aligned != data) {
+    block = splitLeading(block, aligned - data);
+  }
+
+  splitBlock(block, size);
+  trace.record(TraceOp::AlignedAlloc, reinterpret_cast<void *>(alignment),
+               block->getData(), requested);
+  if (profile.active()) {
+    profile.allocated(block->getData(), requested, block->size());
+  }
+  return block->getData();
+}
+
+int MemoryAllocator::my_posix_memalign(void **memptr, size_t alignment,
+                                       size_t size) {
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0 ||
+      alignment % sizeof(void *) != 0) {
+    return EINVAL;
+  }
+
+  *memptr = nullptr;
+  if (size == 0) {
+    return 0;
+  }
+
+  void *ptr = my_aligned_alloc(alignment, size);
+  if (!ptr) {
+    return ENOMEM;
+  }
+  *memptr = ptr;
+  return 0;
+}
+
+size_t MemoryAllocator::my_malloc_batch(size_t size, size_t count,
+                                        void **out) {
+  if (size == 0 || count == 0 || !out) {
+    return 0;
+  }
+
+  ProfileScope profile;
+  TraceScope trace;
+  size_t allocated = carveBatch(size, count, out);
+  if (trace.active()) {
+    for (size_t i = 0; i < allocated; i++) {
+      trace.record(TraceOp::Malloc, nullptr, out[i], size);
+    }
+  }
+  if (profile.active()) {
+    profile.beginBatch(allocated);
+    for (size_t i = 0; i < allocated; i++) {
+      profile.batchAllocated(out[i], size, allocatedSize(out[i]));
+    }
+  }
+  return allocated;
+}
+
+size_t MemoryAllocator::carveBatch(size_t size, size_t count, void **out) {
+  // Large requests each need their own mapping
+  if (options_.large_threshold && size > options_.large_threshold) {
+    size_t allocated = 0;
+    while (allocated < count) {
+      void *ptr = allocateLarge(size);
+      if (!ptr) {
+        break;
+      }
+      out[allocated++] = ptr;
+    }
+    return allocated;
+  }
+
+  size = alignSize(size);
+  if (size < MIN_BLOCK_SIZE) {
+    size = MIN_BLOCK_SIZE;
+  }
+  const size_t stride = size + sizeof(MemoryBlock);
+
+  size_t allocated = 0;
+  while (allocated < count) {
+    // Prefer one block that holds everything still wanted
+    size_t remaining = count - allocated;
+    size_t wanted = remaining - 1 <= (SIZE_MAX - size) / stride
+                        ? size + (remaining - 1) * stride
+                        : size;
+
+    MemoryBlock *block = findFreeBlock(wanted);
+    if (!block) {
+      block = findFreeBlock(size);
+    }
+    if (!block && options_.growable &&
+        (addSegment(wanted) || addSegment(size))) {
+      block = findFreeBlock(size);
+    }
+    if (!block) {
+      reportError(AllocError::OutOfMemory, "my_malloc_batch", nullptr, size);
+      break;
+    }
+
+    bool zeroed = block->isZeroed();
+    removeFreeBlock(block);
+    markAllocated(block);
+    updateStatsAfterAlloc(block->size());
+
+    // Carve whole objects off the front. Every piece is allocated, so the
+    // new headers carry no footer and no free-list links.
+    size_t pieces =
+        std::min(remaining, (block->size() + sizeof(MemoryBlock)) / stride);
+    for (size_t i = 1; i < pieces; i++) {
+      size_t rest = block->size() - stride;
+      block->setSize(size);
+      stampBlock(block);
+      out[allocated++] = block->getData();
+
+      block = block->nextBlock();
+      block->prev_size = 0;
+      block->size_flags = rest;
+    }
+
+    // The carved headers came out of the allocated bytes
+    stats_.used_memory -= (pieces - 1) * sizeof(MemoryBlock);
+    stats_.block_count += pieces - 1;
+    stats_.split_count += pieces - 1;
+    stats_.total_allocations += pieces - 1;
+
+    // The last piece returns whatever is left over
+    splitBlock(block, size, zeroed);
+    out[allocated++] = block->getData();
+  }
+
+  return allocated;
+}
+
+void MemoryAllocator::my_free_batch(void **ptrs, size_t count) {
+  if (!ptrs) {
+    return;
+  }
+
+  // Each free is traced once its block is released, so rejected
+  // pointers stay out of the trace
+  ProfileScope profile;
+  TraceScope trace;
+  profile.beginBatch(count);
+
+  // Hardened frees are validated and quarantined one block at a time
+  if (options_.hardened) {
+    for (size_t i = 0; i < count; i++) {
+      if (ptrs[i]) {
+        size_t usable = profile.active() ? liveBlockSize(ptrs[i]) : 0;
+        if (releaseBlock(ptrs[i])) {
+          trace.record(TraceOp::Free, ptrs[i], nullptr, 0);
+        }
+        profile.batchFreed(ptrs[i], usable);
+      }
+    }
+    return;
+  }
+
+  // Address order puts physical neighbours next to each other
+  std::sort(ptrs, ptrs + count);
+
+  // Sizes are taken before the runs merge; a pointer listed twice is a
+  // double free and counted once
+  if (profile.active()) {
+    for (size_t i = 0; i < count; i++) {
+      if (ptrs[i] && (i == 0 || ptrs[i] != ptrs[i - 1])) {
+        profile.batchFreed(ptrs[i], liveBlockSize(ptrs[i]));
+      }
+    }
+  }
+
+  size_t freed = 0;
+  size_t i = 0;
+  while (i < count) {
+    void *ptr = ptrs[i];
+    if (!ptr) {
+      i++;
+      continue;
+    }
+
+    // Large mappings and invalid pointers take the ordinary path
+    if (!inHeapSegments(ptr)) {
+      if (releaseBlock(ptr)) {
+        trace.record(TraceOp::Free, ptr, nullptr, 0);
+      }
+      i++;
+      continue;
+    }
+
+    MemoryBlock *first = MemoryBlock::fromData(ptr);
+    if (first->isFree()) {
+      reportError(AllocError::DoubleFree, "my_free_batch", ptr);
+      i++;
+      continue;
+    }
+
+    // Extend the run over the allocated blocks that follow it in memory
+    MemoryBlock *last = first;
+    size_t run_bytes = first->size();
+    size_t run_length = 1;
+    trace.record(TraceOp::Free, ptr, nullptr, 0);
+    for (i++; i < count; i++) {
+      if (ptrs[i] == last->getData()) {
+        reportError(AllocError::DoubleFree, "my_free_batch", ptrs[i]);
+        continue;
+      }
+      MemoryBlock *next = last->nextBlock();
+      if (ptrs[i] != next->getData() || next->size() == 0 ||
+          next->isFree()) {
+        break;
+      }
+      trace.record(TraceOp::Free, ptrs[i], nullptr, 0);
+      run_bytes += next->size();
+      run_length++;
+      last = next;
+    }
+
+    // One free block spans the run, the inner headers included
+    size_t merged = run_bytes + (run_length - 1) * sizeof(MemoryBlock);
+    first->setSize(merged);
+    markFree(first);
+
+    stats_.used_memory -= run_bytes;
+    stats_.free_memory += merged;
+    stats_.total_frees += run_length;
+    stats_.block_count -= run_length - 1;
+    stats_.free_block_count++;
+    stats_.coalesce_count += run_length - 1;
+
+    coalesceBlock(first);
+    freed += run_bytes;
+  }
+
+  if (options_.release_empty_segments) {
+    releaseTrailingSegments();
+  }
+
+  dirty_bytes_ += freed;
+  if (options_.purge_threshold || options_.purge_interval_ms) {
+    maybePurge();
+  }
+}
+
+//=============================================================================
+// Hardened Mode
+//=============================================================================
+
+uint16_t MemoryAllocator::blockCanary(const MemoryBlock *block) const {
+  // Covering the size makes an overwritten size word fail the check on
+  // its own. The top bits of an odd multiple depend on every bit of the
+  // keyed value, so one multiply mixes it.
+  uint64_t key =
+      (reinterpret_cast<uintptr_t>(block) ^ canary_secret_) + block->size();
+  return static_cast<uint16_t>((key * 0x9E3779B97F4A7C15ull) >>
+                               MemoryBlock::CANARY_SHIFT);
+}
+
+AllocError MemoryAllocator::checkBlock(void *ptr,
+                                       const HeapSegment *segment) const {
+  if (reinterpret_cast<uintptr_t>(ptr) & (options_.alignment - 1)) {
+    return AllocError::InvalidPointer;
+  }
+
+  // A free block's canary is stale once it has coalesced, so the flags
+  // come first
+  MemoryBlock *block = MemoryBlock::fromData(ptr);
+  if (block->isFree() || block->isQuarantined()) {
+    return AllocError::DoubleFree;
+  }
+
+  // Interior pointers and overwritten size words both miss the canary
+  if (block->canary() != blockCanary(block)) {
+    return AllocError::CorruptedBlock;
+  }
+
+  // A forged size that matches by chance must still end in the segment
+  const char *data = static_cast<const char *>(ptr);
+  if (block->size() >
+      static_cast<size_t>(
+          reinterpret_cast<const char *>(segment->sentinel()) - data)) {
+    return AllocError::CorruptedBlock;
+  }
+
+  // A footer in front must describe a free block that ends right here.
+  // The free path branches on the footer right after this, so testing
+  // it here costs no extra misprediction.
+  size_t back = block->prev_size;
+  if (back) {
+    size_t offset = static_cast<size_t>(reinterpret_cast<char *>(block) -
+                                        segment->start);
+    if (back > offset || offset - back < sizeof(MemoryBlock)) {
+      return AllocError::CorruptedBlock;
+    }
+    const MemoryBlock *prev = block->prevBlock();
+    if (prev->size() != back || !prev->isFree()) {
+      return AllocError::CorruptedBlock;
+    }
+  }
+  return AllocError::None;
+}
+
+void MemoryAllocator::quarantineBlock(MemoryBlock *block) {
+  // Stale readers see the poison instead of the old contents
+  std::memset(block->getData(), POISON_BYTE, block->size());
+  block->setQuarantined(true);
+
+  if (stats_.quarantined_blocks == QUARANTINE_SLOTS) {
+    evictQuarantine();
+  }
+  size_t size = block->size();
+  quarantine_[(quarantine_head_ + stats_.quarantined_blocks) %
+              QUARANTINE_SLOTS] = {block, size};
+  stats_.quarantined_blocks++;
+  stats_.quarantined_bytes += size;
+
+  while (stats_.quarantined_bytes > options_.quarantine_bytes &&
+         stats_.quarantined_blocks) {
+    evictQuarantine();
+  }
+}
+
+size_t MemoryAllocator::evictQuarantine() {
+  // The size recorded on the way in keeps the byte count exact even when
+  // the header has since been overwritten
+  QuarantineEntry entry = quarantine_[quarantine_head_];
+  quarantine_head_ = (quarantine_head_ + 1) % QUARANTINE_SLOTS;
+  MemoryBlock *block = entry.block;
+  size_t size = entry.size;
+  stats_.quarantined_blocks--;
+  stats_.quarantined_bytes -= size;
+
+  // A header overwritten while quarantined cannot be trusted to free;
+  // the block is leaked rather than corrupting the free lists
+  if (block->size() != size || block->canary() != blockCanary(block) ||
+      !block->isQuarantined()) {
+    reportError(AllocError::CorruptedBlock, "my_free", block->getData());
+    return 0;
+  }
+
+  // A write through a dangling pointer shows up as damaged poison
+  const unsigned char *data =
+      static_cast<const unsigned char *>(block->getData());
+  unsigned char damage = 0;
+  for (size_t i = 0, n = std::min(size, POISON_CHECK_BYTES); i < n; i++) {
+    damage |= data[i] ^ POISON_BYTE;
+  }
+  if (damage) {
+    reportError(AllocError::UseAfterFree, "my_free", data, size);
+  }
+
+  block->setQuarantined(false);
+  freeHeapBlock(block);
+  return size;
+}
+
+size_t MemoryAllocator::flushQuarantine() {
+  size_t freed = 0;
+  while (stats_.quarantined_blocks) {
+    freed += evictQuarantine();
+  }
+  return freed;
+}
+
+//=============================================================================
+// Placement Policies
+//=============================================================================
+
+bool MemoryAllocator::setPlacementPolicy(PlacementPolicy policy) {
+  if (policy == PlacementPolicy::Tlsf) {
+    if (!tlsf_ && !enableTlsf()) {
+      return false;
+    }
+  } else if (tlsf_) {
+    disableTlsf();
+  }
+  bool was_tree = addressOrdered();
+  options_.placement = policy;
+  if (addressOrdered() != was_tree) {
+    reindexFreeBlocks();
+  }
+  return true;
+}
+
+void MemoryAllocator::reindexFreeBlocks() {
+  std::fill(std::begin(size_classes_), std::end(size_classes_), nullptr);
+  class_bitmap_ = 0;
+  address_tree_ = nullptr;
+  for (HeapSegment *segment = &primary_; segment; segment = segment->next) {
+    for (MemoryBlock *block = segment->firstBlock(); !block->isSentinel();
+         block = block->nextBlock()) {
+      if (block->isFree()) {
+        insertFreeBlock(block);
+      }
+    }
+  }
+}
+
+bool MemoryAllocator::enableTlsf() {
+  // The index is an ordinary allocated block, placed by the old policy;
+  // it shows in used_memory but not in the allocation counts
+  MemoryStats counters = stats_;
+  void *memory = allocateBlock(sizeof(TlsfIndex), nullptr);
+  stats_.total_allocations = counters.total_allocations;
+  stats_.placement_searches = counters.placement_searches;
+  stats_.placement_steps = counters.placement_steps;
+  if (!memory) {
+    return false;
+  }
+
+  tlsf_ = static_cast<TlsfIndex *>(memory);
+  std::memset(tlsf_, 0, sizeof(TlsfIndex));
+  std::fill(std::begin(size_classes_), std::end(size_classes_), nullptr);
+  class_bitmap_ = 0;
+  address_tree_ = nullptr;
+
+  // Re-index every free block; their links are simply overwritten
+  for (HeapSegment *segment = &primary_; segment; segment = segment->next) {
+    for (MemoryBlock *block = segment->firstBlock(); !block->isSentinel();
+         block = block->nextBlock()) {
+      if (block->isFree()) {
+        insertFreeBlock(block);
+      }
+    }
+  }
+  return true;
+}
+
+void MemoryAllocator::disableTlsf() {
+  void *memory = tlsf_;
+  tlsf_ = nullptr;
+
+  for (HeapSegment *segment = &primary_; segment; segment = segment->next) {
+    for (MemoryBlock *block = segment->firstBlock(); !block->isSentinel();
+         block = block->nextBlock()) {
+      if (block->isFree()) {
+        insertFreeBlock(block);
+      }
+    }
+  }
+
+  // Freed into the size classes, so it coalesces like any other block;
+  // it never goes through a hardened heap's quarantine
+  size_t frees = stats_.total_frees;
+  freeHeapBlock(MemoryBlock::fromData(memory));
+  stats_.total_frees = frees;
+}
+
 //=============================================================================
 // Block Management Algorithms
 //=============================================================================
 
 MemoryBlock *MemoryAllocator::findFreeBlock(size_t size) {
-  // First-fit strategy: find first block that fits
-  MemoryBlock *current = free_list_;
+  size_t steps = 0;
+  MemoryBlock *block = nullptr;
+  switch (options_.placement) {
+  case PlacementPolicy::FirstFit:
+    block = findFirstFit(size, steps);
+    break;
+  case PlacementPolicy::BestFit:
+    block = findBestFit(size, steps);
+    break;
+  case PlacementPolicy::NextFit:
+    block = findLowestAddressFit(size, next_fit_rover_, steps);
+    if (block) {
+      next_fit_rover_ = reinterpret_cast<uintptr_t>(block);
+    }
+    break;
+  case PlacementPolicy::AddressOrderedFirstFit:
+    block = findLowestAddressFit(size, 0, steps);
+    break;
+  case PlacementPolicy::Tlsf:
+    block = findTlsfFit(size, steps);
+    break;
+  }
+
+  stats_.placement_searches++;
+  stats_.placement_steps += steps;
+  return block;
+}
+
+MemoryBlock *MemoryAllocator::findFirstFit(size_t size, size_t &steps) {
+  size_t index = sizeClassIndex(size);
 
+  // Blocks in the request's own class may be smaller than the request,
+  // so look at a few of them first-fit
+  MemoryBlock *current = size_classes_[index];
+  for (size_t scanned = 0; current && scanned < MAX_CLASS_SCAN; scanned++) {
+    steps++;
+    if (current->size() >= size) {
+      return current;
+    }
+    current = current->links()->next_free;
+  }
+
+  // Every block in a larger class fits: take the smallest non-empty one
+  uint64_t larger =
+      index + 1 < NUM_SIZE_CLASSES ? class_bitmap_ & (~0ULL << (index + 1)) : 0;
+  if (larger) {
+    steps++;
+    return size_classes_[lowestSetBit(larger)];
+  }
+
+  // Nothing larger is free; finish scanning the request's own class
   while (current) {
-    if (current->is_free && current->size >= size) {
+    steps++;
+    if (current->size() >= size) {
       return current;
     }
-    current = current->next;
+    current = current->links()->next_free;
   }
 
   return nullptr; // No suitable block found
 }
 
-bool MemoryAllocator::splitBlock(MemoryBlock *block, size_t size) {
+MemoryBlock *MemoryAllocator::findBestFit(size_t size, size_t &steps) {
+  size_t index = sizeClassIndex(size);
+  MemoryBlock *best = nullptr;
+  for (MemoryBlock *current = size_classes_[index]; current;
+       current = current->links()->next_free) {
+    steps++;
+    if (current->size() >= size &&
+        (!best || current->size() < best->size())) {
+      best = current;
+      if (best->size() == size) {
+        return best; // Nothing fits more tightly
+      }
+    }
+  }
+  if (best) {
+    return best;
+  }
+
+  uint64_t larger =
+      index + 1 < NUM_SIZE_CLASSES ? class_bitmap_ & (~0ULL << (index + 1)) : 0;
+  if (!larger) {
+    return nullptr;
+  }
+  for (MemoryBlock *current = size_classes_[lowestSetBit(larger)]; current;
+       current = current->links()->next_free) {
+    steps++;
+    if (!best || current->size() < best->size()) {
+      best = current;
+    }
+  }
+  return best;
+}
+
+MemoryBlock *MemoryAllocator::findLowestAddressFit(size_t size,
+                                                   uintptr_t after,
+                                                   size_t &steps) {
+  // A subtree whose root is too small holds nothing that fits. Above
+  // after, a fitting node is the best so far and anything lower must be
+  // to its left; at or below after, only its right subtree is eligible.
+  MemoryBlock *best = nullptr;
+  for (MemoryBlock *node = address_tree_; node && node->size() >= size;) {
+    steps++;
+    if (reinterpret_cast<uintptr_t>(node) > after) {
+      best = node;
+      node = treeLeft(node);
+    } else {
+      node = treeRight(node);
+    }
+  }
+  if (!best && after) {
+    return findLowestAddressFit(size, 0, steps);
+  }
+  return best;
+}
+
+MemoryBlock *MemoryAllocator::findTlsfFit(size_t size, size_t &steps) {
+  size_t fl;
+  size_t sl;
+  steps++;
+
+  // Round up to the next list boundary: every block from there up fits
+  size_t round = (size_t(1) << (highestSetBit(size) - TLSF_SL_LOG2)) - 1;
+  if (size <= SIZE_MAX - round) {
+    tlsfMapping(size + round, fl, sl);
+    uint32_t lists = tlsf_->sl_bitmap[fl] & (~0u << sl);
+    if (!lists && fl + 1 < NUM_SIZE_CLASSES) {
+      uint64_t classes = tlsf_->fl_bitmap & (~0ULL << (fl + 1));
+      if (classes) {
+        fl = lowestSetBit(classes);
+        lists = tlsf_->sl_bitmap[fl];
+      }
+    }
+    if (lists) {
+      return tlsf_->lists[fl][lowestSetBit(lists)];
+    }
+  }
+
+  // Nothing larger is free; a few blocks of the request's own list may
+  // still be big enough
+  tlsfMapping(size, fl, sl);
+  MemoryBlock *current = tlsf_->lists[fl][sl];
+  for (size_t scanned = 0; current && scanned < MAX_CLASS_SCAN; scanned++) {
+    steps++;
+    if (current->size() >= size) {
+      return current;
+    }
+    current = current->links()->next_free;
+  }
+  return nullptr;
+}
+
+size_t MemoryAllocator::sizeClassIndex(size_t size) {
+  // Class i holds blocks of size [2^i, 2^(i+1))
+  return highestSetBit(static_cast<uint64_t>(size));
+}
+
+void MemoryAllocator::insertFreeBlock(MemoryBlock *block) {
+  if (!tlsf_ && addressOrdered()) {
+    insertTreeBlock(block);
+    return;
+  }
+
+  MemoryBlock **head;
+  if (tlsf_) {
+    size_t fl;
+    size_t sl;
+    tlsfMapping(block->size(), fl, sl);
+    head = &tlsf_->lists[fl][sl];
+    tlsf_->fl_bitmap |= 1ULL << fl;
+    tlsf_->sl_bitmap[fl] |= 1u << sl;
+  } else {
+    size_t index = sizeClassIndex(block->size());
+    head = &size_classes_[index];
+    class_bitmap_ |= 1ULL << index;
+  }
+
+  FreeLinks *links = block->links();
+  links->prev_free = nullptr;
+  links->next_free = *head;
+  if (links->next_free) {
+    links->next_free->links()->prev_free = block;
+  }
+  *head = block;
+}
+
+void MemoryAllocator::removeFreeBlock(MemoryBlock *block) {
+  if (!tlsf_ && addressOrdered()) {
+    removeTreeBlock(block);
+    return;
+  }
+
+  FreeLinks *links = block->links();
+
+  if (links->prev_free) {
+    links->prev_free->links()->next_free = links->next_free;
+  } else if (tlsf_) {
+    size_t fl;
+    size_t sl;
+    tlsfMapping(block->size(), fl, sl);
+    tlsf_->lists[fl][sl] = links->next_free;
+    if (!links->next_free) {
+      tlsf_->sl_bitmap[fl] &= ~(1u << sl);
+      if (!tlsf_->sl_bitmap[fl]) {
+        tlsf_->fl_bitmap &= ~(1ULL << fl);
+      }
+    }
+  } else {
+    size_t index = sizeClassIndex(block->size());
+    size_classes_[index] = links->next_free;
+    if (!links->next_free) {
+      class_bitmap_ &= ~(1ULL << index);
+    }
+  }
+
+  if (links->next_free) {
+    links->next_free->links()->prev_free = links->prev_free;
+  }
+}
+
+void MemoryAllocator::insertTreeBlock(MemoryBlock *block) {
+  // Descend by address until the block outranks the subtree's root
+  MemoryBlock **link = &address_tree_;
+  while (*link && !treeOutranks(block, *link)) {
+    link = block < *link ? &treeLeft(*link) : &treeRight(*link);
+  }
+
+  // Split that subtree around the block's address into its two children
+  MemoryBlock *node = *link;
+  MemoryBlock **left = &treeLeft(block);
+  MemoryBlock **right = &treeRight(block);
+  while (node) {
+    if (node < block) {
+      *left = node;
+      left = &treeRight(node);
+      node = *left;
+    } else {
+      *right = node;
+      right = &treeLeft(node);
+      node = *right;
+    }
+  }
+  *left = nullptr;
+  *right = nullptr;
+  *link = block;
+}
+
+void MemoryAllocator::removeTreeBlock(MemoryBlock *block) {
+  MemoryBlock **link = &address_tree_;
+  while (*link != block) {
+    link = block < *link ? &treeLeft(*link) : &treeRight(*link);
+  }
+
+  // Zip the children together: every left node is below every right one
+  MemoryBlock *left = treeLeft(block);
+  MemoryBlock *right = treeRight(block);
+  while (left && right) {
+    if (treeOutranks(left, right)) {
+      *link = left;
+      link = &treeRight(left);
+      left = *link;
+    } else {
+      *link = right;
+      link = &treeLeft(right);
+      right = *link;
+    }
+  }
+  *link = left ? left : right;
+}
+
+void MemoryAllocator::markAllocated(MemoryBlock *block) {
+  block->setFree(false);
+  block->setZeroed(false);
+  block->nextBlock()->prev_size = 0;
+}
+
+void MemoryAllocator::markFree(MemoryBlock *block) {
+  block->setFree(true);
+
+  // The boundary tag: the next block learns our size so it can find us
+  MemoryBlock *next = block->nextBlock();
+  next->prev_size = block->size();
+}
+
+bool MemoryAllocator::splitBlock(MemoryBlock *block, size_t size,
+                                 bool zeroed) {
   // Calculate remaining space after allocation
-  size_t remaining = block->size - size;
+  size_t remaining = block->size() - size;
 
   // Only split if remaining space can hold metadata + minimum data
   size_t min_split_size = sizeof(MemoryBlock) + MIN_BLOCK_SIZE;
 
   if (remaining < min_split_size) {
+    stampBlock(block);
     return false; // Not worth splitting
   }
 
-  // Create new block in the remaining space
-  char *new_block_addr =
-      reinterpret_cast<char *>(block) + sizeof(MemoryBlock) + size;
-  MemoryBlock *new_block = reinterpret_cast<MemoryBlock *>(new_block_addr);
+  // Shrink the original block; the remainder starts right after it
+  block->setSize(size);
+  stampBlock(block);
+  MemoryBlock *new_block = block->nextBlock();
 
-  // Initialize the new block
-  new_block->size = remaining - sizeof(MemoryBlock);
-  new_block->is_free = true;
-  new_block->next = block->next;
-  new_block->prev = block;
+  // Initialize the new block (its predecessor is allocated). Its header
+  // lands in the old data; the data past its links stays as it was.
+  new_block->prev_size = 0;
+  new_block->size_flags = remaining - sizeof(MemoryBlock);
+  new_block->setZeroed(zeroed);
 
-  // Update the next block's prev pointer
-  if (new_block->next) {
-    new_block->next->prev = new_block;
-  }
-
-  // Update original block
-  block->size = size;
-  block->next = new_block;
-
-  // Update statistics
+  // Update statistics: the tail leaves the allocation, minus its new header
+  stats_.used_memory -= remaining;
+  stats_.free_memory += new_block->size();
   stats_.block_count++;
   stats_.free_block_count++;
   stats_.split_count++;
 
+  // Make the remainder available, merging it with a free successor (only
+  // possible when realloc shrinks a block)
+  coalesceBlock(new_block);
+
   return true;
 }
 
-MemoryBlock *MemoryAllocator::coalesceBlock(MemoryBlock *block) {
-  bool coalesced = false;
+MemoryBlock *MemoryAllocator::splitLeading(MemoryBlock *block, size_t gap) {
+  // The allocation moves up; its end (and the successor's tag) stays put
+  MemoryBlock *aligned =
+      reinterpret_cast<MemoryBlock *>(reinterpret_cast<char *>(block) + gap);
+  aligned->size_flags = block->size() - gap;
 
-  // Try to coalesce with next block
-  if (block->next && block->next->is_free) {
-    // Absorb the next block
-    MemoryBlock *next = block->next;
-    block->size += sizeof(MemoryBlock) + next->size;
-    block->next = next->next;
+  // The front keeps the old header and becomes a free block. Its own
+  // predecessor is allocated, since free blocks are always coalesced.
+  block->setSize(gap - sizeof(MemoryBlock));
+  markFree(block);
+  insertFreeBlock(block);
+
+  stats_.used_memory -= gap;
+  stats_.free_memory += block->size();
+  stats_.block_count++;
+  stats_.free_block_count++;
+  stats_.split_count++;
+  return aligned;
+}
 
-    if (block->next) {
-      block->next->prev = block;
+MemoryBlock *MemoryAllocator::coalesceBlock(MemoryBlock *block) {
+  // Try to coalesce with next block
+  MemoryBlock *next = block->nextBlock();
+  if (next->isFree()) {
+    // Absorb the next block; its header and links become data, which a
+    // merge of two known-zero blocks clears to stay known-zero
+    removeFreeBlock(next);
+    bool zeroed = block->isZeroed() && next->isZeroed();
+    size_t merged = block->size() + sizeof(MemoryBlock) + next->size();
+    if (zeroed) {
+      std::memset(next, 0, sizeof(MemoryBlock) + sizeof(FreeLinks));
     }
+    block->setSize(merged);
+    block->setZeroed(zeroed);
 
+    stats_.free_memory += sizeof(MemoryBlock);
     stats_.block_count--;
     stats_.free_block_count--;
     stats_.coalesce_count++;
-    coalesced = true;
   }
 
   // Try to coalesce with previous block
-  if (block->prev && block->prev->is_free) {
+  if (block->isPrevFree()) {
     // Previous block absorbs current block
-    MemoryBlock *prev = block->prev;
-    prev->size += sizeof(MemoryBlock) + block->size;
-    prev->next = block->next;
-
-    if (prev->next) {
-      prev->next->prev = prev;
+    MemoryBlock *prev = block->prevBlock();
+    removeFreeBlock(prev);
+    bool zeroed = prev->isZeroed() && block->isZeroed();
+    size_t merged = prev->size() + sizeof(MemoryBlock) + block->size();
+    if (zeroed) {
+      std::memset(block, 0, sizeof(MemoryBlock) + sizeof(FreeLinks));
     }
+    prev->setSize(merged);
+    prev->setZeroed(zeroed);
 
+    stats_.free_memory += sizeof(MemoryBlock);
     stats_.block_count--;
     stats_.free_block_count--;
     stats_.coalesce_count++;
     block = prev;
-    coalesced = true;
   }
 
+  // Refresh the footer for the merged block
+  markFree(block);
+  insertFreeBlock(block);
   return block;
 }
 
@@ -355,13 +2189,34 @@ MemoryBlock *MemoryAllocator::coalesceBlock(MemoryBlock *block) {
 // Utility Functions
 //=============================================================================
 
-size_t MemoryAllocator::alignSize(size_t size) {
-  return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+size_t MemoryAllocator::liveBlockSize(void *ptr) const {
+  if (!ptr || !isValidPointer(ptr)) {
+    return 0;
+  }
+  MemoryBlock *block = MemoryBlock::fromData(ptr);
+  return block->isFree() ? 0 : block->size();
+}
+
+size_t MemoryAllocator::alignSize(size_t size) const {
+  return (size + options_.alignment - 1) & ~(options_.alignment - 1);
 }
 
 bool MemoryAllocator::isValidPointer(void *ptr) const {
-  char *p = static_cast<char *>(ptr);
-  return p >= heap_start_ + sizeof(MemoryBlock) && p < heap_end_;
+  return inHeapSegments(ptr) || findLarge(ptr) != NO_LARGE;
+}
+
+bool MemoryAllocator::inHeapSegments(const void *ptr) const {
+  return findSegment(ptr) != nullptr;
+}
+
+const HeapSegment *MemoryAllocator::findSegment(const void *ptr) const {
+  for (const HeapSegment *segment = &primary_; segment;
+       segment = segment->next) {
+    if (segment->contains(ptr)) {
+      return segment;
+    }
+  }
+  return nullptr;
 }
 
 void MemoryAllocator::updateStatsAfterAlloc(size_t size) {
@@ -369,7 +2224,6 @@ void MemoryAllocator::updateStatsAfterAlloc(size_t size) {
   stats_.free_memory -= size;
   stats_.total_allocations++;
   stats_.free_block_count--;
-  recalculateBlockCounts();
 }
 
 void MemoryAllocator::updateStatsAfterFree(size_t size) {
@@ -379,147 +2233,129 @@ void MemoryAllocator::updateStatsAfterFree(size_t size) {
   stats_.free_block_count++;
 }
 
-void MemoryAllocator::recalculateBlockCounts() {
-  size_t total = 0;
-  size_t free_count = 0;
-
-  MemoryBlock *current = free_list_;
-  while (current) {
-    total++;
-    if (current->is_free) {
-      free_count++;
+MemoryStats MemoryAllocator::getStats() const {
+  MemoryStats stats = stats_;
+
+  // The largest free block sits in the highest non-empty class (or list),
+  // or at the root of the address tree
+  stats.largest_free_block = 0;
+  if (tlsf_) {
+    if (tlsf_->fl_bitmap) {
+      size_t fl = highestSetBit(tlsf_->fl_bitmap);
+      for (MemoryBlock *block =
+               tlsf_->lists[fl][highestSetBit(tlsf_->sl_bitmap[fl])];
+           block; block = block->links()->next_free) {
+        stats.largest_free_block =
+            std::max(stats.largest_free_block, block->size());
+      }
+    }
+  } else if (address_tree_) {
+    stats.largest_free_block = address_tree_->size();
+  } else if (class_bitmap_) {
+    for (MemoryBlock *block = size_classes_[highestSetBit(class_bitmap_)];
+         block; block = block->links()->next_free) {
+      stats.largest_free_block =
+          std::max(stats.largest_free_block, block->size());
     }
-    current = current->next;
   }
-
-  stats_.block_count = total;
-  stats_.free_block_count = free_count;
+  return stats;
 }
 
-//=============================================================================
-// Statistics and Debugging
-//=============================================================================
-
-void MemoryAllocator::printStats() const {
-  std::cout << "\n";
-  std::cout
-      << "╔══════════════════════════════════════════════════════════════╗\n";
-  std::cout
-      << "║           CUSTOM MEMORY ALLOCATOR - STATISTICS               ║\n";
-  std::cout
-      << "╠══════════════════════════════════════════════════════════════╣\n";
-  std::cout << "║  Heap Size:          " << std::setw(12)
-            << stats_.total_heap_size << " bytes                    ║\n";
-  std::cout << "║  Used Memory:        " << std::setw(12) << stats_.used_memory
-            << " bytes                    ║\n";
-  std::cout << "║  Free Memory:        " << std::setw(12) << stats_.free_memory
-            << " bytes                    ║\n";
-  std::cout
-      << "╠══════════════════════════════════════════════════════════════╣\n";
-  std::cout << "║  Total Allocations:  " << std::setw(12)
-            << stats_.total_allocations << "                          ║\n";
-  std::cout << "║  Total Frees:        " << std::setw(12) << stats_.total_frees
-            << "                          ║\n";
-  std::cout << "║  Active Allocations: " << std::setw(12)
-            << (stats_.total_allocations - stats_.total_frees)
-            << "                          ║\n";
-  std::cout
-      << "╠══════════════════════════════════════════════════════════════╣\n";
-  std::cout << "║  Total Blocks:       " << std::setw(12) << stats_.block_count
-            << "                          ║\n";
-  std::cout << "║  Free Blocks:        " << std::setw(12)
-            << stats_.free_block_count << "                          ║\n";
-  std::cout << "║  Split Operations:   " << std::setw(12) << stats_.split_count
-            << "                          ║\n";
-  std::cout << "║  Coalesce Operations:" << std::setw(12)
-            << stats_.coalesce_count << "                          ║\n";
-  std::cout
-      << "╠══════════════════════════════════════════════════════════════╣\n";
-  std::cout << "║  Fragmentation:      " << std::setw(11) << std::fixed
-            << std::setprecision(2) << stats_.getFragmentationRatio()
-            << "%                         ║\n";
-  std::cout
-      << "╚══════════════════════════════════════════════════════════════╝\n";
-  std::cout << "\n";
-}
-
-void MemoryAllocator::printHeapLayout() const {
-  std::cout << "\n";
-  std::cout
-      << "═══════════════════════════════════════════════════════════════\n";
-  std::cout
-      << "                    HEAP MEMORY LAYOUT                         \n";
-  std::cout
-      << "═══════════════════════════════════════════════════════════════\n";
-  std::cout << "  Address          Size        Status      Block #\n";
-  std::cout
-      << "───────────────────────────────────────────────────────────────\n";
-
-  MemoryBlock *current = free_list_;
-  int block_num = 0;
-
-  while (current) {
-    char *addr = reinterpret_cast<char *>(current);
-    size_t offset = addr - heap_start_;
-
-    std::cout << "  0x" << std::hex << std::setw(8) << std::setfill('0')
-              << offset << std::dec << std::setfill(' ') << "    "
-              << std::setw(10) << current->size << " B"
-              << "    " << (current->is_free ? "[FREE]    " : "[USED]    ")
-              << "    #" << block_num++ << "\n";
-
-    current = current->next;
+size_t MemoryAllocator::heapMap(HeapMapEntry *out, size_t capacity) const {
+  size_t count = 0;
+  auto emit = [&](uint64_t offset, uint64_t size, uint32_t segment,
+                  HeapMapKind kind) {
+    if (count < capacity) {
+      out[count] = HeapMapEntry{offset, size, segment, kind};
+    }
+    count++;
+  };
+
+  uint32_t index = 0;
+  for (const HeapSegment *segment = &primary_; segment;
+       segment = segment->next, index++) {
+    emit(0, static_cast<uint64_t>(segment->end - segment->start), index,
+         HeapMapKind::Segment);
+    for (MemoryBlock *block = segment->firstBlock(); !block->isSentinel();
+         block = block->nextBlock()) {
+      emit(static_cast<uint64_t>(reinterpret_cast<char *>(block) -
+                                 segment->start),
+           block->size(), index,
+           block->isFree() ? HeapMapKind::Free : HeapMapKind::Used);
+    }
   }
 
-  std::cout
-      << "───────────────────────────────────────────────────────────────\n";
-  std::cout << "  Legend: [FREE] = Available   [USED] = Allocated\n";
-  std::cout
-      << "═══════════════════════════════════════════════════════════════\n";
-  std::cout << "\n";
-}
-
-//=============================================================================
-// Global Functions
-//=============================================================================
-
-void initGlobalAllocator(size_t heap_size) {
-  if (g_allocator) {
-    delete g_allocator;
+  for (size_t i = 0; i < large_count_; i++) {
+    emit(0, large_table_[i].mapped_size, index, HeapMapKind::Large);
   }
-  g_allocator = new MemoryAllocator(heap_size);
+  return count;
 }
 
-void destroyGlobalAllocator() {
-  delete g_allocator;
-  g_allocator = nullptr;
-}
+bool MemoryAllocator::verifyStats() const {
+  size_t total = 0;
+  size_t free_count = 0;
+  size_t used_bytes = 0;
+  size_t free_bytes = 0;
+  size_t segments = 0;
+  size_t heap_bytes = 0;
+  size_t quarantined = 0;
+  size_t quarantined_bytes = 0;
+
+  for (const HeapSegment *segment = &primary_; segment;
+       segment = segment->next) {
+    segments++;
+    heap_bytes += segment->mapped_size ? segment->mapped_size : heap_size_;
+
+    bool prev_free = false;
+    size_t prev_size = 0;
+
+    MemoryBlock *current = segment->firstBlock();
+    while (!current->isSentinel()) {
+      // Boundary tags must agree with the previous block's real state
+      if (current->isPrevFree() != prev_free ||
+          (prev_free && current->prev_size != prev_size)) {
+        return false;
+      }
 
-void *custom_malloc(size_t size) {
-  if (!g_allocator) {
-    initGlobalAllocator();
-  }
-  return g_allocator->my_malloc(size);
-}
+      // Only free blocks can vouch for zeroed contents
+      if (!current->isFree() && current->isZeroed()) {
+        return false;
+      }
 
-void custom_free(void *ptr) {
-  if (g_allocator) {
-    g_allocator->my_free(ptr);
-  }
-}
+      total++;
+      if (current->isFree()) {
+        free_count++;
+        free_bytes += current->size();
+      } else {
+        used_bytes += current->size();
+      }
+      if (current->isQuarantined()) {
+        quarantined++;
+        quarantined_bytes += current->size();
+      }
+      prev_free = current->isFree();
+      prev_size = current->size();
+      current = current->nextBlock();
+    }
 
-void *custom_realloc(void *ptr, size_t size) {
-  if (!g_allocator) {
-    initGlobalAllocator();
+    if (current != segment->sentinel() || current->isPrevFree() != prev_free) {
+      return false;
+    }
   }
-  return g_allocator->my_realloc(ptr, size);
-}
 
-void *custom_calloc(size_t count, size_t size) {
-  if (!g_allocator) {
-    initGlobalAllocator();
+  size_t large_bytes = 0;
+  for (size_t i = 0; i < large_count_; i++) {
+    large_bytes += large_table_[i].mapped_size;
   }
-  return g_allocator->my_calloc(count, size);
+
+  return stats_.large_count == large_count_ &&
+         stats_.large_bytes == large_bytes && stats_.block_count == total &&
+         stats_.free_block_count == free_count &&
+         stats_.used_memory == used_bytes && stats_.free_memory == free_bytes &&
+         stats_.segment_count == segments &&
+         stats_.total_heap_size == heap_bytes &&
+         stats_.quarantined_blocks == quarantined &&
+         stats_.quarantined_bytes == quarantined_bytes;
 }
 
 } // namespace CustomAllocator
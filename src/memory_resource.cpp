@@ -0,0 +1,142 @@
+/**
+ * @file memory_resource.cpp
+ * @brief Custom Memory Allocator - std::pmr Adapter Implementation
+ *
+ * Dispatch from std::pmr::memory_resource calls to each backend.
+ */
+
+#include "memory_resource.hpp"
+
+#include <algorithm>
+
+namespace CustomAllocator {
+
+//=============================================================================
+// Resource - Constructors
+//=============================================================================
+
+Resource::Resource() noexcept : backend_(Backend::Global), target_(nullptr) {}
+
+Resource::Resource(MemoryAllocator &heap) noexcept
+    : backend_(Backend::Heap), target_(&heap) {}
+
+Resource::Resource(ArenaSet &arenas) noexcept
+    : backend_(Backend::Arenas), target_(&arenas) {}
+
+Resource::Resource(MonotonicArena &arena) noexcept
+    : backend_(Backend::Monotonic), target_(&arena) {}
+
+Resource::Resource(FixedPool &pool) noexcept
+    : backend_(Backend::Pool), target_(&pool) {}
+
+Resource::Resource(BuddyAllocator &buddy) noexcept
+    : backend_(Backend::Buddy), target_(&buddy) {}
+
+Resource::Resource(SlabAllocator &slabs) noexcept
+    : backend_(Backend::Slab), target_(&slabs) {}
+
+Resource &globalResource() noexcept {
+  static Resource resource;
+  return resource;
+}
+
+//=============================================================================
+// memory_resource Interface
+//=============================================================================
+
+void *Resource::do_allocate(size_t bytes, size_t alignment) {
+  // Zero-byte requests still need a distinct pointer
+  if (bytes == 0) {
+    bytes = 1;
+  }
+
+  void *ptr = nullptr;
+  switch (backend_) {
+  case Backend::Global:
+    // Only default-aligned requests can come from the thread caches
+    ptr = alignment <= GLOBAL_ALIGNMENT
+              ? custom_malloc(bytes)
+              : custom_aligned_alloc(alignment, bytes);
+    break;
+  case Backend::Heap:
+    ptr = static_cast<MemoryAllocator *>(target_)->my_aligned_alloc(alignment,
+                                                                   bytes);
+    break;
+  case Backend::Arenas:
+    ptr = static_cast<ArenaSet *>(target_)->my_aligned_alloc(alignment, bytes);
+    break;
+  case Backend::Monotonic:
+    ptr = static_cast<MonotonicArena *>(target_)->allocate(bytes, alignment);
+    break;
+  case Backend::Pool: {
+    // Slots are only as large and as aligned as the pool makes them
+    FixedPool *pool = static_cast<FixedPool *>(target_);
+    if (bytes <= pool->slotSize() && alignment <= pool->alignment()) {
+      ptr = pool->allocate();
+    }
+    break;
+  }
+  case Backend::Buddy: {
+    // Blocks are aligned to their own size from the heap start
+    BuddyAllocator *buddy = static_cast<BuddyAllocator *>(target_);
+    ptr = buddy->allocate(std::max(bytes, alignment));
+    if (ptr && (reinterpret_cast<uintptr_t>(ptr) & (alignment - 1))) {
+      buddy->deallocate(ptr);
+      ptr = nullptr;
+    }
+    break;
+  }
+  case Backend::Slab:
+    // Objects are 16-byte aligned and at most MAX_OBJECT_SIZE
+    if (bytes <= SlabAllocator::MAX_OBJECT_SIZE && alignment <= 16) {
+      ptr = static_cast<SlabAllocator *>(target_)->allocate(bytes);
+    }
+    break;
+  }
+
+  if (!ptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void Resource::do_deallocate(void *ptr, size_t bytes, size_t) {
+  if (bytes == 0) {
+    bytes = 1;
+  }
+
+  switch (backend_) {
+  case Backend::Global:
+    custom_free_sized(ptr, bytes);
+    break;
+  case Backend::Heap:
+    static_cast<MemoryAllocator *>(target_)->my_free_sized(ptr, bytes);
+    break;
+  case Backend::Arenas:
+    static_cast<ArenaSet *>(target_)->my_free_sized(ptr, bytes);
+    break;
+  case Backend::Monotonic:
+    break; // Reclaimed by MonotonicArena::release()
+  case Backend::Pool:
+    static_cast<FixedPool *>(target_)->deallocate(ptr);
+    break;
+  case Backend::Buddy:
+    static_cast<BuddyAllocator *>(target_)->deallocate(ptr);
+    break;
+  case Backend::Slab:
+    static_cast<SlabAllocator *>(target_)->deallocate(ptr);
+    break;
+  }
+}
+
+bool Resource::do_is_equal(
+    const std::pmr::memory_resource &other) const noexcept {
+  if (this == &other) {
+    return true;
+  }
+  const Resource *resource = dynamic_cast<const Resource *>(&other);
+  return resource && resource->backend_ == backend_ &&
+         resource->target_ == target_;
+}
+
+} // namespace CustomAllocator
@@ -0,0 +1,120 @@
+/**
+ * @file monotonic_arena.cpp
+ * @brief Custom Memory Allocator - Bump-Pointer Monotonic Arena
+ *
+ * Chunk management for MonotonicArena; the bump itself is inline.
+ */
+
+#include "monotonic_arena.hpp"
+
+#include <stdexcept>
+
+namespace CustomAllocator {
+
+//=============================================================================
+// MonotonicArena - Constructor and Destructor
+//=============================================================================
+
+MonotonicArena::MonotonicArena(MemoryAllocator &parent, size_t chunk_size)
+    : parent_(parent), chunk_size_(chunk_size), chunks_(nullptr),
+      cursor_(nullptr), end_(nullptr), chunk_count_(0), reserved_bytes_(0),
+      allocated_bytes_(0), total_allocations_(0), release_count_(0) {
+  if (chunk_size_ <= sizeof(Chunk)) {
+    throw std::invalid_argument("Chunk size too small");
+  }
+}
+
+MonotonicArena::~MonotonicArena() { release(); }
+
+//=============================================================================
+// Allocation Functions
+//=============================================================================
+
+void *MonotonicArena::allocateSlow(size_t size, size_t alignment) {
+  if (size == 0) {
+    return nullptr;
+  }
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+    reportError(AllocError::InvalidAlignment, "MonotonicArena::allocate",
+                nullptr, alignment);
+    return nullptr;
+  }
+
+  // Room for the payload after the worst-case alignment padding
+  if (size > SIZE_MAX - sizeof(Chunk) - alignment) {
+    return nullptr;
+  }
+  size_t needed = sizeof(Chunk) + alignment - 1 + size;
+
+  // Oversized requests get a dedicated chunk and keep bumping the current one
+  bool dedicated = needed > chunk_size_;
+  size_t bytes = dedicated ? needed : chunk_size_;
+
+  Chunk *chunk = static_cast<Chunk *>(parent_.my_malloc(bytes));
+  if (!chunk) {
+    return nullptr;
+  }
+  chunk->prev = chunks_;
+  chunk->size = bytes;
+  chunks_ = chunk;
+  chunk_count_++;
+  reserved_bytes_ += bytes;
+
+  uintptr_t aligned =
+      (reinterpret_cast<uintptr_t>(chunk->begin()) + alignment - 1) &
+      ~(static_cast<uintptr_t>(alignment) - 1);
+  if (!dedicated) {
+    cursor_ = reinterpret_cast<char *>(aligned + size);
+    end_ = chunk->end();
+  }
+
+  allocated_bytes_ += size;
+  total_allocations_++;
+  return reinterpret_cast<void *>(aligned);
+}
+
+void MonotonicArena::release() {
+  if (!chunks_) {
+    return;
+  }
+
+  while (chunks_) {
+    Chunk *prev = chunks_->prev;
+    parent_.my_free(chunks_);
+    chunks_ = prev;
+  }
+
+  cursor_ = nullptr;
+  end_ = nullptr;
+  chunk_count_ = 0;
+  reserved_bytes_ = 0;
+  allocated_bytes_ = 0;
+  total_allocations_ = 0;
+  release_count_++;
+}
+
+//=============================================================================
+// Utility Functions
+//=============================================================================
+
+bool MonotonicArena::owns(const void *ptr) const {
+  const char *p = static_cast<const char *>(ptr);
+  for (Chunk *chunk = chunks_; chunk; chunk = chunk->prev) {
+    if (p >= chunk->begin() && p < chunk->end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+ArenaStats MonotonicArena::getStats() const {
+  ArenaStats stats{};
+  stats.chunk_count = chunk_count_;
+  stats.reserved_bytes = reserved_bytes_;
+  stats.allocated_bytes = allocated_bytes_;
+  stats.total_allocations = total_allocations_;
+  stats.release_count = release_count_;
+  return stats;
+}
+
+} // namespace CustomAllocator
@@ -0,0 +1,294 @@
+/**
+ * @file movable_heap.cpp
+ * @brief Custom Memory Allocator - Relocatable Blocks and Compaction
+ *
+ * The handle table, pinning, and the incremental sliding compactor.
+ */
+
+#include "movable_heap.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace CustomAllocator {
+
+namespace {
+
+/// Options of the heap behind a MovableHeap
+AllocatorOptions movableOptions(AllocatorOptions options) {
+  // Lowest holes first, and no private mappings: every block can slide
+  options.placement = PlacementPolicy::AddressOrderedFirstFit;
+  options.large_threshold = 0;
+  return options;
+}
+
+} // namespace
+
+//=============================================================================
+// MovableHeap - Constructor and Destructor
+//=============================================================================
+
+MovableHeap::MovableHeap(const AllocatorOptions &options)
+    : heap_(movableOptions(options)), free_slot_(NO_SLOT), live_handles_(0),
+      pinned_handles_(0), live_bytes_(0), blocks_moved_(0), bytes_moved_(0),
+      passes_(0), cursor_(0), stop_(false) {}
+
+MovableHeap::~MovableHeap() { stopBackgroundCompaction(); }
+
+//=============================================================================
+// Handles
+//=============================================================================
+
+MovableHeap::Slot *MovableHeap::liveSlot(Handle handle) {
+  if (!handle || handle.index >= slots_.size()) {
+    return nullptr;
+  }
+  Slot &slot = slots_[handle.index];
+  return slot.data && slot.generation == handle.generation ? &slot : nullptr;
+}
+
+const MovableHeap::Slot *MovableHeap::liveSlot(Handle handle) const {
+  return const_cast<MovableHeap *>(this)->liveSlot(handle);
+}
+
+Handle MovableHeap::alloc_movable(size_t size) {
+  std::lock_guard<std::mutex> guard(lock_);
+  void *data = heap_.my_malloc(size);
+  if (!data) {
+    return Handle();
+  }
+
+  uint32_t index = free_slot_;
+  if (index != NO_SLOT) {
+    free_slot_ = slots_[index].next_free;
+  } else {
+    index = static_cast<uint32_t>(slots_.size());
+    slots_.push_back({nullptr, 0, 1, 0, NO_SLOT});
+  }
+
+  Slot &slot = slots_[index];
+  slot.data = data;
+  slot.size = size;
+  slot.pins = 0;
+  live_handles_++;
+  live_bytes_ += size;
+  return Handle{index, slot.generation};
+}
+
+void MovableHeap::free_movable(Handle handle) {
+  if (!handle) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(lock_);
+  Slot *slot = liveSlot(handle);
+  if (!slot) {
+    reportError(AllocError::InvalidPointer, "MovableHeap::free_movable",
+                nullptr);
+    return;
+  }
+
+  heap_.my_free(slot->data);
+  if (slot->pins) {
+    pinned_handles_--;
+  }
+  live_handles_--;
+  live_bytes_ -= slot->size;
+
+  // A new generation makes every copy of the handle stale (0 stays null)
+  slot->data = nullptr;
+  slot->pins = 0;
+  if (++slot->generation == 0) {
+    slot->generation = 1;
+  }
+  slot->next_free = free_slot_;
+  free_slot_ = handle.index;
+}
+
+void *MovableHeap::pin(Handle handle) {
+  std::lock_guard<std::mutex> guard(lock_);
+  Slot *slot = liveSlot(handle);
+  if (!slot) {
+    reportError(AllocError::InvalidPointer, "MovableHeap::pin", nullptr);
+    return nullptr;
+  }
+  if (slot->pins++ == 0) {
+    pinned_handles_++;
+  }
+  return slot->data;
+}
+
+void MovableHeap::unpin(Handle handle) {
+  std::lock_guard<std::mutex> guard(lock_);
+  Slot *slot = liveSlot(handle);
+  if (!slot || slot->pins == 0) {
+    reportError(AllocError::InvalidPointer, "MovableHeap::unpin", nullptr);
+    return;
+  }
+  if (--slot->pins == 0) {
+    pinned_handles_--;
+  }
+}
+
+bool MovableHeap::isLive(Handle handle) const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return liveSlot(handle) != nullptr;
+}
+
+size_t MovableHeap::movableSize(Handle handle) const {
+  std::lock_guard<std::mutex> guard(lock_);
+  const Slot *slot = liveSlot(handle);
+  return slot ? slot->size : 0;
+}
+
+//=============================================================================
+// Compaction
+//=============================================================================
+
+size_t MovableHeap::compact(uint64_t budget_us) {
+  std::lock_guard<std::mutex> pass(compact_lock_);
+  const auto start = std::chrono::steady_clock::now();
+
+  // Blocks at or above the cursor, lowest first, so each one slides over
+  // the holes its predecessors left behind
+  std::vector<std::pair<uintptr_t, uint32_t>> order;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    order.reserve(live_handles_);
+    for (uint32_t i = 0; i < slots_.size(); i++) {
+      uintptr_t address = reinterpret_cast<uintptr_t>(slots_[i].data);
+      if (address && address >= cursor_) {
+        order.emplace_back(address, i);
+      }
+    }
+  }
+  std::sort(order.begin(), order.end());
+
+  size_t moved = 0;
+  for (size_t i = 0; i < order.size(); i++) {
+    // Reading the clock every few blocks keeps its cost out of the moves;
+    // the first few always go, so even a tiny budget makes progress
+    if (budget_us && i && i % 8 == 0 &&
+        std::chrono::steady_clock::now() - start >=
+            std::chrono::microseconds(budget_us)) {
+      cursor_ = order[i].first;
+      return moved;
+    }
+
+    std::lock_guard<std::mutex> guard(lock_);
+    Slot &slot = slots_[order[i].second];
+    // Skip blocks freed or pinned since the snapshot
+    if (reinterpret_cast<uintptr_t>(slot.data) != order[i].first ||
+        slot.pins) {
+      continue;
+    }
+    void *data = heap_.slideBlock(slot.data);
+    if (data != slot.data) {
+      slot.data = data;
+      blocks_moved_++;
+      bytes_moved_ += slot.size;
+      moved += slot.size;
+    }
+  }
+
+  cursor_ = 0;
+  passes_++;
+  return moved;
+}
+
+void MovableHeap::startBackgroundCompaction(uint32_t interval_ms,
+                                            uint64_t budget_us,
+                                            double min_fragmentation) {
+  stopBackgroundCompaction();
+  stop_ = false;
+  worker_ = std::thread(&MovableHeap::backgroundLoop, this, interval_ms,
+                        budget_us, min_fragmentation);
+}
+
+void MovableHeap::stopBackgroundCompaction() {
+  if (!worker_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> guard(worker_lock_);
+    stop_ = true;
+  }
+  worker_wake_.notify_all();
+  worker_.join();
+}
+
+void MovableHeap::backgroundLoop(uint32_t interval_ms, uint64_t budget_us,
+                                 double min_fragmentation) {
+  std::unique_lock<std::mutex> wait(worker_lock_);
+  for (;;) {
+    if (worker_wake_.wait_for(wait, std::chrono::milliseconds(interval_ms),
+                              [this] { return stop_; })) {
+      return;
+    }
+
+    // Compact without holding worker_lock_, so a stop request is not held up
+    wait.unlock();
+    if (heapStats().getFragmentationRatio() >= min_fragmentation) {
+      compact(budget_us);
+    }
+    wait.lock();
+  }
+}
+
+//=============================================================================
+// Statistics
+//=============================================================================
+
+MovableStats MovableHeap::getStats() const {
+  MemoryStats heap = heapStats();
+
+  std::lock_guard<std::mutex> guard(lock_);
+  MovableStats stats;
+  stats.live_handles = live_handles_;
+  stats.pinned_handles = pinned_handles_;
+  stats.live_bytes = live_bytes_;
+  stats.blocks_moved = blocks_moved_;
+  stats.bytes_moved = bytes_moved_;
+  stats.compaction_passes = passes_;
+  stats.free_bytes = heap.free_memory;
+  stats.largest_free_block = heap.largest_free_block;
+  return stats;
+}
+
+MemoryStats MovableHeap::heapStats() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return heap_.getStats();
+}
+
+bool MovableHeap::verify() const {
+  std::lock_guard<std::mutex> guard(lock_);
+
+  std::vector<const void *> blocks;
+  size_t pinned = 0;
+  size_t bytes = 0;
+  for (const Slot &slot : slots_) {
+    if (!slot.data) {
+      continue;
+    }
+    if (!heap_.isValidPointer(slot.data)) {
+      return false;
+    }
+    const MemoryBlock *block = MemoryBlock::fromData(slot.data);
+    if (block->isFree() || block->size() < slot.size) {
+      return false;
+    }
+    blocks.push_back(slot.data);
+    pinned += slot.pins != 0;
+    bytes += slot.size;
+  }
+
+  std::sort(blocks.begin(), blocks.end());
+  if (std::adjacent_find(blocks.begin(), blocks.end()) != blocks.end()) {
+    return false;
+  }
+  return blocks.size() == live_handles_ && pinned == pinned_handles_ &&
+         bytes == live_bytes_ && heap_.verifyStats();
+}
+
+} // namespace CustomAllocator
@@ -0,0 +1,268 @@
+/**
+ * @file os_memory.cpp
+ * @brief Custom Memory Allocator - Operating System Memory Interface
+ *
+ * POSIX and Windows implementations of the virtual memory primitives,
+ * and the Linux NUMA queries (sysfs, getcpu() and mbind()).
+ */
+
+#include "os_memory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+namespace CustomAllocator {
+
+size_t osPageSize() {
+  static const size_t page_size = []() -> size_t {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? static_cast<size_t>(size) : 4096;
+#endif
+  }();
+  return page_size;
+}
+
+void *osMapMemory(size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+
+#if defined(_WIN32)
+  return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+  void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  return ptr == MAP_FAILED ? nullptr : ptr;
+#endif
+}
+
+void *osMapHugeMemory(size_t size, HugePageBacking *backing) {
+  *backing = HugePageBacking::None;
+  if (size == 0 || size % OS_HUGE_PAGE_SIZE != 0) {
+    return osMapMemory(size);
+  }
+
+#if defined(_WIN32)
+  // Large pages need SeLockMemoryPrivilege; without it this simply fails
+  SIZE_T large_page = GetLargePageMinimum();
+  if (large_page && size % large_page == 0) {
+    void *ptr = VirtualAlloc(nullptr, size,
+                             MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                             PAGE_READWRITE);
+    if (ptr) {
+      *backing = HugePageBacking::Explicit;
+      return ptr;
+    }
+  }
+#else
+#if defined(MAP_HUGETLB)
+  // Reserved huge pages exist only if the administrator set some aside
+  void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (ptr != MAP_FAILED) {
+    *backing = HugePageBacking::Explicit;
+    return ptr;
+  }
+#endif
+#if defined(MADV_HUGEPAGE)
+  // Over-map so a 2 MB-aligned range can be carved out of the middle
+  size_t span = size + OS_HUGE_PAGE_SIZE;
+  if (span > size) {
+    void *raw = mmap(nullptr, span, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw != MAP_FAILED) {
+      uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+      uintptr_t aligned =
+          (start + OS_HUGE_PAGE_SIZE - 1) & ~(OS_HUGE_PAGE_SIZE - 1);
+      size_t lead = aligned - start;
+      size_t trail = span - lead - size;
+      if (lead) {
+        munmap(raw, lead);
+      }
+      if (trail) {
+        munmap(reinterpret_cast<char *>(aligned + size), trail);
+      }
+
+      void *ptr = reinterpret_cast<void *>(aligned);
+      if (madvise(ptr, size, MADV_HUGEPAGE) == 0) {
+        *backing = HugePageBacking::Transparent;
+      }
+      return ptr;
+    }
+  }
+#endif
+#endif
+
+  return osMapMemory(size);
+}
+
+const char *hugePageBackingName(HugePageBacking backing) {
+  switch (backing) {
+  case HugePageBacking::Transparent:
+    return "transparent";
+  case HugePageBacking::Explicit:
+    return "explicit";
+  default:
+    return "none";
+  }
+}
+
+void osUnmapMemory(void *ptr, size_t size) {
+  if (!ptr) {
+    return;
+  }
+
+#if defined(_WIN32)
+  (void)size;
+  VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+  munmap(ptr, size);
+#endif
+}
+
+void *osRemapMemory(void *ptr, size_t old_size, size_t new_size) {
+  if (!ptr || new_size == 0) {
+    return nullptr;
+  }
+
+#if defined(__linux__)
+  void *moved = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE);
+  return moved == MAP_FAILED ? nullptr : moved;
+#else
+  void *moved = osMapMemory(new_size);
+  if (moved) {
+    std::memcpy(moved, ptr, std::min(old_size, new_size));
+    osUnmapMemory(ptr, old_size);
+  }
+  return moved;
+#endif
+}
+
+bool osPurgeMemory(void *ptr, size_t size, bool lazy) {
+  if (!ptr || size == 0) {
+    return false;
+  }
+
+#if defined(_WIN32)
+  (void)lazy;
+  VirtualAlloc(ptr, size, MEM_RESET, PAGE_READWRITE);
+  return false;
+#else
+#if defined(MADV_FREE)
+  if (lazy && madvise(ptr, size, MADV_FREE) == 0) {
+    return false; // Pages may keep their old contents
+  }
+#else
+  (void)lazy;
+#endif
+  // Dropped anonymous pages fault back in zero-filled
+  return madvise(ptr, size, MADV_DONTNEED) == 0;
+#endif
+}
+
+//=============================================================================
+// NUMA
+//=============================================================================
+
+size_t osNumaNodeCount() {
+  static const size_t node_count = []() -> size_t {
+#if defined(__linux__)
+    // "0" or "0-3": the last number is the highest node. Plain read(),
+    // since this can run while the global allocator is being built.
+    int fd = open("/sys/devices/system/node/possible", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return 1;
+    }
+    char text[64];
+    ssize_t length = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    if (length <= 0) {
+      return 1;
+    }
+
+    size_t highest = 0;
+    size_t number = 0;
+    bool digits = false;
+    for (ssize_t i = 0; i < length; i++) {
+      if (text[i] >= '0' && text[i] <= '9') {
+        number = number * 10 + static_cast<size_t>(text[i] - '0');
+        digits = true;
+      } else if (digits) {
+        highest = std::max(highest, number);
+        number = 0;
+        digits = false;
+      }
+    }
+    if (digits) {
+      highest = std::max(highest, number);
+    }
+    return std::min<size_t>(highest + 1, 1024);
+#else
+    return 1;
+#endif
+  }();
+  return node_count;
+}
+
+int osCurrentNumaNode() {
+  if (osNumaNodeCount() == 1) {
+    return 0;
+  }
+
+#if defined(__linux__)
+  unsigned cpu = 0;
+  unsigned node = 0;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 29)
+  if (getcpu(&cpu, &node) != 0) {
+    return 0;
+  }
+#else
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+    return 0;
+  }
+#endif
+  return node < osNumaNodeCount() ? static_cast<int>(node) : 0;
+#else
+  return 0;
+#endif
+}
+
+bool osBindMemory(void *ptr, size_t size, int node) {
+  if (!ptr || size == 0 || node < 0 ||
+      static_cast<size_t>(node) >= osNumaNodeCount()) {
+    return false;
+  }
+
+#if defined(__linux__) && defined(SYS_mbind)
+  // <numaif.h> comes with libnuma, which is not a dependency
+  constexpr int MPOL_PREFERRED_MODE = 1;
+  constexpr size_t MASK_BITS = 1024;
+  unsigned long mask[MASK_BITS / (8 * sizeof(unsigned long))] = {};
+  mask[node / (8 * sizeof(unsigned long))] =
+      1UL << (node % (8 * sizeof(unsigned long)));
+  return syscall(SYS_mbind, ptr, size, MPOL_PREFERRED_MODE, mask, MASK_BITS,
+                 0) == 0;
+#else
+  return false;
+#endif
+}
+
+} // namespace CustomAllocator
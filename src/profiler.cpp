@@ -0,0 +1,441 @@
+/**
+ * @file profiler.cpp
+ * @brief Custom Memory Allocator - Allocation Profiler
+ *
+ * Counters are relaxed atomics updated only while profiling is on. Live
+ * samples sit in a fixed open-addressing table, so recording never
+ * allocates, even when the profiler runs inside the preload library.
+ */
+
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+
+namespace CustomAllocator {
+
+#if defined(CUSTOM_ALLOC_PROFILING)
+
+namespace detail {
+std::atomic<bool> g_profiling{false};
+} // namespace detail
+
+namespace {
+
+/// Live samples the table holds at most (a power of two)
+constexpr size_t SAMPLE_TABLE_SIZE = 4096;
+
+/// Samples beyond this load are dropped to keep probe chains short
+constexpr size_t MAX_LIVE_SAMPLES = SAMPLE_TABLE_SIZE * 3 / 4;
+
+/// Profiler frames at the top of every captured stack: recordSample(),
+/// countAllocation() and the detail:: entry point
+constexpr int SKIPPED_FRAMES = 3;
+
+std::atomic<uint64_t> g_alloc_count[PROFILE_SIZE_CLASSES];
+std::atomic<uint64_t> g_free_count[PROFILE_SIZE_CLASSES];
+std::atomic<uint64_t> g_alloc_cycles[PROFILE_LATENCY_BUCKETS];
+std::atomic<uint64_t> g_free_cycles[PROFILE_LATENCY_BUCKETS];
+
+/// Signed: blocks allocated before startProfiling() may be freed during it
+std::atomic<int64_t> g_live_bytes{0};
+std::atomic<int64_t> g_peak_live_bytes{0};
+
+std::atomic<size_t> g_sample_interval{0};
+std::atomic<uint64_t> g_sample_epoch{0};
+std::atomic<size_t> g_live_samples{0};
+std::atomic<size_t> g_dropped_samples{0};
+
+/// Guards g_samples; a nullptr ptr marks an empty slot
+std::mutex g_sample_mutex;
+HeapSample g_samples[SAMPLE_TABLE_SIZE];
+
+/// Inside a profiled call; nested allocator calls are not counted again
+thread_local bool t_in_call = false;
+
+/// Bytes this thread may still allocate before its next sample
+thread_local int64_t t_until_sample = 0;
+thread_local uint64_t t_sample_epoch = 0;
+thread_local uint64_t t_random = 0;
+
+/// Cycle counter (or nanoseconds where there is none)
+inline uint64_t readCycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+#endif
+}
+
+/// Index of the highest set bit of a non-zero value
+inline size_t log2Floor(uint64_t value) {
+  size_t bit = 0;
+  while (value >>= 1) {
+    bit++;
+  }
+  return bit;
+}
+
+inline size_t latencyBucket(uint64_t start) {
+  uint64_t now = readCycles();
+  uint64_t cycles = now > start ? now - start : 1;
+  return std::min(log2Floor(cycles), PROFILE_LATENCY_BUCKETS - 1);
+}
+
+inline size_t slotFor(const void *ptr) {
+  // Fibonacci hashing spreads the 16-byte aligned addresses
+  uint64_t key = reinterpret_cast<uintptr_t>(ptr) * 0x9E3779B97F4A7C15ull;
+  return static_cast<size_t>(key >> 52) & (SAMPLE_TABLE_SIZE - 1);
+}
+
+/**
+ * Bytes until the next sample: exponentially distributed with the given
+ * mean, so sampling is a Poisson process over allocated bytes and a
+ * block of s bytes is sampled with probability 1 - exp(-s / interval).
+ */
+int64_t nextSampleGap(size_t interval) {
+  if (t_random == 0) {
+    t_random = (reinterpret_cast<uintptr_t>(&t_random) ^ readCycles()) | 1;
+  }
+  t_random ^= t_random << 13;
+  t_random ^= t_random >> 7;
+  t_random ^= t_random << 17;
+
+  double unit = static_cast<double>((t_random >> 11) + 1) / 9007199254740992.0;
+  double gap = -std::log(unit) * static_cast<double>(interval);
+  return static_cast<int64_t>(std::min(gap, 9.0e18)) + 1;
+}
+
+/// Remove a sample, shifting its probe chain back over the hole
+void eraseSampleLocked(size_t slot) {
+  size_t hole = slot;
+  g_samples[hole].ptr = nullptr;
+  for (size_t next = (hole + 1) & (SAMPLE_TABLE_SIZE - 1); g_samples[next].ptr;
+       next = (next + 1) & (SAMPLE_TABLE_SIZE - 1)) {
+    size_t home = slotFor(g_samples[next].ptr);
+    if (((next - home) & (SAMPLE_TABLE_SIZE - 1)) >=
+        ((next - hole) & (SAMPLE_TABLE_SIZE - 1))) {
+      g_samples[hole] = g_samples[next];
+      g_samples[next].ptr = nullptr;
+      hole = next;
+    }
+  }
+  g_live_samples.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/// Capture the caller's stack and add it to the live samples
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void recordSample(const void *ptr, size_t requested) {
+  HeapSample sample;
+  sample.ptr = ptr;
+  sample.size = requested;
+  sample.depth = 0;
+
+#if defined(__GLIBC__)
+  // The first call may load the unwinder, which allocates; t_in_call
+  // keeps those allocations out of the profile
+  void *frames[PROFILE_MAX_FRAMES + SKIPPED_FRAMES];
+  int depth = backtrace(frames, static_cast<int>(PROFILE_MAX_FRAMES) +
+                                    SKIPPED_FRAMES);
+  for (int i = SKIPPED_FRAMES; i < depth; i++) {
+    sample.frames[sample.depth++] = frames[i];
+  }
+#endif
+
+  std::lock_guard<std::mutex> guard(g_sample_mutex);
+  size_t slot = slotFor(ptr);
+  while (g_samples[slot].ptr && g_samples[slot].ptr != ptr) {
+    slot = (slot + 1) & (SAMPLE_TABLE_SIZE - 1);
+  }
+  if (g_samples[slot].ptr == ptr) {
+    g_samples[slot] = sample; // A block freed behind the profiler's back
+    return;
+  }
+  if (g_live_samples.load(std::memory_order_relaxed) >= MAX_LIVE_SAMPLES) {
+    g_dropped_samples.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  g_samples[slot] = sample;
+  g_live_samples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void eraseSample(const void *ptr) {
+  std::lock_guard<std::mutex> guard(g_sample_mutex);
+  for (size_t slot = slotFor(ptr); g_samples[slot].ptr;
+       slot = (slot + 1) & (SAMPLE_TABLE_SIZE - 1)) {
+    if (g_samples[slot].ptr == ptr) {
+      eraseSampleLocked(slot);
+      return;
+    }
+  }
+}
+
+/// Re-key a live sample whose block was relocated
+void moveSample(const void *old_ptr, const void *new_ptr) {
+  std::lock_guard<std::mutex> guard(g_sample_mutex);
+  for (size_t slot = slotFor(old_ptr); g_samples[slot].ptr;
+       slot = (slot + 1) & (SAMPLE_TABLE_SIZE - 1)) {
+    if (g_samples[slot].ptr != old_ptr) {
+      continue;
+    }
+    HeapSample sample = g_samples[slot];
+    sample.ptr = new_ptr;
+    eraseSampleLocked(slot);
+
+    size_t target = slotFor(new_ptr);
+    while (g_samples[target].ptr && g_samples[target].ptr != new_ptr) {
+      target = (target + 1) & (SAMPLE_TABLE_SIZE - 1);
+    }
+    if (!g_samples[target].ptr) {
+      g_live_samples.fetch_add(1, std::memory_order_relaxed);
+    }
+    g_samples[target] = sample;
+    return;
+  }
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void countAllocation(uint64_t start, const void *ptr, size_t requested,
+                     size_t usable) {
+  g_alloc_count[log2Floor(usable | 1)].fetch_add(1,
+                                                 std::memory_order_relaxed);
+  g_alloc_cycles[latencyBucket(start)].fetch_add(1,
+                                                 std::memory_order_relaxed);
+
+  int64_t live = g_live_bytes.fetch_add(static_cast<int64_t>(usable),
+                                        std::memory_order_relaxed) +
+                 static_cast<int64_t>(usable);
+  int64_t peak = g_peak_live_bytes.load(std::memory_order_relaxed);
+  while (live > peak && !g_peak_live_bytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+
+  size_t interval = g_sample_interval.load(std::memory_order_relaxed);
+  if (!interval) {
+    return;
+  }
+  uint64_t epoch = g_sample_epoch.load(std::memory_order_relaxed);
+  if (t_sample_epoch != epoch) {
+    t_sample_epoch = epoch;
+    t_until_sample = nextSampleGap(interval);
+  }
+  t_until_sample -= static_cast<int64_t>(std::min<size_t>(requested, INT64_MAX));
+  if (t_until_sample <= 0) {
+    t_until_sample = nextSampleGap(interval);
+    recordSample(ptr, requested);
+  }
+}
+
+void countFree(uint64_t start, const void *ptr, size_t usable, bool timed) {
+  g_free_count[log2Floor(usable | 1)].fetch_add(1, std::memory_order_relaxed);
+  if (timed) {
+    g_free_cycles[latencyBucket(start)].fetch_add(1,
+                                                  std::memory_order_relaxed);
+  }
+  g_live_bytes.fetch_sub(static_cast<int64_t>(usable),
+                         std::memory_order_relaxed);
+  if (g_live_samples.load(std::memory_order_relaxed)) {
+    eraseSample(ptr);
+  }
+}
+
+} // namespace
+
+//=============================================================================
+// Recording
+//=============================================================================
+
+namespace detail {
+
+uint64_t profileEnter() noexcept {
+  if (t_in_call) {
+    return 0;
+  }
+  t_in_call = true;
+  return readCycles() | 1; // Never 0, which means "not profiling"
+}
+
+void profileAllocated(uint64_t start, const void *ptr, size_t requested,
+                      size_t usable) noexcept {
+  if (ptr) {
+    countAllocation(start, ptr, requested, usable);
+  }
+  t_in_call = false;
+}
+
+void profileFreed(uint64_t start, const void *ptr, size_t usable) noexcept {
+  if (ptr && usable) {
+    countFree(start, ptr, usable, true);
+  }
+  t_in_call = false;
+}
+
+void profileReallocated(uint64_t start, const void *old_ptr,
+                        size_t old_usable, const void *new_ptr,
+                        size_t requested, size_t new_usable) noexcept {
+  if (old_ptr && old_usable) {
+    countFree(start, old_ptr, old_usable, false);
+  }
+  countAllocation(start, new_ptr, requested, new_usable);
+  t_in_call = false;
+}
+
+uint64_t profileBatchStart(uint64_t start, size_t count) noexcept {
+  uint64_t now = readCycles();
+  return (now - (now - start) / count) | 1;
+}
+
+void profileBatchAllocated(uint64_t start, const void *ptr, size_t requested,
+                           size_t usable) noexcept {
+  if (ptr) {
+    countAllocation(start, ptr, requested, usable);
+  }
+}
+
+void profileBatchFreed(uint64_t start, const void *ptr,
+                       size_t usable) noexcept {
+  if (ptr && usable) {
+    countFree(start, ptr, usable, true);
+  }
+}
+
+void profileMoved(const void *old_ptr, const void *new_ptr) noexcept {
+  if (g_live_samples.load(std::memory_order_relaxed)) {
+    moveSample(old_ptr, new_ptr);
+  }
+}
+
+void profileLeave() noexcept { t_in_call = false; }
+
+} // namespace detail
+
+//=============================================================================
+// Control and Reporting
+//=============================================================================
+
+bool startProfiling(const ProfileOptions &options) noexcept {
+  g_sample_interval.store(options.sample_interval, std::memory_order_relaxed);
+  g_sample_epoch.fetch_add(1, std::memory_order_relaxed);
+  detail::g_profiling.store(true, std::memory_order_release);
+  return true;
+}
+
+void stopProfiling() noexcept {
+  detail::g_profiling.store(false, std::memory_order_release);
+}
+
+void resetProfile() noexcept {
+  for (size_t i = 0; i < PROFILE_SIZE_CLASSES; i++) {
+    g_alloc_count[i].store(0, std::memory_order_relaxed);
+    g_free_count[i].store(0, std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < PROFILE_LATENCY_BUCKETS; i++) {
+    g_alloc_cycles[i].store(0, std::memory_order_relaxed);
+    g_free_cycles[i].store(0, std::memory_order_relaxed);
+  }
+  g_live_bytes.store(0, std::memory_order_relaxed);
+  g_peak_live_bytes.store(0, std::memory_order_relaxed);
+  g_dropped_samples.store(0, std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> guard(g_sample_mutex);
+  for (HeapSample &sample : g_samples) {
+    sample.ptr = nullptr;
+  }
+  g_live_samples.store(0, std::memory_order_relaxed);
+}
+
+ProfileSnapshot profileSnapshot() noexcept {
+  ProfileSnapshot snapshot;
+  for (size_t i = 0; i < PROFILE_SIZE_CLASSES; i++) {
+    snapshot.alloc_count[i] = g_alloc_count[i].load(std::memory_order_relaxed);
+    snapshot.free_count[i] = g_free_count[i].load(std::memory_order_relaxed);
+  }
+  for (size_t i = 0; i < PROFILE_LATENCY_BUCKETS; i++) {
+    snapshot.alloc_cycles[i] =
+        g_alloc_cycles[i].load(std::memory_order_relaxed);
+    snapshot.free_cycles[i] = g_free_cycles[i].load(std::memory_order_relaxed);
+  }
+  snapshot.live_bytes = static_cast<size_t>(
+      std::max<int64_t>(g_live_bytes.load(std::memory_order_relaxed), 0));
+  snapshot.peak_live_bytes = static_cast<size_t>(
+      g_peak_live_bytes.load(std::memory_order_relaxed));
+  snapshot.live_samples = g_live_samples.load(std::memory_order_relaxed);
+  snapshot.dropped_samples = g_dropped_samples.load(std::memory_order_relaxed);
+  snapshot.sample_interval = g_sample_interval.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+size_t heapSamples(HeapSample *out, size_t capacity) noexcept {
+  std::lock_guard<std::mutex> guard(g_sample_mutex);
+  size_t copied = 0;
+  for (const HeapSample &sample : g_samples) {
+    if (copied == capacity) {
+      break;
+    }
+    if (sample.ptr) {
+      out[copied++] = sample;
+    }
+  }
+  return copied;
+}
+
+#else // !CUSTOM_ALLOC_PROFILING
+
+namespace detail {
+
+uint64_t profileEnter() noexcept { return 0; }
+
+void profileAllocated(uint64_t, const void *, size_t, size_t) noexcept {}
+
+void profileFreed(uint64_t, const void *, size_t) noexcept {}
+
+void profileReallocated(uint64_t, const void *, size_t, const void *, size_t,
+                        size_t) noexcept {}
+
+uint64_t profileBatchStart(uint64_t, size_t) noexcept { return 0; }
+
+void profileBatchAllocated(uint64_t, const void *, size_t, size_t) noexcept {}
+
+void profileBatchFreed(uint64_t, const void *, size_t) noexcept {}
+
+void profileMoved(const void *, const void *) noexcept {}
+
+void profileLeave() noexcept {}
+
+} // namespace detail
+
+bool startProfiling(const ProfileOptions &) noexcept { return false; }
+
+void stopProfiling() noexcept {}
+
+void resetProfile() noexcept {}
+
+ProfileSnapshot profileSnapshot() noexcept { return ProfileSnapshot{}; }
+
+size_t heapSamples(HeapSample *, size_t) noexcept { return 0; }
+
+#endif // CUSTOM_ALLOC_PROFILING
+
+} // namespace CustomAllocator
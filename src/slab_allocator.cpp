@@ -0,0 +1,422 @@
+/**
+ * @file slab_allocator.cpp
+ * @brief Custom Memory Allocator - Slab Allocator for Small Objects
+ *
+ * Slab formatting, the occupancy bitmap scan and the slab lists.
+ */
+
+#include "slab_allocator.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CUSTOM_ALLOC_SLAB_SSE2 1
+#endif
+
+namespace CustomAllocator {
+
+/**
+ * Header at the front of every slab. The occupancy bitmap follows it (a
+ * set bit is a free object), then the objects from the next 16-byte
+ * boundary. Bits past the capacity stay clear.
+ */
+struct SlabAllocator::Slab {
+  Slab *prev;                  ///< Previous slab on the same list
+  Slab *next;                  ///< Next slab on the same list
+  const SlabAllocator *owner;  ///< Allocator the slab belongs to
+  char *objects;               ///< First object
+  uint32_t object_size;        ///< Bytes per object
+  uint32_t capacity;           ///< Objects in the slab
+  uint32_t in_use;             ///< Live objects
+  uint32_t words;              ///< 64-bit words in the bitmap
+  uint32_t hint;               ///< Every bitmap word below this one is zero
+  uint32_t size_class;         ///< Class index of the objects
+  uint32_t reciprocal;         ///< ceil(2^32 / object_size), for offset division
+
+  uint64_t *freeBits() { return reinterpret_cast<uint64_t *>(this + 1); }
+  const uint64_t *freeBits() const {
+    return reinterpret_cast<const uint64_t *>(this + 1);
+  }
+};
+
+namespace {
+
+/// Index of the lowest set bit (value must be non-zero)
+inline size_t lowestSetBit(uint64_t value) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#else
+  return static_cast<size_t>(__builtin_ctzll(value));
+#endif
+}
+
+/// Number of set bits
+inline size_t popCount(uint64_t value) {
+#if defined(_MSC_VER)
+  return static_cast<size_t>(__popcnt64(value));
+#else
+  return static_cast<size_t>(__builtin_popcountll(value));
+#endif
+}
+
+/// Object sizes of the classes
+constexpr uint32_t CLASS_SIZES[SlabAllocator::NUM_CLASSES] = {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512};
+
+/// First bitmap word at or after start with a free bit (one must exist)
+inline size_t findFreeWord(const uint64_t *bits, size_t start, size_t words) {
+  size_t word = start;
+#if defined(CUSTOM_ALLOC_SLAB_SSE2)
+  // Full slabs of tiny objects have long runs of zero words
+  const __m128i zero = _mm_setzero_si128();
+  while (word + 2 <= words) {
+    __m128i pair =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(bits + word));
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(pair, zero)) != 0xFFFF) {
+      break;
+    }
+    word += 2;
+  }
+#else
+  (void)words;
+#endif
+  while (bits[word] == 0) {
+    word++;
+  }
+  return word;
+}
+
+} // namespace
+
+//=============================================================================
+// SlabAllocator - Constructor and Destructor
+//=============================================================================
+
+SlabAllocator::SlabAllocator(MemoryAllocator &parent, size_t slab_size,
+                             size_t max_empty)
+    : parent_(parent), slab_size_(slab_size), max_empty_(max_empty),
+      partial_{}, full_{}, empty_(nullptr), slab_count_(0), empty_count_(0),
+      objects_in_use_(0), object_bytes_(0), allocations_(0), frees_(0),
+      failures_(0) {
+  if (slab_size < 4096 || slab_size > 1024 * 1024 ||
+      (slab_size & (slab_size - 1)) != 0) {
+    throw std::invalid_argument("Invalid slab size");
+  }
+}
+
+SlabAllocator::~SlabAllocator() {
+  for (size_t i = 0; i < NUM_CLASSES; i++) {
+    while (partial_[i]) {
+      Slab *slab = partial_[i];
+      unlinkSlab(partial_[i], slab);
+      releaseSlab(slab);
+    }
+    while (full_[i]) {
+      Slab *slab = full_[i];
+      unlinkSlab(full_[i], slab);
+      releaseSlab(slab);
+    }
+  }
+  trim();
+}
+
+//=============================================================================
+// Allocation Functions
+//=============================================================================
+
+size_t SlabAllocator::classIndex(size_t size) {
+  if (size <= 128) {
+    return (size - 1) >> 4;
+  }
+  if (size <= 256) {
+    return 8 + ((size - 129) >> 5);
+  }
+  return 12 + ((size - 257) >> 6);
+}
+
+size_t SlabAllocator::classSize(size_t index) { return CLASS_SIZES[index]; }
+
+void *SlabAllocator::allocate(size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  if (size > MAX_OBJECT_SIZE) {
+    failures_++;
+    reportError(AllocError::OutOfMemory, "SlabAllocator::allocate", nullptr,
+                size);
+    return nullptr;
+  }
+
+  size_t size_class = classIndex(size);
+  Slab *slab = partial_[size_class];
+  if (!slab) {
+    slab = takeSlab(size_class);
+    if (!slab) {
+      failures_++;
+      return nullptr; // The parent reported OutOfMemory
+    }
+    pushSlab(partial_[size_class], slab);
+  }
+
+  // Lowest free object: clear its bit
+  uint64_t *bits = slab->freeBits();
+  size_t word = findFreeWord(bits, slab->hint, slab->words);
+  size_t index = word * 64 + lowestSetBit(bits[word]);
+  bits[word] &= bits[word] - 1;
+  slab->hint = static_cast<uint32_t>(word);
+
+  if (++slab->in_use == slab->capacity) {
+    unlinkSlab(partial_[size_class], slab);
+    pushSlab(full_[size_class], slab);
+  }
+  objects_in_use_++;
+  object_bytes_ += slab->object_size;
+  allocations_++;
+  return slab->objects + index * slab->object_size;
+}
+
+void SlabAllocator::deallocate(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+
+  // The slab starts at the slab-size boundary below the object
+  Slab *slab = reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(ptr) &
+                                        ~(slab_size_ - 1));
+  char *object = static_cast<char *>(ptr);
+  if (slab->owner != this || object < slab->objects) {
+    reportError(AllocError::InvalidPointer, "SlabAllocator::deallocate", ptr);
+    return;
+  }
+  // Exact for offsets below 2^32 / MAX_OBJECT_SIZE, well past 1 MB slabs
+  size_t offset = static_cast<size_t>(object - slab->objects);
+  size_t index = (offset * slab->reciprocal) >> 32;
+  if (index >= slab->capacity || index * slab->object_size != offset) {
+    reportError(AllocError::InvalidPointer, "SlabAllocator::deallocate", ptr);
+    return;
+  }
+
+  uint64_t *bits = slab->freeBits();
+  uint64_t mask = uint64_t(1) << (index % 64);
+  if (bits[index / 64] & mask) {
+    reportError(AllocError::DoubleFree, "SlabAllocator::deallocate", ptr);
+    return;
+  }
+  bits[index / 64] |= mask;
+  if (index / 64 < slab->hint) {
+    slab->hint = static_cast<uint32_t>(index / 64);
+  }
+
+  size_t size_class = slab->size_class;
+  if (slab->in_use-- == slab->capacity) {
+    unlinkSlab(full_[size_class], slab);
+    pushSlab(partial_[size_class], slab);
+  }
+  if (slab->in_use == 0) {
+    unlinkSlab(partial_[size_class], slab);
+    if (empty_count_ < max_empty_) {
+      pushSlab(empty_, slab);
+      empty_count_++;
+    } else {
+      releaseSlab(slab);
+    }
+  }
+  objects_in_use_--;
+  object_bytes_ -= CLASS_SIZES[size_class];
+  frees_++;
+}
+
+//=============================================================================
+// Slab Management
+//=============================================================================
+
+SlabAllocator::Slab *SlabAllocator::takeSlab(size_t size_class) {
+  Slab *slab = empty_;
+  if (slab) {
+    unlinkSlab(empty_, slab);
+    empty_count_--;
+  } else {
+    // Aligned to its own size, so any object masks back to the header
+    slab = static_cast<Slab *>(parent_.my_aligned_alloc(slab_size_, slab_size_));
+    if (!slab) {
+      return nullptr;
+    }
+    slab_count_++;
+  }
+  formatSlab(slab, size_class);
+  return slab;
+}
+
+void SlabAllocator::formatSlab(Slab *slab, size_t size_class) {
+  const size_t object_size = CLASS_SIZES[size_class];
+
+  // Each object costs object_size bytes plus one bitmap bit
+  size_t capacity = (slab_size_ - sizeof(Slab) - 15) * 8 / (object_size * 8 + 1);
+  size_t words;
+  size_t header;
+  for (;;) {
+    words = (capacity + 63) / 64;
+    header = (sizeof(Slab) + words * sizeof(uint64_t) + 15) & ~size_t(15);
+    if (header + capacity * object_size <= slab_size_) {
+      break;
+    }
+    capacity--;
+  }
+
+  slab->prev = nullptr;
+  slab->next = nullptr;
+  slab->owner = this;
+  slab->objects = reinterpret_cast<char *>(slab) + header;
+  slab->object_size = static_cast<uint32_t>(object_size);
+  slab->capacity = static_cast<uint32_t>(capacity);
+  slab->in_use = 0;
+  slab->words = static_cast<uint32_t>(words);
+  slab->hint = 0;
+  slab->size_class = static_cast<uint32_t>(size_class);
+  slab->reciprocal =
+      static_cast<uint32_t>(((uint64_t(1) << 32) + object_size - 1) / object_size);
+
+  uint64_t *bits = slab->freeBits();
+  std::memset(bits, 0xFF, words * sizeof(uint64_t));
+  if (capacity % 64) {
+    bits[words - 1] = (uint64_t(1) << (capacity % 64)) - 1;
+  }
+}
+
+void SlabAllocator::releaseSlab(Slab *slab) {
+  slab->owner = nullptr;
+  parent_.my_free(slab);
+  slab_count_--;
+}
+
+void SlabAllocator::pushSlab(Slab *&head, Slab *slab) {
+  slab->prev = nullptr;
+  slab->next = head;
+  if (head) {
+    head->prev = slab;
+  }
+  head = slab;
+}
+
+void SlabAllocator::unlinkSlab(Slab *&head, Slab *slab) {
+  if (slab->prev) {
+    slab->prev->next = slab->next;
+  } else {
+    head = slab->next;
+  }
+  if (slab->next) {
+    slab->next->prev = slab->prev;
+  }
+  slab->prev = nullptr;
+  slab->next = nullptr;
+}
+
+size_t SlabAllocator::trim() {
+  size_t released = 0;
+  while (empty_) {
+    Slab *slab = empty_;
+    unlinkSlab(empty_, slab);
+    releaseSlab(slab);
+    released += slab_size_;
+  }
+  empty_count_ = 0;
+  return released;
+}
+
+//=============================================================================
+// Utility Functions
+//=============================================================================
+
+bool SlabAllocator::owns(const void *ptr) const {
+  const char *object = static_cast<const char *>(ptr);
+  for (size_t i = 0; i < NUM_CLASSES; i++) {
+    for (const Slab *list : {partial_[i], full_[i]}) {
+      for (const Slab *slab = list; slab; slab = slab->next) {
+        if (object < slab->objects ||
+            object >= slab->objects + slab->capacity * slab->object_size) {
+          continue;
+        }
+        size_t offset = static_cast<size_t>(object - slab->objects);
+        size_t index = offset / slab->object_size;
+        return offset % slab->object_size == 0 &&
+               !((slab->freeBits()[index / 64] >> (index % 64)) & 1);
+      }
+    }
+  }
+  return false;
+}
+
+size_t SlabAllocator::objectSize(const void *ptr) const {
+  const Slab *slab = reinterpret_cast<const Slab *>(
+      reinterpret_cast<uintptr_t>(ptr) & ~(slab_size_ - 1));
+  return slab->object_size;
+}
+
+SlabStats SlabAllocator::getStats() const {
+  SlabStats stats{};
+  stats.slab_size = slab_size_;
+  stats.slab_count = slab_count_;
+  stats.empty_slabs = empty_count_;
+  stats.objects_in_use = objects_in_use_;
+  stats.object_bytes = object_bytes_;
+  stats.total_allocations = allocations_;
+  stats.total_frees = frees_;
+  stats.failed_allocations = failures_;
+  return stats;
+}
+
+bool SlabAllocator::verify() const {
+  size_t slabs = 0;
+  size_t objects = 0;
+  size_t bytes = 0;
+
+  auto check = [&](const Slab *list, size_t size_class, bool full) {
+    const Slab *prev = nullptr;
+    for (const Slab *slab = list; slab; prev = slab, slab = slab->next) {
+      const uint64_t *bits = slab->freeBits();
+      size_t free_objects = 0;
+      for (size_t word = 0; word < slab->words; word++) {
+        free_objects += popCount(bits[word]);
+        if (word < slab->hint && bits[word]) {
+          return false;
+        }
+      }
+      if (slab->prev != prev || slab->owner != this ||
+          slab->size_class != size_class ||
+          free_objects != slab->capacity - slab->in_use ||
+          slab->in_use == 0 || (slab->in_use == slab->capacity) != full) {
+        return false;
+      }
+      slabs++;
+      objects += slab->in_use;
+      bytes += slab->in_use * static_cast<size_t>(slab->object_size);
+    }
+    return true;
+  };
+
+  for (size_t i = 0; i < NUM_CLASSES; i++) {
+    if (!check(partial_[i], i, false) || !check(full_[i], i, true)) {
+      return false;
+    }
+  }
+
+  size_t empty = 0;
+  for (const Slab *slab = empty_; slab; slab = slab->next) {
+    if (slab->owner != this || slab->in_use != 0) {
+      return false;
+    }
+    empty++;
+  }
+
+  return empty == empty_count_ && slabs + empty == slab_count_ &&
+         objects == objects_in_use_ && bytes == object_bytes_;
+}
+
+} // namespace CustomAllocator
@@ -0,0 +1,390 @@
+/**
+ * @file tracer.cpp
+ * @brief Custom Memory Allocator - Allocation Tracer
+ *
+ * A bounded multi-producer ring buffer: each slot carries a sequence
+ * number that tells producers when it is free and the writer thread when
+ * it is filled, so recording is one compare-and-swap and never blocks. A
+ * full buffer drops the record and counts it rather than stall the
+ * allocation. The buffer is mapped straight from the OS, so tracing
+ * works inside the preload library. A forked child stops tracing: it has
+ * no writer thread, and the parent's buffered records are its to write.
+ */
+
+#include "tracer.hpp"
+#include "os_memory.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+#if defined(__GLIBC__)
+#include <stdio_ext.h>
+#endif
+
+namespace CustomAllocator {
+
+#if defined(CUSTOM_ALLOC_TRACING)
+
+namespace detail {
+std::atomic<bool> g_tracing{false};
+} // namespace detail
+
+namespace {
+
+/// Records the writer copies out of the ring per fwrite()
+constexpr size_t WRITE_BATCH = 256;
+
+/**
+ * @struct Slot
+ * @brief Ring buffer entry
+ *
+ * For position p, sequence p means the slot is free for p's producer and
+ * p + 1 means its record is ready for the writer, which then sets it to
+ * p + capacity for the producer one lap later.
+ */
+struct Slot {
+  std::atomic<uint64_t> sequence;
+  TraceRecord record;
+};
+
+Slot *g_ring = nullptr;
+size_t g_ring_mask = 0;
+size_t g_ring_bytes = 0;
+
+/// Next position a producer claims
+alignas(64) std::atomic<uint64_t> g_head{0};
+
+/// Producers inside traceRecord(); the ring is unmapped only at zero
+alignas(64) std::atomic<size_t> g_active_producers{0};
+
+std::atomic<uint64_t> g_recorded{0};
+std::atomic<uint64_t> g_dropped{0};
+std::atomic<uint64_t> g_written{0};
+
+/// Thread ids restart at 1 with every trace
+std::atomic<uint64_t> g_trace_epoch{0};
+std::atomic<uint32_t> g_next_thread{0};
+std::chrono::steady_clock::time_point g_start;
+
+/// Guards starting and stopping, and wakes the writer early
+std::mutex g_control_mutex;
+std::condition_variable g_wake_writer;
+bool g_stop_writer = false;
+std::thread g_writer;
+std::FILE *g_file = nullptr;
+
+/// Inside a traced call; nested allocator calls are not recorded again
+thread_local bool t_in_call = false;
+
+thread_local uint32_t t_thread = 0;
+thread_local uint64_t t_thread_epoch = 0;
+
+uint32_t currentThread() {
+  uint64_t epoch = g_trace_epoch.load(std::memory_order_relaxed);
+  if (t_thread_epoch != epoch) {
+    t_thread_epoch = epoch;
+    t_thread = g_next_thread.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+  return t_thread;
+}
+
+/// Move every ready record to the file; only the writer thread calls this
+void drainRing(uint64_t &tail) {
+  TraceRecord batch[WRITE_BATCH];
+  for (;;) {
+    size_t count = 0;
+    while (count < WRITE_BATCH) {
+      Slot &slot = g_ring[tail & g_ring_mask];
+      if (slot.sequence.load(std::memory_order_acquire) != tail + 1) {
+        break;
+      }
+      batch[count++] = slot.record;
+      slot.sequence.store(tail + g_ring_mask + 1, std::memory_order_release);
+      tail++;
+    }
+    if (count == 0) {
+      return;
+    }
+    size_t written = std::fwrite(batch, sizeof(TraceRecord), count, g_file);
+    g_written.fetch_add(written, std::memory_order_relaxed);
+  }
+}
+
+void writerLoop(std::chrono::milliseconds interval) {
+  // The writer's own allocations (stdio buffers) stay out of the trace
+  t_in_call = true;
+
+  uint64_t tail = 0;
+  std::unique_lock<std::mutex> lock(g_control_mutex);
+  while (!g_stop_writer) {
+    lock.unlock();
+    drainRing(tail);
+    std::fflush(g_file);
+    lock.lock();
+    g_wake_writer.wait_for(lock, interval, [] { return g_stop_writer; });
+  }
+  lock.unlock();
+
+  // stopTracing() waited for the producers, so this drain is the last
+  drainRing(tail);
+  std::fflush(g_file);
+}
+
+#if !defined(_WIN32)
+bool g_fork_handlers = false;
+
+/// Hold the control mutex across fork() so the child's copy is unlocked
+void lockBeforeFork() { g_control_mutex.lock(); }
+
+void unlockAfterFork() { g_control_mutex.unlock(); }
+
+/**
+ * @brief Forget the parent's trace in a fork() child
+ *
+ * Only the forking thread exists in the child, so joining the writer
+ * would wait forever, and closing the file normally would write the
+ * parent's buffered records a second time. The handle, the condition
+ * variable and the producer count are reset instead; the stdio buffer is
+ * discarded where the C library allows it, and the FILE is leaked
+ * otherwise.
+ */
+void forgetTraceInChild() {
+  detail::g_tracing.store(false, std::memory_order_seq_cst);
+  g_active_producers.store(0, std::memory_order_relaxed);
+  new (&g_writer) std::thread();
+  new (&g_wake_writer) std::condition_variable();
+  if (g_file) {
+#if defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__)
+    bool saved_in_call = t_in_call;
+    t_in_call = true;
+#if defined(__GLIBC__)
+    __fpurge(g_file);
+#else
+    fpurge(g_file);
+#endif
+    std::fclose(g_file);
+    t_in_call = saved_in_call;
+#endif
+    g_file = nullptr;
+  }
+  if (g_ring) {
+    osUnmapMemory(g_ring, g_ring_bytes);
+    g_ring = nullptr;
+  }
+  g_control_mutex.unlock();
+}
+#endif
+
+/// Cleanup when a trace is still running at exit
+struct TraceShutdown {
+  ~TraceShutdown() { stopTracing(); }
+} g_shutdown;
+
+} // namespace
+
+//=============================================================================
+// Recording
+//=============================================================================
+
+namespace detail {
+
+bool traceEnter() noexcept {
+  if (t_in_call) {
+    return false;
+  }
+  t_in_call = true;
+  return true;
+}
+
+void traceRecord(TraceOp op, const void *ptr, const void *result,
+                 size_t size) noexcept {
+  bool succeeded = op == TraceOp::Free || result ||
+                   (op == TraceOp::Realloc && size == 0);
+  if (!succeeded) {
+    return;
+  }
+
+  // Announce this producer before the final check, so stopTracing()
+  // either sees it or it sees tracing off
+  g_active_producers.fetch_add(1, std::memory_order_seq_cst);
+  if (!g_tracing.load(std::memory_order_seq_cst)) {
+    g_active_producers.fetch_sub(1, std::memory_order_release);
+    return;
+  }
+
+  TraceRecord record{};
+  record.timestamp = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - g_start)
+          .count());
+  record.ptr = reinterpret_cast<uintptr_t>(ptr);
+  record.result = reinterpret_cast<uintptr_t>(result);
+  record.size = size;
+  record.thread = currentThread();
+  record.op = op;
+
+  uint64_t pos = g_head.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot &slot = g_ring[pos & g_ring_mask];
+    int64_t lag = static_cast<int64_t>(
+        slot.sequence.load(std::memory_order_acquire) - pos);
+    if (lag == 0) {
+      if (g_head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+        slot.record = record;
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        g_recorded.fetch_add(1, std::memory_order_relaxed);
+        break;
+      }
+    } else if (lag < 0) {
+      // The writer has not drained this slot since the last lap
+      g_dropped.fetch_add(1, std::memory_order_relaxed);
+      break;
+    } else {
+      pos = g_head.load(std::memory_order_relaxed);
+    }
+  }
+  g_active_producers.fetch_sub(1, std::memory_order_release);
+}
+
+void traceLeave() noexcept { t_in_call = false; }
+
+} // namespace detail
+
+//=============================================================================
+// Control
+//=============================================================================
+
+bool startTracing(const char *path, const TraceOptions &options) noexcept {
+  std::lock_guard<std::mutex> guard(g_control_mutex);
+  if (g_file) {
+    return false;
+  }
+#if !defined(_WIN32)
+  // Registered after the preload library's handlers, so the child's
+  // cleanup runs once the allocator is unlocked again
+  if (!g_fork_handlers) {
+    g_fork_handlers = pthread_atfork(lockBeforeFork, unlockAfterFork,
+                                     forgetTraceInChild) == 0;
+  }
+#endif
+
+  // Setting up the file and the writer allocates; none of it is traced
+  bool saved_in_call = t_in_call;
+  t_in_call = true;
+
+  size_t capacity = 2;
+  while (capacity < options.buffer_records && capacity < (size_t(1) << 40)) {
+    capacity <<= 1;
+  }
+  g_ring_bytes = capacity * sizeof(Slot);
+  g_ring = static_cast<Slot *>(osMapMemory(g_ring_bytes));
+  g_file = g_ring ? std::fopen(path, "wb") : nullptr;
+
+  TraceFileHeader header = {{'C', 'A', 'T', 'R'},
+                            TRACE_VERSION,
+                            sizeof(TraceRecord),
+                            0};
+  header.start_time = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  if (g_file && std::fwrite(&header, sizeof(header), 1, g_file) == 1) {
+    g_ring_mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+      new (&g_ring[i].sequence) std::atomic<uint64_t>(i);
+    }
+    g_head.store(0, std::memory_order_relaxed);
+    g_recorded.store(0, std::memory_order_relaxed);
+    g_dropped.store(0, std::memory_order_relaxed);
+    g_written.store(0, std::memory_order_relaxed);
+    g_next_thread.store(0, std::memory_order_relaxed);
+    g_trace_epoch.fetch_add(1, std::memory_order_relaxed);
+    g_start = std::chrono::steady_clock::now();
+    g_stop_writer = false;
+
+    try {
+      g_writer = std::thread(writerLoop, std::chrono::milliseconds(
+                                             options.flush_interval_ms
+                                                 ? options.flush_interval_ms
+                                                 : 1));
+      detail::g_tracing.store(true, std::memory_order_seq_cst);
+      t_in_call = saved_in_call;
+      return true;
+    } catch (const std::system_error &) {
+      // No writer thread; fall through to the cleanup
+    }
+  }
+
+  if (g_file) {
+    std::fclose(g_file);
+    g_file = nullptr;
+  }
+  if (g_ring) {
+    osUnmapMemory(g_ring, g_ring_bytes);
+    g_ring = nullptr;
+  }
+  t_in_call = saved_in_call;
+  return false;
+}
+
+void stopTracing() noexcept {
+  std::unique_lock<std::mutex> lock(g_control_mutex);
+  if (!g_file) {
+    return;
+  }
+
+  detail::g_tracing.store(false, std::memory_order_seq_cst);
+  while (g_active_producers.load(std::memory_order_seq_cst) != 0) {
+    std::this_thread::yield();
+  }
+
+  g_stop_writer = true;
+  g_wake_writer.notify_one();
+  lock.unlock();
+  g_writer.join();
+  lock.lock();
+
+  std::fclose(g_file);
+  g_file = nullptr;
+  osUnmapMemory(g_ring, g_ring_bytes);
+  g_ring = nullptr;
+}
+
+TraceStats traceStats() noexcept {
+  TraceStats stats;
+  stats.recorded = g_recorded.load(std::memory_order_relaxed);
+  stats.dropped = g_dropped.load(std::memory_order_relaxed);
+  stats.written = g_written.load(std::memory_order_relaxed);
+  return stats;
+}
+
+#else // !CUSTOM_ALLOC_TRACING
+
+namespace detail {
+
+bool traceEnter() noexcept { return false; }
+
+void traceRecord(TraceOp, const void *, const void *, size_t) noexcept {}
+
+void traceLeave() noexcept {}
+
+} // namespace detail
+
+bool startTracing(const char *, const TraceOptions &) noexcept { return false; }
+
+void stopTracing() noexcept {}
+
+TraceStats traceStats() noexcept { return TraceStats{}; }
+
+#endif // CUSTOM_ALLOC_TRACING
+
+} // namespace CustomAllocator
@@ -0,0 +1,567 @@
+/**
+ * @file alloc_replay.cpp
+ * @brief Custom Memory Allocator - Trace Replay Tool
+ *
+ * Replays a trace written by startTracing() (tracer.hpp) against one
+ * allocator configuration and reports throughput, resident memory and
+ * fragmentation as the replay goes:
+ *
+ *     alloc_replay trace.bin --backend=heap --heap-size=64M
+ *     alloc_replay trace.bin --backend=system
+ *
+ * Calls are replayed in recorded order on one thread; the recorded
+ * pointers only pair frees and reallocs with their allocations. Records
+ * dropped while tracing show up as unmatched frees and are skipped.
+ */
+
+#include "arena_set.hpp"
+#include "memory_allocator.hpp"
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace CustomAllocator;
+
+namespace {
+
+//=============================================================================
+// Backends
+//=============================================================================
+
+/// Allocator a trace is replayed against
+struct Backend {
+  virtual ~Backend() = default;
+  virtual void *allocate(size_t size) = 0;
+  virtual void *allocateZeroed(size_t size) = 0;
+  virtual void *allocateAligned(size_t alignment, size_t size) = 0;
+  virtual void *reallocate(void *ptr, size_t size) = 0;
+  virtual void deallocate(void *ptr) = 0;
+
+  /// Heap statistics, where the backend has them
+  virtual bool stats(MemoryStats &) const { return false; }
+};
+
+/// The platform's malloc, the baseline for every comparison
+struct SystemBackend : Backend {
+  void *allocate(size_t size) override { return std::malloc(size); }
+  void *allocateZeroed(size_t size) override { return std::calloc(1, size); }
+  void *allocateAligned(size_t alignment, size_t size) override {
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    void *ptr = nullptr;
+    return posix_memalign(&ptr, std::max(alignment, sizeof(void *)), size)
+               ? nullptr
+               : ptr;
+#endif
+  }
+  void *reallocate(void *ptr, size_t size) override {
+    return std::realloc(ptr, size);
+  }
+  void deallocate(void *ptr) override { std::free(ptr); }
+};
+
+/// One MemoryAllocator heap built from the command-line options
+struct HeapBackend : Backend {
+  explicit HeapBackend(const AllocatorOptions &options) : heap(options) {}
+
+  void *allocate(size_t size) override { return heap.my_malloc(size); }
+  void *allocateZeroed(size_t size) override { return heap.my_calloc(1, size); }
+  void *allocateAligned(size_t alignment, size_t size) override {
+    return heap.my_aligned_alloc(alignment, size);
+  }
+  void *reallocate(void *ptr, size_t size) override {
+    return heap.my_realloc(ptr, size);
+  }
+  void deallocate(void *ptr) override { heap.my_free(ptr); }
+  bool stats(MemoryStats &out) const override {
+    out = heap.getStats();
+    return true;
+  }
+
+  MemoryAllocator heap;
+};
+
+/// An ArenaSet (the replay thread uses one of its arenas)
+struct ArenaBackend : Backend {
+  ArenaBackend(size_t count, size_t heap_size) : arenas(count, heap_size) {}
+
+  void *allocate(size_t size) override { return arenas.my_malloc(size); }
+  void *allocateZeroed(size_t size) override {
+    return arenas.my_calloc(1, size);
+  }
+  void *allocateAligned(size_t alignment, size_t size) override {
+    return arenas.my_aligned_alloc(alignment, size);
+  }
+  void *reallocate(void *ptr, size_t size) override {
+    return arenas.my_realloc(ptr, size);
+  }
+  void deallocate(void *ptr) override { arenas.my_free(ptr); }
+  bool stats(MemoryStats &out) const override {
+    out = arenas.getStats();
+    return true;
+  }
+
+  ArenaSet arenas;
+};
+
+/// The thread-cached global custom_* functions
+struct GlobalBackend : Backend {
+  GlobalBackend(size_t count, size_t heap_size) {
+    initGlobalArenas(count, heap_size);
+  }
+  ~GlobalBackend() override { destroyGlobalAllocator(); }
+
+  void *allocate(size_t size) override { return custom_malloc(size); }
+  void *allocateZeroed(size_t size) override { return custom_calloc(1, size); }
+  void *allocateAligned(size_t alignment, size_t size) override {
+    return custom_aligned_alloc(alignment, size);
+  }
+  void *reallocate(void *ptr, size_t size) override {
+    return custom_realloc(ptr, size);
+  }
+  void deallocate(void *ptr) override { custom_free(ptr); }
+};
+
+//=============================================================================
+// Measurements
+//=============================================================================
+
+/// Resident set size now, in bytes (0 where unknown)
+size_t currentRss() {
+#if defined(__linux__)
+  std::FILE *statm = std::fopen("/proc/self/statm", "r");
+  if (!statm) {
+    return 0;
+  }
+  unsigned long pages_total = 0;
+  unsigned long pages_resident = 0;
+  int fields = std::fscanf(statm, "%lu %lu", &pages_total, &pages_resident);
+  std::fclose(statm);
+  return fields == 2 ? pages_resident * static_cast<size_t>(sysconf(_SC_PAGESIZE))
+                     : 0;
+#else
+  return 0;
+#endif
+}
+
+/// High-water mark of the resident set, in bytes (0 where unknown)
+size_t peakRss() {
+#if defined(__unix__) || defined(__APPLE__)
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return static_cast<size_t>(usage.ru_maxrss);
+#else
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#else
+  return 0;
+#endif
+}
+
+double megabytes(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+//=============================================================================
+// Command Line
+//=============================================================================
+
+struct Config {
+  std::string trace_path;
+  std::string backend = "heap";
+  AllocatorOptions heap;
+  size_t arena_count = 4;
+  uint64_t interval = 0;        ///< Records between report lines (0 = 20 lines)
+  bool touch = true;            ///< Write every page of each allocation
+};
+
+/// Parse "123", "64K", "16M" or "2G"
+bool parseSize(const char *text, size_t &out) {
+  char *end = nullptr;
+  unsigned long long value = std::strtoull(text, &end, 10);
+  if (end == text) {
+    return false;
+  }
+  switch (*end) {
+  case 'K': case 'k': value <<= 10; end++; break;
+  case 'M': case 'm': value <<= 20; end++; break;
+  case 'G': case 'g': value <<= 30; end++; break;
+  default: break;
+  }
+  out = static_cast<size_t>(value);
+  return *end == '\0';
+}
+
+bool parsePlacement(const char *text, PlacementPolicy &out) {
+  const PlacementPolicy policies[] = {
+      PlacementPolicy::FirstFit, PlacementPolicy::NextFit,
+      PlacementPolicy::BestFit, PlacementPolicy::AddressOrderedFirstFit,
+      PlacementPolicy::Tlsf};
+  for (PlacementPolicy policy : policies) {
+    if (std::strcmp(text, placementPolicyName(policy)) == 0) {
+      out = policy;
+      return true;
+    }
+  }
+  return false;
+}
+
+void printUsage(const char *program) {
+  std::printf(
+      "Usage: %s TRACE [options]\n"
+      "  --backend=heap|arenas|global|system  Allocator to replay against "
+      "(heap)\n"
+      "  --heap-size=N         Initial heap (or per-arena heap) size\n"
+      "  --segment-size=N      Minimum extra segment size\n"
+      "  --no-grow             Fail instead of mapping extra segments\n"
+      "  --alignment=8|16      Alignment of every returned pointer\n"
+      "  --large-threshold=N   Own mapping above N bytes (0 = off)\n"
+      "  --purge-threshold=N   Freed bytes that trigger a purge\n"
+      "  --lazy-purge          Purge with MADV_FREE\n"
+      "  --huge-pages          Back the heap with huge pages\n"
+      "  --placement=P         first-fit, next-fit, best-fit, "
+      "address-ordered or tlsf\n"
+      "  --arenas=N            Arenas of the arenas/global backends (4)\n"
+      "  --interval=N          Records between report lines\n"
+      "  --no-touch            Do not write to the allocated memory\n"
+      "Sizes take K, M and G suffixes.\n",
+      program);
+}
+
+bool parseArguments(int argc, char **argv, Config &config) {
+  config.heap.heap_size = 16 * 1024 * 1024;
+  config.heap.growable = true;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    size_t eq = arg.find('=');
+    std::string name = arg.substr(0, eq);
+    const char *value = eq == std::string::npos ? "" : argv[i] + eq + 1;
+    size_t number = 0;
+
+    bool ok = true;
+    if (arg.rfind("--", 0) != 0) {
+      ok = config.trace_path.empty();
+      config.trace_path = arg;
+    } else if (name == "--backend") {
+      config.backend = value;
+    } else if (name == "--heap-size") {
+      ok = parseSize(value, config.heap.heap_size);
+    } else if (name == "--segment-size") {
+      ok = parseSize(value, config.heap.segment_size);
+    } else if (name == "--no-grow") {
+      config.heap.growable = false;
+    } else if (name == "--alignment") {
+      ok = parseSize(value, config.heap.alignment);
+    } else if (name == "--large-threshold") {
+      ok = parseSize(value, config.heap.large_threshold);
+    } else if (name == "--purge-threshold") {
+      ok = parseSize(value, config.heap.purge_threshold);
+    } else if (name == "--lazy-purge") {
+      config.heap.lazy_purge = true;
+    } else if (name == "--huge-pages") {
+      config.heap.huge_pages = true;
+    } else if (name == "--placement") {
+      ok = parsePlacement(value, config.heap.placement);
+    } else if (name == "--arenas") {
+      ok = parseSize(value, config.arena_count) && config.arena_count > 0;
+    } else if (name == "--interval") {
+      ok = parseSize(value, number);
+      config.interval = number;
+    } else if (name == "--no-touch") {
+      config.touch = false;
+    } else {
+      ok = false;
+    }
+
+    if (!ok) {
+      std::fprintf(stderr, "alloc_replay: bad argument '%s'\n", argv[i]);
+      return false;
+    }
+  }
+  return !config.trace_path.empty();
+}
+
+std::unique_ptr<Backend> makeBackend(const Config &config) {
+  if (config.backend == "system") {
+    return std::make_unique<SystemBackend>();
+  }
+  if (config.backend == "heap") {
+    return std::make_unique<HeapBackend>(config.heap);
+  }
+  if (config.backend == "arenas") {
+    auto backend = std::make_unique<ArenaBackend>(config.arena_count,
+                                                  config.heap.heap_size);
+    if (!backend->arenas.setPlacementPolicy(config.heap.placement)) {
+      std::fprintf(stderr, "alloc_replay: arenas too small for %s\n",
+                   placementPolicyName(config.heap.placement));
+    }
+    return backend;
+  }
+  if (config.backend == "global") {
+    return std::make_unique<GlobalBackend>(config.arena_count,
+                                           config.heap.heap_size);
+  }
+  return nullptr;
+}
+
+//=============================================================================
+// Replay
+//=============================================================================
+
+/// Records read from the trace per fread()
+constexpr size_t READ_BATCH = 4096;
+
+struct Replay {
+  Backend &backend;
+  bool touch;
+
+  /// Recorded pointer -> (replayed pointer, size)
+  std::unordered_map<uint64_t, std::pair<void *, size_t>> live;
+  size_t live_bytes = 0;
+  size_t peak_live_bytes = 0;
+  uint64_t failed = 0;          ///< Allocations that returned nullptr
+  uint64_t unmatched = 0;       ///< Frees and reallocs of unknown pointers
+
+  void touchPages(void *ptr, size_t size) {
+    if (!touch || !ptr) {
+      return;
+    }
+    char *bytes = static_cast<char *>(ptr);
+    for (size_t offset = 0; offset < size; offset += 4096) {
+      bytes[offset] = 1;
+    }
+    if (size) {
+      bytes[size - 1] = 1;
+    }
+  }
+
+  void forget(std::unordered_map<uint64_t, std::pair<void *, size_t>>::iterator it) {
+    live_bytes -= it->second.second;
+    live.erase(it);
+  }
+
+  void remember(uint64_t recorded, void *ptr, size_t size) {
+    if (!ptr) {
+      failed++;
+      return;
+    }
+    // A free lost while tracing leaves the old entry behind
+    auto it = live.find(recorded);
+    if (it != live.end()) {
+      backend.deallocate(it->second.first);
+      forget(it);
+    }
+    live.emplace(recorded, std::make_pair(ptr, size));
+    live_bytes += size;
+    peak_live_bytes = std::max(peak_live_bytes, live_bytes);
+    touchPages(ptr, size);
+  }
+
+  void apply(const TraceRecord &record) {
+    size_t size = static_cast<size_t>(record.size);
+    switch (record.op) {
+    case TraceOp::Malloc:
+      remember(record.result, backend.allocate(size), size);
+      break;
+    case TraceOp::Calloc:
+      remember(record.result, backend.allocateZeroed(size), size);
+      break;
+    case TraceOp::AlignedAlloc:
+      remember(record.result,
+               backend.allocateAligned(static_cast<size_t>(record.ptr), size),
+               size);
+      break;
+    case TraceOp::Realloc: {
+      void *old_ptr = nullptr;
+      auto it = live.find(record.ptr);
+      if (it != live.end()) {
+        old_ptr = it->second.first;
+        forget(it);
+      } else if (record.ptr) {
+        unmatched++;
+      }
+      void *ptr = backend.reallocate(old_ptr, size);
+      if (size) {
+        remember(record.result, ptr, size);
+      }
+      break;
+    }
+    case TraceOp::Free: {
+      auto it = live.find(record.ptr);
+      if (it == live.end()) {
+        unmatched++;
+        break;
+      }
+      backend.deallocate(it->second.first);
+      forget(it);
+      break;
+    }
+    }
+  }
+
+  void releaseAll() {
+    for (auto &entry : live) {
+      backend.deallocate(entry.second.first);
+    }
+    live.clear();
+    live_bytes = 0;
+  }
+};
+
+void printReportLine(uint64_t records, double seconds, const Replay &replay,
+                     const Backend &backend) {
+  MemoryStats stats;
+  if (backend.stats(stats)) {
+    std::printf("%12llu %10.3f %10zu %10.2f %10.2f %10.2f %10.2f %7.2f%%\n",
+                static_cast<unsigned long long>(records), seconds,
+                replay.live.size(), megabytes(replay.live_bytes),
+                megabytes(currentRss()),
+                megabytes(stats.total_heap_size + stats.large_bytes),
+                megabytes(stats.used_memory + stats.large_bytes),
+                stats.getFragmentationRatio());
+  } else {
+    std::printf("%12llu %10.3f %10zu %10.2f %10.2f %10s %10s %8s\n",
+                static_cast<unsigned long long>(records), seconds,
+                replay.live.size(), megabytes(replay.live_bytes),
+                megabytes(currentRss()), "-", "-", "-");
+  }
+}
+
+} // namespace
+
+//=============================================================================
+// Main
+//=============================================================================
+
+int main(int argc, char **argv) {
+  Config config;
+  if (!parseArguments(argc, argv, config)) {
+    printUsage(argv[0]);
+    return 2;
+  }
+
+  std::FILE *trace = std::fopen(config.trace_path.c_str(), "rb");
+  if (!trace) {
+    std::fprintf(stderr, "alloc_replay: cannot open %s\n",
+                 config.trace_path.c_str());
+    return 1;
+  }
+
+  TraceFileHeader header;
+  if (std::fread(&header, sizeof(header), 1, trace) != 1 ||
+      std::memcmp(header.magic, "CATR", 4) != 0 ||
+      header.version != TRACE_VERSION ||
+      header.record_size != sizeof(TraceRecord)) {
+    std::fprintf(stderr, "alloc_replay: %s is not a version %u trace\n",
+                 config.trace_path.c_str(), TRACE_VERSION);
+    std::fclose(trace);
+    return 1;
+  }
+
+  std::fseek(trace, 0, SEEK_END);
+  uint64_t total_records =
+      (static_cast<uint64_t>(std::ftell(trace)) - sizeof(header)) /
+      sizeof(TraceRecord);
+  std::fseek(trace, sizeof(header), SEEK_SET);
+  uint64_t interval = config.interval
+                          ? config.interval
+                          : std::max<uint64_t>(total_records / 20, 1);
+
+  std::unique_ptr<Backend> backend = makeBackend(config);
+  if (!backend) {
+    std::fprintf(stderr, "alloc_replay: unknown backend '%s'\n",
+                 config.backend.c_str());
+    std::fclose(trace);
+    return 2;
+  }
+
+  std::printf("Replaying %llu records from %s against '%s'\n",
+              static_cast<unsigned long long>(total_records),
+              config.trace_path.c_str(), config.backend.c_str());
+  std::printf("%12s %10s %10s %10s %10s %10s %10s %8s\n", "records", "time s",
+              "live", "live MB", "RSS MB", "heap MB", "used MB", "frag");
+
+  Replay replay{*backend, config.touch, {}, 0, 0, 0, 0};
+  std::vector<TraceRecord> batch(READ_BATCH);
+  std::vector<uint32_t> threads;
+  uint64_t records = 0;
+  uint64_t next_report = interval;
+  double max_fragmentation = 0.0;
+  std::chrono::steady_clock::duration busy{};
+
+  size_t count;
+  while ((count = std::fread(batch.data(), sizeof(TraceRecord), READ_BATCH,
+                             trace)) > 0) {
+    // Only the replay itself is timed, not reading or reporting
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; i++) {
+      replay.apply(batch[i]);
+    }
+    busy += std::chrono::steady_clock::now() - start;
+
+    for (size_t i = 0; i < count; i++) {
+      if (std::find(threads.begin(), threads.end(), batch[i].thread) ==
+          threads.end()) {
+        threads.push_back(batch[i].thread);
+      }
+    }
+    records += count;
+
+    MemoryStats stats;
+    if (backend->stats(stats)) {
+      max_fragmentation =
+          std::max(max_fragmentation, stats.getFragmentationRatio());
+    }
+    if (records >= next_report) {
+      printReportLine(records, std::chrono::duration<double>(busy).count(),
+                      replay, *backend);
+      next_report = records + interval;
+    }
+  }
+  std::fclose(trace);
+
+  double seconds = std::chrono::duration<double>(busy).count();
+  printReportLine(records, seconds, replay, *backend);
+  size_t leaked = replay.live.size();
+  replay.releaseAll();
+
+  std::printf("\n");
+  MemoryStats stats;
+  if (backend->stats(stats)) {
+    std::printf("Placement:          %s (%.2f blocks examined per search)\n",
+                placementPolicyName(config.heap.placement),
+                stats.getAverageSearchLength());
+  }
+  std::printf("Records replayed:   %llu (%zu traced threads)\n",
+              static_cast<unsigned long long>(records), threads.size());
+  std::printf("Throughput:         %.2f Mops/s (%.3f s)\n",
+              seconds > 0 ? records / seconds / 1e6 : 0.0, seconds);
+  std::printf("Peak live bytes:    %.2f MB\n",
+              megabytes(replay.peak_live_bytes));
+  std::printf("Peak RSS:           %.2f MB\n", megabytes(peakRss()));
+  if (config.backend == "heap" || config.backend == "arenas") {
+    std::printf("Max fragmentation:  %.2f%%\n", max_fragmentation);
+  }
+  std::printf("Live at end:        %zu blocks\n", leaked);
+  std::printf("Failed allocations: %llu\n",
+              static_cast<unsigned long long>(replay.failed));
+  std::printf("Unmatched frees:    %llu\n",
+              static_cast<unsigned long long>(replay.unmatched));
+  return 0;
+}